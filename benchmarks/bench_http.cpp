@@ -0,0 +1,64 @@
+#include "benchmark_access.h"
+#include <benchmark/benchmark.h>
+#include <string>
+
+// HTTP request parsing and response formatting, done once per request on
+// the server's worker threads
+
+namespace metricstream {
+namespace {
+
+HttpServer& server() {
+    static HttpServer instance(0, 1);  // never started
+    return instance;
+}
+
+std::string make_post_request(size_t metrics) {
+    std::string body = make_metrics_json(metrics);
+    std::string request = "POST /metrics HTTP/1.1\r\n";
+    request += "Host: localhost\r\n";
+    request += "Content-Type: application/json\r\n";
+    request += "Authorization: bench_client\r\n";
+    request += "Connection: keep-alive\r\n";
+    request += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    request += body;
+    return request;
+}
+
+void BM_HttpParseRequestPost(benchmark::State& state) {
+    std::string raw = make_post_request(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        HttpRequest request = BenchmarkAccess::parse_request(server(), raw);
+        benchmark::DoNotOptimize(request);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(raw.size()));
+}
+BENCHMARK(BM_HttpParseRequestPost)->Arg(1)->Arg(100);
+
+void BM_HttpParseRequestQuery(benchmark::State& state) {
+    std::string raw = "GET /query?query=avg%20by%20(host)%20(rate(requests_total%7Bservice%3D%22api%22%7D%5B5m%5D))"
+                      "&start=1700000000000&end=1700003600000&step=15s HTTP/1.1\r\n"
+                      "Host: localhost\r\nAccept: application/json\r\nConnection: keep-alive\r\n\r\n";
+    for (auto _ : state) {
+        HttpRequest request = BenchmarkAccess::parse_request(server(), raw);
+        benchmark::DoNotOptimize(request);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(raw.size()));
+}
+BENCHMARK(BM_HttpParseRequestQuery);
+
+void BM_HttpFormatResponse(benchmark::State& state) {
+    HttpResponse response;
+    response.status_code = 200;
+    response.body = std::string(static_cast<size_t>(state.range(0)), 'x');
+    response.set_json_content();
+    for (auto _ : state) {
+        std::string wire = BenchmarkAccess::format_response(server(), response);
+        benchmark::DoNotOptimize(wire);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HttpFormatResponse)->Arg(64)->Arg(4096)->Arg(65536);
+
+} // namespace
+} // namespace metricstream
@@ -0,0 +1,110 @@
+#include "benchmark_access.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// JSON ingestion path: request body -> MetricBatch -> queue message,
+// plus the per-client rate limiter every POST goes through
+
+namespace metricstream {
+
+std::string make_metrics_json(size_t count) {
+    static const char* hosts[] = {"web1", "web2", "db1", "db2", "cache1"};
+    static const char* regions[] = {"us-west", "us-east", "eu-west", "ap-south"};
+    std::string json = "{\"metrics\": [";
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) json += ",";
+        json += "{\"name\": \"cpu_usage\", \"value\": " + std::to_string(10.0 + static_cast<double>(i % 80)) +
+                ", \"type\": \"gauge\", \"tags\": {\"host\": \"" + hosts[i % 5] +
+                "\", \"region\": \"" + regions[i % 4] + "\"}}";
+    }
+    json += "]}";
+    return json;
+}
+
+namespace {
+
+// One service for the whole run; its constructor opens the file queue and
+// starts the async writer, but the HTTP server is never started
+IngestionService& service() {
+    static IngestionService instance(0);
+    return instance;
+}
+
+void BM_ParseJsonMetrics(benchmark::State& state) {
+    std::string body = make_metrics_json(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        MetricBatch batch = BenchmarkAccess::parse_json_metrics(service(), body);
+        benchmark::DoNotOptimize(batch);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(body.size()));
+}
+BENCHMARK(BM_ParseJsonMetrics)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_ParseJsonMetricsOptimized(benchmark::State& state) {
+    std::string body = make_metrics_json(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        MetricBatch batch = BenchmarkAccess::parse_json_metrics_optimized(service(), body);
+        benchmark::DoNotOptimize(batch);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(body.size()));
+}
+BENCHMARK(BM_ParseJsonMetricsOptimized)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_SerializeMetricsBatch(benchmark::State& state) {
+    MetricBatch batch = BenchmarkAccess::parse_json_metrics_optimized(
+        service(), make_metrics_json(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        std::string json = BenchmarkAccess::serialize_metrics_batch_to_json(service(), batch);
+        benchmark::DoNotOptimize(json);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SerializeMetricsBatch)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+// Shared by all benchmark threads. Every client is registered before the
+// threads start: allow_request() inserts into its maps outside the per-client
+// locks, so first-time clients must not race.
+std::unique_ptr<RateLimiter> rate_limiter;
+constexpr int RATE_LIMITER_CLIENTS = 1024;
+
+std::string client_name(int client) {
+    return "client_" + std::to_string(client);
+}
+
+void SetupRateLimiter(const benchmark::State&) {
+    rate_limiter = std::make_unique<RateLimiter>(1000000000);
+    for (int c = 0; c < RATE_LIMITER_CLIENTS; ++c) {
+        rate_limiter->allow_request(client_name(c));
+    }
+}
+
+void TeardownRateLimiter(const benchmark::State&) {
+    rate_limiter.reset();
+}
+
+// range(0) = distinct clients; 1 puts every thread on the same lock
+void BM_RateLimiterAllowRequest(benchmark::State& state) {
+    int clients = static_cast<int>(state.range(0));
+    std::vector<std::string> names;
+    for (int c = 0; c < clients; ++c) {
+        names.push_back(client_name((c + state.thread_index()) % clients));
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rate_limiter->allow_request(names[i]));
+        if (++i == names.size()) i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RateLimiterAllowRequest)
+    ->Arg(1)->Arg(RATE_LIMITER_CLIENTS)
+    ->ThreadRange(1, 8)
+    ->Setup(SetupRateLimiter)->Teardown(TeardownRateLimiter)
+    ->UseRealTime();
+
+} // namespace
+} // namespace metricstream
@@ -0,0 +1,81 @@
+#include "partitioned_queue.h"
+#include "thread_pool.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Hand-off points between ingestion stages: the HTTP worker pool and the
+// file-backed partitioned queue
+
+namespace {
+
+// Producer side of the pool: range(0) workers draining no-op tasks. A full
+// queue (backpressure) is retried, so the number includes that wait.
+void BM_ThreadPoolEnqueue(benchmark::State& state) {
+    metricstream::ThreadPool pool(static_cast<size_t>(state.range(0)));
+    std::atomic<int64_t> executed{0};
+    for (auto _ : state) {
+        while (!pool.enqueue([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); })) {
+            std::this_thread::yield();
+        }
+    }
+    while (executed.load() < static_cast<int64_t>(state.iterations())) {
+        std::this_thread::yield();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolEnqueue)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+// Several producers (like concurrent accept paths) contending on the queue lock
+std::unique_ptr<metricstream::ThreadPool> shared_pool;
+
+void SetupSharedPool(const benchmark::State&) {
+    shared_pool = std::make_unique<metricstream::ThreadPool>(4);
+}
+
+void TeardownSharedPool(const benchmark::State&) {
+    shared_pool.reset();  // drains the remaining tasks
+}
+
+void BM_ThreadPoolEnqueueContended(benchmark::State& state) {
+    for (auto _ : state) {
+        while (!shared_pool->enqueue([]() {})) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolEnqueueContended)
+    ->ThreadRange(1, 8)
+    ->Setup(SetupSharedPool)->Teardown(TeardownSharedPool)
+    ->UseRealTime();
+
+// range(0) = message size; each produce appends one file to a partition
+void BM_PartitionedQueueProduce(benchmark::State& state) {
+    char dir_template[] = "/tmp/metricstream_bench_queue_XXXXXX";
+    const char* dir = mkdtemp(dir_template);
+    if (!dir) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+    PartitionedQueue queue(std::string(dir) + "/queue", 4);
+    std::string message(static_cast<size_t>(state.range(0)), 'm');
+    uint64_t key = 0;
+    for (auto _ : state) {
+        auto result = queue.produce("client_" + std::to_string(key++ % 64), message);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+
+    std::string cleanup = "rm -rf '" + std::string(dir) + "'";
+    if (std::system(cleanup.c_str()) != 0) {
+        state.SkipWithError("cleanup failed");
+    }
+}
+BENCHMARK(BM_PartitionedQueueProduce)->Arg(256)->Arg(4096)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "http_server.h"
+#include "ingestion_service.h"
+#include <string>
+
+namespace metricstream {
+
+// Friend of the classes whose hot paths are private helpers, so the
+// microbenchmarks can call them without going through a socket
+struct BenchmarkAccess {
+    static HttpRequest parse_request(HttpServer& server, const std::string& raw) {
+        return server.parse_request(raw);
+    }
+    static std::string format_response(HttpServer& server, const HttpResponse& response) {
+        return server.format_response(response);
+    }
+    static MetricBatch parse_json_metrics(IngestionService& service, const std::string& body) {
+        return service.parse_json_metrics(body);
+    }
+    static MetricBatch parse_json_metrics_optimized(IngestionService& service, const std::string& body) {
+        return service.parse_json_metrics_optimized(body);
+    }
+    static std::string serialize_metrics_batch_to_json(IngestionService& service, const MetricBatch& batch) {
+        return service.serialize_metrics_batch_to_json(batch);
+    }
+};
+
+// POST /metrics body with `count` metrics in the shape the load tests send
+std::string make_metrics_json(size_t count);
+
+} // namespace metricstream
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Vectorized aggregation over contiguous value/timestamp columns
+// (head block chunks, decoded block series). On x86-64 the widest available
+// instruction set (AVX-512F, then AVX2) is picked once at startup; every
+// other platform uses the scalar loops, which produce the same results up to
+// floating-point summation order. Inputs are assumed NaN-free.
+
+enum class AggregateOp { SUM, MIN, MAX, AVG, COUNT };
+
+// Partial aggregate - mergeable, so shards and buckets can be combined later
+struct Aggregate {
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    uint64_t count = 0;
+
+    double avg() const { return count ? sum / static_cast<double>(count) : 0.0; }
+    double value(AggregateOp op) const;
+    void merge(const Aggregate& other);
+};
+
+// "sum" / "min" / "max" / "avg" / "count"; throws std::invalid_argument otherwise
+AggregateOp parse_aggregate_op(const std::string& name);
+
+double sum_values(const double* values, size_t count);
+double min_values(const double* values, size_t count);  // +inf when empty
+double max_values(const double* values, size_t count);  // -inf when empty
+
+// sum, min, max and count in a single pass
+Aggregate aggregate_values(const double* values, size_t count);
+
+// Filtered aggregates: only positions where mask[i] != 0 contribute
+enum class CompareOp { GT, GE, LT, LE, EQ, NE };
+size_t build_mask(const double* values, size_t count, CompareOp op, double threshold,
+                  uint8_t* mask);  // returns number of selected positions
+Aggregate aggregate_masked(const double* values, const uint8_t* mask, size_t count);
+
+// Counter increase over the samples, treating any drop as a counter reset
+// (the post-reset value counts as the increase since the reset)
+double counter_increase(const double* values, size_t count);
+// Per-second rate between the first and last sample; 0 with fewer than two samples
+double counter_rate(const int64_t* timestamps, const double* values, size_t count);
+
+// Time-bucketed downsampling ("sum by 1m"): bucket i covers
+// [start_ts + i*step_ms, start_ts + (i+1)*step_ms). Timestamps must be sorted.
+// Samples are merged into `buckets`, which is resized to cover [start_ts, end_ts],
+// so successive chunks of one series can be fed in turn.
+void downsample(const int64_t* timestamps, const double* values, size_t count,
+                int64_t start_ts, int64_t end_ts, int64_t step_ms,
+                std::vector<Aggregate>& buckets);
+
+// Instruction set the kernels dispatched to: "avx512", "avx2" or "scalar"
+const char* aggregation_isa();
+
+} // namespace metricstream
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "aggregation_kernels.h"
+#include "alert_rules.h"
+#include "batch_codec.h"
+#include "block_storage.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace metricstream {
+
+enum class AlertState { INACTIVE, PENDING, FIRING };
+
+const char* alert_state_name(AlertState state);
+
+struct AlertEvent {
+    std::string rule;
+    SeriesDescriptor series;
+    AlertState from = AlertState::INACTIVE;
+    AlertState to = AlertState::INACTIVE;
+    double value = 0.0;        // window aggregate that caused the transition
+    int64_t timestamp_ms = 0;  // sample time of the transition
+};
+
+// Incremental alert evaluation on the ingest stream
+//
+// Instead of re-querying storage on a timer, every decoded batch from the
+// consumer is pushed through on_batch(). Each (rule, series) pair keeps its
+// window as a deque with a running sum plus monotonic deques for min/max, so
+// a point costs amortized O(1) per matching rule and transitions are detected
+// as soon as the sample that causes them arrives. Time is event time (sample
+// timestamps); samples older than the pair's newest are ignored.
+//
+// Series state is sharded by series ID so concurrent consumers (one per
+// partition) rarely contend. A series is routed through the RuleSet index
+// once, when first seen or after a rule reload, and keeps the list of rules
+// it matched; a point then only touches those rules. Only series matching at
+// least one rule are tracked; the IDs of the rest are remembered per rule set,
+// so they are matched again only after a reload. expire_stale() evicts series
+// that stopped reporting, resolving their alerts.
+//
+// Reloads compile the new RuleSet off to the side and swap a pointer, so
+// evaluation never pauses. Each series switches on its next point, keeping
+// the window and state of every rule that is unchanged in the new set; the
+// PENDING and FIRING alerts of rules it no longer has resolve to INACTIVE.
+class AlertEvaluator {
+public:
+    using EventHandler = std::function<void(const AlertEvent&)>;
+
+    struct Stats {
+        uint64_t points_evaluated = 0;  // (point, matching rule) updates
+        uint64_t transitions = 0;
+        uint64_t out_of_order = 0;
+        uint64_t expired = 0;  // series evicted by expire_stale()
+        size_t firing = 0;
+        size_t series_tracked = 0;
+        size_t series_unmatched = 0;  // cached as selected by no current rule
+    };
+
+    static constexpr int64_t DEFAULT_STALE_AFTER_MS = 10 * 60 * 1000;
+
+    // A series with no batch for stale_after_ms is dropped by expire_stale()
+    explicit AlertEvaluator(int64_t stale_after_ms = DEFAULT_STALE_AFTER_MS);
+
+    // Rules may be added or replaced while batches flow; existing series
+    // pick the change up with their next point
+    void add_rule(const AlertRule& rule);
+    void set_rules(const std::vector<AlertRule>& rules);
+    size_t rule_count() const;
+
+    // Called for every transition, from the thread that fed the batch
+    void set_event_handler(EventHandler handler);
+
+    void on_batch(const DecodedBatch& batch);
+
+    // Evicts series last seen at or before now_ms - stale_after_ms (server
+    // time: the batch timestamp); their PENDING and FIRING alerts resolve to
+    // INACTIVE through the event handler. Returns the number evicted.
+    size_t expire_stale(int64_t now_ms);
+
+    std::vector<AlertEvent> active_alerts() const;  // PENDING and FIRING
+    Stats stats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    // Sliding window aggregate with O(1) amortized updates
+    struct Window {
+        std::deque<Sample> samples;
+        std::deque<Sample> min_candidates;  // increasing values
+        std::deque<Sample> max_candidates;  // decreasing values
+        double sum = 0.0;
+
+        void add(const Sample& sample, int64_t window_ms);
+        double value(AggregateOp op) const;
+    };
+
+    struct RuleState {
+        const AlertRule* rule;  // kept alive by the series' rule_set
+        Window window;
+        AlertState state = AlertState::INACTIVE;
+        int64_t pending_since = 0;
+        double last_value = 0.0;
+        int64_t last_timestamp = 0;
+    };
+
+    struct SeriesState {
+        SeriesDescriptor descriptor;
+        std::shared_ptr<const RuleSet> rule_set;  // set the matches were computed for
+        std::vector<RuleState> rules;
+        int64_t last_seen_ms = 0;  // newest batch timestamp carrying the series
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<SeriesId, SeriesState> series;
+        // Series no rule of unmatched_rule_set selects -> last seen (ms)
+        std::unordered_map<SeriesId, int64_t> unmatched;
+        std::shared_ptr<const RuleSet> unmatched_rule_set;
+    };
+
+    mutable std::mutex rules_mutex_;  // guards the rule_set_ pointer only
+    std::shared_ptr<const RuleSet> rule_set_;
+    std::mutex reload_mutex_;  // serializes rebuilds
+
+
+    std::mutex handler_mutex_;
+    EventHandler handler_;
+
+    std::unique_ptr<Shard[]> shards_;
+    int64_t stale_after_ms_;
+
+    std::atomic<uint64_t> points_evaluated_{0};
+    std::atomic<uint64_t> transitions_{0};
+    std::atomic<uint64_t> out_of_order_{0};
+    std::atomic<uint64_t> expired_{0};
+
+    Shard& shard_for(SeriesId id) { return shards_[id % SHARD_COUNT]; }
+    std::shared_ptr<const RuleSet> current_rules() const;
+    void install(std::shared_ptr<const RuleSet> rule_set);
+    // Rules dropped by the switch emit their resolution into `events`
+    static void refresh_matches(SeriesState& series, const std::shared_ptr<const RuleSet>& rule_set,
+                                int64_t timestamp_ms, std::vector<AlertEvent>& events);
+    static AlertEvent resolve_event(const SeriesState& series, const RuleState& rule_state, int64_t timestamp_ms);
+    void evaluate(SeriesState& series, RuleState& rule_state, const Sample& sample,
+                  std::vector<AlertEvent>& events);
+    void publish(const std::vector<AlertEvent>& events);
+};
+
+} // namespace metricstream
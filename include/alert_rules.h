@@ -0,0 +1,100 @@
+#pragma once
+
+#include "aggregation_kernels.h"
+#include "series_registry.h"
+#include "tag_index.h"
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace metricstream {
+
+// Threshold rule over a sliding window of each matching series
+//
+//   cpu_high: avg_over_time(cpu_usage{region="us"}[1m]) > 80 for 30s
+//
+// The expression is <op>_over_time(<selector>[<window>]) with op one of
+// sum|avg|min|max|count, a comparison (> >= < <= == !=), a threshold and an
+// optional "for" duration the condition must hold before the alert fires.
+struct AlertRule {
+    std::string name;
+    std::vector<TagMatcher> matchers;  // includes __name__
+    AggregateOp aggregate = AggregateOp::AVG;
+    CompareOp comparison = CompareOp::GT;
+    double threshold = 0.0;
+    int64_t window_ms = 60 * 1000;
+    int64_t for_ms = 0;
+
+    // Parses "name: expression"; throws std::invalid_argument (or QueryParseError)
+    static AlertRule parse(const std::string& line);
+
+    // Canonical text in the parse() syntax: same rule -> same string
+    std::string to_string() const;
+};
+
+// Immutable, compiled set of alert rules that routes a series to the rules
+// whose matchers it satisfies
+//
+// Rules are bucketed by their __name__ equality matcher and, within a name,
+// by one more equality matcher (tag key -> value) when they have one. Matching
+// a series is then a hash lookup on its name plus one per tag, and only those
+// candidates get their full matcher list checked, with regexes compiled once
+// here. Rules without a name equality (e.g. {__name__=~"cpu_.*"}) are checked
+// against every series.
+//
+// Reloads build a new RuleSet and swap it in; rules identical to one in the
+// previous set keep the same RulePtr so per-series state can carry over.
+class RuleSet {
+public:
+    using RulePtr = std::shared_ptr<const AlertRule>;
+
+    struct Stats {
+        size_t rules = 0;
+        size_t name_buckets = 0;
+        size_t tag_routed = 0;  // rules reached through a (tag, value) lookup
+        size_t scanned = 0;     // rules checked against every series
+    };
+
+    // Exact duplicates are dropped; throws std::invalid_argument on a bad rule
+    explicit RuleSet(const std::vector<AlertRule>& rules, const RuleSet* previous = nullptr);
+
+    const std::vector<RulePtr>& rules() const { return rules_; }
+    size_t size() const { return rules_.size(); }
+    bool contains(const AlertRule* rule) const { return members_.count(rule) > 0; }
+
+    // Rules matching the series, in rule order
+    std::vector<const AlertRule*> match(const SeriesDescriptor& series) const;
+
+    Stats stats() const;
+
+private:
+    struct CompiledMatcher {
+        const TagMatcher* matcher;
+        std::unique_ptr<std::regex> regex;  // for =~ and !~
+    };
+
+    struct CompiledRule {
+        RulePtr rule;
+        std::vector<CompiledMatcher> matchers;
+    };
+
+    struct NameBucket {
+        // tag key -> tag value -> rules
+        std::unordered_map<std::string, std::unordered_map<std::string, std::vector<size_t>>> by_tag;
+        std::vector<size_t> name_only;
+    };
+
+    std::vector<RulePtr> rules_;
+    std::vector<CompiledRule> compiled_;  // parallel to rules_
+    std::unordered_map<std::string, NameBucket> by_name_;
+    std::vector<size_t> unnamed_;
+    std::unordered_set<const AlertRule*> members_;
+
+    bool matches(const CompiledRule& rule, const SeriesDescriptor& series) const;
+};
+
+} // namespace metricstream
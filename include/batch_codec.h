@@ -0,0 +1,53 @@
+#pragma once
+
+#include "metric.h"
+#include "series_registry.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Wire format for metric batches travelling through the queue (file or Kafka)
+//
+// {"batch_timestamp":"1700000000000","ingest_timestamp_us":1700000000000000,
+//  "series":[{"id":123,"name":"cpu_usage","type":"gauge","tags":{"host":"web1"}}],
+//  "points":[[123,75.5,1700000000000]]}
+//
+// Each distinct series in the batch is described once; samples are
+// compact [series_id, value, timestamp_ms] triples. batch_timestamp is when
+// the batch was encoded, ingest_timestamp_us when its POST /metrics arrived
+// (MetricBatch::received_at), for end-to-end latency at the consumer.
+
+struct EncodedPoint {
+    SeriesId series_id;
+    double value;
+    int64_t timestamp_ms;
+};
+
+struct DecodedSeries {
+    SeriesDescriptor descriptor;
+    MetricType type = MetricType::GAUGE;
+};
+
+struct DecodedBatch {
+    int64_t batch_timestamp_ms = 0;
+    int64_t ingest_timestamp_us = 0;  // 0 from producers that predate the field
+    std::vector<DecodedSeries> series;
+    std::vector<EncodedPoint> points;
+};
+
+// Metrics must already carry their series_id
+std::string encode_metrics_batch(const MetricBatch& batch);
+
+// Throws std::runtime_error on malformed input
+DecodedBatch decode_metrics_batch(const std::string& message);
+
+// ingest_timestamp_us without decoding the batch (it is written near the
+// start); 0 if absent
+int64_t peek_ingest_timestamp_us(const std::string& message);
+
+int64_t to_unix_millis(Timestamp ts);
+int64_t to_unix_micros(Timestamp ts);
+
+} // namespace metricstream
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "series_registry.h"
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace metricstream {
+
+// One series of one block, decompressed
+struct DecodedColumns {
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+};
+
+// Decompressed block series shared by every query on a storage node
+//
+// Entries are keyed by (reader id, series), so a block replaced by
+// compaction is never served from stale entries; they just age out.
+// The cache is split into SHARD_COUNT independently locked LRU shards, each
+// with 1/SHARD_COUNT of the byte budget.
+//
+// Admission is TinyLFU: every lookup bumps a small count-min sketch of
+// recent key frequencies (halved periodically so it follows the workload),
+// and a new entry that needs room is only admitted if it has been asked for
+// more often than each LRU victim it would displace. A one-off export scan
+// touches every key once, so it cannot push out the series that dashboards
+// and alert rules read over and over.
+class BlockCache {
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t admitted = 0;
+        uint64_t rejected = 0;   // turned away by the frequency filter
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+
+        double hit_ratio() const {
+            return hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+        }
+    };
+
+    explicit BlockCache(size_t max_bytes);
+
+    std::shared_ptr<const DecodedColumns> get(uint64_t block_id, SeriesId series);
+
+    // Offer a series just decoded after a get() miss
+    void put(uint64_t block_id, SeriesId series, std::shared_ptr<const DecodedColumns> columns);
+
+    Stats stats() const;
+    size_t max_bytes() const { return max_bytes_; }
+
+private:
+    struct Key {
+        uint64_t block_id;
+        SeriesId series;
+        bool operator==(const Key& other) const { return block_id == other.block_id && series == other.series; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    // Count-min sketch of 4 rows of saturating 4-bit-range counters
+    class FrequencySketch {
+    public:
+        explicit FrequencySketch(size_t width);
+        void increment(uint64_t hash);
+        uint8_t estimate(uint64_t hash) const;
+
+    private:
+        static constexpr size_t DEPTH = 4;
+        static constexpr uint8_t MAX_COUNT = 15;
+
+        std::vector<uint8_t> counters_;  // DEPTH rows of width_
+        size_t width_;                   // power of two
+        size_t additions_ = 0;
+        size_t sample_size_;             // halve every counter after this many
+
+        size_t index(uint64_t hash, size_t row) const;
+    };
+
+    struct Entry {
+        Key key;
+        std::shared_ptr<const DecodedColumns> columns;
+        size_t bytes;
+    };
+
+    struct Shard {
+        explicit Shard(size_t sketch_width) : sketch(sketch_width) {}
+
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // most recent first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries;
+        FrequencySketch sketch;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t admitted = 0;
+        uint64_t rejected = 0;
+        uint64_t evictions = 0;
+    };
+
+    size_t max_bytes_;
+    size_t shard_bytes_;
+    std::array<std::unique_ptr<Shard>, SHARD_COUNT> shards_;
+
+    Shard& shard(uint64_t hash) { return *shards_[hash % SHARD_COUNT]; }
+};
+
+} // namespace metricstream
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "metric.h"
+#include "series_registry.h"
+#include "bloom_filter.h"
+#include "block_cache.h"
+#include "io_rate_limiter.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+struct Sample {
+    int64_t timestamp_ms;
+    double value;
+};
+
+using SeriesSamples = std::map<SeriesId, std::vector<Sample>>;  // ordered by series ID
+
+// Summary of one immutable block file, kept in memory for every block so a
+// range query can pick the overlapping blocks without opening the others
+struct BlockMeta {
+    std::string path;
+    uint64_t sequence = 0;
+    int64_t min_ts = 0;
+    int64_t max_ts = 0;
+    uint32_t series_count = 0;
+    uint64_t sample_count = 0;
+    uint64_t size_bytes = 0;
+    uint32_t level = 0;  // 0 = head flush, higher = compaction output (kept in the file name)
+};
+
+// Block file layout (all integers little-endian, native width):
+//
+//   [header]  magic "MSBLOCK1", version, series_count, min_ts, max_ts,
+//             sample_count, bloom_offset/size, index_offset/size
+//   [data]    per series: Gorilla stream of (timestamp, value) pairs
+//   [bloom]   BloomFilter over series IDs in the block
+//   [index]   per series (sorted by ID): id, min_ts, max_ts, data_offset,
+//             count, data_size, name, tags
+//
+// Version 1 blocks (still readable) store raw columns instead:
+// timestamps[count] (int64) then values[count] (double), and no data_size.
+class BlockWriter {
+public:
+    // Samples for each series must be sorted by timestamp.
+    // Written to <path>.tmp then renamed, so readers never see partial blocks.
+    // With a limiter the file is written in slices paced by it.
+    static BlockMeta write(const std::string& path, uint64_t sequence,
+                           const std::vector<SeriesDescriptor>& series,
+                           const SeriesSamples& samples,
+                           IoRateLimiter* limiter = nullptr);
+};
+
+class BlockReader {
+public:
+    // Loads header, bloom filter and series index; data stays on disk.
+    // Throws std::runtime_error if the file is missing or corrupt.
+    explicit BlockReader(const std::string& path);
+    ~BlockReader();
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    const BlockMeta& meta() const { return meta_; }
+    bool overlaps(int64_t start_ts, int64_t end_ts) const {
+        return meta_.min_ts <= end_ts && meta_.max_ts >= start_ts;
+    }
+    bool might_contain(SeriesId id) const { return bloom_.might_contain(id); }
+
+    // Samples of one series within [start_ts, end_ts], appended to `out`
+    // Returns false if the series is not in this block. With a cache the
+    // decompressed series is looked up there first and offered to it after
+    // a miss; bulk readers (compaction, backfill) pass none.
+    bool read_series(SeriesId id, int64_t start_ts, int64_t end_ts,
+                     std::vector<Sample>& out, BlockCache* cache = nullptr) const;
+
+    // Series labels stored in the block (used to rebuild the tag index)
+    const std::vector<SeriesDescriptor>& series() const { return series_; }
+
+private:
+    struct IndexEntry {
+        SeriesId id;
+        int64_t min_ts;
+        int64_t max_ts;
+        uint64_t offset;
+        uint32_t count;
+        uint64_t size;  // bytes of series data
+    };
+
+    int fd_ = -1;
+    uint32_t version_ = 0;
+    uint64_t cache_id_;  // unique per reader, so replaced files never share cache entries
+    BlockMeta meta_;
+    BloomFilter bloom_;
+    std::vector<IndexEntry> index_;           // sorted by id
+    std::vector<SeriesDescriptor> series_;    // parallel to index_
+
+    void read_exact(void* buf, size_t len, uint64_t offset) const;
+};
+
+// Directory of time-bucketed blocks
+// Every block holds samples from a single bucket of block_duration_ms, so the
+// blocks that can overlap [start, end] are found with one binary search over
+// the in-memory list (sorted by min_ts) instead of opening every file.
+class BlockStore {
+public:
+    static constexpr int64_t DEFAULT_BLOCK_DURATION_MS = 2 * 60 * 60 * 1000;  // 2 hours
+
+    // Query reads go through `cache` when given (not owned)
+    explicit BlockStore(const std::string& directory,
+                        int64_t block_duration_ms = DEFAULT_BLOCK_DURATION_MS,
+                        BlockCache* cache = nullptr);
+
+    // Persist samples as a new block and make it visible to queries
+    BlockMeta add_block(const std::vector<SeriesDescriptor>& series, const SeriesSamples& samples);
+
+    // Atomically swap `inputs` for one block holding `samples` at `level`:
+    // queries see either all inputs or the output, never both or neither.
+    // A <block>.parents file lists the inputs until they are deleted, so a
+    // crash in between drops them on the next load instead of keeping both.
+    // The output takes the newest input's sequence, so a block added to the
+    // bucket while the inputs were being merged still reads after it; the
+    // output level must differ from that input's (the file name would clash).
+    BlockMeta replace_blocks(const std::vector<std::shared_ptr<BlockReader>>& inputs,
+                             const std::vector<SeriesDescriptor>& series, const SeriesSamples& samples,
+                             uint32_t level, IoRateLimiter* limiter = nullptr);
+
+    // Relabel a block with another level by renaming its file (no rewrite)
+    BlockMeta move_block(const std::shared_ptr<BlockReader>& block, uint32_t level);
+
+    // Every block, sorted by (min_ts, sequence)
+    std::vector<std::shared_ptr<BlockReader>> all_blocks() const;
+
+    // Blocks whose [min_ts, max_ts] intersects the range, oldest first
+    std::vector<std::shared_ptr<BlockReader>> blocks_overlapping(int64_t start_ts, int64_t end_ts) const;
+
+    // Read the given series over the range from every overlapping block, in
+    // write (sequence) order so the newest copy of a timestamp comes last.
+    // Returns the number of blocks actually read (after bloom filtering).
+    size_t read(const std::vector<SeriesId>& series_ids, int64_t start_ts, int64_t end_ts,
+                SeriesSamples& out) const;
+
+    std::vector<BlockMeta> list_blocks() const;
+    size_t block_count() const;
+
+    // Series labels across all blocks loaded from disk at startup
+    std::vector<SeriesDescriptor> loaded_series() const;
+
+    int64_t bucket_start(int64_t ts) const;
+    int64_t block_duration_ms() const { return block_duration_ms_; }
+    const std::string& directory() const { return directory_; }
+
+private:
+    std::string directory_;
+    int64_t block_duration_ms_;
+    BlockCache* cache_;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<std::shared_ptr<BlockReader>> blocks_;  // sorted by (min_ts, sequence)
+    std::atomic<uint64_t> next_sequence_{1};
+
+    void load_existing_blocks();
+    void finish_interrupted_replacements();
+    void insert_sorted(std::shared_ptr<BlockReader> block);
+};
+
+} // namespace metricstream
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Probabilistic membership filter stored alongside each storage block
+// Answers "might this block contain series X?" so range queries can skip
+// blocks without touching their series index. No false negatives.
+class BloomFilter {
+public:
+    // Size the filter for the expected number of keys and target false-positive rate
+    explicit BloomFilter(size_t expected_items = 1024, double false_positive_rate = 0.01);
+
+    void add(uint64_t key);
+    bool might_contain(uint64_t key) const;
+
+    void add(const std::string& key) { add(hash_string(key)); }
+    bool might_contain(const std::string& key) const { return might_contain(hash_string(key)); }
+
+    size_t bit_count() const { return num_bits_; }
+    size_t hash_count() const { return num_hashes_; }
+
+    // Compact binary form for embedding in block files
+    std::string serialize() const;
+    static BloomFilter deserialize(const std::string& data);
+
+    static uint64_t hash_string(const std::string& key);
+
+private:
+    BloomFilter(size_t num_bits, uint32_t num_hashes, std::vector<uint64_t> words);
+
+    size_t num_bits_;
+    uint32_t num_hashes_;
+    std::vector<uint64_t> words_;
+};
+
+} // namespace metricstream
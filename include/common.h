@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace metricstream {
+
+// Append value as a quoted JSON string. Escapes '"', '\' and every control
+// character (the short forms where JSON has them, \u00XX otherwise); other
+// bytes pass through, so UTF-8 input stays UTF-8.
+void append_json_string(std::string& out, std::string_view value);
+
+// Same, as a new string
+std::string json_string(std::string_view value);
+
+// Append a \uXXXX code point (as decoded by string parsers) as UTF-8
+void append_utf8(std::string& out, uint32_t code_point);
+
+} // namespace metricstream
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "block_storage.h"
+#include "io_rate_limiter.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metricstream {
+
+enum class CompactionStrategy { NONE, TIME_WINDOW, LEVELED };
+
+// "none", "time_window" or "leveled"; throws std::invalid_argument otherwise
+CompactionStrategy parse_compaction_strategy(const std::string& name);
+const char* compaction_strategy_name(CompactionStrategy strategy);
+
+struct CompactionOptions {
+    CompactionStrategy strategy = CompactionStrategy::TIME_WINDOW;
+    size_t min_input_blocks = 4;                   // blocks of one level merged at once
+    uint32_t max_level = 4;
+    uint64_t level_base_bytes = 8 * 1024 * 1024;   // leveled: L1 size per window before it moves down
+    uint64_t level_size_ratio = 10;                // leveled: each level holds this much more
+    uint64_t io_bytes_per_second = 32 * 1024 * 1024;  // read + write budget (0 = unlimited)
+    int64_t interval_ms = 30000;                   // background check period (0 = manual only)
+    int64_t window_grace_ms = 15 * 60 * 1000;      // a window closes this long after it ends
+};
+
+// Cumulative since the compactor was created
+struct CompactionStats {
+    uint64_t compactions = 0;
+    uint64_t failures = 0;
+    uint64_t input_blocks = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;   // by compaction
+    uint64_t bytes_flushed = 0;   // by head flushes
+    uint64_t throttled_ns = 0;    // waiting on the I/O limiter
+
+    // Bytes written to disk per byte flushed from the head (1 = no rewrites)
+    double write_amplification() const {
+        return bytes_flushed ? static_cast<double>(bytes_flushed + bytes_written) / bytes_flushed : 1.0;
+    }
+};
+
+// One merge: blocks (by sequence) of a single window and the output level
+struct CompactionPlan {
+    int64_t window_start = 0;
+    std::vector<uint64_t> sequences;
+    uint32_t output_level = 0;
+};
+
+// Background merging of the small blocks head flushes leave behind
+//
+// Every block covers one time window (the store's block bucket), so merges
+// never cross windows and the single-bucket invariant holds for the output.
+// A merge into level L also takes every block of the window below L, so a
+// lower level only ever holds newer writes and the output, which keeps the
+// newest input's sequence, wins duplicate timestamps the way its inputs did
+// and loses to blocks flushed while it was being written. A merge whose
+// window gained blocks while its inputs were read is dropped and replanned.
+//
+// TIME_WINDOW: in a window still being written, min_input_blocks blocks of
+// one level merge into one block of the next (size-tiered), so a window's
+// rewrites grow with log(flushes). Once the window is window_grace_ms past
+// its end it is merged into a single max_level block, which is never
+// rewritten again; samples arriving later are merged among themselves only.
+//
+// LEVELED: each window keeps L0 flushes plus at most one block per level.
+// min_input_blocks L0 blocks merge into L1, and a level larger than
+// level_base_bytes * level_size_ratio^(L-1) merges into the next, rewriting
+// the block there. Fewer files per window, at a higher write amplification.
+//
+// Reads and writes go through an IoRateLimiter so compaction cannot take
+// the disk bandwidth head flushes need; the block swap itself is a short
+// exclusive lock in BlockStore::replace_blocks().
+class Compactor {
+public:
+    // Turns the samples of every input, concatenated per series in sequence
+    // order, into the sorted samples of the output block
+    using MergeFunction = std::function<void(SeriesSamples& samples)>;
+
+    // The default merge keeps the latest copy of each timestamp
+    Compactor(BlockStore& store, const CompactionOptions& options, MergeFunction merge = {});
+    ~Compactor();
+
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+
+    // Background thread checking every interval_ms and after notify()
+    void start();
+    void stop();
+    void notify();
+
+    // Next merge the strategy would do for these blocks, if any
+    std::optional<CompactionPlan> plan(const std::vector<BlockMeta>& blocks) const;
+
+    // Run one merge now; returns false if there was nothing to do
+    bool compact_once();
+
+    // Counted towards write amplification
+    void record_flush(uint64_t bytes) { bytes_flushed_.fetch_add(bytes, std::memory_order_relaxed); }
+
+    CompactionStats stats() const;
+    const CompactionOptions& options() const { return options_; }
+
+private:
+    BlockStore& store_;
+    CompactionOptions options_;
+    MergeFunction merge_;
+    IoRateLimiter limiter_;
+
+    std::mutex compact_mutex_;  // one merge at a time
+    std::mutex wait_mutex_;
+    std::condition_variable cv_;
+    bool pending_ = false;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::atomic<uint64_t> compactions_{0};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<uint64_t> input_blocks_{0};
+    std::atomic<uint64_t> bytes_read_{0};
+    std::atomic<uint64_t> bytes_written_{0};
+    std::atomic<uint64_t> bytes_flushed_{0};
+
+    void run();
+    std::optional<CompactionPlan> plan_window(int64_t window_start, const std::vector<const BlockMeta*>& blocks,
+                                              bool closed) const;
+};
+
+} // namespace metricstream
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Gorilla time-series compression (Pelkonen et al., VLDB 2015)
+// Timestamps: delta-of-delta with variable-length buckets - regular scrape
+// intervals cost 1 bit per sample. Values: XOR with the previous value,
+// storing only the meaningful bits - slowly changing gauges cost a few bits.
+class GorillaEncoder {
+public:
+    void append(int64_t timestamp_ms, double value);
+
+    size_t count() const { return count_; }
+
+    // Encoded stream: [count:u32][bitstream]
+    std::string finish() const;
+
+private:
+    std::vector<uint8_t> bytes_;
+    uint8_t bit_pos_ = 0;  // bits used in the last byte (0 = start new byte)
+
+    size_t count_ = 0;
+    int64_t prev_ts_ = 0;
+    int64_t prev_delta_ = 0;
+    uint64_t prev_value_bits_ = 0;
+    uint8_t prev_leading_ = 0xFF;  // 0xFF = no previous XOR window
+    uint8_t prev_trailing_ = 0;
+
+    void write_bits(uint64_t value, int num_bits);
+    void write_bit(bool bit) { write_bits(bit ? 1 : 0, 1); }
+};
+
+// Decode a stream produced by GorillaEncoder::finish(), appending to the columns.
+// Throws std::runtime_error if the stream is truncated.
+void gorilla_decode(const char* data, size_t size,
+                    std::vector<int64_t>& timestamps, std::vector<double>& values);
+
+} // namespace metricstream
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// High dynamic range histogram of non-negative integer values (e.g. latency
+// in microseconds)
+//
+// Values are bucketed log-linearly: each power-of-two range is split into
+// 2^k equal sub-buckets, where 2^k is chosen to hold `significant_digits`
+// decimal digits. Every recorded value is reported within that relative
+// precision (0.1% for 3 digits) from 1 up to highest_trackable, in a fixed
+// array of counts (about 190 KB for 3 digits over an hour in microseconds).
+// Values above highest_trackable are clamped, but max() stays exact.
+//
+// Not thread-safe: keep one per thread and merge() them for reporting.
+class HdrHistogram {
+public:
+    explicit HdrHistogram(int64_t highest_trackable = 3600LL * 1000 * 1000, int significant_digits = 3);
+
+    void record(int64_t value, uint64_t count = 1);
+    void merge(const HdrHistogram& other);  // same configuration required
+    void reset();
+
+    uint64_t count() const { return total_count_; }
+    int64_t min() const;
+    int64_t max() const { return total_count_ ? max_ : 0; }
+    double mean() const;
+
+    // Smallest value v such that `percentile`% of recorded values are <= v,
+    // reported as the highest value equivalent to v's bucket; 0 when empty
+    int64_t value_at_percentile(double percentile) const;
+
+    // "p50=.. p90=.. p99=.. p99.9=.. p99.99=.. max=.." with the given unit suffix
+    std::string summary(const std::string& unit) const;
+
+private:
+    int64_t highest_trackable_;
+    int significant_digits_;
+    int sub_bucket_half_count_magnitude_;
+    int64_t sub_bucket_count_;
+    int64_t sub_bucket_half_count_;
+    int64_t sub_bucket_mask_;
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_count_ = 0;
+    int64_t min_ = INT64_MAX;
+    int64_t max_ = 0;
+    double sum_ = 0.0;
+
+    size_t counts_index(int64_t value) const;
+    int64_t value_at_index(size_t index) const;
+    int64_t highest_equivalent_value(int64_t value) const;
+};
+
+} // namespace metricstream
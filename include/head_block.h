@@ -0,0 +1,152 @@
+#pragma once
+
+#include "metric.h"
+#include "block_storage.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace metricstream {
+
+// Fixed-size columnar chunk of one series
+// Timestamps and values live in separate contiguous arrays, each starting on
+// a cache line, so a range scan walks two dense streams with no per-sample
+// pointer chasing.
+struct alignas(64) HeadChunk {
+    static constexpr size_t CAPACITY = 64;
+
+    int64_t timestamps[CAPACITY];
+    double values[CAPACITY];
+    uint32_t count = 0;
+    bool sealed = false;  // no more appends (full, crossed a bucket, or being flushed)
+
+    bool full() const { return count == CAPACITY; }
+    int64_t min_ts() const { return timestamps[0]; }
+    int64_t max_ts() const { return timestamps[count - 1]; }
+};
+
+// In-memory head block: the most recent samples of every series
+// Appends go to the open chunk of the series; a chunk never spans two block
+// buckets, so flushed chunks map onto the single-bucket block invariant.
+// Queries over the recent window are served from memory; older chunks are
+// periodically handed to the storage engine and written out as blocks.
+//
+// A sample older than its series' newest one, but no more than the
+// out-of-order window behind it, goes to a small
+// per-series side buffer instead of the chunks, so in-order appends keep
+// their fast path. Flushes write these samples as blocks of their own and
+// compaction merges them with the in-order blocks of the same window.
+class HeadBlock {
+public:
+    // Column view handed to scan callbacks; valid only during the callback
+    using ChunkVisitor = std::function<void(const int64_t* timestamps, const double* values, size_t count)>;
+
+    // Chunks taken by collect_flushable(), grouped by bucket start
+    struct FlushBatch {
+        std::map<int64_t, SeriesSamples> buckets;
+        std::map<int64_t, SeriesSamples> out_of_order_buckets;  // written as separate blocks
+        std::vector<std::pair<SeriesId, size_t>> taken;  // series -> chunks taken from the front
+        std::vector<SeriesId> out_of_order_taken;
+        size_t sample_count = 0;
+
+        bool empty() const { return sample_count == 0; }
+    };
+
+    // out_of_order_window_ms = 0 rejects every out-of-order sample
+    explicit HeadBlock(int64_t block_duration_ms, int64_t out_of_order_window_ms = 0);
+
+    // An equal timestamp overwrites the last value. Older samples within the
+    // out-of-order window are buffered (the same timestamp again overwrites);
+    // anything older is rejected (returns false).
+    bool append(SeriesId id, int64_t timestamp_ms, double value);
+
+    // Visit the in-range part of every chunk of the series, oldest first,
+    // then the buffered out-of-order samples (sorted among themselves)
+    void scan(SeriesId id, int64_t start_ts, int64_t end_ts, const ChunkVisitor& visitor) const;
+
+    // Samples in [start_ts, end_ts] in timestamp order, appended to `out`;
+    // an out-of-order sample follows an in-order one with the same timestamp
+    void read(SeriesId id, int64_t start_ts, int64_t end_ts, std::vector<Sample>& out) const;
+
+    // Copy out every chunk whose samples are all older than cutoff_ts, and
+    // every out-of-order sample older than it. Both stay readable until
+    // release() so queries never miss them while the blocks are being
+    // written. Only one flush may be in progress.
+    FlushBatch collect_flushable(int64_t cutoff_ts);
+    void release(const FlushBatch& batch);
+
+    // Drop series with nothing left in memory whose newest sample is older
+    // than before_ts, so label churn does not grow the head forever. A later
+    // sample starts the series afresh. Returns how many were dropped.
+    size_t evict_idle(int64_t before_ts);
+
+    size_t series_count() const;
+    size_t sample_count() const { return sample_count_.load(std::memory_order_relaxed); }
+    size_t chunk_count() const { return chunk_count_.load(std::memory_order_relaxed); }
+    size_t memory_bytes() const { return chunk_count() * sizeof(HeadChunk); }
+    uint64_t out_of_order_rejected() const { return out_of_order_.load(std::memory_order_relaxed); }
+    uint64_t out_of_order_accepted() const { return out_of_order_accepted_.load(std::memory_order_relaxed); }
+    int64_t out_of_order_window_ms() const { return out_of_order_window_ms_; }
+    int64_t max_timestamp() const { return max_timestamp_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    // Columns sorted by timestamp
+    struct OutOfOrderSamples {
+        std::vector<int64_t> timestamps;
+        std::vector<double> values;
+
+        size_t size() const { return timestamps.size(); }
+    };
+
+    // Allocated on the first out-of-order sample of a series
+    struct OutOfOrderBuffer {
+        OutOfOrderSamples pending;
+        OutOfOrderSamples flushing;  // taken by collect_flushable(), until release()
+    };
+
+    struct MemSeries {
+        mutable std::mutex mutex;
+        std::deque<std::unique_ptr<HeadChunk>> chunks;  // oldest first
+        int64_t last_ts = INT64_MIN;
+        std::unique_ptr<OutOfOrderBuffer> out_of_order;
+        bool evicted = false;  // removed from its shard; appends must look it up again
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<SeriesId, std::shared_ptr<MemSeries>> series;
+    };
+
+    int64_t block_duration_ms_;
+    int64_t out_of_order_window_ms_;
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    std::atomic<size_t> sample_count_{0};
+    std::atomic<size_t> chunk_count_{0};
+    std::atomic<uint64_t> out_of_order_{0};  // rejected
+    std::atomic<uint64_t> out_of_order_accepted_{0};
+    std::atomic<int64_t> max_timestamp_{INT64_MIN};
+
+    Shard& shard_for(SeriesId id) { return shards_[id % SHARD_COUNT]; }
+    const Shard& shard_for(SeriesId id) const { return shards_[id % SHARD_COUNT]; }
+
+    // Shared so callers can keep using a series evict_idle() removes
+    std::shared_ptr<MemSeries> get_or_create(SeriesId id);
+    std::shared_ptr<const MemSeries> find(SeriesId id) const;
+    int64_t bucket_start(int64_t ts) const;
+    bool append_out_of_order(MemSeries& series, int64_t timestamp_ms, double value);
+    void collect_out_of_order(SeriesId id, OutOfOrderBuffer& buffer, int64_t cutoff_ts, FlushBatch& batch);
+};
+
+} // namespace metricstream
@@ -12,15 +12,28 @@ namespace metricstream {
 
 struct HttpRequest {
     std::string method;
-    std::string path;
+    std::string path;                                           // without query string
     std::string body;
     std::unordered_map<std::string, std::string> headers;
+    std::unordered_map<std::string, std::string> query_params;  // URL-decoded
+
+    // False once the client has closed its connection, so long-running
+    // handlers can stop early (always true when not set by the server)
+    std::function<bool()> client_connected;
 };
 
+// Sends one chunk of a streamed body; returns false once the client is gone
+using ChunkWriter = std::function<bool(const std::string& chunk)>;
+
 struct HttpResponse {
     int status_code = 200;
     std::string body;
     std::unordered_map<std::string, std::string> headers;
+
+    // When set, `body` is ignored and the producer writes the body in chunks
+    // (Transfer-Encoding: chunked) after the headers have gone out, so large
+    // results are never held in memory in full
+    std::function<void(const ChunkWriter& write_chunk)> body_stream;
     
     void set_json_content() {
         headers["Content-Type"] = "application/json";
@@ -38,16 +51,27 @@ public:
     void start();
     void stop();
 
+    // Gauges for GET /metrics
+    size_t queue_depth() const { return thread_pool_->queue_size(); }  // accepted, waiting for a worker
+    size_t active_connections() const { return active_connections_.load(std::memory_order_relaxed); }
+
 private:
+    friend struct BenchmarkAccess;  // benchmarks/ drives the parse/format hot path directly
+
     int port_;
     std::atomic<bool> running_;
+    std::atomic<int> server_fd_{-1};  // Listening socket, shut down by stop() to unblock accept()
     std::unique_ptr<std::thread> server_thread_;
     std::unique_ptr<ThreadPool> thread_pool_;  // Phase 6: Thread pool
+    std::atomic<size_t> active_connections_{0};  // accepted and not yet closed
 
     void run_server();
     HttpResponse handle_request(const HttpRequest& request);
     HttpRequest parse_request(const std::string& raw_request);
     std::string format_response(const HttpResponse& response);
+    void send_streamed_response(int client_socket, const HttpResponse& response);
+    static std::unordered_map<std::string, std::string> parse_query_string(const std::string& query);
+    static std::string url_decode(const std::string& value);
 
     std::unordered_map<std::string, std::unordered_map<std::string, HttpHandler>> handlers_;
 };
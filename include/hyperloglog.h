@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace metricstream {
+
+// HyperLogLog distinct-count sketch with lock-free register updates
+// Used for per-tenant series cardinality: fixed 2^precision bytes per tenant
+// no matter how many series it sends (~0.8% standard error at precision 14).
+class HyperLogLog {
+public:
+    explicit HyperLogLog(uint8_t precision = 14);
+
+    // Add a pre-hashed 64-bit key (safe to call concurrently)
+    void add(uint64_t hash);
+
+    // Estimated number of distinct keys added
+    double estimate() const;
+
+    // Fold another sketch of the same precision into this one
+    void merge(const HyperLogLog& other);
+
+    uint8_t precision() const { return precision_; }
+
+private:
+    uint8_t precision_;
+    size_t num_registers_;
+    std::unique_ptr<std::atomic<uint8_t>[]> registers_;
+};
+
+} // namespace metricstream
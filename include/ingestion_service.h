@@ -4,12 +4,16 @@
 #include "http_server.h"
 #include "partitioned_queue.h"
 #include "kafka_producer.h"
+#include "series_registry.h"
+#include "metrics_registry.h"
+#include "metric_validator.h"
 #include <memory>
 #include <atomic>
 #include <unordered_map>
 #include <deque>
 #include <chrono>
 #include <mutex>
+#include <shared_mutex>
 #include <array>
 #include <atomic>
 #include <fstream>
@@ -25,17 +29,6 @@ enum class QueueMode {
     KAFKA        // Use Kafka message queue
 };
 
-class MetricValidator {
-public:
-    struct ValidationResult {
-        bool valid;
-        std::string error_message;
-    };
-    
-    ValidationResult validate_metric(const Metric& metric) const;
-    ValidationResult validate_batch(const MetricBatch& batch) const;
-};
-
 struct MetricEvent {
     std::chrono::time_point<std::chrono::steady_clock> timestamp;
     bool allowed;
@@ -54,12 +47,20 @@ struct ClientMetrics {
 
 class RateLimiter {
 public:
-    RateLimiter(size_t max_requests_per_second);
+    // Decisions are counted in `registry` (a private one when null)
+    explicit RateLimiter(size_t max_requests_per_second, MetricsRegistry* registry = nullptr);
     bool allow_request(const std::string& client_id);
+
+    // Drains the per-client event rings into per-client rejection counters
     void flush_metrics();
     
 private:
     size_t max_requests_;
+
+    std::unique_ptr<MetricsRegistry> own_registry_;
+    MetricsRegistry* registry_;
+    Counter* allowed_;
+    Counter* rejected_;
     
     // Hash-based per-client mutex pool (Phase 4 optimization)
     static constexpr size_t MUTEX_POOL_SIZE = 10007;  // Prime number for better distribution
@@ -70,13 +71,27 @@ private:
     
     // Metrics collection data structures  
     std::unordered_map<std::string, ClientMetrics> client_metrics_;
+    std::shared_mutex client_metrics_mutex_;  // guards the map, not the rings
+    std::mutex flush_mutex_;                  // one reader per ring at a time
+
+    // Client IDs come from request headers, so only the first clients to be
+    // rejected get their own series; the rest share client="other"
+    static constexpr size_t MAX_LABELED_CLIENTS = 20;
+    std::unordered_map<std::string, Counter*> client_rejections_;  // under flush_mutex_
+    Counter* other_rejections_ = nullptr;
     
     // Helper method to get client-specific mutex
     std::mutex& get_client_mutex(const std::string& client_id);
     
-    void send_to_monitoring(const std::string& client_id, 
-                           const std::chrono::time_point<std::chrono::steady_clock>& timestamp, 
-                           bool allowed);
+    void send_to_monitoring(const std::string& client_id, size_t rejected);
+};
+
+// A batch waiting for the async writer
+struct PendingWrite {
+    MetricBatch batch;
+    std::string client_id;
+    uint64_t trace_id = 0;     // sampled request that produced it, 0 if none
+    int64_t enqueued_ns = 0;   // trace_clock_ns() at enqueue, set only when traced
 };
 
 class IngestionService {
@@ -94,11 +109,16 @@ public:
     size_t get_total_batches_processed() const { return batches_processed_; }
     size_t get_validation_errors() const { return validation_errors_; }
     size_t get_rate_limited_requests() const { return rate_limited_; }
+    size_t get_series_count() const { return series_registry_->series_count(); }
     
 private:
+    friend struct BenchmarkAccess;  // benchmarks/ drives the parsing helpers directly
+
+    MetricsRegistry metrics_registry_;  // declared first: outlives everything it samples
     std::unique_ptr<HttpServer> server_;
     std::unique_ptr<MetricValidator> validator_;
     std::unique_ptr<RateLimiter> rate_limiter_;
+    std::unique_ptr<SeriesRegistry> series_registry_;  // (name, tags) -> series ID
     
     std::atomic<size_t> metrics_received_;
     std::atomic<size_t> batches_processed_;
@@ -115,16 +135,21 @@ private:
     std::mutex file_mutex_;
     
     // Asynchronous batch writer infrastructure
-    std::queue<std::pair<MetricBatch, std::string>> write_queue_;  // pair<batch, client_id>
+    std::queue<PendingWrite> write_queue_;
     std::mutex queue_mutex_;
     std::condition_variable queue_cv_;
     std::thread writer_thread_;
     std::atomic<bool> writer_running_{true};
+    std::atomic<size_t> write_queue_bytes_{0};  // approximate in-memory size of write_queue_
     
     // HTTP handlers
     HttpResponse handle_metrics_post(const HttpRequest& request);
     HttpResponse handle_health_check(const HttpRequest& request);
     HttpResponse handle_metrics_get(const HttpRequest& request);
+    HttpResponse handle_internal_metrics(const HttpRequest& request);
+    HttpResponse handle_internal_traces(const HttpRequest& request);
+    HttpResponse handle_internal_profile(const HttpRequest& request);
+    void register_self_metrics();
     
     // Helper methods
     MetricBatch parse_json_metrics_optimized(const std::string& json_body);
@@ -136,6 +161,7 @@ private:
     void store_metrics_to_queue(const MetricBatch& batch, const std::string& client_id);
     void queue_metrics_for_async_write(const MetricBatch& batch, const std::string& client_id);
     void async_writer_loop();
+    static size_t approximate_batch_bytes(const MetricBatch& batch);
     std::string serialize_metrics_batch_to_json(const MetricBatch& batch);
     std::string create_error_response(const std::string& message);
     std::string create_success_response(size_t metrics_count);
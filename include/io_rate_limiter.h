@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace metricstream {
+
+// Byte token bucket for background disk I/O
+// acquire() blocks until the bytes fit under the rate, so a background job
+// (compaction) streams at a steady pace instead of bursting against head
+// flushes. Up to one second of unused budget accumulates; a request larger
+// than that waits for a full bucket and leaves it in debt. 0 = unlimited.
+class IoRateLimiter {
+public:
+    explicit IoRateLimiter(uint64_t bytes_per_second);
+
+    // Waits for budget; returns false once cancel() has been called
+    bool acquire(uint64_t bytes);
+
+    // Fails current and future acquire() calls (used on shutdown)
+    void cancel();
+
+    uint64_t bytes_per_second() const;
+    uint64_t throttled_ns() const;  // total time callers spent waiting
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    uint64_t rate_;
+    double tokens_;
+    Clock::time_point last_refill_;
+    bool cancelled_ = false;
+    uint64_t throttled_ns_ = 0;
+
+    void refill(Clock::time_point now);
+};
+
+} // namespace metricstream
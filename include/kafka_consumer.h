@@ -6,6 +6,7 @@
 #include <vector>
 #include <functional>
 #include <atomic>
+#include <cstdint>
 
 class KafkaConsumer {
 private:
@@ -20,8 +21,10 @@ public:
     KafkaConsumer(const std::string& brokers, const std::string& topic, const std::string& group_id);
     ~KafkaConsumer();
 
+    using MessageHandler = std::function<void(const std::string& key, const std::string& message, int32_t partition)>;
+
     // Start consuming messages
-    void start(std::function<void(const std::string& key, const std::string& message)> message_handler);
+    void start(MessageHandler message_handler);
 
     // Stop consuming
     void stop();
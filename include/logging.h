@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace metricstream {
+
+// Asynchronous structured logging
+//
+//   MS_LOG_INFO("Queued batch: partition={}, offset={}", partition, offset);
+//
+// The level is checked before any argument is evaluated. An enabled call
+// copies its arguments in binary form (integers, doubles, strings) into a
+// byte ring owned by the calling thread - no lock, no formatting, no
+// syscall - and a background flusher formats the records of all threads in
+// timestamp order and writes them with one write() per batch. A full ring
+// drops the record (counted and reported) rather than blocking the caller.
+//
+// Each call site is rate limited (Logger::set_site_rate_limit, or per site
+// with MS_LOG_RATE_LIMITED); the next message that gets through reports how
+// many were suppressed. `format` must be a string literal: "{}" is replaced
+// by the next argument.
+//
+// Configuration comes from the environment via configure_from_env():
+// METRICSTREAM_LOG_LEVEL (debug|info|warn|error|off), METRICSTREAM_LOG_FORMAT
+// (text|json) and METRICSTREAM_LOG_RATE_LIMIT (messages per second per call
+// site, 0 = unlimited).
+
+enum class LogLevel : uint8_t { DEBUG, INFO, WARN, ERROR, OFF };
+
+const char* log_level_name(LogLevel level);  // "debug", "info", ...
+
+// Per-call-site state; one static instance per MS_LOG_* expansion
+struct LogSite {
+    const char* file;
+    int line;
+    LogLevel level;
+    uint32_t max_per_second;  // 0: the logger's default
+
+    std::atomic<int64_t> window{-1};           // current one-second window
+    std::atomic<uint32_t> window_count{0};     // messages admitted in it
+    std::atomic<uint64_t> suppressed{0};       // dropped since the last admitted one
+};
+
+namespace log_detail {
+
+enum class ArgType : uint8_t { INT, UINT, DOUBLE, BOOL, CHAR, STRING, POINTER };
+
+constexpr size_t MAX_STRING_BYTES = 4096;  // longer string arguments are truncated
+
+template <typename T>
+struct dependent_false : std::false_type {};
+
+template <typename T>
+constexpr bool is_string_arg =
+    std::is_convertible_v<const T&, std::string_view> && !std::is_same_v<std::decay_t<T>, std::nullptr_t>;
+
+template <typename T>
+std::string_view as_string(const T& value) {
+    if constexpr (std::is_pointer_v<T>) {
+        return value ? std::string_view(value) : std::string_view("(null)");
+    } else {
+        return std::string_view(value);
+    }
+}
+
+template <typename T>
+size_t encoded_size(const T& value) {
+    if constexpr (is_string_arg<T>) {
+        return 1 + sizeof(uint32_t) + std::min(as_string(value).size(), MAX_STRING_BYTES);
+    } else {
+        return 1 + sizeof(uint64_t);
+    }
+}
+
+inline char* put(char* out, ArgType type, const void* data, size_t size) {
+    *out++ = static_cast<char>(type);
+    std::memcpy(out, data, size);
+    return out + size;
+}
+
+template <typename T>
+char* encode(char* out, const T& value) {
+    using D = std::decay_t<T>;
+    if constexpr (is_string_arg<T>) {
+        std::string_view s = as_string(value);
+        uint32_t length = static_cast<uint32_t>(std::min(s.size(), MAX_STRING_BYTES));
+        out = put(out, ArgType::STRING, &length, sizeof(length));
+        std::memcpy(out, s.data(), length);
+        return out + length;
+    } else if constexpr (std::is_same_v<D, bool>) {
+        uint64_t v = value ? 1 : 0;
+        return put(out, ArgType::BOOL, &v, sizeof(v));
+    } else if constexpr (std::is_same_v<D, char>) {
+        uint64_t v = static_cast<unsigned char>(value);
+        return put(out, ArgType::CHAR, &v, sizeof(v));
+    } else if constexpr (std::is_enum_v<D>) {
+        int64_t v = static_cast<int64_t>(value);
+        return put(out, ArgType::INT, &v, sizeof(v));
+    } else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+        int64_t v = value;
+        return put(out, ArgType::INT, &v, sizeof(v));
+    } else if constexpr (std::is_integral_v<D>) {
+        uint64_t v = value;
+        return put(out, ArgType::UINT, &v, sizeof(v));
+    } else if constexpr (std::is_floating_point_v<D>) {
+        double v = static_cast<double>(value);
+        return put(out, ArgType::DOUBLE, &v, sizeof(v));
+    } else if constexpr (std::is_pointer_v<D> || std::is_same_v<D, std::nullptr_t>) {
+        uint64_t v = reinterpret_cast<uintptr_t>(static_cast<const void*>(value));
+        return put(out, ArgType::POINTER, &v, sizeof(v));
+    } else {
+        static_assert(dependent_false<T>::value, "unsupported log argument type");
+        return out;
+    }
+}
+
+} // namespace log_detail
+
+class Logger {
+public:
+    static constexpr size_t RING_BYTES = 64 * 1024;  // per thread
+
+    static Logger& instance();
+
+    static bool enabled(LogLevel level) { return level >= level_.load(std::memory_order_relaxed); }
+
+    void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+    void set_json(bool json) { json_.store(json, std::memory_order_relaxed); }
+    void set_site_rate_limit(uint32_t per_second) { site_rate_limit_.store(per_second, std::memory_order_relaxed); }
+    void set_output_fd(int fd) { output_fd_.store(fd, std::memory_order_relaxed); }
+
+    // Applies METRICSTREAM_LOG_*; throws std::invalid_argument on a bad value
+    void configure_from_env();
+
+    template <typename... Args>
+    void log(LogSite& site, const char* format, const Args&... args) {
+        int64_t timestamp_ns = now_ns();
+        uint64_t suppressed = 0;
+        if (!admit(site, timestamp_ns, suppressed)) {
+            return;
+        }
+        size_t size = sizeof(RecordHeader) + (size_t{0} + ... + log_detail::encoded_size(args));
+        char* out = reserve(size);
+        if (!out) {
+            return;
+        }
+        RecordHeader header{static_cast<uint32_t>(size), static_cast<uint16_t>(sizeof...(args)), site.level, 0,
+                            &site, format, timestamp_ns, suppressed};
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        ((out = log_detail::encode(out, args)), ...);
+        commit(size);
+    }
+
+    // Writes everything logged so far (by any thread) before returning
+    void flush();
+
+    // Drains and stops the flusher; later messages are written synchronously.
+    // Runs automatically at exit.
+    void shutdown();
+
+    uint64_t dropped() const { return dropped_total_.load(std::memory_order_relaxed); }
+
+private:
+    struct RecordHeader {
+        uint32_t size;  // whole record, header included, before alignment
+        uint16_t arg_count;
+        LogLevel level;
+        uint8_t flags;  // PADDING: skip to the end of the ring
+        const LogSite* site;
+        const char* format;
+        int64_t timestamp_ns;  // system clock
+        uint64_t suppressed;
+    };
+
+    static constexpr uint8_t PADDING = 1;
+
+    // Single-producer (owning thread) / single-consumer (drain) byte ring;
+    // records are 8-byte aligned and never wrap, a PADDING record fills the
+    // gap at the end instead
+    struct ThreadRing {
+        std::unique_ptr<char[]> data{new char[RING_BYTES]};
+        std::atomic<uint64_t> head{0};     // bytes ever written, owning thread only
+        std::atomic<uint64_t> tail{0};     // bytes ever consumed, drain only
+        std::atomic<uint64_t> dropped{0};  // records that did not fit
+        size_t thread_index = 0;
+        bool in_use = false;
+    };
+
+    Logger();
+
+    static int64_t now_ns();
+    bool admit(LogSite& site, int64_t timestamp_ns, uint64_t& suppressed);
+    char* reserve(size_t size);  // nullptr when the record is dropped
+    void commit(size_t size);
+    ThreadRing* claim_ring();
+    void release_ring(ThreadRing* ring);
+
+    void flusher_loop();
+    void drain();  // formats and writes every ring's pending records
+
+    inline static std::atomic<LogLevel> level_{LogLevel::INFO};
+    std::atomic<bool> json_{false};
+    std::atomic<uint32_t> site_rate_limit_{100};
+    std::atomic<int> output_fd_{2};
+    std::atomic<uint64_t> dropped_total_{0};
+    std::atomic<bool> synchronous_{false};  // set by shutdown()
+    std::atomic<bool> wake_pending_{false};  // a producer has signalled the flusher
+
+    mutable std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<ThreadRing>> rings_;
+
+    std::mutex drain_mutex_;  // one drain at a time: flusher, flush() or shutdown()
+    std::string drain_buffer_;
+
+    std::mutex flusher_mutex_;
+    std::condition_variable flusher_cv_;
+    bool stopping_ = false;
+    std::thread flusher_;
+
+    friend struct LogRingHandle;
+};
+
+} // namespace metricstream
+
+#define MS_LOG_RATE_LIMITED(level, per_second, ...)                                          \
+    do {                                                                                    \
+        if (::metricstream::Logger::enabled(level)) {                                       \
+            static ::metricstream::LogSite ms_log_site{__FILE__, __LINE__, level, per_second}; \
+            ::metricstream::Logger::instance().log(ms_log_site, __VA_ARGS__);               \
+        }                                                                                   \
+    } while (0)
+
+#define MS_LOG_DEBUG(...) MS_LOG_RATE_LIMITED(::metricstream::LogLevel::DEBUG, 0, __VA_ARGS__)
+#define MS_LOG_INFO(...) MS_LOG_RATE_LIMITED(::metricstream::LogLevel::INFO, 0, __VA_ARGS__)
+#define MS_LOG_WARN(...) MS_LOG_RATE_LIMITED(::metricstream::LogLevel::WARN, 0, __VA_ARGS__)
+#define MS_LOG_ERROR(...) MS_LOG_RATE_LIMITED(::metricstream::LogLevel::ERROR, 0, __VA_ARGS__)
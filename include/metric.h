@@ -4,11 +4,13 @@
 #include <unordered_map>
 #include <chrono>
 #include <vector>
+#include <cstdint>
 
 namespace metricstream {
 
 using Timestamp = std::chrono::time_point<std::chrono::system_clock>;
 using Tags = std::unordered_map<std::string, std::string>;
+using SeriesId = uint64_t;  // Identifies one (name, tags) combination
 
 enum class MetricType {
     COUNTER,
@@ -23,6 +25,7 @@ struct Metric {
     MetricType type;
     Tags tags;
     Timestamp timestamp;
+    SeriesId series_id = 0;  // Assigned by SeriesRegistry at ingest (0 = unresolved)
     
     // Constructor
     Metric(const std::string& name, double value, MetricType type, 
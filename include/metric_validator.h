@@ -0,0 +1,34 @@
+#pragma once
+
+#include "metric.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace metricstream {
+
+// Checks applied to every metric of an ingested batch; a failure answers 400
+class MetricValidator {
+public:
+    // Client timestamps are rejected this far ahead of the server clock, so a
+    // skewed agent cannot push the storage's notion of "now" into the future
+    static constexpr int64_t MAX_FUTURE_SKEW_MS = 5 * 60 * 1000;
+    // ... and below this (2001-09-09), which catches seconds sent as milliseconds
+    static constexpr int64_t MIN_TIMESTAMP_MS = 1000000000000;
+
+    struct ValidationResult {
+        bool valid;
+        std::string error_message;
+    };
+    
+    ValidationResult validate_metric(const Metric& metric) const;
+    ValidationResult validate_batch(const MetricBatch& batch) const;
+};
+
+// Timestamp for a metric's optional "timestamp" field (Unix milliseconds): the
+// server clock when the field is absent. Zero, negative and NaN values map to
+// the epoch and absurdly large ones are clamped, so validate_metric() rejects
+// them instead of silently stamping the sample with the server clock.
+Timestamp client_timestamp(std::optional<double> timestamp_ms);
+
+} // namespace metricstream
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace metricstream {
+
+// Self-monitoring metrics in the Prometheus text exposition format
+//
+// Registration (creating a family or a labeled child) takes the registry
+// mutex and returns a reference that stays valid for the registry's
+// lifetime; callers keep it and update it with single atomic operations, so
+// the hot path never locks. write_prometheus() renders everything into a
+// caller-owned buffer that keeps its capacity between scrapes.
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class Counter {
+public:
+    void inc(uint64_t delta = 1) { value_.fetch_add(delta, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void set(double value) { bits_.store(to_bits(value), std::memory_order_relaxed); }
+    void add(double delta);
+    double value() const { return from_bits(bits_.load(std::memory_order_relaxed)); }
+
+private:
+    std::atomic<uint64_t> bits_{0};  // double, so updates are plain atomic stores
+
+    static uint64_t to_bits(double value);
+    static double from_bits(uint64_t bits);
+};
+
+// Fixed-bucket histogram; `bounds` are the inclusive upper bounds ("le")
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    const std::vector<double>& bounds() const { return bounds_; }
+
+    // Per-bucket (non-cumulative) counts, the last one being +Inf
+    std::vector<uint64_t> bucket_counts() const;
+    double sum() const;
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;  // bounds_.size() + 1
+    Gauge sum_;
+};
+
+// Appends text-format samples; used by the registry and by collectors that
+// render data kept elsewhere (e.g. PipelineStats) at scrape time
+class PrometheusWriter {
+public:
+    explicit PrometheusWriter(std::string& out) : out_(out) {}
+
+    void family(const std::string& name, const std::string& help, const char* type);
+    void sample(const std::string& name, const std::string& labels, double value);
+    void sample(const std::string& name, const std::string& labels, uint64_t value);
+
+    // Cumulative _bucket series plus _sum and _count; `counts` are
+    // per-bucket with the +Inf bucket last, as from Histogram::bucket_counts
+    void histogram(const std::string& name, const std::string& labels, const std::vector<double>& bounds,
+                   const std::vector<uint64_t>& counts, double sum);
+
+    // `name="value",...` with values escaped; empty for no labels
+    static std::string render_labels(const MetricLabels& labels);
+
+private:
+    std::string& out_;
+
+    void append_series(const std::string& name, const std::string& labels, const char* extra_label = nullptr,
+                       const char* extra_value = nullptr);
+};
+
+class MetricsRegistry {
+public:
+    using Collector = std::function<void(PrometheusWriter&)>;
+
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // Same name and labels return the same child. A name reused with a
+    // different type, or an invalid metric/label name, throws
+    // std::invalid_argument.
+    Counter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                         const MetricLabels& labels = {});
+
+    // Sampled at scrape time, for values that already live elsewhere
+    void counter_function(const std::string& name, const std::string& help, std::function<double()> sample,
+                          const MetricLabels& labels = {});
+    void gauge_function(const std::string& name, const std::string& help, std::function<double()> sample,
+                        const MetricLabels& labels = {});
+
+    // Writes its own families; run after the registered ones, in order
+    void add_collector(Collector collector);
+
+    // Clears `out` (keeping its capacity) and renders every family. Sample
+    // functions and collectors run under the registry mutex, so they must
+    // not register metrics themselves.
+    void write_prometheus(std::string& out) const;
+
+private:
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Child {
+        std::string labels;  // rendered once at registration
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> sample;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        Type type;
+        std::vector<std::unique_ptr<Child>> children;
+        std::unordered_map<std::string, Child*> children_by_labels;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Family>> families_;  // registration order
+    std::unordered_map<std::string, Family*> families_by_name_;
+    std::vector<Collector> collectors_;
+
+    Child& child(const std::string& name, const std::string& help, Type type, const MetricLabels& labels);
+};
+
+} // namespace metricstream
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "metrics_registry.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace metricstream {
+
+// End-to-end pipeline latency as seen by a queue consumer
+//
+// Every batch carries the wall-clock time its POST /metrics arrived
+// (ingest_timestamp_us, see batch_codec.h). Per partition the consumer
+// records how long batches took to reach it (delivery) and to get through
+// its handler (end to end), and remembers the ingest time of the newest
+// batch handled so staleness can be alerted on. Ingester and consumer
+// clocks are compared directly, so clock skew shows up in the numbers;
+// negative latencies are clamped to zero.
+class PipelineLatencyStats {
+public:
+    explicit PipelineLatencyStats(MetricsRegistry& registry);
+
+    // Microseconds since the Unix epoch; ingest_us == 0 (a producer that
+    // predates the field) is counted but not timed
+    void record(int partition, int64_t ingest_us, int64_t received_us, int64_t processed_us);
+
+    // Per-partition batch counts, end-to-end mean/p50/p99/max in
+    // milliseconds (percentiles are histogram bucket upper bounds) and
+    // seconds since the newest handled batch was ingested
+    std::string to_json() const;
+
+    static int64_t now_us();
+
+private:
+    struct Partition {
+        Histogram* delivery;
+        Histogram* end_to_end;
+        std::atomic<int64_t> newest_ingest_us{0};
+        std::atomic<int64_t> max_end_to_end_us{0};
+    };
+
+    Partition& partition(int id);
+
+    MetricsRegistry& registry_;
+    Counter& untimed_;
+
+    mutable std::mutex mutex_;
+    std::map<int, std::unique_ptr<Partition>> partitions_;  // ordered for to_json()
+};
+
+} // namespace metricstream
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "tracing.h"
+
+namespace metricstream {
+
+// Stages of the ingest path, in request order
+enum class Stage : size_t {
+    HTTP_PARSE,   // raw bytes -> HttpRequest
+    RATE_LIMIT,
+    JSON_PARSE,
+    VALIDATE,
+    ENQUEUE,      // hand-off to the async writer (or the synchronous Kafka write)
+    QUEUE_WRITE,  // encode + produce to the file queue / Kafka
+    COUNT
+};
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::COUNT);
+
+const char* stage_name(Stage stage);  // "http_parse", "rate_limit", ...
+
+// Log-linear bucket layout shared by the recording and merged histograms:
+// values below 16 get exact buckets, every power of two above is split into
+// 16 sub-buckets (about 6% relative error). Values are nanoseconds and are
+// clamped at 2^40 (about 18 minutes).
+namespace latency_buckets {
+
+constexpr int SUB_BUCKET_BITS = 4;
+constexpr uint64_t SUB_BUCKETS = uint64_t{1} << SUB_BUCKET_BITS;
+constexpr int MAX_EXPONENT = 40;
+constexpr size_t COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+size_t index_of(uint64_t value);
+uint64_t upper_bound(size_t index);  // largest value that lands in bucket `index`
+
+} // namespace latency_buckets
+
+// Merged, immutable view of one stage's latencies
+class LatencySnapshot {
+public:
+    LatencySnapshot() : counts_(latency_buckets::COUNT, 0) {}
+
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    // Upper bound of the bucket holding the percentile; 0 when empty
+    uint64_t value_at_percentile(double percentile) const;
+
+    // Per-bucket counts, indexed like latency_buckets
+    const std::vector<uint64_t>& counts() const { return counts_; }
+
+private:
+    friend class LatencyHistogram;
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+// Histogram written by exactly one thread and read by any number of
+// scrapers. The writer does plain relaxed load/store pairs (no RMW, no lock);
+// readers may see a scrape that is a few samples behind, never a torn count.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t nanos);                   // owning thread only
+    void add_to(LatencySnapshot& snapshot) const;  // any thread
+
+private:
+    std::array<std::atomic<uint64_t>, latency_buckets::COUNT> counts_;
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+};
+
+// Process-wide per-stage latency histograms
+//
+// Every recording thread owns a slot with one histogram per stage, claimed
+// on its first record() and released (but kept, with its counts) when the
+// thread exits, so the hot path never takes a lock. snapshot() merges all
+// slots; that is the only place the registry mutex is taken after warm-up.
+class PipelineStats {
+public:
+    static PipelineStats& instance();
+
+    void record(Stage stage, uint64_t nanos);
+    std::array<LatencySnapshot, STAGE_COUNT> snapshot() const;
+
+private:
+    struct ThreadSlot {
+        std::array<LatencyHistogram, STAGE_COUNT> stages;
+        bool in_use = false;
+    };
+
+    PipelineStats() = default;
+
+    ThreadSlot* claim_slot();
+    void release_slot(ThreadSlot* slot);
+
+    mutable std::mutex slots_mutex_;
+    std::vector<std::unique_ptr<ThreadSlot>> slots_;
+
+    friend struct ThreadSlotHandle;
+};
+
+// Records the time from construction to destruction against `stage`, and
+// as a span named after the stage when the current request is traced
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage) : stage_(stage), start_ns_(trace_clock_ns()) {}
+    ~StageTimer() {
+        int64_t end_ns = trace_clock_ns();
+        PipelineStats::instance().record(stage_, static_cast<uint64_t>(end_ns - start_ns_));
+        if (current_trace_id != 0) {
+            Tracer::instance().record(current_trace_id, stage_name(stage_), start_ns_, end_ns);
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stage stage_;
+    int64_t start_ns_;
+};
+
+// Resident set size of this process from /proc/self/statm; 0 if unavailable
+size_t resident_memory_bytes();
+
+} // namespace metricstream
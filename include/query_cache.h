@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace metricstream {
+
+// One output series of an instant-vector expression, one slot per step
+struct StepSeries {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::vector<double> values;
+    std::vector<uint8_t> present;
+};
+
+// Range query results cached per step-aligned bucket
+//
+// A bucket holds the evaluated series for steps_per_bucket consecutive steps
+// of one (canonical query, step, step offset). A step's value only depends on
+// samples inside its window, so a dashboard refresh whose end slid forward
+// finds every complete bucket cached and evaluates just the new tail.
+//
+// Buckets are evicted LRU once max_bytes is exceeded. Writes reported through
+// invalidate() drop every bucket whose data range overlaps the written range;
+// a Fill started before the computation makes sure a write that races with
+// it keeps the stale result out of the cache.
+class QueryResultCache {
+public:
+    struct Options {
+        size_t max_bytes = 64 * 1024 * 1024;
+        size_t steps_per_bucket = 60;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    using Bucket = std::vector<StepSeries>;
+
+    // Registration of one in-progress computation (RAII)
+    class Fill {
+    public:
+        ~Fill();
+        Fill(const Fill&) = delete;
+        Fill& operator=(const Fill&) = delete;
+
+    private:
+        friend class QueryResultCache;
+        Fill(QueryResultCache& cache, uint64_t id) : cache_(cache), id_(id) {}
+        QueryResultCache& cache_;
+        uint64_t id_;
+    };
+
+    explicit QueryResultCache(const Options& options);
+    QueryResultCache() : QueryResultCache(Options()) {}
+
+    size_t steps_per_bucket() const { return options_.steps_per_bucket; }
+
+    // Bucket whose first step is first_step_ts, or nullptr
+    std::shared_ptr<const Bucket> get(const std::string& key, int64_t first_step_ts);
+
+    // Call before reading storage for buckets ending at or before last_step_ts
+    std::unique_ptr<Fill> begin_fill(int64_t last_step_ts);
+
+    // Store a bucket computed under `fill`. Its steps read samples in
+    // [first_data_ts, last_step_ts]; the bucket is dropped if a write in that
+    // range was reported since the fill began.
+    void put(const Fill& fill, const std::string& key, int64_t first_step_ts,
+             int64_t first_data_ts, int64_t last_step_ts, Bucket bucket);
+
+    // Samples were written somewhere in [oldest_ts, newest_ts]
+    void invalidate(int64_t oldest_ts, int64_t newest_ts);
+
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string key;  // query key + first step
+        std::shared_ptr<const Bucket> bucket;
+        int64_t first_data_ts;
+        int64_t last_step_ts;
+        size_t bytes;
+    };
+
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+    size_t bytes_ = 0;
+    int64_t max_cached_ts_ = INT64_MIN;  // upper bound on cached last steps
+
+    // In-flight fills: id -> (last step, oldest write seen since begin)
+    std::unordered_map<uint64_t, std::pair<int64_t, int64_t>> fills_;
+    uint64_t next_fill_id_ = 1;
+
+    // Upper bound on every tracked last step; writes after it skip the lock
+    std::atomic<int64_t> max_tracked_ts_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t invalidations_ = 0;
+
+    void end_fill(uint64_t id);
+    void update_max_tracked();  // requires mutex_
+    void erase(std::list<Entry>::iterator it);  // requires mutex_
+    static std::string entry_key(const std::string& key, int64_t first_step_ts);
+    static size_t bucket_bytes(const Bucket& bucket);
+};
+
+} // namespace metricstream
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "query_cache.h"
+#include "query_parser.h"
+#include "storage_engine.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metricstream {
+
+class QueryCancelled : public std::runtime_error {
+public:
+    explicit QueryCancelled(const std::string& reason) : std::runtime_error(reason) {}
+};
+
+// Cooperative cancellation for one query
+// Shard tasks call check() between series; poll() additionally asks the
+// client probe (e.g. "is the socket still open") and is called once per shard.
+class QueryContext {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    QueryContext() = default;
+    explicit QueryContext(Clock::time_point deadline, std::function<bool()> client_connected = nullptr)
+        : deadline_(deadline), client_connected_(std::move(client_connected)) {}
+
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const;
+
+    void check() const;  // throws QueryCancelled
+    void poll();         // check() plus the client probe
+
+private:
+    Clock::time_point deadline_ = Clock::time_point::max();
+    std::function<bool()> client_connected_;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> disconnected_{false};
+};
+
+// Plans and evaluates parsed queries against the storage engine
+//
+// Planning walks the AST and turns every selector into one storage scan:
+// its tag matchers go to the inverted index and its time bounds (query range
+// widened by the selector's range or lookback) go to the head/block scan, so
+// work is proportional to the matching series and window, not to the store.
+// Evaluation then runs the aggregation kernels over per-series columns.
+// *_over_time functions read the coarsest rollup tier whose resolution
+// divides their range, the step and the first step timestamp, so a 30-day
+// avg_over_time(x[1h]) at 1h steps touches one point per series per hour.
+//
+// With a thread pool, each scan's matching series are split into shards of
+// SERIES_PER_TASK that are read and evaluated as independent tasks; an
+// aggregation directly over a selector or function folds each shard into
+// partial aggregates that are merged at the end (map-reduce). The calling
+// thread works on shards too, so a full pool only makes a query slower.
+class QueryEngine {
+public:
+    static constexpr int64_t DEFAULT_LOOKBACK_MS = 5 * 60 * 1000;  // staleness for instant selectors
+    static constexpr size_t MAX_STEPS = 11000;
+    static constexpr size_t SERIES_PER_TASK = 64;
+    static constexpr size_t STREAM_SHARDS = 16;  // shards read per wave by execute_streaming()
+
+    struct ScanPlan {
+        std::string selector;  // canonical selector text
+        std::vector<TagMatcher> matchers;
+        int64_t start_ts = 0;
+        int64_t end_ts = 0;
+        int64_t rollup_resolution_ms = 0;  // 0 = raw samples
+    };
+
+    struct Stats {
+        size_t series_matched = 0;
+        size_t blocks_read = 0;
+        size_t samples_scanned = 0;
+        size_t cached_steps = 0;  // steps served from the result cache
+        std::vector<ScanPlan> scans;
+    };
+
+    struct ResultSeries {
+        std::string name;  // empty once a function or aggregation dropped it
+        std::vector<std::pair<std::string, std::string>> tags;  // sorted by key
+        std::vector<Sample> points;
+    };
+
+    struct Result {
+        bool is_matrix = false;  // range query (or raw range vector) vs single instant
+        std::vector<ResultSeries> series;
+        Stats stats;
+    };
+
+    // pool == nullptr evaluates every shard on the calling thread
+    explicit QueryEngine(const StorageEngine& storage, ThreadPool* pool = nullptr,
+                         int64_t lookback_ms = DEFAULT_LOOKBACK_MS);
+
+    // Range queries reuse complete step buckets from the cache (not owned)
+    void set_result_cache(QueryResultCache* cache) { cache_ = cache; }
+
+    // Range query: evaluate at start, start+step, ..., end.
+    // step_ms == 0 makes it an instant query evaluated at end_ts.
+    // Throws std::invalid_argument for unsupported shapes or too many steps,
+    // and QueryCancelled once the context is cancelled or past its deadline.
+    Result execute(const QueryExpr& expr, int64_t start_ts, int64_t end_ts, int64_t step_ms,
+                   QueryContext* context = nullptr) const;
+    Result execute(const std::string& query, int64_t start_ts, int64_t end_ts, int64_t step_ms,
+                   QueryContext* context = nullptr) const;
+
+    // Same as execute(), but each output series goes to `sink` (on the calling
+    // thread, in execute() order) and the returned Result holds no series.
+    // Selectors, functions and raw range vectors are read STREAM_SHARDS shards
+    // at a time, so memory is bounded by one wave instead of the whole result.
+    // Aggregations (one series per group) and range queries served through the
+    // result cache (assembled from buckets) are still evaluated in full first.
+    using SeriesSink = std::function<void(ResultSeries&& series)>;
+    Result execute_streaming(const QueryExpr& expr, int64_t start_ts, int64_t end_ts, int64_t step_ms,
+                             const SeriesSink& sink, QueryContext* context = nullptr) const;
+
+    // Step timestamps execute() evaluates at; throws std::invalid_argument for
+    // the same shapes, so a query can be rejected before streaming starts
+    static std::vector<int64_t> evaluation_steps(const QueryExpr& expr, int64_t start_ts, int64_t end_ts,
+                                                 int64_t step_ms);
+
+    // Storage scans the query would issue (no data is read)
+    std::vector<ScanPlan> plan(const QueryExpr& expr, int64_t first_step_ts, int64_t last_step_ts) const;
+
+private:
+    // Fetched samples of one series, split into columns for the kernels
+    struct SeriesColumns {
+        SeriesDescriptor series;
+        std::vector<int64_t> timestamps;
+        std::vector<double> values;
+    };
+
+    // Aggregation partials per output group (labels kept by by/without)
+    using GroupKey = std::vector<std::pair<std::string, std::string>>;
+    using GroupPartials = std::map<GroupKey, std::vector<Aggregate>>;
+
+    const StorageEngine& storage_;
+    ThreadPool* pool_;
+    int64_t lookback_ms_;
+    QueryResultCache* cache_ = nullptr;
+
+    void collect_scans(const QueryExpr& expr, int64_t first_step_ts, int64_t last_step_ts,
+                       std::vector<ScanPlan>& scans) const;
+
+    // Runs task(i) for i in [0, count) on the pool and the calling thread;
+    // returns once all are done and rethrows the first task exception
+    void run_sharded(size_t count, const std::function<void(size_t)>& task, QueryContext* context) const;
+
+    // One selector's matching series, resolved once through the index and
+    // read shard by shard
+    struct ShardedScan {
+        ScanPlan plan;
+        std::vector<SeriesId> ids;
+        size_t shard_count() const { return (ids.size() + SERIES_PER_TASK - 1) / SERIES_PER_TASK; }
+    };
+
+    ShardedScan select_series(const QueryExpr& selector, const std::vector<int64_t>& steps, Stats& stats,
+                              int64_t rollup_resolution_ms = 0) const;
+    // Consecutive slices of the scan, STREAM_SHARDS shards each
+    static std::vector<ShardedScan> waves(const ShardedScan& scan);
+    // Reads every shard in parallel and calls visit(shard, columns) per series,
+    // so callers can keep per-shard output without locking
+    void read_shards(const ShardedScan& scan, Stats& stats, QueryContext* context,
+                     const std::function<void(size_t, SeriesColumns&)>& visit) const;
+    // Same over the scan's rollup tier
+    void read_rollup_shards(const ShardedScan& scan, Stats& stats, QueryContext* context,
+                            const std::function<void(size_t, StorageEngine::RollupResult&)>& visit) const;
+
+    // Coarsest rollup tier that answers the function exactly, or 0
+    int64_t pick_rollup_resolution(const QueryExpr& function, const std::vector<int64_t>& steps) const;
+
+    // Evaluates cached buckets from the cache and the rest from storage
+    std::vector<StepSeries> evaluate_cached(const QueryExpr& expr, const std::vector<int64_t>& steps,
+                                            int64_t step_ms, Stats& stats, QueryContext* context) const;
+    std::vector<StepSeries> evaluate(const QueryExpr& expr, const std::vector<int64_t>& steps,
+                                     Stats& stats, QueryContext* context) const;
+    // Selector or function call: one output series per input series, which
+    // is folded into `groups` instead when aggregating directly over it
+    std::vector<StepSeries> evaluate_leaf(const QueryExpr& expr, const std::vector<int64_t>& steps,
+                                          Stats& stats, QueryContext* context,
+                                          const QueryExpr* aggregation, GroupPartials* groups) const;
+    ShardedScan select_leaf(const QueryExpr& expr, const std::vector<int64_t>& steps, Stats& stats) const;
+    std::vector<StepSeries> evaluate_leaf_scan(const QueryExpr& expr, const ShardedScan& scan,
+                                               const std::vector<int64_t>& steps, Stats& stats,
+                                               QueryContext* context, const QueryExpr* aggregation,
+                                               GroupPartials* groups) const;
+    std::vector<StepSeries> evaluate_aggregation(const QueryExpr& expr, const std::vector<int64_t>& steps,
+                                                 Stats& stats, QueryContext* context) const;
+
+    StepSeries apply_selector(SeriesColumns& series, const std::vector<int64_t>& steps) const;
+    static StepSeries apply_function(const QueryExpr& expr, SeriesColumns& series,
+                                     const std::vector<int64_t>& steps);
+    static StepSeries apply_rollup_function(const QueryExpr& expr, StorageEngine::RollupResult& series,
+                                            const std::vector<int64_t>& steps);
+    static void add_to_groups(const QueryExpr& aggregation, const StepSeries& series, size_t step_count,
+                              GroupPartials& groups);
+    static std::vector<StepSeries> groups_to_series(const QueryExpr& aggregation, GroupPartials& groups,
+                                                    size_t step_count);
+};
+
+} // namespace metricstream
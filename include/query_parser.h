@@ -0,0 +1,91 @@
+#pragma once
+
+#include "tag_index.h"
+#include "aggregation_kernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// PromQL-like query language (subset)
+//
+//   cpu_usage{host="web-1", region=~"us-.*"}          instant vector selector
+//   http_requests_total{status!="500"}[5m]            range vector selector
+//   rate(http_requests_total[1m])                     rate / increase
+//   avg_over_time(cpu_usage[10m])                     {sum,avg,min,max,count}_over_time
+//   sum by (region) (rate(http_requests_total[1m]))   {sum,avg,min,max,count} [by|without (...)]
+//
+// Durations: <number><unit> with unit ms|s|m|h|d|w|y, concatenable ("1h30m").
+
+class QueryParseError : public std::runtime_error {
+public:
+    QueryParseError(const std::string& message, size_t position)
+        : std::runtime_error(message + " at position " + std::to_string(position)),
+          position_(position) {}
+
+    size_t position() const { return position_; }
+
+private:
+    size_t position_;
+};
+
+struct QueryToken {
+    enum class Type {
+        IDENTIFIER, NUMBER, STRING, DURATION,
+        LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_BRACKET, RIGHT_BRACKET,
+        COMMA, EQUAL, NOT_EQUAL, REGEX_MATCH, REGEX_NO_MATCH,
+        END
+    };
+
+    Type type;
+    std::string text;   // identifier name / unescaped string contents
+    double number = 0;  // NUMBER value, or DURATION in milliseconds
+    size_t position = 0;
+};
+
+// Splits a query into tokens; throws QueryParseError on bad input
+std::vector<QueryToken> tokenize_query(const std::string& query);
+
+// Parses "1h30m" style durations into milliseconds; throws std::invalid_argument
+int64_t parse_duration_ms(const std::string& text);
+
+struct QueryExpr {
+    enum class Kind {
+        NUMBER,           // 42
+        VECTOR_SELECTOR,  // name{matchers}
+        MATRIX_SELECTOR,  // name{matchers}[range]
+        FUNCTION_CALL,    // rate(...), avg_over_time(...)
+        AGGREGATION       // sum by (...) (...)
+    };
+
+    Kind kind = Kind::NUMBER;
+    double number = 0;
+
+    // Selectors: matchers include the metric name as __name__="..."
+    std::vector<TagMatcher> matchers;
+    int64_t range_ms = 0;
+
+    // Function calls and aggregations
+    std::string function;
+    AggregateOp aggregate_op = AggregateOp::SUM;
+    std::vector<std::string> grouping;  // sorted, deduplicated
+    bool without = false;
+    std::vector<std::unique_ptr<QueryExpr>> args;
+
+    // Canonical text: same meaning -> same string (matchers and grouping
+    // sorted, durations in ms), so it can serve as a cache key
+    std::string to_string() const;
+};
+
+// Deepest nesting of expressions parse_query() accepts
+constexpr size_t MAX_QUERY_DEPTH = 128;
+
+// Recursive-descent parser; throws QueryParseError on syntax or type errors
+// (e.g. rate() over an instant vector) and on nesting past MAX_QUERY_DEPTH
+std::unique_ptr<QueryExpr> parse_query(const std::string& query);
+
+} // namespace metricstream
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "http_server.h"
+#include "query_engine.h"
+#include "storage_engine.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// HTTP read path over the storage engine
+//
+//   GET /query?name=cpu_usage&start=<ms>&end=<ms>&tags=host:web-1,region:us
+//   GET /query?name=cpu_usage&start=<ms>&end=<ms>&step=60000&agg=sum
+//
+// With step, each series is downsampled to one point per step bucket
+// (agg = sum|min|max|avg|count, default avg).
+//
+//   GET /query?query=sum by (region) (rate(http_requests_total[1m]))&start=<ms>&end=<ms>&step=15000
+//
+// With query, the expression is parsed and run by the QueryEngine; without
+// step it is an instant query at end. Series shards run on a dedicated query
+// pool; timeout=<ms> (default 30s) or a client disconnect cancels the query.
+// Range queries go through a result cache that the storage engine's write
+// observer invalidates when late samples land in cached buckets.
+// The selector is resolved through the tag index and only blocks whose
+// time range overlaps [start, end] are read. Results are sent with chunked
+// transfer encoding while later series are still being read.
+class QueryService {
+public:
+    QueryService(int port, StorageEngine& storage);
+    ~QueryService();
+
+    void start();
+    void stop();
+
+private:
+    static constexpr int64_t MAX_STEP_BUCKETS = 11000;
+    static constexpr int64_t DEFAULT_TIMEOUT_MS = 30000;
+    static constexpr size_t STREAM_SERIES_PER_READ = 256;  // series read from storage at a time
+    static constexpr size_t STREAM_CHUNK_BYTES = 64 * 1024;
+
+    std::unique_ptr<HttpServer> server_;
+    StorageEngine& storage_;
+    std::unique_ptr<ThreadPool> query_pool_;
+    QueryResultCache cache_;
+    QueryEngine engine_;
+
+    HttpResponse handle_query(const HttpRequest& request);
+    HttpResponse handle_expression_query(const HttpRequest& request);
+    HttpResponse handle_health_check(const HttpRequest& request);
+
+    static std::vector<TagMatcher> parse_tag_filters(const std::string& tags);
+    static std::string create_error_response(const std::string& message);
+};
+
+} // namespace metricstream
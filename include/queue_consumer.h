@@ -4,6 +4,8 @@
 #include <vector>
 #include <optional>
 #include <thread>
+#include <atomic>
+#include <functional>
 #include <cstdint>
 
 struct Message {
@@ -13,18 +15,26 @@ struct Message {
 };
 
 class QueueConsumer {
+public:
+    using MessageHandler = std::function<void(const Message&)>;
+
 private:
     std::string queue_path_;
     std::string consumer_group_;
     int num_partitions_;
     std::vector<uint64_t> read_offsets_;
-    bool running_;
+    std::atomic<bool> running_;
+    MessageHandler handler_;  // Optional: called for each message before commit
 
 public:
     QueueConsumer(const std::string& queue_path,
                   const std::string& consumer_group,
                   int num_partitions);
 
+    // Install a processing callback (e.g. storage writer). Without one,
+    // messages are only logged. Must be called before start().
+    void set_message_handler(MessageHandler handler) { handler_ = std::move(handler); }
+
     // Start consuming (spawns threads for each partition)
     void start();
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <memory>
+#include <functional>
+
+namespace metricstream {
+
+// Compressed bitmap for postings lists (Roaring layout)
+// 32-bit values are split into a 16-bit high key selecting a container and a
+// 16-bit low part stored in it. Sparse containers are sorted uint16 arrays,
+// dense containers (> 4096 entries) switch to a fixed 8KB bitset.
+class RoaringBitmap {
+public:
+    RoaringBitmap() = default;
+    RoaringBitmap(const RoaringBitmap& other);
+    RoaringBitmap& operator=(const RoaringBitmap& other);
+    RoaringBitmap(RoaringBitmap&&) noexcept = default;
+    RoaringBitmap& operator=(RoaringBitmap&&) noexcept = default;
+
+    void add(uint32_t value);
+    bool remove(uint32_t value);
+    bool contains(uint32_t value) const;
+
+    uint64_t cardinality() const;
+    bool empty() const { return containers_.empty(); }
+
+    // Set algebra used to combine postings lists
+    RoaringBitmap and_(const RoaringBitmap& other) const;
+    RoaringBitmap or_(const RoaringBitmap& other) const;
+    RoaringBitmap andnot(const RoaringBitmap& other) const;
+
+    // Visit values in ascending order
+    void for_each(const std::function<void(uint32_t)>& fn) const;
+    std::vector<uint32_t> to_vector() const;
+
+    // Approximate heap footprint (for index memory accounting)
+    size_t memory_bytes() const;
+
+private:
+    static constexpr size_t ARRAY_MAX_SIZE = 4096;
+    static constexpr size_t BITSET_WORDS = 65536 / 64;
+
+    struct Container {
+        bool is_bitset = false;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;                               // sorted, when !is_bitset
+        std::unique_ptr<std::array<uint64_t, BITSET_WORDS>> bits;  // when is_bitset
+
+        Container() = default;
+        Container(const Container& other);
+        Container& operator=(const Container& other);
+        Container(Container&&) noexcept = default;
+        Container& operator=(Container&&) noexcept = default;
+
+        bool add(uint16_t low);
+        bool remove(uint16_t low);
+        bool contains(uint16_t low) const;
+        void to_bitset();
+        void to_array();
+        void for_each(uint32_t high_bits, const std::function<void(uint32_t)>& fn) const;
+    };
+
+    // Parallel arrays sorted by high key
+    std::vector<uint16_t> keys_;
+    std::vector<Container> containers_;
+
+    size_t find_container(uint16_t key) const;  // index or keys_.size()
+    Container& get_or_create(uint16_t key);
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static Container subtract(const Container& a, const Container& b);
+};
+
+} // namespace metricstream
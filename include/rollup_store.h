@@ -0,0 +1,81 @@
+#pragma once
+
+#include "aggregation_kernels.h"
+#include "block_storage.h"
+#include "compaction.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Aggregate of one series over the bucket (timestamp_ms - resolution, timestamp_ms]
+// Buckets are keyed by their end so a query window (t - range, t] with t and
+// range multiples of the resolution is exactly a run of whole buckets.
+struct RollupPoint {
+    int64_t timestamp_ms;
+    Aggregate aggregate;
+    bool complete = false;  // whole bucket: replaces the points of the bucket before it
+};
+
+using SeriesRollups = std::map<SeriesId, std::vector<RollupPoint>>;
+
+// End of the bucket (end - resolution, end] holding ts
+int64_t rollup_bucket_end(int64_t ts, int64_t resolution_ms);
+
+// Folds samples (sorted by timestamp) into rollup points appended to `out`
+void fold_rollup(const Sample* samples, size_t count, int64_t resolution_ms, std::vector<RollupPoint>& out);
+
+// Sorts points by bucket end (stable) and merges partial aggregates of the
+// same bucket; a complete point drops whatever came before it
+void merge_rollup_points(std::vector<RollupPoint>& points);
+
+// Downsampled tier (min/max/sum/count per series per bucket) kept next to the
+// raw blocks and written from the same head flushes
+//
+// Each series is stored as four pseudo-series (sum, min, max, count) in the
+// tier's own BlockStore, so one block write persists all four fields
+// atomically. A flush cuts head chunks, not rollup buckets, so one bucket can
+// be split across blocks; reads merge the partial aggregates. Buckets whose
+// raw samples were rewritten are written again whole (a negative count on
+// disk), and reads let that point replace the partials written before it.
+// The tier has a compactor of its own whose merge folds the partials of each
+// bucket the same way, so a complete point still wins over older partials.
+class RollupStore {
+public:
+    RollupStore(const std::string& directory, int64_t resolution_ms, int64_t block_duration_ms,
+                BlockCache* cache = nullptr, const CompactionOptions& compaction = {});
+
+    int64_t resolution_ms() const { return resolution_ms_; }
+    size_t block_count() const { return blocks_.block_count(); }
+    Compactor& compactor() { return compactor_; }
+
+    // Fold raw samples into buckets and persist them
+    void add(const SeriesSamples& samples);
+    // Same for samples that cover their buckets entirely (deduplicated), which
+    // replace everything the tier holds for those buckets
+    void replace(const SeriesSamples& samples);
+
+    // Points with bucket end in [start_ts, end_ts], merged per bucket.
+    // Returns the number of blocks read.
+    size_t read(const std::vector<SeriesId>& ids, int64_t start_ts, int64_t end_ts, SeriesRollups& out) const;
+
+private:
+    enum Field { SUM, MIN, MAX, COUNT, FIELD_COUNT };
+
+    BlockStore blocks_;
+    int64_t resolution_ms_;
+    Compactor compactor_;
+
+    static SeriesId field_id(SeriesId id, int field);
+    // Appends one point as its four fields
+    static void append_point(SeriesId id, const RollupPoint& point, SeriesSamples& fields);
+    // Points of one series from its fields, unmerged; false if it has none
+    static bool decode(SeriesId id, const SeriesSamples& fields, std::vector<RollupPoint>& out);
+    // Compaction merge: one point per bucket for every series of the inputs
+    static void merge_fields(SeriesSamples& fields);
+    void write(const SeriesSamples& samples, bool complete);
+};
+
+} // namespace metricstream
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace metricstream {
+
+// In-process CPU sampling profiler
+//
+// While a profile runs, an ITIMER_PROF timer sends SIGPROF at `hz` per
+// second of process CPU time; the kernel delivers it to the thread that was
+// on CPU, whose handler captures its own stack with backtrace() into a
+// preallocated sample buffer. When the profile ends the samples are
+// symbolized and folded into "frame;frame;... count" lines, the input format
+// of flamegraph.pl and speedscope.
+//
+// backtrace() is not async-signal-safe. Its first call loads the unwinder
+// (dlopen, malloc), so that call is made before SIGPROF is installed; after
+// it the handler neither allocates nor takes locks of its own, but the
+// unwinder still looks frames up through dl_iterate_phdr(). A sample taken
+// while the thread is inside dlopen()/dlclose() can therefore see the module
+// list mid-update, so avoid profiling while libraries are being loaded.
+//
+// Symbols come from dladdr(), so the executable must export its symbols
+// (-rdynamic); frames it cannot name are printed as module+offset for
+// offline addr2line.
+class SamplingProfiler {
+public:
+    static constexpr int MAX_DEPTH = 48;
+    static constexpr size_t MAX_SAMPLES = 1 << 15;  // later samples are counted as dropped
+    static constexpr int MAX_HZ = 1000;
+
+    static SamplingProfiler& instance();
+
+    // Profiles for `duration` (stopping early once `keep_going` returns
+    // false) and returns folded stacks, most frequent first. One profile at
+    // a time: throws std::runtime_error if another is running, and
+    // std::invalid_argument for a non-positive duration or hz outside
+    // 1..MAX_HZ.
+    std::string profile(std::chrono::milliseconds duration, int hz,
+                        const std::function<bool()>& keep_going = {});
+
+    bool running() const { return running_.load(std::memory_order_relaxed); }
+
+private:
+    struct Sample {
+        std::atomic<int> depth{0};  // 0 until the handler has filled `frames`
+        void* frames[MAX_DEPTH];
+    };
+
+    SamplingProfiler() = default;
+
+    static void on_sigprof(int signal, siginfo_t* info, void* context);
+    void install_handler();
+    std::string fold_samples(size_t count) const;
+
+    std::mutex profile_mutex_;  // held for the whole profile
+    bool handler_installed_ = false;
+
+    std::unique_ptr<Sample[]> samples_;
+    std::atomic<size_t> next_sample_{0};
+    std::atomic<bool> running_{false};
+    std::atomic<int> handlers_active_{0};  // signal handlers between entry and exit
+};
+
+} // namespace metricstream
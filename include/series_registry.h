@@ -0,0 +1,95 @@
+#pragma once
+
+#include "metric.h"
+#include "hyperloglog.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace metricstream {
+
+// Canonical identity of a series: name plus tags sorted by key
+struct SeriesDescriptor {
+    SeriesId id = 0;
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> tags;  // sorted by key
+
+    Tags tag_map() const { return Tags(tags.begin(), tags.end()); }
+};
+
+// Assigns 64-bit series IDs at ingest
+// The ID is a hash of the canonical (name, sorted tags) form, so registries
+// that never see a hash collision agree on it. IDs are not guaranteed stable
+// across restarts or nodes, though: when two series collide, the one
+// registered second is probed to the next free ID, which depends on what
+// this registry saw first. Anything persisted keeps the labels next to the
+// ID (block series index, queued batch descriptors) for that reason.
+// Lookups go through a sharded table (shared lock per shard) so concurrent
+// request threads rarely contend; only first sightings take a write lock.
+class SeriesRegistry {
+public:
+    struct Resolution {
+        SeriesId id;
+        bool created;  // first time this registry has seen the series
+    };
+
+    // Log a warning once a tenant's estimated cardinality passes this many series
+    explicit SeriesRegistry(size_t tenant_cardinality_warning = 100000);
+
+    // Resolve (name, tags) to its series ID, registering it if new.
+    // The tenant is only used for cardinality accounting.
+    Resolution resolve(const std::string& name, const Tags& tags,
+                       const std::string& tenant = "default");
+
+    std::optional<SeriesDescriptor> lookup(SeriesId id) const;
+
+    size_t series_count() const { return series_count_.load(std::memory_order_relaxed); }
+
+    // HyperLogLog estimate of distinct series per tenant
+    double tenant_cardinality(const std::string& tenant) const;
+    std::vector<std::pair<std::string, double>> tenant_cardinalities() const;
+
+    // Hash of the canonical form, without registering anything
+    static SeriesId compute_series_id(const std::string& name, const Tags& tags);
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<SeriesId, SeriesDescriptor> series;
+    };
+
+    struct TenantStats {
+        HyperLogLog sketch;
+        std::atomic<uint64_t> new_series{0};
+        std::atomic<bool> warned{false};
+    };
+
+    std::array<Shard, SHARD_COUNT> shards_;
+    std::atomic<size_t> series_count_{0};
+    size_t tenant_cardinality_warning_;
+
+    mutable std::shared_mutex tenants_mutex_;
+    std::unordered_map<std::string, std::unique_ptr<TenantStats>> tenants_;
+
+    Shard& shard_for(SeriesId id) { return shards_[id % SHARD_COUNT]; }
+    const Shard& shard_for(SeriesId id) const { return shards_[id % SHARD_COUNT]; }
+
+    TenantStats& tenant_stats(const std::string& tenant);
+    void record_tenant_series(const std::string& tenant, SeriesId id, bool created);
+
+    using SortedTags = std::vector<const std::pair<const std::string, std::string>*>;
+    static SortedTags sort_tags(const Tags& tags);
+    static SeriesId hash_canonical(const std::string& name, const SortedTags& tags);
+    static bool same_series(const SeriesDescriptor& desc, const std::string& name,
+                            const SortedTags& tags);
+};
+
+} // namespace metricstream
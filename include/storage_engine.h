@@ -0,0 +1,174 @@
+#pragma once
+
+#include "metric.h"
+#include "series_registry.h"
+#include "tag_index.h"
+#include "block_storage.h"
+#include "head_block.h"
+#include "rollup_store.h"
+#include "batch_codec.h"
+#include "compaction.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace metricstream {
+
+// Time-series storage fed by the queue consumers
+// Recent samples live in the columnar in-memory head block; a background
+// flusher writes chunks older than the head window out as compressed
+// immutable blocks. Series labels go into the tag index so queries resolve
+// selectors to IDs, scan the head, and only read blocks that overlap the
+// requested time range - a recent-window query never touches disk. A
+// background compactor merges the small flushed blocks of each window so a
+// range query opens a few files instead of one per flush. Decompressed
+// series read by queries are kept in a shared, scan-resistant BlockCache.
+class StorageEngine {
+public:
+    struct Options {
+        std::string data_dir = "storage";
+        int64_t block_duration_ms = BlockStore::DEFAULT_BLOCK_DURATION_MS;
+        int64_t head_window_ms = 15 * 60 * 1000;  // keep the last 15 minutes in memory
+        size_t max_head_samples = 1000000;        // flush early beyond this
+        int64_t flush_interval_ms = 10000;        // background flush period (0 = manual only)
+        std::vector<int64_t> rollup_resolutions_ms = {60 * 1000, 60 * 60 * 1000};  // 1m and 1h tiers
+        CompactionOptions compaction;  // raw blocks and rollup tiers; grace is at least the head window
+        size_t block_cache_bytes = 256 * 1024 * 1024;  // decompressed block series (0 = no cache)
+        int64_t out_of_order_window_ms = 10 * 60 * 1000;  // accept samples this far behind the newest (0 = none)
+    };
+
+    struct QueryStats {
+        size_t series_matched = 0;
+        size_t blocks_read = 0;
+        size_t samples_returned = 0;
+    };
+
+    struct SeriesResult {
+        SeriesDescriptor series;
+        std::vector<Sample> samples;
+    };
+
+    struct RollupResult {
+        SeriesDescriptor series;
+        std::vector<RollupPoint> points;  // sorted by bucket end
+    };
+
+    explicit StorageEngine(const Options& options);
+    ~StorageEngine();
+
+    // Ingest one decoded queue message (thread-safe)
+    void ingest(const DecodedBatch& batch);
+
+    // Lower-level write path
+    void register_series(const SeriesDescriptor& series);
+    void append(SeriesId id, int64_t timestamp_ms, double value);
+
+    // Called after every write with the oldest and newest timestamps written
+    // (once per ingested batch), e.g. to invalidate cached query results. Set
+    // before ingest starts; not synchronized with concurrent writes.
+    using WriteObserver = std::function<void(int64_t oldest_ts, int64_t newest_ts)>;
+    void set_write_observer(WriteObserver observer) { write_observer_ = std::move(observer); }
+
+    // Series matching all matchers
+    std::vector<SeriesId> select(const std::vector<TagMatcher>& matchers) const;
+    std::optional<SeriesDescriptor> series(SeriesId id) const;
+
+    // Raw samples in [start_ts, end_ts] for every series matching the selector
+    std::vector<SeriesResult> query(const std::vector<TagMatcher>& matchers,
+                                    int64_t start_ts, int64_t end_ts,
+                                    QueryStats* stats = nullptr) const;
+
+    // Same over already-selected series, so a query can be split into
+    // series shards that are read independently (thread-safe)
+    std::vector<SeriesResult> query_series(const std::vector<SeriesId>& ids,
+                                           int64_t start_ts, int64_t end_ts,
+                                           QueryStats* stats = nullptr) const;
+
+    // Rollup tier resolutions, finest first
+    std::vector<int64_t> rollup_resolutions() const;
+
+    // Tier buckets with end in [start_ts, end_ts] for already-selected series,
+    // including samples still in the head; throws if there is no such tier
+    std::vector<RollupResult> query_rollups(const std::vector<SeriesId>& ids, int64_t resolution_ms,
+                                            int64_t start_ts, int64_t end_ts,
+                                            QueryStats* stats = nullptr) const;
+
+    // Write the whole head out as blocks
+    void flush();
+
+    // Run every merge the compaction strategy has pending, raw blocks first
+    // and then each rollup tier; returns how many
+    size_t compact();
+    CompactionStats compaction_stats() const { return compactor_.stats(); }
+
+    // Zeroed stats when the cache is disabled
+    BlockCache::Stats block_cache_stats() const {
+        return block_cache_ ? block_cache_->stats() : BlockCache::Stats{};
+    }
+
+    const HeadBlock& head() const { return head_; }
+
+    size_t series_count() const { return index_.series_count(); }
+    size_t block_count() const { return blocks_.block_count(); }
+    size_t head_samples() const { return head_.sample_count(); }
+    uint64_t out_of_order_accepted() const { return head_.out_of_order_accepted(); }
+    uint64_t out_of_order_rejected() const { return head_.out_of_order_rejected(); }
+
+private:
+    Options options_;
+    TagIndex index_;
+    std::unique_ptr<BlockCache> block_cache_;  // shared by the raw and rollup stores
+    BlockStore blocks_;
+    HeadBlock head_;
+    Compactor compactor_;
+    std::vector<std::unique_ptr<RollupStore>> rollups_;  // finest first
+    mutable std::shared_mutex rollup_mutex_;  // tier writes + head release vs rollup reads
+    // Newest sample of each series already folded into the tiers (under
+    // rollup_mutex_); a sample at or before it may rewrite a counted one
+    std::unordered_map<SeriesId, int64_t> rolled_up_until_;
+
+    WriteObserver write_observer_;
+
+    mutable std::shared_mutex series_mutex_;
+    std::unordered_map<SeriesId, SeriesDescriptor> series_;
+
+    // Background flusher
+    std::mutex flush_mutex_;  // one flush at a time
+    std::mutex flusher_wait_mutex_;
+    std::condition_variable flusher_cv_;
+    std::atomic<bool> running_{false};
+    std::thread flusher_thread_;
+
+    void append_sample(SeriesId id, int64_t timestamp_ms, double value);
+    void flusher_loop();
+    // Newest head timestamp, but never past the server clock, so a client
+    // clock running ahead cannot flush the head window early
+    int64_t head_newest() const;
+    // Drops head series flushed empty and idle past the head and out-of-order
+    // windows (under flush_mutex_)
+    void evict_idle_series();
+    void backfill_rollup(RollupStore& rollup);
+    // Folds flushed samples into one tier (under rollup_mutex_)
+    void add_to_rollup(RollupStore& rollup, const SeriesSamples& flushed) const;
+    // Raw samples of the given tier buckets from the blocks, with `recent`
+    // laid over them, deduplicated
+    std::vector<Sample> rebuild_buckets(SeriesId id, const std::set<int64_t>& bucket_ends, int64_t resolution_ms,
+                                        const std::vector<Sample>& recent) const;
+    int64_t rolled_up_until(SeriesId id) const;  // under rollup_mutex_
+    // Persist head chunks whose samples are all older than cutoff_ts
+    void flush_head(int64_t cutoff_ts);
+    // One block per bucket; samples written are appended to `flushed` for the rollups
+    void write_buckets(std::map<int64_t, SeriesSamples>& buckets, SeriesSamples& flushed);
+};
+
+} // namespace metricstream
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "metric.h"
+#include "roaring_bitmap.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <regex>
+#include <unordered_map>
+#include <shared_mutex>
+
+namespace metricstream {
+
+// One predicate of a series selector, e.g. host="web-1" or region=~"us-.*"
+struct TagMatcher {
+    enum class Op {
+        EQUAL,          // =
+        NOT_EQUAL,      // !=
+        REGEX_MATCH,    // =~  (fully anchored)
+        REGEX_NO_MATCH  // !~
+    };
+
+    std::string key;
+    std::string value;
+    Op op = Op::EQUAL;
+    std::shared_ptr<const std::regex> regex;  // for =~ and !~, compiled once here
+
+    // Throws std::regex_error on a bad =~ / !~ pattern
+    TagMatcher(std::string k, std::string v, Op o = Op::EQUAL);
+
+    // Does a tag value satisfy this matcher? (missing tag == empty value)
+    bool matches(const std::string& tag_value) const;
+};
+
+// Inverted index: (tag key, tag value) -> postings list of series
+// The metric name is indexed as the reserved tag "__name__", so
+// cpu_usage{host="web-1"} is just two equality matchers intersected.
+//
+// Postings hold dense 32-bit ordinals (assigned in insertion order) compressed
+// as Roaring bitmaps; ordinals map back to the 64-bit SeriesId on output.
+class TagIndex {
+public:
+    static constexpr const char* NAME_TAG = "__name__";
+
+    // Index a series. Returns false if the series was already present.
+    bool add_series(SeriesId id, const std::string& name, const Tags& tags);
+
+    // Resolve a selector to matching series IDs (sorted ascending).
+    // Equality matchers are intersected smallest-first; negative matchers
+    // are subtracted afterwards so no full scan is needed unless every
+    // matcher is negative.
+    std::vector<SeriesId> select(const std::vector<TagMatcher>& matchers) const;
+
+    // Convenience: metric name plus equality tags
+    std::vector<SeriesId> select(const std::string& name, const Tags& tags = {}) const;
+
+    bool contains(SeriesId id) const;
+
+    // Values seen for a tag key, sorted (for autocompletion / regex expansion)
+    std::vector<std::string> tag_values(const std::string& key) const;
+
+    size_t series_count() const;
+    size_t postings_count() const;  // number of distinct (key, value) pairs
+    size_t memory_bytes() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+
+    std::unordered_map<SeriesId, uint32_t> ordinals_;  // series -> ordinal
+    std::vector<SeriesId> series_by_ordinal_;          // ordinal -> series
+    RoaringBitmap all_series_;
+
+    // key -> (value -> postings). Values kept ordered for regex scans.
+    std::unordered_map<std::string, std::map<std::string, RoaringBitmap>> postings_;
+
+    // Must be called with mutex_ held (shared)
+    RoaringBitmap postings_for(const TagMatcher& matcher) const;
+    RoaringBitmap equal_postings(const std::string& key, const std::string& value) const;
+    RoaringBitmap regex_postings(const std::string& key, const std::regex& pattern) const;
+    RoaringBitmap union_of_key(const std::string& key) const;
+    std::vector<SeriesId> to_series_ids(const RoaringBitmap& ordinals) const;
+};
+
+} // namespace metricstream
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Sampled request tracing
+//
+// A request is sampled once, where it enters the server; its trace ID then
+// rides in a thread-local "current trace" on whichever thread is working on
+// it (and explicitly across the async write queue). Span sites check that
+// thread-local and do nothing else when it is 0, so unsampled requests pay a
+// single branch per site.
+//
+// Finished spans go into a fixed ring per thread. Only the owning thread
+// writes its ring; dump_chrome_json() copies every ring without stopping the
+// writers and drops entries that were overwritten while it read them.
+
+inline thread_local uint64_t current_trace_id = 0;
+
+inline int64_t trace_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Tracer {
+public:
+    static constexpr size_t RING_SIZE = 4096;  // spans kept per thread
+
+    static Tracer& instance();
+
+    // Fraction of requests to trace, 0 (off) to 1 (all)
+    void set_sample_rate(double rate);
+    double sample_rate() const;
+
+    // New trace ID if this request is sampled, else 0
+    uint64_t start_trace() {
+        uint64_t threshold = sample_threshold_.load(std::memory_order_relaxed);
+        if (threshold == 0) {
+            return 0;
+        }
+        return start_trace_slow(threshold);
+    }
+
+    void record(uint64_t trace_id, const char* name, int64_t start_ns, int64_t end_ns);
+
+    // Chrome trace event format (chrome://tracing, ui.perfetto.dev), oldest
+    // span first; complete ("X") events with the trace ID in args
+    std::string dump_chrome_json() const;
+
+private:
+    struct SpanRecord {
+        std::atomic<uint64_t> trace_id{0};
+        std::atomic<const char*> name{nullptr};  // string literal
+        std::atomic<int64_t> start_ns{0};
+        std::atomic<int64_t> end_ns{0};
+    };
+
+    struct ThreadRing {
+        std::array<SpanRecord, RING_SIZE> spans;
+        std::atomic<uint64_t> written{0};  // total spans ever written
+        size_t thread_index = 0;
+        bool in_use = false;
+    };
+
+    Tracer() = default;
+
+    uint64_t start_trace_slow(uint64_t threshold);
+    ThreadRing* claim_ring();
+    void release_ring(ThreadRing* ring);
+
+    std::atomic<uint64_t> sample_threshold_{0};  // sample when random < threshold
+    std::atomic<uint64_t> next_trace_id_{1};
+
+    mutable std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<ThreadRing>> rings_;
+
+    friend struct ThreadRingHandle;
+};
+
+// Makes `trace_id` the calling thread's current trace for the scope
+class TraceScope {
+public:
+    explicit TraceScope(uint64_t trace_id) : previous_(current_trace_id) { current_trace_id = trace_id; }
+    ~TraceScope() { current_trace_id = previous_; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    uint64_t previous_;
+};
+
+// Records [construction, destruction) as `name` under the current trace
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : trace_id_(current_trace_id), name_(name) {
+        if (trace_id_ != 0) {
+            start_ns_ = trace_clock_ns();
+        }
+    }
+    ~TraceSpan() {
+        if (trace_id_ != 0) {
+            Tracer::instance().record(trace_id_, name_, start_ns_, trace_clock_ns());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    uint64_t trace_id_;
+    const char* name_;
+    int64_t start_ns_ = 0;
+};
+
+} // namespace metricstream
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace metricstream {
+
+// Zipf distribution over ranks [0, n): P(r) ~ 1 / (r + 1)^s
+//
+// Rejection-inversion sampling (Hormann & Derflinger), so memory stays O(1)
+// even for millions of series. s = 0 is uniform.
+class ZipfDistribution {
+public:
+    ZipfDistribution(uint64_t n, double s);
+
+    uint64_t operator()(std::mt19937_64& gen) const;
+    uint64_t size() const { return n_; }
+
+private:
+    uint64_t n_;
+    double s_;
+    double h_integral_x1_;
+    double h_integral_n_;
+    double threshold_;
+
+    double h(double x) const;
+    double h_integral(double x) const;
+    double h_integral_inverse(double x) const;
+};
+
+// Shape of a synthetic ingest workload
+//
+// Series are identified by index and their name and tags are derived from a
+// hash of (seed, index), so any number of generator threads agree on what
+// series i looks like without storing the series set.
+struct WorkloadConfig {
+    uint64_t clients = 100;
+    double client_skew = 1.0;         // Zipf exponent over clients (0 = uniform)
+    uint64_t series = 10000;          // total distinct series (cardinality)
+    double series_skew = 1.0;         // Zipf exponent over series
+    uint64_t metric_names = 50;
+    size_t min_tags = 2;              // besides the instance tag
+    size_t max_tags = 6;
+    size_t min_tag_value_length = 4;
+    size_t max_tag_value_length = 16;
+    size_t min_batch = 1;             // metrics per request
+    size_t max_batch = 1;             // at most MAX_BATCH
+    uint64_t seed = 42;
+
+    static constexpr size_t MAX_BATCH = 1000;  // MetricValidator::validate_batch limit
+
+    // "series=100000,series_skew=1.1,clients=500,batch=1-1000,tags=2-8,tag_len=4-32,names=200,seed=7"
+    // Unknown keys or bad values throw std::invalid_argument.
+    static WorkloadConfig parse(const std::string& spec);
+    void validate() const;  // throws std::invalid_argument
+    std::string describe() const;
+};
+
+// One POST /metrics request
+struct WorkloadRequest {
+    std::string client_id;
+    std::string body;  // single-line JSON
+};
+
+class WorkloadModel {
+public:
+    explicit WorkloadModel(const WorkloadConfig& config);
+
+    const WorkloadConfig& config() const { return config_; }
+
+    // Thread-safe as long as each thread passes its own generator
+    WorkloadRequest next(std::mt19937_64& gen) const;
+
+    // JSON object for one sample of series `index`
+    void append_metric(uint64_t index, std::mt19937_64& gen, std::string& out) const;
+
+private:
+    WorkloadConfig config_;
+    ZipfDistribution clients_;
+    ZipfDistribution series_;
+};
+
+// Captured requests, one per line: <client_id> TAB <body>
+namespace request_log {
+
+void append(std::ostream& out, const WorkloadRequest& request);
+
+// Throws std::runtime_error if the file cannot be read or has no requests
+std::vector<WorkloadRequest> load(const std::string& path);
+
+} // namespace request_log
+
+} // namespace metricstream
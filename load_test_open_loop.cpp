@@ -0,0 +1,632 @@
+#include "hdr_histogram.h"
+#include "workload_model.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iomanip>
+#include <fstream>
+#include <mutex>
+
+// Open-loop load generator - requests follow a fixed-rate schedule no matter
+// how fast the server answers, and latency is measured from the time each
+// request was *supposed* to be sent.
+//
+// The closed-loop clients (load_test, load_test_persistent) wait for a reply
+// before sending the next request, so a server stall also stalls the client
+// and the requests that should have been issued meanwhile are never measured
+// (coordinated omission). Here a stall builds a backlog of scheduled requests
+// whose latency includes the time they waited, which is what a real user
+// population sees.
+//
+// Each thread drives its share of the connections with epoll, one request in
+// flight per connection; connects are non-blocking too, so a slow reconnect
+// never holds up the schedule. A timerfd armed at the next send time wakes the
+// loop with nanosecond precision. Latencies go into per-thread HDR histograms
+// that are merged for the report.
+//
+// POST bodies come from a WorkloadModel (--workload=...): Zipf-distributed
+// clients and series, variable batch sizes and tag shapes. --capture writes
+// every request sent to a log and --replay sends a captured log instead.
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    double rate = 1000.0;       // requests per second, all threads
+    int duration_seconds = 10;
+    int connections = 32;
+    int threads = 2;
+    std::string path;           // GET path; empty = POST /metrics
+    int drain_seconds = 5;      // wait for in-flight requests after the schedule ends
+    int batch_size = 0;         // --batch=N shorthand for workload batch=N
+    bool keep_alive = true;     // false sends Connection: close
+    std::string json_path;      // machine-readable summary for the regression harness
+    std::string workload_spec;  // WorkloadConfig::parse syntax
+    std::string replay_path;    // request_log to send instead of generated bodies
+    std::string capture_path;   // request_log of every request sent
+};
+
+// Where POST bodies come from, shared by all workers
+// epoll data of the schedule timer; connections use their index
+constexpr uint64_t TIMER_TOKEN = ~uint64_t{0};
+
+struct RequestSource {
+    std::unique_ptr<metricstream::WorkloadModel> model;
+    std::vector<metricstream::WorkloadRequest> replay;  // non-empty = replay mode
+
+    std::mutex capture_mutex;
+    std::ofstream capture;
+};
+
+std::atomic<uint64_t> progress_completed{0};
+std::atomic<uint64_t> progress_errors{0};
+
+class Worker {
+public:
+    Worker(const Options& options, RequestSource& source, int id, int connections, int64_t start_ns,
+           int64_t interval_ns)
+        : options_(options), source_(source), id_(id), connection_count_(connections), start_ns_(start_ns),
+          interval_ns_(interval_ns), gen_(std::random_device{}() + id), replay_next_(id),
+          latency_(), service_time_() {}
+
+    void run();
+
+    const metricstream::HdrHistogram& latency() const { return latency_; }
+    const metricstream::HdrHistogram& service_time() const { return service_time_; }
+    uint64_t scheduled() const { return scheduled_; }
+    uint64_t completed() const { return completed_; }
+    uint64_t errors() const { return errors_; }
+    uint64_t unsent() const { return unsent_; }
+    size_t max_backlog() const { return max_backlog_; }
+
+private:
+    struct Connection {
+        int fd = -1;
+        bool connecting = false;  // waiting for EPOLLOUT to finish connect()
+        bool busy = false;
+        bool want_write = false;
+        int64_t intended_ns = 0;  // scheduled send time of the in-flight request
+        int64_t sent_ns = 0;      // actual send time
+        std::string out;
+        size_t out_offset = 0;
+        std::string in;
+    };
+
+    const Options& options_;
+    RequestSource& source_;
+    int id_;
+    int connection_count_;
+    int64_t start_ns_;
+    int64_t interval_ns_;
+    std::mt19937_64 gen_;
+    size_t replay_next_;  // worker t sends replay entries t, t + threads, ...
+
+    int epoll_fd_ = -1;
+    int timer_fd_ = -1;
+    int64_t timer_armed_ns_ = -1;
+    std::vector<Connection> connections_;
+    std::vector<size_t> idle_;
+    std::deque<int64_t> backlog_;  // intended send times not yet on a connection
+
+    metricstream::HdrHistogram latency_;       // from intended send time
+    metricstream::HdrHistogram service_time_;  // from actual send time
+    uint64_t scheduled_ = 0;
+    uint64_t completed_ = 0;
+    uint64_t errors_ = 0;
+    uint64_t unsent_ = 0;
+    size_t max_backlog_ = 0;
+
+    bool connect_one(Connection& conn, size_t index);
+    void finish_connect(size_t index);
+    void arm_timer(int64_t deadline_ns);
+    void fail(size_t index);
+    void send_request(size_t index, int64_t intended_ns);
+    void flush_output(size_t index);
+    void read_input(size_t index);
+    std::string build_request();
+};
+
+// Starts a non-blocking connect. A connection that is not up yet joins idle_
+// from finish_connect(); false means the socket could not be opened at all.
+bool Worker::connect_one(Connection& conn, size_t index) {
+    conn = Connection();
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in server_addr;
+    std::memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(options_.port);
+    inet_pton(AF_INET, options_.host.c_str(), &server_addr.sin_addr);
+
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return false;
+    }
+    // EPOLLOUT reports the end of the handshake, successful or not
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    conn.fd = fd;
+    conn.connecting = true;
+    return true;
+}
+
+void Worker::finish_connect(size_t index) {
+    Connection& conn = connections_[index];
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        // Refused: drop it rather than spin reconnecting to a server that is down
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        conn = Connection();
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+    conn.connecting = false;
+    idle_.push_back(index);
+}
+
+void Worker::arm_timer(int64_t deadline_ns) {
+    if (deadline_ns == timer_armed_ns_) {
+        return;
+    }
+    // steady_clock is CLOCK_MONOTONIC, so the schedule is an absolute deadline
+    struct itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline_ns / 1000000000LL;
+    spec.it_value.tv_nsec = deadline_ns % 1000000000LL;
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+    timer_armed_ns_ = deadline_ns;
+}
+
+void Worker::fail(size_t index) {
+    Connection& conn = connections_[index];
+    if (conn.busy) {
+        errors_++;
+        progress_errors++;
+    }
+    if (conn.fd >= 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+    }
+    if (!connect_one(conn, index)) {
+        conn.fd = -1;  // dropped; the remaining connections carry the schedule
+    }
+}
+
+std::string Worker::build_request() {
+    const char* connection = options_.keep_alive ? "keep-alive" : "close";
+    if (!options_.path.empty()) {
+        return "GET " + options_.path + " HTTP/1.1\r\nHost: localhost\r\nConnection: " + connection + "\r\n\r\n";
+    }
+    metricstream::WorkloadRequest generated;
+    const metricstream::WorkloadRequest* workload_request = &generated;
+    if (!source_.replay.empty()) {
+        workload_request = &source_.replay[replay_next_ % source_.replay.size()];
+        replay_next_ += static_cast<size_t>(options_.threads);
+    } else {
+        generated = source_.model->next(gen_);
+    }
+    if (source_.capture.is_open()) {
+        std::lock_guard<std::mutex> lock(source_.capture_mutex);
+        metricstream::request_log::append(source_.capture, *workload_request);
+    }
+
+    const std::string& body = workload_request->body;
+    std::string request = "POST /metrics HTTP/1.1\r\n";
+    request += "Host: localhost\r\n";
+    request += "Content-Type: application/json\r\n";
+    request += "Authorization: " + workload_request->client_id + "\r\n";
+    request += std::string("Connection: ") + connection + "\r\n";
+    request += "Content-Length: " + std::to_string(body.length()) + "\r\n\r\n";
+    request += body;
+    return request;
+}
+
+void Worker::send_request(size_t index, int64_t intended_ns) {
+    Connection& conn = connections_[index];
+    conn.busy = true;
+    conn.intended_ns = intended_ns;
+    conn.sent_ns = now_ns();
+    conn.out = build_request();
+    conn.out_offset = 0;
+    conn.in.clear();
+    flush_output(index);
+}
+
+void Worker::flush_output(size_t index) {
+    Connection& conn = connections_[index];
+    while (conn.out_offset < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset,
+                         MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            fail(index);
+            return;
+        }
+        conn.out_offset += static_cast<size_t>(n);
+    }
+    bool want_write = conn.out_offset < conn.out.size();
+    if (want_write != conn.want_write) {
+        struct epoll_event ev;
+        ev.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        ev.data.u64 = index;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+        conn.want_write = want_write;
+    }
+}
+
+// Complete when the headers plus Content-Length bytes (or the final chunk of
+// a chunked body) have arrived. Returns true if the server closes afterwards.
+bool response_complete(const std::string& in, bool& close_after) {
+    size_t header_end = in.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+        return false;
+    }
+    std::string headers = in.substr(0, header_end);
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+    close_after = headers.find("connection: close") != std::string::npos;
+
+    if (headers.find("transfer-encoding: chunked") != std::string::npos) {
+        return in.size() >= header_end + 9 && in.compare(in.size() - 5, 5, "0\r\n\r\n") == 0;
+    }
+    size_t length = 0;
+    size_t pos = headers.find("content-length:");
+    if (pos != std::string::npos) {
+        length = std::strtoul(headers.c_str() + pos + 15, nullptr, 10);
+    }
+    return in.size() >= header_end + 4 + length;
+}
+
+void Worker::read_input(size_t index) {
+    Connection& conn = connections_[index];
+    char buffer[16384];
+    bool closed = false;
+    while (true) {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.in.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        closed = true;  // the response may still be complete
+        break;
+    }
+
+    bool close_after = false;
+    if (!conn.busy || !response_complete(conn.in, close_after)) {
+        if (closed) {
+            fail(index);
+        }
+        return;
+    }
+    int64_t done = now_ns();
+    bool ok = conn.in.compare(0, 12, "HTTP/1.1 200") == 0 || conn.in.compare(0, 12, "HTTP/1.0 200") == 0;
+    if (ok) {
+        latency_.record((done - conn.intended_ns) / 1000);
+        service_time_.record((done - conn.sent_ns) / 1000);
+        completed_++;
+        progress_completed++;
+    } else {
+        errors_++;
+        progress_errors++;
+    }
+    conn.busy = false;
+    conn.in.clear();
+    if (close_after || closed) {
+        fail(index);
+    } else {
+        idle_.push_back(index);
+    }
+}
+
+void Worker::run() {
+    epoll_fd_ = epoll_create1(0);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    struct epoll_event timer_ev;
+    timer_ev.events = EPOLLIN;
+    timer_ev.data.u64 = TIMER_TOKEN;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &timer_ev);
+
+    connections_.resize(static_cast<size_t>(connection_count_));
+    for (size_t i = 0; i < connections_.size(); ++i) {
+        connect_one(connections_[i], i);
+    }
+    auto open = [](const Connection& c) { return c.fd >= 0; };
+
+    // Threads interleave their schedules so the combined stream stays even
+    int64_t next_ns = start_ns_ + interval_ns_ * id_ / std::max(options_.threads, 1);
+    const int64_t end_ns = start_ns_ + static_cast<int64_t>(options_.duration_seconds) * 1000000000LL;
+    const int64_t drain_end_ns = end_ns + static_cast<int64_t>(options_.drain_seconds) * 1000000000LL;
+    std::vector<struct epoll_event> events(static_cast<size_t>(connection_count_) + 1);
+
+    while (true) {
+        int64_t now = now_ns();
+        while (next_ns <= now && next_ns < end_ns) {
+            backlog_.push_back(next_ns);
+            scheduled_++;
+            next_ns += interval_ns_;
+        }
+        while (!backlog_.empty() && !idle_.empty()) {
+            size_t index = idle_.back();
+            idle_.pop_back();
+            int64_t intended = backlog_.front();
+            backlog_.pop_front();
+            send_request(index, intended);
+        }
+        max_backlog_ = std::max(max_backlog_, backlog_.size());
+
+        bool any_busy = std::any_of(connections_.begin(), connections_.end(),
+                                    [](const Connection& c) { return c.busy; });
+        if (next_ns >= end_ns && backlog_.empty() && !any_busy) {
+            break;
+        }
+        if (now >= drain_end_ns) {
+            break;
+        }
+        if (std::none_of(connections_.begin(), connections_.end(), open)) {
+            std::cerr << "Worker " << id_ << ": no connection to " << options_.host << ":" << options_.port
+                      << std::endl;
+            break;
+        }
+
+        // Millisecond epoll timeouts would either busy-spin on sub-millisecond
+        // gaps or send late, so the timer carries the schedule
+        int timeout_ms = 10;
+        if (next_ns < end_ns) {
+            arm_timer(next_ns);
+            timeout_ms = -1;
+        }
+        int ready = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout_ms);
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.u64 == TIMER_TOKEN) {
+                uint64_t expirations;
+                if (read(timer_fd_, &expirations, sizeof(expirations)) > 0) {
+                    timer_armed_ns_ = -1;
+                }
+                continue;
+            }
+            size_t index = static_cast<size_t>(events[i].data.u64);
+            if (connections_[index].fd < 0) {
+                continue;
+            }
+            if (connections_[index].connecting) {
+                finish_connect(index);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                // A response can arrive together with the hangup; read_input
+                // sees the close once the data is consumed
+                read_input(index);
+                continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                fail(index);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flush_output(index);
+            }
+        }
+    }
+
+    // Whatever is still queued or in flight never got an answer in time
+    unsent_ = backlog_.size();
+    for (auto& conn : connections_) {
+        if (conn.busy) {
+            errors_++;
+        }
+        if (conn.fd >= 0) {
+            close(conn.fd);
+        }
+    }
+    close(timer_fd_);
+    close(epoll_fd_);
+}
+
+} // namespace
+
+void write_json_summary(const std::string& path, const Options& options, const std::string& workload,
+                        uint64_t scheduled, uint64_t completed,
+                        uint64_t errors, uint64_t unsent, const metricstream::HdrHistogram& latency,
+                        const metricstream::HdrHistogram& service_time) {
+    std::ofstream out(path);
+    out << "{\"rate\":" << options.rate
+        << ",\"duration_s\":" << options.duration_seconds
+        << ",\"connections\":" << options.connections
+        << ",\"workload\":\"" << workload << "\""
+        << ",\"keep_alive\":" << (options.keep_alive ? "true" : "false")
+        << ",\"scheduled\":" << scheduled
+        << ",\"completed\":" << completed
+        << ",\"errors\":" << errors
+        << ",\"unsent\":" << unsent
+        << ",\"throughput\":" << static_cast<double>(completed) / options.duration_seconds;
+    const std::pair<const char*, const metricstream::HdrHistogram*> histograms[] = {
+        {"latency_us", &latency}, {"service_time_us", &service_time}};
+    for (const auto& [name, histogram] : histograms) {
+        out << ",\"" << name << "\":{\"p50\":" << histogram->value_at_percentile(50.0)
+            << ",\"p90\":" << histogram->value_at_percentile(90.0)
+            << ",\"p99\":" << histogram->value_at_percentile(99.0)
+            << ",\"p99.9\":" << histogram->value_at_percentile(99.9)
+            << ",\"max\":" << histogram->max()
+            << ",\"mean\":" << histogram->mean() << "}";
+    }
+    out << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--batch=", 0) == 0) {
+            options.batch_size = std::stoi(arg.substr(8));
+        } else if (arg.rfind("--workload=", 0) == 0) {
+            options.workload_spec = arg.substr(11);
+        } else if (arg.rfind("--replay=", 0) == 0) {
+            options.replay_path = arg.substr(9);
+        } else if (arg.rfind("--capture=", 0) == 0) {
+            options.capture_path = arg.substr(10);
+        } else if (arg == "--close") {
+            options.keep_alive = false;
+        } else if (arg.rfind("--json=", 0) == 0) {
+            options.json_path = arg.substr(7);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 0) options.port = std::stoi(positional[0]);
+    if (positional.size() > 1) options.rate = std::stod(positional[1]);
+    if (positional.size() > 2) options.duration_seconds = std::stoi(positional[2]);
+    if (positional.size() > 3) options.connections = std::stoi(positional[3]);
+    if (positional.size() > 4) options.threads = std::stoi(positional[4]);
+    if (positional.size() > 5) options.path = positional[5];
+
+    if (options.rate <= 0 || options.duration_seconds <= 0 || options.connections <= 0 || options.threads <= 0 ||
+        options.batch_size < 0) {
+        std::cerr << "Usage: " << argv[0] << " [port] [rate_per_sec] [duration_s] [connections] [threads] [get_path]"
+                  << " [--workload=spec] [--batch=N] [--replay=log] [--capture=log] [--close] [--json=path]\n"
+                  << "  spec: series=N,series_skew=S,clients=N,client_skew=S,names=N,"
+                  << "batch=MIN-MAX,tags=MIN-MAX,tag_len=MIN-MAX,seed=N\n";
+        return 1;
+    }
+
+    RequestSource source;
+    std::string workload_description;
+    try {
+        if (!options.replay_path.empty()) {
+            source.replay = metricstream::request_log::load(options.replay_path);
+            workload_description = "replay of " + options.replay_path + " (" +
+                                   std::to_string(source.replay.size()) + " requests)";
+        } else {
+            metricstream::WorkloadConfig config = metricstream::WorkloadConfig::parse(options.workload_spec);
+            if (options.batch_size > 0) {
+                config.min_batch = config.max_batch = static_cast<size_t>(options.batch_size);
+            }
+            source.model = std::make_unique<metricstream::WorkloadModel>(config);
+            workload_description = config.describe();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!options.capture_path.empty()) {
+        source.capture.open(options.capture_path);
+        if (!source.capture) {
+            std::cerr << "Error: cannot write " << options.capture_path << std::endl;
+            return 1;
+        }
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    std::cout << "MetricStream Open-Loop Load Test" << std::endl;
+    std::cout << "================================" << std::endl;
+    std::cout << "Target: " << options.host << ":" << options.port
+              << (options.path.empty() ? " POST /metrics" : " GET " + options.path) << std::endl;
+    std::cout << "Rate: " << options.rate << " req/s for " << options.duration_seconds << " s" << std::endl;
+    std::cout << "Connections: " << options.connections << " across " << options.threads << " threads"
+              << (options.keep_alive ? "" : " (Connection: close)") << std::endl;
+    if (options.path.empty()) {
+        std::cout << "Workload: " << workload_description << std::endl;
+    }
+    std::cout << "\nStarting load test..." << std::endl;
+
+    // Per-thread rate = rate / threads, so each thread's interval is threads / rate
+    int64_t interval_ns = static_cast<int64_t>(1e9 * options.threads / options.rate);
+    int64_t start_ns = now_ns() + 100000000LL;  // leave time to connect
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int t = 0; t < options.threads; ++t) {
+        int connections = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(options, source, t, connections, start_ns, interval_ns));
+    }
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker]() { worker->run(); });
+    }
+
+    std::atomic<bool> done{false};
+    std::thread progress_thread([&]() {
+        int second = 0;
+        while (!done) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (done) break;
+            std::cout << "Progress: " << ++second << " s, Completed: " << progress_completed
+                      << ", Errors: " << progress_errors << std::endl;
+        }
+    });
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    progress_thread.join();
+
+    metricstream::HdrHistogram latency;
+    metricstream::HdrHistogram service_time;
+    uint64_t scheduled = 0, completed = 0, errors = 0, unsent = 0;
+    size_t max_backlog = 0;
+    for (const auto& worker : workers) {
+        latency.merge(worker->latency());
+        service_time.merge(worker->service_time());
+        scheduled += worker->scheduled();
+        completed += worker->completed();
+        errors += worker->errors();
+        unsent += worker->unsent();
+        max_backlog = std::max(max_backlog, worker->max_backlog());
+    }
+
+    double achieved = static_cast<double>(completed) / options.duration_seconds;
+    std::cout << "\n=== Open-Loop Load Test ===" << std::endl;
+    std::cout << "Scheduled: " << scheduled << " (" << std::fixed << std::setprecision(2)
+              << options.rate << " req/s target)" << std::endl;
+    std::cout << "Completed: " << completed << " (" << achieved << " req/s)" << std::endl;
+    std::cout << "Errors: " << errors << ", never sent: " << unsent << std::endl;
+    std::cout << "Max backlog per thread: " << max_backlog << std::endl;
+    std::cout << "Latency (from intended send): " << latency.summary("us") << std::endl;
+    std::cout << "Service time (from actual send): " << service_time.summary("us") << std::endl;
+    std::cout << "===========================" << std::endl;
+
+    if (!options.json_path.empty()) {
+        write_json_summary(options.json_path, options, workload_description, scheduled, completed, errors, unsent, latency,
+                           service_time);
+    }
+    return errors > 0 || unsent > 0 ? 2 : 0;
+}
@@ -0,0 +1,474 @@
+#include "aggregation_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define METRICSTREAM_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace metricstream {
+
+double Aggregate::value(AggregateOp op) const {
+    switch (op) {
+        case AggregateOp::SUM:   return sum;
+        case AggregateOp::MIN:   return min;
+        case AggregateOp::MAX:   return max;
+        case AggregateOp::AVG:   return avg();
+        case AggregateOp::COUNT: return static_cast<double>(count);
+    }
+    return 0.0;
+}
+
+void Aggregate::merge(const Aggregate& other) {
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    count += other.count;
+}
+
+AggregateOp parse_aggregate_op(const std::string& name) {
+    if (name == "sum") return AggregateOp::SUM;
+    if (name == "min") return AggregateOp::MIN;
+    if (name == "max") return AggregateOp::MAX;
+    if (name == "avg") return AggregateOp::AVG;
+    if (name == "count") return AggregateOp::COUNT;
+    throw std::invalid_argument("Unknown aggregation: " + name);
+}
+
+namespace {
+
+constexpr double POS_INF = std::numeric_limits<double>::infinity();
+constexpr double NEG_INF = -std::numeric_limits<double>::infinity();
+
+// ----------------------------------------------------------------------------
+// Scalar kernels (portable fallback, and the tail of every SIMD loop)
+// ----------------------------------------------------------------------------
+
+double sum_scalar(const double* values, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) sum += values[i];
+    return sum;
+}
+
+double min_scalar(const double* values, size_t count) {
+    double result = POS_INF;
+    for (size_t i = 0; i < count; ++i) result = std::min(result, values[i]);
+    return result;
+}
+
+double max_scalar(const double* values, size_t count) {
+    double result = NEG_INF;
+    for (size_t i = 0; i < count; ++i) result = std::max(result, values[i]);
+    return result;
+}
+
+Aggregate aggregate_scalar(const double* values, size_t count) {
+    Aggregate agg;
+    for (size_t i = 0; i < count; ++i) {
+        agg.sum += values[i];
+        agg.min = std::min(agg.min, values[i]);
+        agg.max = std::max(agg.max, values[i]);
+    }
+    agg.count = count;
+    return agg;
+}
+
+Aggregate aggregate_masked_scalar(const double* values, const uint8_t* mask, size_t count) {
+    Aggregate agg;
+    for (size_t i = 0; i < count; ++i) {
+        if (!mask[i]) continue;
+        agg.sum += values[i];
+        agg.min = std::min(agg.min, values[i]);
+        agg.max = std::max(agg.max, values[i]);
+        agg.count++;
+    }
+    return agg;
+}
+
+// Increase contributed by values[1..count) relative to their predecessors
+double increase_scalar(const double* values, size_t count) {
+    double increase = 0.0;
+    for (size_t i = 1; i < count; ++i) {
+        double delta = values[i] - values[i - 1];
+        increase += delta < 0 ? values[i] : delta;
+    }
+    return increase;
+}
+
+#ifdef METRICSTREAM_X86_KERNELS
+
+// ----------------------------------------------------------------------------
+// AVX2: 4 doubles per register, several independent accumulators to hide
+// add latency
+// ----------------------------------------------------------------------------
+
+__attribute__((target("avx2"))) double hsum256(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2"))) double hmin256(__m256d v) {
+    __m128d lo = _mm_min_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_min_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2"))) double hmax256(__m256d v) {
+    __m128d lo = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2"))) double sum_avx2(const double* values, size_t count) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    __m256d a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(values + i));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(values + i + 4));
+        a2 = _mm256_add_pd(a2, _mm256_loadu_pd(values + i + 8));
+        a3 = _mm256_add_pd(a3, _mm256_loadu_pd(values + i + 12));
+    }
+    for (; i + 4 <= count; i += 4) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(values + i));
+    }
+    double sum = hsum256(_mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)));
+    return sum + sum_scalar(values + i, count - i);
+}
+
+__attribute__((target("avx2"))) double min_avx2(const double* values, size_t count) {
+    __m256d m0 = _mm256_set1_pd(POS_INF), m1 = _mm256_set1_pd(POS_INF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        m0 = _mm256_min_pd(m0, _mm256_loadu_pd(values + i));
+        m1 = _mm256_min_pd(m1, _mm256_loadu_pd(values + i + 4));
+    }
+    for (; i + 4 <= count; i += 4) {
+        m0 = _mm256_min_pd(m0, _mm256_loadu_pd(values + i));
+    }
+    return std::min(hmin256(_mm256_min_pd(m0, m1)), min_scalar(values + i, count - i));
+}
+
+__attribute__((target("avx2"))) double max_avx2(const double* values, size_t count) {
+    __m256d m0 = _mm256_set1_pd(NEG_INF), m1 = _mm256_set1_pd(NEG_INF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        m0 = _mm256_max_pd(m0, _mm256_loadu_pd(values + i));
+        m1 = _mm256_max_pd(m1, _mm256_loadu_pd(values + i + 4));
+    }
+    for (; i + 4 <= count; i += 4) {
+        m0 = _mm256_max_pd(m0, _mm256_loadu_pd(values + i));
+    }
+    return std::max(hmax256(_mm256_max_pd(m0, m1)), max_scalar(values + i, count - i));
+}
+
+__attribute__((target("avx2"))) Aggregate aggregate_avx2(const double* values, size_t count) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256d lo0 = _mm256_set1_pd(POS_INF), lo1 = _mm256_set1_pd(POS_INF);
+    __m256d hi0 = _mm256_set1_pd(NEG_INF), hi1 = _mm256_set1_pd(NEG_INF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256d v0 = _mm256_loadu_pd(values + i);
+        __m256d v1 = _mm256_loadu_pd(values + i + 4);
+        s0 = _mm256_add_pd(s0, v0);
+        s1 = _mm256_add_pd(s1, v1);
+        lo0 = _mm256_min_pd(lo0, v0);
+        lo1 = _mm256_min_pd(lo1, v1);
+        hi0 = _mm256_max_pd(hi0, v0);
+        hi1 = _mm256_max_pd(hi1, v1);
+    }
+    Aggregate agg = aggregate_scalar(values + i, count - i);
+    agg.sum += hsum256(_mm256_add_pd(s0, s1));
+    agg.min = std::min(agg.min, hmin256(_mm256_min_pd(lo0, lo1)));
+    agg.max = std::max(agg.max, hmax256(_mm256_max_pd(hi0, hi1)));
+    agg.count = count;
+    return agg;
+}
+
+__attribute__((target("avx2"))) Aggregate aggregate_masked_avx2(const double* values, const uint8_t* mask,
+                                                                size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256d pos_inf = _mm256_set1_pd(POS_INF);
+    const __m256d neg_inf = _mm256_set1_pd(NEG_INF);
+    __m256d sum = _mm256_setzero_pd(), lo = pos_inf, hi = neg_inf;
+    __m256i skipped = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32_t bytes;
+        std::memcpy(&bytes, mask + i, sizeof(bytes));
+        // Widen 4 mask bytes to 4 x 64-bit lanes; all-ones where the mask is 0
+        __m256i off = _mm256_cmpeq_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes)), zero);
+        __m256d off_pd = _mm256_castsi256_pd(off);
+        __m256d v = _mm256_loadu_pd(values + i);
+        sum = _mm256_add_pd(sum, _mm256_andnot_pd(off_pd, v));
+        lo = _mm256_min_pd(lo, _mm256_blendv_pd(v, pos_inf, off_pd));
+        hi = _mm256_max_pd(hi, _mm256_blendv_pd(v, neg_inf, off_pd));
+        skipped = _mm256_sub_epi64(skipped, off);  // off lanes are -1
+    }
+    int64_t skipped_lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(skipped_lanes), skipped);
+
+    Aggregate agg = aggregate_masked_scalar(values + i, mask + i, count - i);
+    agg.sum += hsum256(sum);
+    agg.min = std::min(agg.min, hmin256(lo));
+    agg.max = std::max(agg.max, hmax256(hi));
+    agg.count += i - static_cast<uint64_t>(skipped_lanes[0] + skipped_lanes[1] +
+                                           skipped_lanes[2] + skipped_lanes[3]);
+    return agg;
+}
+
+__attribute__((target("avx2"))) double increase_avx2(const double* values, size_t count) {
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        __m256d cur = _mm256_loadu_pd(values + i);
+        __m256d delta = _mm256_sub_pd(cur, _mm256_loadu_pd(values + i - 1));
+        __m256d reset = _mm256_cmp_pd(delta, zero, _CMP_LT_OQ);
+        acc = _mm256_add_pd(acc, _mm256_blendv_pd(delta, cur, reset));
+    }
+    // values[i-1] is the predecessor of the first tail element
+    return hsum256(acc) + increase_scalar(values + i - 1, count - i + 1);
+}
+
+// ----------------------------------------------------------------------------
+// AVX-512F: 8 doubles per register, native lane masks
+// ----------------------------------------------------------------------------
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12's AVX-512 reduction intrinsics trip a false -Wuninitialized (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f"))) double sum_avx512(const double* values, size_t count) {
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+    __m512d a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        a0 = _mm512_add_pd(a0, _mm512_loadu_pd(values + i));
+        a1 = _mm512_add_pd(a1, _mm512_loadu_pd(values + i + 8));
+        a2 = _mm512_add_pd(a2, _mm512_loadu_pd(values + i + 16));
+        a3 = _mm512_add_pd(a3, _mm512_loadu_pd(values + i + 24));
+    }
+    for (; i + 8 <= count; i += 8) {
+        a0 = _mm512_add_pd(a0, _mm512_loadu_pd(values + i));
+    }
+    double sum = _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3)));
+    return sum + sum_scalar(values + i, count - i);
+}
+
+__attribute__((target("avx512f"))) double min_avx512(const double* values, size_t count) {
+    __m512d m0 = _mm512_set1_pd(POS_INF), m1 = _mm512_set1_pd(POS_INF);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        m0 = _mm512_min_pd(m0, _mm512_loadu_pd(values + i));
+        m1 = _mm512_min_pd(m1, _mm512_loadu_pd(values + i + 8));
+    }
+    for (; i + 8 <= count; i += 8) {
+        m0 = _mm512_min_pd(m0, _mm512_loadu_pd(values + i));
+    }
+    return std::min(_mm512_reduce_min_pd(_mm512_min_pd(m0, m1)), min_scalar(values + i, count - i));
+}
+
+__attribute__((target("avx512f"))) double max_avx512(const double* values, size_t count) {
+    __m512d m0 = _mm512_set1_pd(NEG_INF), m1 = _mm512_set1_pd(NEG_INF);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        m0 = _mm512_max_pd(m0, _mm512_loadu_pd(values + i));
+        m1 = _mm512_max_pd(m1, _mm512_loadu_pd(values + i + 8));
+    }
+    for (; i + 8 <= count; i += 8) {
+        m0 = _mm512_max_pd(m0, _mm512_loadu_pd(values + i));
+    }
+    return std::max(_mm512_reduce_max_pd(_mm512_max_pd(m0, m1)), max_scalar(values + i, count - i));
+}
+
+__attribute__((target("avx512f"))) Aggregate aggregate_avx512(const double* values, size_t count) {
+    __m512d sum = _mm512_setzero_pd();
+    __m512d lo = _mm512_set1_pd(POS_INF);
+    __m512d hi = _mm512_set1_pd(NEG_INF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d v = _mm512_loadu_pd(values + i);
+        sum = _mm512_add_pd(sum, v);
+        lo = _mm512_min_pd(lo, v);
+        hi = _mm512_max_pd(hi, v);
+    }
+    Aggregate agg = aggregate_scalar(values + i, count - i);
+    agg.sum += _mm512_reduce_add_pd(sum);
+    agg.min = std::min(agg.min, _mm512_reduce_min_pd(lo));
+    agg.max = std::max(agg.max, _mm512_reduce_max_pd(hi));
+    agg.count = count;
+    return agg;
+}
+
+__attribute__((target("avx512f"))) Aggregate aggregate_masked_avx512(const double* values, const uint8_t* mask,
+                                                                     size_t count) {
+    __m512d sum = _mm512_setzero_pd();
+    __m512d lo = _mm512_set1_pd(POS_INF);
+    __m512d hi = _mm512_set1_pd(NEG_INF);
+    uint64_t selected = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i lanes = _mm512_cvtepu8_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask + i)));
+        __mmask8 k = _mm512_test_epi64_mask(lanes, lanes);
+        __m512d v = _mm512_loadu_pd(values + i);
+        sum = _mm512_mask_add_pd(sum, k, sum, v);
+        lo = _mm512_mask_min_pd(lo, k, lo, v);
+        hi = _mm512_mask_max_pd(hi, k, hi, v);
+        selected += static_cast<uint64_t>(__builtin_popcount(k));
+    }
+    Aggregate agg = aggregate_masked_scalar(values + i, mask + i, count - i);
+    agg.sum += _mm512_reduce_add_pd(sum);
+    agg.min = std::min(agg.min, _mm512_reduce_min_pd(lo));
+    agg.max = std::max(agg.max, _mm512_reduce_max_pd(hi));
+    agg.count += selected;
+    return agg;
+}
+
+__attribute__((target("avx512f"))) double increase_avx512(const double* values, size_t count) {
+    const __m512d zero = _mm512_setzero_pd();
+    __m512d acc = _mm512_setzero_pd();
+    size_t i = 1;
+    for (; i + 8 <= count; i += 8) {
+        __m512d cur = _mm512_loadu_pd(values + i);
+        __m512d delta = _mm512_sub_pd(cur, _mm512_loadu_pd(values + i - 1));
+        __mmask8 reset = _mm512_cmp_pd_mask(delta, zero, _CMP_LT_OQ);
+        acc = _mm512_add_pd(acc, _mm512_mask_blend_pd(reset, delta, cur));
+    }
+    return _mm512_reduce_add_pd(acc) + increase_scalar(values + i - 1, count - i + 1);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif  // METRICSTREAM_X86_KERNELS
+
+// Resolved once; every call after that is one indirect jump
+struct KernelTable {
+    double (*sum)(const double*, size_t);
+    double (*min)(const double*, size_t);
+    double (*max)(const double*, size_t);
+    Aggregate (*aggregate)(const double*, size_t);
+    Aggregate (*aggregate_masked)(const double*, const uint8_t*, size_t);
+    double (*increase)(const double*, size_t);
+    const char* isa;
+};
+
+KernelTable select_kernels() {
+#ifdef METRICSTREAM_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {sum_avx512, min_avx512, max_avx512, aggregate_avx512,
+                aggregate_masked_avx512, increase_avx512, "avx512"};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {sum_avx2, min_avx2, max_avx2, aggregate_avx2,
+                aggregate_masked_avx2, increase_avx2, "avx2"};
+    }
+#endif
+    return {sum_scalar, min_scalar, max_scalar, aggregate_scalar,
+            aggregate_masked_scalar, increase_scalar, "scalar"};
+}
+
+const KernelTable& kernels() {
+    static const KernelTable table = select_kernels();
+    return table;
+}
+
+} // namespace
+
+double sum_values(const double* values, size_t count) {
+    return kernels().sum(values, count);
+}
+
+double min_values(const double* values, size_t count) {
+    return kernels().min(values, count);
+}
+
+double max_values(const double* values, size_t count) {
+    return kernels().max(values, count);
+}
+
+Aggregate aggregate_values(const double* values, size_t count) {
+    return kernels().aggregate(values, count);
+}
+
+size_t build_mask(const double* values, size_t count, CompareOp op, double threshold, uint8_t* mask) {
+    // One branch-free loop per operator so the compiler can vectorize each
+    switch (op) {
+        case CompareOp::GT: for (size_t i = 0; i < count; ++i) mask[i] = values[i] > threshold; break;
+        case CompareOp::GE: for (size_t i = 0; i < count; ++i) mask[i] = values[i] >= threshold; break;
+        case CompareOp::LT: for (size_t i = 0; i < count; ++i) mask[i] = values[i] < threshold; break;
+        case CompareOp::LE: for (size_t i = 0; i < count; ++i) mask[i] = values[i] <= threshold; break;
+        case CompareOp::EQ: for (size_t i = 0; i < count; ++i) mask[i] = values[i] == threshold; break;
+        case CompareOp::NE: for (size_t i = 0; i < count; ++i) mask[i] = values[i] != threshold; break;
+    }
+    size_t selected = 0;
+    for (size_t i = 0; i < count; ++i) selected += mask[i];
+    return selected;
+}
+
+Aggregate aggregate_masked(const double* values, const uint8_t* mask, size_t count) {
+    return kernels().aggregate_masked(values, mask, count);
+}
+
+double counter_increase(const double* values, size_t count) {
+    if (count < 2) {
+        return 0.0;
+    }
+    return kernels().increase(values, count);
+}
+
+double counter_rate(const int64_t* timestamps, const double* values, size_t count) {
+    if (count < 2 || timestamps[count - 1] <= timestamps[0]) {
+        return 0.0;
+    }
+    double seconds = static_cast<double>(timestamps[count - 1] - timestamps[0]) / 1000.0;
+    return counter_increase(values, count) / seconds;
+}
+
+void downsample(const int64_t* timestamps, const double* values, size_t count,
+                int64_t start_ts, int64_t end_ts, int64_t step_ms,
+                std::vector<Aggregate>& buckets) {
+    if (step_ms <= 0) {
+        throw std::invalid_argument("Downsample step must be positive");
+    }
+    if (end_ts < start_ts) {
+        return;
+    }
+    // Offsets from start_ts are unsigned so the widest range cannot overflow
+    uint64_t step = static_cast<uint64_t>(step_ms);
+    uint64_t span = static_cast<uint64_t>(end_ts) - static_cast<uint64_t>(start_ts);
+    size_t bucket_count = static_cast<size_t>(span / step) + 1;
+    if (buckets.size() < bucket_count) {
+        buckets.resize(bucket_count);
+    }
+
+    // Each bucket is a contiguous run of the sorted column; aggregate runs whole
+    const int64_t* end = timestamps + count;
+    const int64_t* it = std::lower_bound(timestamps, end, start_ts);
+    while (it != end && *it <= end_ts) {
+        uint64_t offset_ts = static_cast<uint64_t>(*it) - static_cast<uint64_t>(start_ts);
+        size_t bucket = static_cast<size_t>(offset_ts / step);
+        uint64_t first_offset = bucket * step;
+        int64_t bucket_last = span - first_offset < step
+                                  ? end_ts
+                                  : static_cast<int64_t>(static_cast<uint64_t>(start_ts) + first_offset + (step - 1));
+        const int64_t* run_end = std::upper_bound(it, end, bucket_last);
+        size_t offset = static_cast<size_t>(it - timestamps);
+        buckets[bucket].merge(aggregate_values(values + offset, static_cast<size_t>(run_end - it)));
+        it = run_end;
+    }
+}
+
+const char* aggregation_isa() {
+    return kernels().isa;
+}
+
+} // namespace metricstream
@@ -0,0 +1,357 @@
+#include "alert_evaluator.h"
+#include "logging.h"
+#include <algorithm>
+#include <iterator>
+
+namespace metricstream {
+
+namespace {
+
+bool compare(double value, CompareOp op, double threshold) {
+    switch (op) {
+        case CompareOp::GT: return value > threshold;
+        case CompareOp::GE: return value >= threshold;
+        case CompareOp::LT: return value < threshold;
+        case CompareOp::LE: return value <= threshold;
+        case CompareOp::EQ: return value == threshold;
+        case CompareOp::NE: return value != threshold;
+    }
+    return false;
+}
+
+} // namespace
+
+const char* alert_state_name(AlertState state) {
+    switch (state) {
+        case AlertState::INACTIVE: return "inactive";
+        case AlertState::PENDING:  return "pending";
+        case AlertState::FIRING:   return "firing";
+    }
+    return "inactive";
+}
+
+// ----------------------------------------------------------------------------
+// Window
+// ----------------------------------------------------------------------------
+
+void AlertEvaluator::Window::add(const Sample& sample, int64_t window_ms) {
+    samples.push_back(sample);
+    sum += sample.value;
+    while (!min_candidates.empty() && min_candidates.back().value >= sample.value) min_candidates.pop_back();
+    min_candidates.push_back(sample);
+    while (!max_candidates.empty() && max_candidates.back().value <= sample.value) max_candidates.pop_back();
+    max_candidates.push_back(sample);
+
+    // Window is (newest - window_ms, newest]
+    int64_t cutoff = sample.timestamp_ms - window_ms;
+    while (samples.front().timestamp_ms <= cutoff) {
+        sum -= samples.front().value;
+        samples.pop_front();
+    }
+    while (min_candidates.front().timestamp_ms <= cutoff) min_candidates.pop_front();
+    while (max_candidates.front().timestamp_ms <= cutoff) max_candidates.pop_front();
+    if (samples.size() == 1) {
+        sum = samples.front().value;  // drop accumulated rounding error
+    }
+}
+
+double AlertEvaluator::Window::value(AggregateOp op) const {
+    switch (op) {
+        case AggregateOp::SUM:   return sum;
+        case AggregateOp::MIN:   return min_candidates.front().value;
+        case AggregateOp::MAX:   return max_candidates.front().value;
+        case AggregateOp::AVG:   return sum / static_cast<double>(samples.size());
+        case AggregateOp::COUNT: return static_cast<double>(samples.size());
+    }
+    return 0.0;
+}
+
+// ----------------------------------------------------------------------------
+// AlertEvaluator
+// ----------------------------------------------------------------------------
+
+AlertEvaluator::AlertEvaluator(int64_t stale_after_ms)
+    : shards_(new Shard[SHARD_COUNT]),
+      stale_after_ms_(stale_after_ms) {
+    handler_ = [](const AlertEvent& event) {
+        MS_LOG_INFO("[Alerting] {} {} -> {} for {} (value {} at {})", event.rule, alert_state_name(event.from),
+                    alert_state_name(event.to), event.series.name, event.value, event.timestamp_ms);
+    };
+}
+
+std::shared_ptr<const RuleSet> AlertEvaluator::current_rules() const {
+    std::lock_guard<std::mutex> lock(rules_mutex_);
+    return rule_set_;
+}
+
+void AlertEvaluator::install(std::shared_ptr<const RuleSet> rule_set) {
+    std::lock_guard<std::mutex> lock(rules_mutex_);
+    rule_set_ = std::move(rule_set);
+}
+
+void AlertEvaluator::add_rule(const AlertRule& rule) {
+    std::lock_guard<std::mutex> reload(reload_mutex_);
+    auto current = current_rules();
+    std::vector<AlertRule> rules;
+    if (current) {
+        rules.reserve(current->size() + 1);
+        for (const auto& existing : current->rules()) {
+            rules.push_back(*existing);
+        }
+    }
+    rules.push_back(rule);
+    install(std::make_shared<const RuleSet>(rules, current.get()));
+}
+
+void AlertEvaluator::set_rules(const std::vector<AlertRule>& rules) {
+    std::lock_guard<std::mutex> reload(reload_mutex_);
+    auto current = current_rules();
+    install(std::make_shared<const RuleSet>(rules, current.get()));
+}
+
+size_t AlertEvaluator::rule_count() const {
+    auto current = current_rules();
+    return current ? current->size() : 0;
+}
+
+void AlertEvaluator::set_event_handler(EventHandler handler) {
+    std::lock_guard<std::mutex> lock(handler_mutex_);
+    handler_ = std::move(handler);
+}
+
+void AlertEvaluator::refresh_matches(SeriesState& series, const std::shared_ptr<const RuleSet>& rule_set,
+                                     int64_t timestamp_ms, std::vector<AlertEvent>& events) {
+    std::vector<RuleState> previous = std::move(series.rules);
+    series.rules.clear();
+    for (const AlertRule* rule : rule_set->match(series.descriptor)) {
+        // Unchanged rules share their pointer across sets: keep their window
+        auto it = std::find_if(previous.begin(), previous.end(),
+                               [rule](const RuleState& state) { return state.rule == rule; });
+        if (it != previous.end()) {
+            series.rules.push_back(std::move(*it));
+            it->rule = nullptr;
+        } else {
+            RuleState state;
+            state.rule = rule;
+            series.rules.push_back(std::move(state));
+        }
+    }
+
+    // Removed or changed rules resolve, so notifiers do not keep them open
+    for (const auto& dropped : previous) {
+        if (dropped.rule && dropped.state != AlertState::INACTIVE) {
+            events.push_back(resolve_event(series, dropped, timestamp_ms));
+        }
+    }
+    series.rule_set = rule_set;
+}
+
+AlertEvent AlertEvaluator::resolve_event(const SeriesState& series, const RuleState& rule_state,
+                                         int64_t timestamp_ms) {
+    AlertEvent event;
+    event.rule = rule_state.rule->name;
+    event.series = series.descriptor;
+    event.from = rule_state.state;
+    event.to = AlertState::INACTIVE;
+    event.value = rule_state.last_value;
+    event.timestamp_ms = timestamp_ms;
+    return event;
+}
+
+void AlertEvaluator::on_batch(const DecodedBatch& batch) {
+    std::unordered_map<SeriesId, const SeriesDescriptor*> descriptors;
+    descriptors.reserve(batch.series.size());
+    for (const auto& decoded : batch.series) {
+        descriptors.emplace(decoded.descriptor.id, &decoded.descriptor);
+    }
+
+    std::vector<AlertEvent> events;
+    const std::shared_ptr<const RuleSet> rule_set = current_rules();
+    if (!rule_set || rule_set->size() == 0) {
+        return;
+    }
+
+    uint64_t evaluated = 0;
+    std::unordered_set<SeriesId> unmatched;  // series of this batch no rule selects
+    for (const auto& point : batch.points) {
+        if (unmatched.count(point.series_id)) {
+            continue;
+        }
+        // Producers that predate the batch timestamp fall back to event time
+        const int64_t seen_ms = batch.batch_timestamp_ms > 0 ? batch.batch_timestamp_ms : point.timestamp_ms;
+        Shard& shard = shard_for(point.series_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.unmatched_rule_set != rule_set) {
+            shard.unmatched.clear();  // a reload may select them now
+            shard.unmatched_rule_set = rule_set;
+        }
+
+        auto it = shard.series.find(point.series_id);
+        if (it == shard.series.end()) {
+            auto miss = shard.unmatched.find(point.series_id);
+            if (miss != shard.unmatched.end()) {
+                miss->second = std::max(miss->second, seen_ms);
+                unmatched.insert(point.series_id);
+                continue;
+            }
+            auto desc_it = descriptors.find(point.series_id);
+            if (desc_it == descriptors.end()) {
+                continue;  // no labels to match rules against
+            }
+            it = shard.series.emplace(point.series_id, SeriesState{*desc_it->second, nullptr, {}}).first;
+        }
+        SeriesState& series = it->second;
+        if (series.rule_set != rule_set) {
+            refresh_matches(series, rule_set, point.timestamp_ms, events);
+            if (series.rules.empty()) {
+                shard.series.erase(it);
+                shard.unmatched[point.series_id] = seen_ms;
+                unmatched.insert(point.series_id);
+                continue;
+            }
+        }
+        series.last_seen_ms = std::max(series.last_seen_ms, seen_ms);
+
+        const Sample sample{point.timestamp_ms, point.value};
+        for (auto& rule_state : series.rules) {
+            evaluate(series, rule_state, sample, events);
+            evaluated++;
+        }
+    }
+    points_evaluated_.fetch_add(evaluated, std::memory_order_relaxed);
+    publish(events);
+}
+
+size_t AlertEvaluator::expire_stale(int64_t now_ms) {
+    const int64_t cutoff = now_ms - stale_after_ms_;
+    std::vector<AlertEvent> events;
+    size_t evicted = 0;
+    for (size_t s = 0; s < SHARD_COUNT; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].mutex);
+        auto& series_map = shards_[s].series;
+        for (auto it = series_map.begin(); it != series_map.end();) {
+            const SeriesState& series = it->second;
+            if (series.last_seen_ms > cutoff) {
+                ++it;
+                continue;
+            }
+            for (const auto& rule_state : series.rules) {
+                if (rule_state.state != AlertState::INACTIVE) {
+                    events.push_back(resolve_event(series, rule_state, now_ms));
+                }
+            }
+            it = series_map.erase(it);
+            evicted++;
+        }
+
+        auto& unmatched = shards_[s].unmatched;
+        for (auto it = unmatched.begin(); it != unmatched.end();) {
+            it = it->second <= cutoff ? unmatched.erase(it) : std::next(it);
+        }
+    }
+    expired_.fetch_add(evicted, std::memory_order_relaxed);
+    publish(events);
+    return evicted;
+}
+
+void AlertEvaluator::publish(const std::vector<AlertEvent>& events) {
+    if (events.empty()) {
+        return;
+    }
+    transitions_.fetch_add(events.size(), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(handler_mutex_);
+    if (handler_) {
+        for (const auto& event : events) {
+            handler_(event);
+        }
+    }
+}
+
+void AlertEvaluator::evaluate(SeriesState& series, RuleState& rule_state, const Sample& sample,
+                              std::vector<AlertEvent>& events) {
+    const AlertRule& rule = *rule_state.rule;
+    if (!rule_state.window.samples.empty() && sample.timestamp_ms <= rule_state.last_timestamp) {
+        out_of_order_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    rule_state.window.add(sample, rule.window_ms);
+    rule_state.last_timestamp = sample.timestamp_ms;
+    rule_state.last_value = rule_state.window.value(rule.aggregate);
+
+    bool breached = compare(rule_state.last_value, rule.comparison, rule.threshold);
+    AlertState next = rule_state.state;
+    if (!breached) {
+        next = AlertState::INACTIVE;
+    } else if (rule_state.state == AlertState::INACTIVE) {
+        rule_state.pending_since = sample.timestamp_ms;
+        next = rule.for_ms > 0 ? AlertState::PENDING : AlertState::FIRING;
+    } else if (rule_state.state == AlertState::PENDING &&
+               sample.timestamp_ms - rule_state.pending_since >= rule.for_ms) {
+        next = AlertState::FIRING;
+    }
+
+    if (next != rule_state.state) {
+        AlertEvent event;
+        event.rule = rule.name;
+        event.series = series.descriptor;
+        event.from = rule_state.state;
+        event.to = next;
+        event.value = rule_state.last_value;
+        event.timestamp_ms = sample.timestamp_ms;
+        events.push_back(std::move(event));
+        rule_state.state = next;
+    }
+}
+
+std::vector<AlertEvent> AlertEvaluator::active_alerts() const {
+    std::vector<AlertEvent> active;
+    const auto rule_set = current_rules();
+    if (!rule_set) {
+        return active;
+    }
+    for (size_t s = 0; s < SHARD_COUNT; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].mutex);
+        for (const auto& [id, series] : shards_[s].series) {
+            for (const auto& rule_state : series.rules) {
+                // Rules dropped by a reload linger until the series' next point
+                if (rule_state.state == AlertState::INACTIVE || !rule_set->contains(rule_state.rule)) continue;
+                AlertEvent event;
+                event.rule = rule_state.rule->name;
+                event.series = series.descriptor;
+                event.from = rule_state.state;
+                event.to = rule_state.state;
+                event.value = rule_state.last_value;
+                event.timestamp_ms = rule_state.state == AlertState::PENDING ? rule_state.pending_since
+                                                                             : rule_state.last_timestamp;
+                active.push_back(std::move(event));
+            }
+        }
+    }
+    return active;
+}
+
+AlertEvaluator::Stats AlertEvaluator::stats() const {
+    Stats stats;
+    const auto rule_set = current_rules();
+    stats.points_evaluated = points_evaluated_.load(std::memory_order_relaxed);
+    stats.transitions = transitions_.load(std::memory_order_relaxed);
+    stats.out_of_order = out_of_order_.load(std::memory_order_relaxed);
+    stats.expired = expired_.load(std::memory_order_relaxed);
+    for (size_t s = 0; s < SHARD_COUNT; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].mutex);
+        stats.series_tracked += shards_[s].series.size();
+        if (shards_[s].unmatched_rule_set == rule_set) {
+            stats.series_unmatched += shards_[s].unmatched.size();
+        }
+        for (const auto& [id, series] : shards_[s].series) {
+            for (const auto& rule_state : series.rules) {
+                if (rule_state.state == AlertState::FIRING && rule_set && rule_set->contains(rule_state.rule)) {
+                    stats.firing++;
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+} // namespace metricstream
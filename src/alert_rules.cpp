@@ -0,0 +1,257 @@
+#include "alert_rules.h"
+#include "query_parser.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+const char* aggregate_name(AggregateOp op) {
+    switch (op) {
+        case AggregateOp::SUM:   return "sum";
+        case AggregateOp::MIN:   return "min";
+        case AggregateOp::MAX:   return "max";
+        case AggregateOp::AVG:   return "avg";
+        case AggregateOp::COUNT: return "count";
+    }
+    return "avg";
+}
+
+const char* compare_text(CompareOp op) {
+    switch (op) {
+        case CompareOp::GT: return ">";
+        case CompareOp::GE: return ">=";
+        case CompareOp::LT: return "<";
+        case CompareOp::LE: return "<=";
+        case CompareOp::EQ: return "==";
+        case CompareOp::NE: return "!=";
+    }
+    return ">";
+}
+
+const std::string* tag_value(const SeriesDescriptor& series, const std::string& key) {
+    if (key == TagIndex::NAME_TAG) {
+        return &series.name;
+    }
+    auto it = std::lower_bound(series.tags.begin(), series.tags.end(), key,
+                               [](const auto& tag, const std::string& k) { return tag.first < k; });
+    if (it != series.tags.end() && it->first == key) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// AlertRule
+// ----------------------------------------------------------------------------
+
+AlertRule AlertRule::parse(const std::string& line) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+        throw std::invalid_argument("Alert rule must be 'name: expression'");
+    }
+    AlertRule rule;
+    rule.name = trim(line.substr(0, colon));
+    std::string rest = trim(line.substr(colon + 1));
+    if (rule.name.empty()) {
+        throw std::invalid_argument("Alert rule name is empty");
+    }
+
+    // The comparison follows the closing parenthesis of the function call;
+    // matchers inside it may contain != and =~ themselves
+    size_t close = rest.rfind(')');
+    if (close == std::string::npos) {
+        throw std::invalid_argument("Alert rule needs <op>_over_time(selector[window])");
+    }
+    std::string expression = rest.substr(0, close + 1);
+    std::string condition = trim(rest.substr(close + 1));
+
+    auto expr = parse_query(expression);
+    if (expr->kind != QueryExpr::Kind::FUNCTION_CALL || expr->function.find("_over_time") == std::string::npos) {
+        throw std::invalid_argument("Alert rule expression must be <op>_over_time(selector[window])");
+    }
+    rule.aggregate = parse_aggregate_op(expr->function.substr(0, expr->function.find('_')));
+    rule.matchers = expr->args[0]->matchers;
+    rule.window_ms = expr->args[0]->range_ms;
+
+    static const std::pair<const char*, CompareOp> operators[] = {
+        {">=", CompareOp::GE}, {"<=", CompareOp::LE}, {"==", CompareOp::EQ},
+        {"!=", CompareOp::NE}, {">", CompareOp::GT}, {"<", CompareOp::LT}};
+    size_t op_length = 0;
+    for (const auto& [text, op] : operators) {
+        if (condition.compare(0, std::char_traits<char>::length(text), text) == 0) {
+            rule.comparison = op;
+            op_length = std::char_traits<char>::length(text);
+            break;
+        }
+    }
+    if (op_length == 0) {
+        throw std::invalid_argument("Alert rule needs a comparison (> >= < <= == !=)");
+    }
+    condition = trim(condition.substr(op_length));
+
+    size_t for_pos = condition.find(" for ");
+    std::string threshold = trim(condition.substr(0, for_pos));
+    size_t used = 0;
+    rule.threshold = std::stod(threshold, &used);
+    if (used != threshold.size()) {
+        throw std::invalid_argument("Bad alert threshold '" + threshold + "'");
+    }
+    if (for_pos != std::string::npos) {
+        rule.for_ms = parse_duration_ms(trim(condition.substr(for_pos + 5)));
+    }
+    return rule;
+}
+
+std::string AlertRule::to_string() const {
+    // Reuse the query printer so the selector part is canonical too
+    QueryExpr selector;
+    selector.kind = QueryExpr::Kind::MATRIX_SELECTOR;
+    selector.matchers = matchers;
+    selector.range_ms = window_ms;
+
+    std::string out = name + ": " + aggregate_name(aggregate) + "_over_time(" + selector.to_string() + ") ";
+    out += compare_text(comparison);
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), " %.17g", threshold);
+    out.append(buf, n);
+    if (for_ms > 0) {
+        out += " for " + std::to_string(for_ms) + "ms";
+    }
+    return out;
+}
+
+// ----------------------------------------------------------------------------
+// RuleSet
+// ----------------------------------------------------------------------------
+
+RuleSet::RuleSet(const std::vector<AlertRule>& rules, const RuleSet* previous) {
+    std::unordered_map<std::string, RulePtr> reusable;
+    if (previous) {
+        for (const auto& rule : previous->rules_) {
+            reusable.emplace(rule->to_string(), rule);
+        }
+    }
+
+    std::unordered_set<std::string> seen;
+    for (const auto& rule : rules) {
+        if (rule.window_ms <= 0) {
+            throw std::invalid_argument("Alert rule '" + rule.name + "' window must be positive");
+        }
+        std::string text = rule.to_string();
+        if (!seen.insert(text).second) {
+            continue;
+        }
+        auto reuse = reusable.find(text);
+        RulePtr ptr = reuse != reusable.end() ? reuse->second : std::make_shared<const AlertRule>(rule);
+
+        CompiledRule compiled;
+        compiled.rule = ptr;
+        const TagMatcher* name_matcher = nullptr;
+        const TagMatcher* tag_matcher = nullptr;
+        for (const auto& matcher : ptr->matchers) {
+            CompiledMatcher cm{&matcher, nullptr};
+            if (matcher.op == TagMatcher::Op::REGEX_MATCH || matcher.op == TagMatcher::Op::REGEX_NO_MATCH) {
+                try {
+                    cm.regex = std::make_unique<std::regex>(matcher.value);
+                } catch (const std::regex_error& e) {
+                    throw std::invalid_argument("Alert rule '" + rule.name + "' has a bad regex: " + e.what());
+                }
+            } else if (matcher.op == TagMatcher::Op::EQUAL) {
+                if (matcher.key == TagIndex::NAME_TAG) {
+                    if (!name_matcher) name_matcher = &matcher;
+                } else if (!tag_matcher && !matcher.value.empty()) {
+                    // key="" also matches series without the tag, so it cannot route
+                    tag_matcher = &matcher;
+                }
+            }
+            compiled.matchers.push_back(std::move(cm));
+        }
+
+        size_t index = rules_.size();
+        rules_.push_back(ptr);
+        compiled_.push_back(std::move(compiled));
+        members_.insert(ptr.get());
+
+        if (!name_matcher) {
+            unnamed_.push_back(index);
+        } else if (tag_matcher) {
+            by_name_[name_matcher->value].by_tag[tag_matcher->key][tag_matcher->value].push_back(index);
+        } else {
+            by_name_[name_matcher->value].name_only.push_back(index);
+        }
+    }
+}
+
+bool RuleSet::matches(const CompiledRule& rule, const SeriesDescriptor& series) const {
+    static const std::string empty;
+    for (const auto& cm : rule.matchers) {
+        const std::string* value = tag_value(series, cm.matcher->key);
+        const std::string& text = value ? *value : empty;
+        bool ok = false;
+        switch (cm.matcher->op) {
+            case TagMatcher::Op::EQUAL:          ok = text == cm.matcher->value; break;
+            case TagMatcher::Op::NOT_EQUAL:      ok = text != cm.matcher->value; break;
+            case TagMatcher::Op::REGEX_MATCH:    ok = std::regex_match(text, *cm.regex); break;
+            case TagMatcher::Op::REGEX_NO_MATCH: ok = !std::regex_match(text, *cm.regex); break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<const AlertRule*> RuleSet::match(const SeriesDescriptor& series) const {
+    std::vector<size_t> candidates(unnamed_);
+    auto name_it = by_name_.find(series.name);
+    if (name_it != by_name_.end()) {
+        const NameBucket& bucket = name_it->second;
+        candidates.insert(candidates.end(), bucket.name_only.begin(), bucket.name_only.end());
+        for (const auto& [key, value] : series.tags) {
+            auto key_it = bucket.by_tag.find(key);
+            if (key_it == bucket.by_tag.end()) continue;
+            auto value_it = key_it->second.find(value);
+            if (value_it == key_it->second.end()) continue;
+            candidates.insert(candidates.end(), value_it->second.begin(), value_it->second.end());
+        }
+    }
+    // Each rule sits in exactly one bucket, so there are no duplicates
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<const AlertRule*> matched;
+    for (size_t index : candidates) {
+        if (matches(compiled_[index], series)) {
+            matched.push_back(rules_[index].get());
+        }
+    }
+    return matched;
+}
+
+RuleSet::Stats RuleSet::stats() const {
+    Stats stats;
+    stats.rules = rules_.size();
+    stats.name_buckets = by_name_.size();
+    stats.scanned = unnamed_.size();
+    for (const auto& [name, bucket] : by_name_) {
+        for (const auto& [key, values] : bucket.by_tag) {
+            for (const auto& [value, rules] : values) {
+                stats.tag_routed += rules.size();
+            }
+        }
+    }
+    return stats;
+}
+
+} // namespace metricstream
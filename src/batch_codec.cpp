@@ -0,0 +1,296 @@
+#include "batch_codec.h"
+#include "common.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+
+namespace metricstream {
+
+namespace {
+
+const char* metric_type_name(MetricType type) {
+    switch (type) {
+        case MetricType::COUNTER: return "counter";
+        case MetricType::GAUGE: return "gauge";
+        case MetricType::HISTOGRAM: return "histogram";
+        case MetricType::SUMMARY: return "summary";
+    }
+    return "gauge";
+}
+
+MetricType parse_metric_type(const std::string& name) {
+    if (name == "counter") return MetricType::COUNTER;
+    if (name == "histogram") return MetricType::HISTOGRAM;
+    if (name == "summary") return MetricType::SUMMARY;
+    return MetricType::GAUGE;
+}
+
+// Minimal cursor over the fixed batch schema. Unknown fields are skipped so
+// newer producers can add fields without breaking older consumers.
+class Cursor {
+public:
+    explicit Cursor(const std::string& s) : s_(s) {}
+
+    void skip_ws() {
+        while (i_ < s_.size() && (s_[i_] == ' ' || s_[i_] == '\n' || s_[i_] == '\t' || s_[i_] == '\r')) {
+            i_++;
+        }
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (i_ < s_.size() && s_[i_] == c) {
+            i_++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) {
+            throw std::runtime_error(std::string("Expected '") + c + "' at offset " + std::to_string(i_));
+        }
+    }
+
+    char peek() {
+        skip_ws();
+        return i_ < s_.size() ? s_[i_] : '\0';
+    }
+
+    std::string string() {
+        expect('"');
+        std::string out;
+        while (i_ < s_.size() && s_[i_] != '"') {
+            if (s_[i_] == '\\' && i_ + 1 < s_.size()) {
+                i_++;
+                switch (s_[i_]) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': {
+                        std::string hex = s_.substr(i_ + 1, 4);
+                        if (hex.size() != 4 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+                            throw std::runtime_error("Bad \\u escape at offset " + std::to_string(i_));
+                        }
+                        append_utf8(out, static_cast<uint32_t>(std::stoul(hex, nullptr, 16)));
+                        i_ += 4;
+                        break;
+                    }
+                    default: out += s_[i_]; break;
+                }
+            } else {
+                out += s_[i_];
+            }
+            i_++;
+        }
+        expect('"');
+        return out;
+    }
+
+    // Parses a bare number; returns the raw token so callers pick the type
+    std::string number_token() {
+        skip_ws();
+        size_t start = i_;
+        while (i_ < s_.size() && (std::isdigit(static_cast<unsigned char>(s_[i_])) || s_[i_] == '-' ||
+                                  s_[i_] == '+' || s_[i_] == '.' || s_[i_] == 'e' || s_[i_] == 'E')) {
+            i_++;
+        }
+        if (start == i_) {
+            throw std::runtime_error("Expected number at offset " + std::to_string(i_));
+        }
+        return s_.substr(start, i_ - start);
+    }
+
+    uint64_t u64() { return std::strtoull(number_token().c_str(), nullptr, 10); }
+    int64_t i64() { return std::strtoll(number_token().c_str(), nullptr, 10); }
+    double f64() { return std::strtod(number_token().c_str(), nullptr); }
+
+    // Skip any JSON value (used for unknown fields)
+    void skip_value() {
+        char c = peek();
+        if (c == '"') {
+            string();
+        } else if (c == '{' || c == '[') {
+            char close = c == '{' ? '}' : ']';
+            expect(c);
+            if (consume(close)) return;
+            do {
+                if (c == '{') {
+                    string();
+                    expect(':');
+                }
+                skip_value();
+            } while (consume(','));
+            expect(close);
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            while (i_ < s_.size() && std::isalpha(static_cast<unsigned char>(s_[i_]))) i_++;
+        } else {
+            number_token();
+        }
+    }
+
+private:
+    const std::string& s_;
+    size_t i_ = 0;
+};
+
+DecodedSeries parse_series(Cursor& cur) {
+    DecodedSeries series;
+    cur.expect('{');
+    if (cur.consume('}')) return series;
+    do {
+        std::string field = cur.string();
+        cur.expect(':');
+        if (field == "id") {
+            series.descriptor.id = cur.u64();
+        } else if (field == "name") {
+            series.descriptor.name = cur.string();
+        } else if (field == "type") {
+            series.type = parse_metric_type(cur.string());
+        } else if (field == "tags") {
+            cur.expect('{');
+            if (!cur.consume('}')) {
+                do {
+                    std::string key = cur.string();
+                    cur.expect(':');
+                    series.descriptor.tags.emplace_back(std::move(key), cur.string());
+                } while (cur.consume(','));
+                cur.expect('}');
+            }
+        } else {
+            cur.skip_value();
+        }
+    } while (cur.consume(','));
+    cur.expect('}');
+
+    std::sort(series.descriptor.tags.begin(), series.descriptor.tags.end());
+    return series;
+}
+
+} // namespace
+
+int64_t to_unix_millis(Timestamp ts) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(ts.time_since_epoch()).count();
+}
+
+int64_t to_unix_micros(Timestamp ts) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(ts.time_since_epoch()).count();
+}
+
+std::string encode_metrics_batch(const MetricBatch& batch) {
+    std::string json;
+    json.reserve(64 + batch.metrics.size() * 48);
+
+    json += "{\"batch_timestamp\":\"";
+    json += std::to_string(to_unix_millis(std::chrono::system_clock::now()));
+    json += "\",\"ingest_timestamp_us\":";
+    json += std::to_string(to_unix_micros(batch.received_at));
+    json += ",\"series\":[";
+
+    std::unordered_set<SeriesId> described;
+    described.reserve(batch.metrics.size());
+    for (const auto& metric : batch.metrics) {
+        if (!described.insert(metric.series_id).second) {
+            continue;
+        }
+        if (described.size() > 1) json += ",";
+
+        json += "{\"id\":" + std::to_string(metric.series_id) + ",\"name\":";
+        append_json_string(json, metric.name);
+        json += ",\"type\":\"";
+        json += metric_type_name(metric.type);
+        json += "\",\"tags\":{";
+        bool first_tag = true;
+        for (const auto& [key, value] : metric.tags) {
+            if (!first_tag) json += ",";
+            append_json_string(json, key);
+            json += ":";
+            append_json_string(json, value);
+            first_tag = false;
+        }
+        json += "}}";
+    }
+
+    json += "],\"points\":[";
+    char value_buf[32];
+    for (size_t i = 0; i < batch.metrics.size(); ++i) {
+        const auto& metric = batch.metrics[i];
+        if (i > 0) json += ",";
+        json += "[" + std::to_string(metric.series_id) + ",";
+        int n = std::snprintf(value_buf, sizeof(value_buf), "%.17g", metric.value);
+        json.append(value_buf, n);
+        json += "," + std::to_string(to_unix_millis(metric.timestamp)) + "]";
+    }
+
+    json += "]}\n";
+    return json;
+}
+
+int64_t peek_ingest_timestamp_us(const std::string& message) {
+    constexpr std::string_view key = "\"ingest_timestamp_us\":";
+    // Only the head is searched: series names (user data) come after it
+    size_t pos = std::string_view(message).substr(0, 128).find(key);
+    if (pos == std::string_view::npos) {
+        return 0;
+    }
+    return std::strtoll(message.c_str() + pos + key.size(), nullptr, 10);
+}
+
+DecodedBatch decode_metrics_batch(const std::string& message) {
+    DecodedBatch batch;
+    Cursor cur(message);
+
+    cur.expect('{');
+    if (cur.consume('}')) return batch;
+    do {
+        std::string field = cur.string();
+        cur.expect(':');
+        if (field == "batch_timestamp") {
+            // Written as a string for compatibility with the original format
+            if (cur.peek() == '"') {
+                batch.batch_timestamp_ms = std::strtoll(cur.string().c_str(), nullptr, 10);
+            } else {
+                batch.batch_timestamp_ms = cur.i64();
+            }
+        } else if (field == "ingest_timestamp_us") {
+            batch.ingest_timestamp_us = cur.i64();
+        } else if (field == "series") {
+            cur.expect('[');
+            if (!cur.consume(']')) {
+                do {
+                    batch.series.push_back(parse_series(cur));
+                } while (cur.consume(','));
+                cur.expect(']');
+            }
+        } else if (field == "points") {
+            cur.expect('[');
+            if (!cur.consume(']')) {
+                do {
+                    EncodedPoint point;
+                    cur.expect('[');
+                    point.series_id = cur.u64();
+                    cur.expect(',');
+                    point.value = cur.f64();
+                    cur.expect(',');
+                    point.timestamp_ms = cur.i64();
+                    cur.expect(']');
+                    batch.points.push_back(point);
+                } while (cur.consume(','));
+                cur.expect(']');
+            }
+        } else {
+            cur.skip_value();
+        }
+    } while (cur.consume(','));
+    cur.expect('}');
+
+    return batch;
+}
+
+} // namespace metricstream
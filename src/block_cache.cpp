@@ -0,0 +1,155 @@
+#include "block_cache.h"
+#include <algorithm>
+
+namespace metricstream {
+
+namespace {
+
+// Bookkeeping charged per entry on top of the column data
+constexpr size_t ENTRY_OVERHEAD = 128;
+
+// Expected entry size, for sizing the frequency sketch
+constexpr size_t TYPICAL_ENTRY_BYTES = 4096;
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// FrequencySketch
+// ----------------------------------------------------------------------------
+
+BlockCache::FrequencySketch::FrequencySketch(size_t width) {
+    width_ = 256;
+    while (width_ < width) {
+        width_ <<= 1;
+    }
+    counters_.assign(DEPTH * width_, 0);
+    sample_size_ = 10 * width_;
+}
+
+size_t BlockCache::FrequencySketch::index(uint64_t hash, size_t row) const {
+    return row * width_ + (mix(hash + row * 0x9e3779b97f4a7c15ULL) & (width_ - 1));
+}
+
+void BlockCache::FrequencySketch::increment(uint64_t hash) {
+    for (size_t row = 0; row < DEPTH; ++row) {
+        uint8_t& counter = counters_[index(hash, row)];
+        if (counter < MAX_COUNT) {
+            counter++;
+        }
+    }
+    if (++additions_ >= sample_size_) {
+        // Age out old popularity so the filter follows a changing workload
+        for (uint8_t& counter : counters_) {
+            counter >>= 1;
+        }
+        additions_ /= 2;
+    }
+}
+
+uint8_t BlockCache::FrequencySketch::estimate(uint64_t hash) const {
+    uint8_t min = MAX_COUNT;
+    for (size_t row = 0; row < DEPTH; ++row) {
+        min = std::min(min, counters_[index(hash, row)]);
+    }
+    return min;
+}
+
+// ----------------------------------------------------------------------------
+// BlockCache
+// ----------------------------------------------------------------------------
+
+size_t BlockCache::KeyHash::operator()(const Key& key) const {
+    return static_cast<size_t>(mix(key.block_id * 0x9e3779b97f4a7c15ULL ^ key.series));
+}
+
+BlockCache::BlockCache(size_t max_bytes) : max_bytes_(max_bytes), shard_bytes_(max_bytes / SHARD_COUNT) {
+    for (auto& shard : shards_) {
+        shard = std::make_unique<Shard>(shard_bytes_ / TYPICAL_ENTRY_BYTES);
+    }
+}
+
+std::shared_ptr<const DecodedColumns> BlockCache::get(uint64_t block_id, SeriesId series) {
+    Key key{block_id, series};
+    uint64_t hash = KeyHash{}(key);
+    Shard& s = shard(hash);
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.sketch.increment(hash);
+    auto it = s.entries.find(key);
+    if (it == s.entries.end()) {
+        s.misses++;
+        return nullptr;
+    }
+    s.hits++;
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    return it->second->columns;
+}
+
+void BlockCache::put(uint64_t block_id, SeriesId series, std::shared_ptr<const DecodedColumns> columns) {
+    Key key{block_id, series};
+    uint64_t hash = KeyHash{}(key);
+    size_t bytes = ENTRY_OVERHEAD + columns->timestamps.capacity() * sizeof(int64_t) +
+                   columns->values.capacity() * sizeof(double);
+    if (bytes > shard_bytes_) {
+        return;  // would not fit even in an empty shard
+    }
+
+    Shard& s = shard(hash);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.entries.count(key)) {
+        return;  // another query decoded it first
+    }
+
+    // Room is only made for a key asked for more often than every victim
+    if (s.bytes + bytes > shard_bytes_) {
+        uint8_t frequency = s.sketch.estimate(hash);
+        size_t freed = 0;
+        size_t victims = 0;
+        for (auto it = s.lru.rbegin(); it != s.lru.rend() && s.bytes - freed + bytes > shard_bytes_; ++it) {
+            if (s.sketch.estimate(KeyHash{}(it->key)) >= frequency) {
+                s.rejected++;
+                return;
+            }
+            freed += it->bytes;
+            victims++;
+        }
+        for (size_t i = 0; i < victims; ++i) {
+            Entry& victim = s.lru.back();
+            s.bytes -= victim.bytes;
+            s.entries.erase(victim.key);
+            s.lru.pop_back();
+            s.evictions++;
+        }
+    }
+
+    s.lru.push_front(Entry{key, std::move(columns), bytes});
+    s.entries.emplace(key, s.lru.begin());
+    s.bytes += bytes;
+    s.admitted++;
+}
+
+BlockCache::Stats BlockCache::stats() const {
+    Stats stats;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.admitted += shard->admitted;
+        stats.rejected += shard->rejected;
+        stats.evictions += shard->evictions;
+        stats.entries += shard->entries.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
+
+} // namespace metricstream
@@ -0,0 +1,651 @@
+#include "block_storage.h"
+#include "gorilla_codec.h"
+#include "logging.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace metricstream {
+
+namespace {
+
+constexpr char BLOCK_MAGIC[8] = {'M', 'S', 'B', 'L', 'O', 'C', 'K', '1'};
+constexpr uint32_t BLOCK_VERSION_RAW = 1;      // uncompressed columns
+constexpr uint32_t BLOCK_VERSION_GORILLA = 2;  // Gorilla-compressed columns
+constexpr uint32_t BLOCK_VERSION = BLOCK_VERSION_GORILLA;
+
+struct BlockHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t series_count;
+    int64_t min_ts;
+    int64_t max_ts;
+    uint64_t sample_count;
+    uint64_t bloom_offset;
+    uint64_t bloom_size;
+    uint64_t index_offset;
+    uint64_t index_size;
+    uint64_t sequence;
+};
+
+template <typename T>
+void put(std::string& buf, T value) {
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void put_string(std::string& buf, const std::string& s) {
+    put<uint32_t>(buf, static_cast<uint32_t>(s.size()));
+    buf.append(s);
+}
+
+// Bounds-checked reader over the in-memory index section
+class ByteReader {
+public:
+    ByteReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        check(sizeof(T));
+        T value;
+        std::memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    std::string get_string() {
+        uint32_t len = get<uint32_t>();
+        check(len);
+        std::string s(data_ + pos_, len);
+        pos_ += len;
+        return s;
+    }
+
+private:
+    void check(size_t n) const {
+        if (pos_ + n > size_) {
+            throw std::runtime_error("Block index truncated");
+        }
+    }
+
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+constexpr size_t WRITE_SLICE_BYTES = 256 * 1024;  // rate-limited writes go out in these
+
+// <bucket>-<sequence>.block for head flushes, <bucket>-<sequence>-L<level>.block
+// for compaction output
+std::string block_filename(int64_t bucket_start, uint64_t sequence, uint32_t level) {
+    std::ostringstream oss;
+    oss << bucket_start << "-" << std::setfill('0') << std::setw(10) << sequence;
+    if (level > 0) {
+        oss << "-L" << level;
+    }
+    oss << ".block";
+    return oss.str();
+}
+
+uint32_t block_level(const std::string& path) {
+    std::string stem = fs::path(path).stem().string();
+    size_t pos = stem.rfind("-L");
+    if (pos == std::string::npos || pos + 2 == stem.size()) {
+        return 0;
+    }
+    uint32_t level = 0;
+    for (size_t i = pos + 2; i < stem.size(); ++i) {
+        if (stem[i] < '0' || stem[i] > '9') {
+            return 0;
+        }
+        level = level * 10 + static_cast<uint32_t>(stem[i] - '0');
+    }
+    return level;
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// BlockWriter
+// ----------------------------------------------------------------------------
+
+BlockMeta BlockWriter::write(const std::string& path, uint64_t sequence,
+                             const std::vector<SeriesDescriptor>& series,
+                             const SeriesSamples& samples,
+                             IoRateLimiter* limiter) {
+    std::unordered_map<SeriesId, const SeriesDescriptor*> labels;
+    for (const auto& desc : series) {
+        labels[desc.id] = &desc;
+    }
+
+    BlockHeader header{};
+    std::memcpy(header.magic, BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    header.version = BLOCK_VERSION;
+    header.min_ts = INT64_MAX;
+    header.max_ts = INT64_MIN;
+    header.sequence = sequence;
+
+    std::string data;
+    std::string index;
+    BloomFilter bloom(std::max<size_t>(samples.size(), 1));
+    uint64_t offset = sizeof(BlockHeader);
+
+    for (const auto& [id, points] : samples) {
+        if (points.empty()) continue;
+
+        auto label_it = labels.find(id);
+        if (label_it == labels.end()) {
+            throw std::runtime_error("Block write: missing labels for series " + std::to_string(id));
+        }
+
+        GorillaEncoder encoder;
+        for (const auto& s : points) encoder.append(s.timestamp_ms, s.value);
+        std::string encoded = encoder.finish();
+        data += encoded;
+
+        int64_t series_min = points.front().timestamp_ms;
+        int64_t series_max = points.back().timestamp_ms;
+        header.min_ts = std::min(header.min_ts, series_min);
+        header.max_ts = std::max(header.max_ts, series_max);
+        header.sample_count += points.size();
+        header.series_count++;
+        bloom.add(id);
+
+        put<uint64_t>(index, id);
+        put<int64_t>(index, series_min);
+        put<int64_t>(index, series_max);
+        put<uint64_t>(index, offset);
+        put<uint32_t>(index, static_cast<uint32_t>(points.size()));
+        put<uint32_t>(index, static_cast<uint32_t>(encoded.size()));
+        put_string(index, label_it->second->name);
+        put<uint32_t>(index, static_cast<uint32_t>(label_it->second->tags.size()));
+        for (const auto& [key, value] : label_it->second->tags) {
+            put_string(index, key);
+            put_string(index, value);
+        }
+
+        offset += encoded.size();
+    }
+
+    if (header.series_count == 0) {
+        throw std::runtime_error("Block write: no samples");
+    }
+
+    std::string bloom_bytes = bloom.serialize();
+    header.bloom_offset = offset;
+    header.bloom_size = bloom_bytes.size();
+    header.index_offset = offset + bloom_bytes.size();
+    header.index_size = index.size();
+
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open block file: " + tmp_path);
+        }
+        auto write_section = [&](const char* p, size_t len) {
+            if (!limiter) {
+                file.write(p, len);
+                return;
+            }
+            while (len > 0) {
+                size_t slice = std::min(len, WRITE_SLICE_BYTES);
+                if (!limiter->acquire(slice)) {
+                    throw std::runtime_error("Block write cancelled: " + tmp_path);
+                }
+                file.write(p, slice);
+                p += slice;
+                len -= slice;
+            }
+        };
+        write_section(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_section(data.data(), data.size());
+        write_section(bloom_bytes.data(), bloom_bytes.size());
+        write_section(index.data(), index.size());
+        file.flush();
+        if (!file) {
+            throw std::runtime_error("Failed to write block file: " + tmp_path);
+        }
+    }
+    fs::rename(tmp_path, path);
+
+    BlockMeta meta;
+    meta.path = path;
+    meta.sequence = sequence;
+    meta.min_ts = header.min_ts;
+    meta.max_ts = header.max_ts;
+    meta.series_count = header.series_count;
+    meta.sample_count = header.sample_count;
+    meta.size_bytes = header.index_offset + header.index_size;
+    meta.level = block_level(path);
+    return meta;
+}
+
+// ----------------------------------------------------------------------------
+// BlockReader
+// ----------------------------------------------------------------------------
+
+BlockReader::BlockReader(const std::string& path) {
+    static std::atomic<uint64_t> next_cache_id{1};
+    cache_id_ = next_cache_id.fetch_add(1, std::memory_order_relaxed);
+
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open block file: " + path);
+    }
+
+    try {
+        BlockHeader header;
+        read_exact(&header, sizeof(header), 0);
+        if (std::memcmp(header.magic, BLOCK_MAGIC, sizeof(BLOCK_MAGIC)) != 0 ||
+            (header.version != BLOCK_VERSION_RAW && header.version != BLOCK_VERSION_GORILLA)) {
+            throw std::runtime_error("Not a block file (bad magic/version): " + path);
+        }
+
+        std::string bloom_bytes(header.bloom_size, '\0');
+        read_exact(bloom_bytes.data(), bloom_bytes.size(), header.bloom_offset);
+        bloom_ = BloomFilter::deserialize(bloom_bytes);
+
+        std::string index_bytes(header.index_size, '\0');
+        read_exact(index_bytes.data(), index_bytes.size(), header.index_offset);
+
+        ByteReader reader(index_bytes.data(), index_bytes.size());
+        index_.reserve(header.series_count);
+        series_.reserve(header.series_count);
+        for (uint32_t i = 0; i < header.series_count; ++i) {
+            IndexEntry entry;
+            entry.id = reader.get<uint64_t>();
+            entry.min_ts = reader.get<int64_t>();
+            entry.max_ts = reader.get<int64_t>();
+            entry.offset = reader.get<uint64_t>();
+            entry.count = reader.get<uint32_t>();
+            entry.size = header.version == BLOCK_VERSION_RAW
+                             ? entry.count * (sizeof(int64_t) + sizeof(double))
+                             : reader.get<uint32_t>();
+
+            SeriesDescriptor desc;
+            desc.id = entry.id;
+            desc.name = reader.get_string();
+            uint32_t tag_count = reader.get<uint32_t>();
+            desc.tags.reserve(tag_count);
+            for (uint32_t t = 0; t < tag_count; ++t) {
+                std::string key = reader.get_string();
+                desc.tags.emplace_back(std::move(key), reader.get_string());
+            }
+
+            index_.push_back(entry);
+            series_.push_back(std::move(desc));
+        }
+
+        version_ = header.version;
+        meta_.path = path;
+        meta_.sequence = header.sequence;
+        meta_.min_ts = header.min_ts;
+        meta_.max_ts = header.max_ts;
+        meta_.series_count = header.series_count;
+        meta_.sample_count = header.sample_count;
+        meta_.size_bytes = header.index_offset + header.index_size;
+        meta_.level = block_level(path);
+    } catch (...) {
+        ::close(fd_);
+        fd_ = -1;
+        throw;
+    }
+}
+
+BlockReader::~BlockReader() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void BlockReader::read_exact(void* buf, size_t len, uint64_t offset) const {
+    // pread keeps reads position-independent, so concurrent queries can share one fd
+    char* p = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t n = ::pread(fd_, p, len, static_cast<off_t>(offset));
+        if (n <= 0) {
+            throw std::runtime_error("Short read from block file: " + meta_.path);
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+bool BlockReader::read_series(SeriesId id, int64_t start_ts, int64_t end_ts,
+                              std::vector<Sample>& out, BlockCache* cache) const {
+    auto it = std::lower_bound(index_.begin(), index_.end(), id,
+                               [](const IndexEntry& e, SeriesId v) { return e.id < v; });
+    if (it == index_.end() || it->id != id) {
+        return false;
+    }
+    if (it->max_ts < start_ts || it->min_ts > end_ts) {
+        return true;  // Present but nothing in range
+    }
+
+    if (version_ == BLOCK_VERSION_GORILLA) {
+        // The stream is sequential, so decode the whole series and trim
+        std::shared_ptr<const DecodedColumns> columns = cache ? cache->get(cache_id_, id) : nullptr;
+        if (!columns) {
+            std::string encoded(it->size, '\0');
+            read_exact(encoded.data(), encoded.size(), it->offset);
+
+            auto decoded = std::make_shared<DecodedColumns>();
+            gorilla_decode(encoded.data(), encoded.size(), decoded->timestamps, decoded->values);
+            if (cache) {
+                cache->put(cache_id_, id, decoded);
+            }
+            columns = std::move(decoded);
+        }
+        const std::vector<int64_t>& timestamps = columns->timestamps;
+        const std::vector<double>& values = columns->values;
+
+        auto first = std::lower_bound(timestamps.begin(), timestamps.end(), start_ts);
+        auto last = std::upper_bound(first, timestamps.end(), end_ts);
+        size_t begin_idx = static_cast<size_t>(first - timestamps.begin());
+        size_t end_idx = static_cast<size_t>(last - timestamps.begin());
+        out.reserve(out.size() + (end_idx - begin_idx));
+        for (size_t i = begin_idx; i < end_idx; ++i) {
+            out.push_back(Sample{timestamps[i], values[i]});
+        }
+        return true;
+    }
+
+    // v1: read the timestamp column, then only the value slice we need
+    std::vector<int64_t> timestamps(it->count);
+    read_exact(timestamps.data(), it->count * sizeof(int64_t), it->offset);
+
+    auto first = std::lower_bound(timestamps.begin(), timestamps.end(), start_ts);
+    auto last = std::upper_bound(first, timestamps.end(), end_ts);
+    size_t begin_idx = static_cast<size_t>(first - timestamps.begin());
+    size_t count = static_cast<size_t>(last - first);
+    if (count == 0) {
+        return true;
+    }
+
+    std::vector<double> values(count);
+    uint64_t values_offset = it->offset + it->count * sizeof(int64_t) + begin_idx * sizeof(double);
+    read_exact(values.data(), count * sizeof(double), values_offset);
+
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(Sample{timestamps[begin_idx + i], values[i]});
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// BlockStore
+// ----------------------------------------------------------------------------
+
+BlockStore::BlockStore(const std::string& directory, int64_t block_duration_ms, BlockCache* cache)
+    : directory_(directory), block_duration_ms_(block_duration_ms), cache_(cache) {
+    if (block_duration_ms_ <= 0) {
+        throw std::invalid_argument("Block duration must be positive");
+    }
+    fs::create_directories(directory_);
+    load_existing_blocks();
+}
+
+void BlockStore::finish_interrupted_replacements() {
+    std::vector<fs::path> parents_files;
+    for (const auto& entry : fs::directory_iterator(directory_)) {
+        if (entry.path().extension() == ".parents") {
+            parents_files.push_back(entry.path());
+        }
+    }
+
+    for (const auto& parents : parents_files) {
+        fs::path output = parents;
+        output.replace_extension();  // <block>.parents -> <block>
+        if (fs::exists(output)) {
+            // The output made it to disk: its inputs are superseded
+            std::ifstream file(parents);
+            std::string name;
+            while (std::getline(file, name)) {
+                if (!name.empty() && fs::remove(fs::path(directory_) / name)) {
+                    MS_LOG_INFO("[BlockStore] Removed block {} superseded by {}", name, output.filename().string());
+                }
+            }
+        }
+        fs::remove(parents);
+    }
+}
+
+void BlockStore::load_existing_blocks() {
+    finish_interrupted_replacements();
+
+    uint64_t max_sequence = 0;
+
+    for (const auto& entry : fs::directory_iterator(directory_)) {
+        const auto& path = entry.path();
+        if (path.extension() == ".tmp") {
+            fs::remove(path);  // Incomplete write from a crash
+            continue;
+        }
+        if (path.extension() != ".block") {
+            continue;
+        }
+        try {
+            auto block = std::make_shared<BlockReader>(path.string());
+            max_sequence = std::max(max_sequence, block->meta().sequence);
+            insert_sorted(std::move(block));
+        } catch (const std::exception& e) {
+            MS_LOG_WARN("[BlockStore] Skipping unreadable block {}: {}", path.string(), e.what());
+        }
+    }
+
+    next_sequence_ = max_sequence + 1;
+    if (!blocks_.empty()) {
+        MS_LOG_INFO("[BlockStore] Loaded {} blocks from {}", blocks_.size(), directory_);
+    }
+}
+
+void BlockStore::insert_sorted(std::shared_ptr<BlockReader> block) {
+    auto pos = std::upper_bound(blocks_.begin(), blocks_.end(), block,
+                                [](const auto& a, const auto& b) {
+                                    if (a->meta().min_ts != b->meta().min_ts) {
+                                        return a->meta().min_ts < b->meta().min_ts;
+                                    }
+                                    return a->meta().sequence < b->meta().sequence;
+                                });
+    blocks_.insert(pos, std::move(block));
+}
+
+int64_t BlockStore::bucket_start(int64_t ts) const {
+    int64_t bucket = ts / block_duration_ms_;
+    if (ts < 0 && ts % block_duration_ms_ != 0) {
+        bucket--;  // floor division for pre-epoch timestamps
+    }
+    return bucket * block_duration_ms_;
+}
+
+BlockMeta BlockStore::add_block(const std::vector<SeriesDescriptor>& series, const SeriesSamples& samples) {
+    uint64_t sequence = next_sequence_.fetch_add(1);
+
+    int64_t min_ts = INT64_MAX;
+    for (const auto& [id, points] : samples) {
+        if (!points.empty()) min_ts = std::min(min_ts, points.front().timestamp_ms);
+    }
+
+    std::string path = (fs::path(directory_) / block_filename(bucket_start(min_ts), sequence, 0)).string();
+    BlockMeta meta = BlockWriter::write(path, sequence, series, samples);
+
+    auto reader = std::make_shared<BlockReader>(path);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        insert_sorted(std::move(reader));
+    }
+    return meta;
+}
+
+BlockMeta BlockStore::replace_blocks(const std::vector<std::shared_ptr<BlockReader>>& inputs,
+                                     const std::vector<SeriesDescriptor>& series, const SeriesSamples& samples,
+                                     uint32_t level, IoRateLimiter* limiter) {
+    if (inputs.empty()) {
+        throw std::invalid_argument("replace_blocks needs at least one input");
+    }
+    const BlockMeta* newest = &inputs.front()->meta();
+    for (const auto& input : inputs) {
+        if (input->meta().sequence > newest->sequence) newest = &input->meta();
+    }
+    if (newest->level == level) {
+        throw std::invalid_argument("Compaction output would reuse " + newest->path);
+    }
+    uint64_t sequence = newest->sequence;
+
+    int64_t min_ts = INT64_MAX;
+    for (const auto& [id, points] : samples) {
+        if (!points.empty()) min_ts = std::min(min_ts, points.front().timestamp_ms);
+    }
+    std::string path = (fs::path(directory_) / block_filename(bucket_start(min_ts), sequence, level)).string();
+    std::string parents_path = path + ".parents";
+
+    BlockMeta meta;
+    try {
+        {
+            std::ofstream parents(parents_path, std::ios::trunc);
+            for (const auto& input : inputs) {
+                parents << fs::path(input->meta().path).filename().string() << "\n";
+            }
+            parents.flush();
+            if (!parents) {
+                throw std::runtime_error("Failed to write " + parents_path);
+            }
+        }
+        meta = BlockWriter::write(path, sequence, series, samples, limiter);
+    } catch (...) {
+        std::error_code ec;
+        fs::remove(path + ".tmp", ec);
+        fs::remove(parents_path, ec);
+        throw;
+    }
+
+    auto reader = std::make_shared<BlockReader>(path);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& input : inputs) {
+            auto it = std::find(blocks_.begin(), blocks_.end(), input);
+            if (it != blocks_.end()) {
+                blocks_.erase(it);
+            }
+        }
+        insert_sorted(std::move(reader));
+    }
+
+    // Queries still holding an input keep reading it through the open fd
+    for (const auto& input : inputs) {
+        fs::remove(input->meta().path);
+    }
+    fs::remove(parents_path);
+    return meta;
+}
+
+BlockMeta BlockStore::move_block(const std::shared_ptr<BlockReader>& block, uint32_t level) {
+    const BlockMeta& old_meta = block->meta();
+    std::string path = (fs::path(directory_) /
+                        block_filename(bucket_start(old_meta.min_ts), old_meta.sequence, level)).string();
+    fs::rename(old_meta.path, path);
+
+    auto reader = std::make_shared<BlockReader>(path);
+    BlockMeta meta = reader->meta();
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = std::find(blocks_.begin(), blocks_.end(), block);
+        if (it != blocks_.end()) {
+            *it = std::move(reader);  // same (min_ts, sequence), so the order holds
+        }
+    }
+    return meta;
+}
+
+std::vector<std::shared_ptr<BlockReader>> BlockStore::all_blocks() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return blocks_;
+}
+
+std::vector<std::shared_ptr<BlockReader>> BlockStore::blocks_overlapping(int64_t start_ts, int64_t end_ts) const {
+    std::vector<std::shared_ptr<BlockReader>> result;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    // A block never spans more than one bucket, so nothing starting before
+    // the bucket containing start_ts can reach into the range
+    int64_t earliest = bucket_start(start_ts);
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), earliest,
+                               [](const auto& block, int64_t ts) { return block->meta().min_ts < ts; });
+
+    for (; it != blocks_.end() && (*it)->meta().min_ts <= end_ts; ++it) {
+        if ((*it)->overlaps(start_ts, end_ts)) {
+            result.push_back(*it);
+        }
+    }
+    return result;
+}
+
+size_t BlockStore::read(const std::vector<SeriesId>& series_ids, int64_t start_ts, int64_t end_ts,
+                        SeriesSamples& out) const {
+    // In write order, so a later block's copy of a timestamp comes later and
+    // wins the caller's dedup (as it does when compaction merges them)
+    std::vector<std::shared_ptr<BlockReader>> blocks = blocks_overlapping(start_ts, end_ts);
+    std::sort(blocks.begin(), blocks.end(),
+              [](const auto& a, const auto& b) { return a->meta().sequence < b->meta().sequence; });
+
+    size_t blocks_read = 0;
+    for (const auto& block : blocks) {
+        bool touched = false;
+        for (SeriesId id : series_ids) {
+            if (!block->might_contain(id)) {
+                continue;  // Bloom filter: definitely not in this block
+            }
+            touched = true;
+            std::vector<Sample>& dest = out[id];
+            block->read_series(id, start_ts, end_ts, dest, cache_);
+        }
+        if (touched) {
+            blocks_read++;
+        }
+    }
+    return blocks_read;
+}
+
+std::vector<BlockMeta> BlockStore::list_blocks() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<BlockMeta> metas;
+    metas.reserve(blocks_.size());
+    for (const auto& block : blocks_) {
+        metas.push_back(block->meta());
+    }
+    return metas;
+}
+
+size_t BlockStore::block_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return blocks_.size();
+}
+
+std::vector<SeriesDescriptor> BlockStore::loaded_series() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::unordered_map<SeriesId, SeriesDescriptor> unique;
+    for (const auto& block : blocks_) {
+        for (const auto& desc : block->series()) {
+            unique.emplace(desc.id, desc);
+        }
+    }
+    std::vector<SeriesDescriptor> result;
+    result.reserve(unique.size());
+    for (auto& entry : unique) {
+        result.push_back(std::move(entry.second));
+    }
+    return result;
+}
+
+} // namespace metricstream
@@ -0,0 +1,105 @@
+#include "bloom_filter.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+namespace metricstream {
+
+namespace {
+
+// SplitMix64 finalizer - spreads series IDs (which may be sequential) across bits
+uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(size_t expected_items, double false_positive_rate) {
+    expected_items = std::max<size_t>(expected_items, 1);
+    false_positive_rate = std::clamp(false_positive_rate, 1e-6, 0.5);
+
+    // Optimal sizing: m = -n ln(p) / (ln 2)^2, k = (m / n) ln 2
+    const double ln2 = std::log(2.0);
+    double m = -static_cast<double>(expected_items) * std::log(false_positive_rate) / (ln2 * ln2);
+    num_bits_ = std::max<size_t>(64, static_cast<size_t>(std::ceil(m / 64.0)) * 64);
+    num_hashes_ = std::max<uint32_t>(1, static_cast<uint32_t>(
+        std::round(static_cast<double>(num_bits_) / expected_items * ln2)));
+    words_.assign(num_bits_ / 64, 0);
+}
+
+BloomFilter::BloomFilter(size_t num_bits, uint32_t num_hashes, std::vector<uint64_t> words)
+    : num_bits_(num_bits), num_hashes_(num_hashes), words_(std::move(words)) {}
+
+void BloomFilter::add(uint64_t key) {
+    // Kirsch-Mitzenmacher double hashing: h_i = h1 + i * h2
+    uint64_t h = mix64(key);
+    uint64_t h1 = h & 0xFFFFFFFF;
+    uint64_t h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < num_hashes_; ++i) {
+        size_t bit = (h1 + i * h2) % num_bits_;
+        words_[bit >> 6] |= uint64_t{1} << (bit & 63);
+    }
+}
+
+bool BloomFilter::might_contain(uint64_t key) const {
+    uint64_t h = mix64(key);
+    uint64_t h1 = h & 0xFFFFFFFF;
+    uint64_t h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < num_hashes_; ++i) {
+        size_t bit = (h1 + i * h2) % num_bits_;
+        if (!((words_[bit >> 6] >> (bit & 63)) & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string BloomFilter::serialize() const {
+    // Layout: [num_bits:u64][num_hashes:u32][words...]
+    std::string out;
+    out.resize(sizeof(uint64_t) + sizeof(uint32_t) + words_.size() * sizeof(uint64_t));
+    uint64_t bits = num_bits_;
+    char* p = out.data();
+    std::memcpy(p, &bits, sizeof(bits));
+    p += sizeof(bits);
+    std::memcpy(p, &num_hashes_, sizeof(num_hashes_));
+    p += sizeof(num_hashes_);
+    std::memcpy(p, words_.data(), words_.size() * sizeof(uint64_t));
+    return out;
+}
+
+BloomFilter BloomFilter::deserialize(const std::string& data) {
+    const size_t header = sizeof(uint64_t) + sizeof(uint32_t);
+    if (data.size() < header) {
+        throw std::runtime_error("Bloom filter data truncated");
+    }
+
+    uint64_t bits;
+    uint32_t hashes;
+    std::memcpy(&bits, data.data(), sizeof(bits));
+    std::memcpy(&hashes, data.data() + sizeof(bits), sizeof(hashes));
+
+    if (bits == 0 || bits % 64 != 0 || data.size() != header + bits / 8) {
+        throw std::runtime_error("Bloom filter data corrupt");
+    }
+
+    std::vector<uint64_t> words(bits / 64);
+    std::memcpy(words.data(), data.data() + header, bits / 8);
+    return BloomFilter(bits, hashes, std::move(words));
+}
+
+uint64_t BloomFilter::hash_string(const std::string& key) {
+    // FNV-1a 64-bit
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+} // namespace metricstream
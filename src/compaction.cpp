@@ -0,0 +1,290 @@
+#include "compaction.h"
+#include "logging.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace metricstream {
+
+CompactionStrategy parse_compaction_strategy(const std::string& name) {
+    if (name == "none") return CompactionStrategy::NONE;
+    if (name == "time_window") return CompactionStrategy::TIME_WINDOW;
+    if (name == "leveled") return CompactionStrategy::LEVELED;
+    throw std::invalid_argument("Unknown compaction strategy: " + name);
+}
+
+const char* compaction_strategy_name(CompactionStrategy strategy) {
+    switch (strategy) {
+        case CompactionStrategy::NONE: return "none";
+        case CompactionStrategy::TIME_WINDOW: return "time_window";
+        case CompactionStrategy::LEVELED: return "leveled";
+    }
+    return "none";
+}
+
+namespace {
+
+void keep_latest_samples(SeriesSamples& samples) {
+    for (auto& [id, points] : samples) {
+        std::stable_sort(points.begin(), points.end(),
+                         [](const Sample& a, const Sample& b) { return a.timestamp_ms < b.timestamp_ms; });
+        size_t kept = 0;
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (kept > 0 && points[kept - 1].timestamp_ms == points[i].timestamp_ms) {
+                points[kept - 1] = points[i];  // latest copy wins
+            } else {
+                points[kept++] = points[i];
+            }
+        }
+        points.resize(kept);
+    }
+}
+
+} // namespace
+
+Compactor::Compactor(BlockStore& store, const CompactionOptions& options, MergeFunction merge)
+    : store_(store),
+      options_(options),
+      merge_(merge ? std::move(merge) : MergeFunction(keep_latest_samples)),
+      limiter_(options.io_bytes_per_second) {
+    if (options_.min_input_blocks < 2) {
+        throw std::invalid_argument("Compaction needs at least 2 input blocks");
+    }
+    if (options_.max_level < 1) {
+        throw std::invalid_argument("Compaction max level must be at least 1");
+    }
+}
+
+Compactor::~Compactor() {
+    stop();
+}
+
+void Compactor::start() {
+    if (options_.strategy == CompactionStrategy::NONE || options_.interval_ms <= 0 || running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&Compactor::run, this);
+}
+
+void Compactor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    limiter_.cancel();  // abandon a merge waiting on I/O budget
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Compactor::notify() {
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        pending_ = true;
+    }
+    cv_.notify_one();
+}
+
+void Compactor::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(options_.interval_ms),
+                         [this] { return !running_ || pending_; });
+            if (!running_) {
+                return;
+            }
+            pending_ = false;
+        }
+
+        try {
+            while (running_ && compact_once()) {
+            }
+        } catch (const std::exception& e) {
+            if (running_) {
+                // Inputs stay in place; the merge is planned again next pass
+                failures_.fetch_add(1, std::memory_order_relaxed);
+                MS_LOG_ERROR("[Compaction] Merge failed: {}", e.what());
+            }
+        }
+    }
+}
+
+std::optional<CompactionPlan> Compactor::plan(const std::vector<BlockMeta>& blocks) const {
+    if (options_.strategy == CompactionStrategy::NONE || blocks.empty()) {
+        return std::nullopt;
+    }
+
+    int64_t newest_ts = INT64_MIN;
+    std::map<int64_t, std::vector<const BlockMeta*>> windows;  // oldest window first
+    for (const auto& meta : blocks) {
+        windows[store_.bucket_start(meta.min_ts)].push_back(&meta);
+        newest_ts = std::max(newest_ts, meta.max_ts);
+    }
+    // A sample from a client clock running ahead must not close windows early
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    newest_ts = std::min(newest_ts, now_ms);
+
+    for (const auto& [window_start, window_blocks] : windows) {
+        bool closed = window_start + store_.block_duration_ms() + options_.window_grace_ms <= newest_ts;
+        if (auto next = plan_window(window_start, window_blocks, closed)) {
+            return next;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<CompactionPlan> Compactor::plan_window(int64_t window_start,
+                                                     const std::vector<const BlockMeta*>& blocks,
+                                                     bool closed) const {
+    std::vector<std::vector<const BlockMeta*>> levels(options_.max_level + 1);
+    for (const BlockMeta* meta : blocks) {
+        levels[std::min(meta->level, options_.max_level)].push_back(meta);
+    }
+
+    CompactionPlan plan;
+    plan.window_start = window_start;
+    auto take = [&plan](const std::vector<const BlockMeta*>& level) {
+        for (const BlockMeta* meta : level) plan.sequences.push_back(meta->sequence);
+    };
+
+    if (options_.strategy == CompactionStrategy::TIME_WINDOW) {
+        if (closed && levels[options_.max_level].empty()) {
+            // Major compaction of a finished window, done once (a lone block
+            // is just relabelled)
+            for (uint32_t level = 0; level < options_.max_level; ++level) take(levels[level]);
+            plan.output_level = options_.max_level;
+            return plan;
+        }
+        // Size tiers below the final level; a closed window's final block is
+        // never an input, so late samples only merge with each other
+        for (uint32_t level = 0; level + 1 < options_.max_level; ++level) {
+            if (levels[level].size() >= options_.min_input_blocks) {
+                for (uint32_t upper = 0; upper <= level; ++upper) take(levels[upper]);
+                plan.output_level = level + 1;
+                return plan;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // LEVELED
+    if (levels[0].size() >= options_.min_input_blocks) {
+        take(levels[0]);
+        take(levels[1]);
+        plan.output_level = 1;
+        return plan;
+    }
+    uint64_t target = options_.level_base_bytes;
+    for (uint32_t level = 1; level < options_.max_level; ++level) {
+        uint64_t size = 0;
+        for (const BlockMeta* meta : levels[level]) size += meta->size_bytes;
+        if (size > target || levels[level].size() > 1) {
+            for (uint32_t upper = 0; upper <= level + 1; ++upper) take(levels[upper]);
+            plan.output_level = level + 1;
+            return plan;
+        }
+        target *= options_.level_size_ratio;
+    }
+    return std::nullopt;
+}
+
+bool Compactor::compact_once() {
+    std::lock_guard<std::mutex> lock(compact_mutex_);
+
+    std::vector<std::shared_ptr<BlockReader>> blocks = store_.all_blocks();
+    std::vector<BlockMeta> metas;
+    metas.reserve(blocks.size());
+    for (const auto& block : blocks) {
+        metas.push_back(block->meta());
+    }
+    std::optional<CompactionPlan> next = plan(metas);
+    if (!next) {
+        return false;
+    }
+
+    // Oldest first, so later flushes win on duplicate timestamps as in queries
+    std::unordered_set<uint64_t> picked(next->sequences.begin(), next->sequences.end());
+    std::vector<std::shared_ptr<BlockReader>> inputs;
+    for (const auto& block : blocks) {
+        if (picked.count(block->meta().sequence)) {
+            inputs.push_back(block);
+        }
+    }
+    std::sort(inputs.begin(), inputs.end(),
+              [](const auto& a, const auto& b) { return a->meta().sequence < b->meta().sequence; });
+
+    if (inputs.size() == 1) {
+        // Nothing to merge with: move it down a level without rewriting
+        BlockMeta moved = store_.move_block(inputs.front(), next->output_level);
+        MS_LOG_DEBUG("[Compaction] Moved {} to L{}", moved.path, moved.level);
+        return true;
+    }
+
+    SeriesSamples merged;
+    std::unordered_map<SeriesId, SeriesDescriptor> labels;
+    uint64_t bytes_in = 0;
+    for (const auto& block : inputs) {
+        if (!limiter_.acquire(block->meta().size_bytes)) {
+            throw std::runtime_error("Compaction cancelled");
+        }
+        for (const auto& desc : block->series()) {
+            labels.emplace(desc.id, desc);
+            block->read_series(desc.id, INT64_MIN, INT64_MAX, merged[desc.id]);
+        }
+        bytes_in += block->meta().size_bytes;
+    }
+
+    merge_(merged);
+
+    // Blocks flushed into the window meanwhile stay newer than the output,
+    // but the plan no longer covers the window: drop it and plan again
+    std::unordered_set<uint64_t> planned;
+    for (const auto& meta : metas) {
+        if (store_.bucket_start(meta.min_ts) == next->window_start) planned.insert(meta.sequence);
+    }
+    for (const auto& block : store_.all_blocks()) {
+        const BlockMeta& meta = block->meta();
+        if (store_.bucket_start(meta.min_ts) == next->window_start && !planned.count(meta.sequence)) {
+            MS_LOG_DEBUG("[Compaction] Window {} gained blocks during a merge; replanning", next->window_start);
+            return false;
+        }
+    }
+
+    std::vector<SeriesDescriptor> series;
+    series.reserve(labels.size());
+    for (auto& entry : labels) {
+        series.push_back(std::move(entry.second));
+    }
+
+    BlockMeta output = store_.replace_blocks(inputs, series, merged, next->output_level, &limiter_);
+
+    compactions_.fetch_add(1, std::memory_order_relaxed);
+    input_blocks_.fetch_add(inputs.size(), std::memory_order_relaxed);
+    bytes_read_.fetch_add(bytes_in, std::memory_order_relaxed);
+    bytes_written_.fetch_add(output.size_bytes, std::memory_order_relaxed);
+    MS_LOG_INFO("[Compaction] Merged {} blocks of window {} into L{} {} ({} -> {} bytes)", inputs.size(),
+                next->window_start, output.level, output.path, bytes_in, output.size_bytes);
+    return true;
+}
+
+CompactionStats Compactor::stats() const {
+    CompactionStats stats;
+    stats.compactions = compactions_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    stats.input_blocks = input_blocks_.load(std::memory_order_relaxed);
+    stats.bytes_read = bytes_read_.load(std::memory_order_relaxed);
+    stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    stats.bytes_flushed = bytes_flushed_.load(std::memory_order_relaxed);
+    stats.throttled_ns = limiter_.throttled_ns();
+    return stats;
+}
+
+} // namespace metricstream
@@ -1,30 +1,258 @@
 #include "queue_consumer.h"
 #include "kafka_consumer.h"
 #include "partitioned_queue.h"
+#include "storage_engine.h"
+#include "query_service.h"
+#include "batch_codec.h"
+#include "alert_evaluator.h"
+#include "logging.h"
+#include "metrics_registry.h"
+#include "pipeline_latency.h"
+#include "http_server.h"
+#include <fstream>
 #include <iostream>
 #include <csignal>
 #include <atomic>
+#include <cstdlib>
+#include <memory>
 
 std::atomic<bool> running{true};
+std::atomic<bool> reload_requested{false};
 
 void signal_handler(int signal) {
     std::cout << "\nReceived signal " << signal << ", stopping consumer...\n";
     running = false;
 }
 
-void message_handler(const std::string& key, const std::string& message) {
-    // Process message (for now, just log it)
-    std::cout << "[Consumer] Key: " << key << ", Message: " << message.substr(0, 200)
-              << (message.size() > 200 ? "..." : "") << "\n";
+void reload_signal_handler(int) {
+    reload_requested = true;
+}
+
+// Storage node: when a storage directory is given, decoded batches are
+// written to the storage engine and served by a query endpoint
+std::unique_ptr<metricstream::StorageEngine> storage;
+std::unique_ptr<metricstream::QueryService> query_service;
+std::unique_ptr<metricstream::AlertEvaluator> alerts;  // optional, from a rules file
+
+// Consumer self-monitoring: end-to-end latency per partition, served on
+// its own port (METRICSTREAM_CONSUMER_STATS_PORT, default 9091, 0 = off)
+metricstream::MetricsRegistry stats_registry;
+metricstream::PipelineLatencyStats latency_stats(stats_registry);
+std::unique_ptr<metricstream::HttpServer> stats_server;
+
+void storage_handler(const std::string& message) {
+    metricstream::DecodedBatch batch = metricstream::decode_metrics_batch(message);
+    storage->ingest(batch);
+    if (alerts) {
+        alerts->on_batch(batch);
+    }
+}
+
+// Stores the batch (or, without storage, just logs it) and records how long
+// it took from POST /metrics to here
+void handle_batch(int partition, const std::string& message) {
+    int64_t received_us = metricstream::PipelineLatencyStats::now_us();
+    if (storage) {
+        storage_handler(message);
+    } else {
+        MS_LOG_INFO("[Consumer] Partition {}: {}{}", partition, std::string_view(message).substr(0, 200),
+                    message.size() > 200 ? "..." : "");
+    }
+    latency_stats.record(partition, metricstream::peek_ingest_timestamp_us(message), received_us,
+                         metricstream::PipelineLatencyStats::now_us());
+}
+
+void start_stats_server() {
+    int port = 9091;
+    if (const char* value = std::getenv("METRICSTREAM_CONSUMER_STATS_PORT")) {
+        port = std::stoi(value);
+    }
+    if (port == 0) {
+        return;
+    }
+    stats_server = std::make_unique<metricstream::HttpServer>(port, 2);
+    stats_server->add_handler("/stats", "GET", [](const metricstream::HttpRequest&) {
+        metricstream::HttpResponse response;
+        response.set_json_content();
+        response.body = latency_stats.to_json();
+        return response;
+    });
+    stats_server->add_handler("/internal/metrics", "GET", [](const metricstream::HttpRequest&) {
+        metricstream::HttpResponse response;
+        response.headers["Content-Type"] = "text/plain; version=0.0.4; charset=utf-8";
+        stats_registry.write_prometheus(response.body);
+        return response;
+    });
+    stats_server->start();
+    std::cout << "Stats endpoint: http://localhost:" << port << "/stats\n";
+}
+
+void stop_stats_server() {
+    if (stats_server) {
+        stats_server->stop();
+    }
+}
+
+void register_storage_metrics() {
+    auto stat = [](uint64_t metricstream::CompactionStats::*field) {
+        return [field] { return static_cast<double>(storage->compaction_stats().*field); };
+    };
+    stats_registry.counter_function("metricstream_compactions_total", "Block merges completed",
+                                    stat(&metricstream::CompactionStats::compactions));
+    stats_registry.counter_function("metricstream_compaction_failures_total", "Block merges that failed",
+                                    stat(&metricstream::CompactionStats::failures));
+    stats_registry.counter_function("metricstream_compaction_input_blocks_total", "Blocks consumed by merges",
+                                    stat(&metricstream::CompactionStats::input_blocks));
+    const char* bytes_help = "Block bytes moved by head flushes and compaction";
+    stats_registry.counter_function("metricstream_storage_bytes_total", bytes_help,
+                                    stat(&metricstream::CompactionStats::bytes_flushed), {{"op", "flush"}});
+    stats_registry.counter_function("metricstream_storage_bytes_total", bytes_help,
+                                    stat(&metricstream::CompactionStats::bytes_read), {{"op", "compaction_read"}});
+    stats_registry.counter_function("metricstream_storage_bytes_total", bytes_help,
+                                    stat(&metricstream::CompactionStats::bytes_written), {{"op", "compaction_write"}});
+    stats_registry.counter_function("metricstream_compaction_throttled_seconds_total",
+                                    "Time compaction waited on its I/O budget",
+                                    [] { return storage->compaction_stats().throttled_ns / 1e9; });
+    stats_registry.gauge_function("metricstream_storage_write_amplification",
+                                  "Bytes written to disk per byte flushed from the head",
+                                  [] { return storage->compaction_stats().write_amplification(); });
+    stats_registry.gauge_function("metricstream_storage_blocks", "Raw blocks on disk",
+                                  [] { return static_cast<double>(storage->block_count()); });
+
+    const char* ooo_help = "Samples older than their series' newest, by outcome";
+    stats_registry.counter_function("metricstream_storage_out_of_order_samples_total", ooo_help,
+                                    [] { return static_cast<double>(storage->out_of_order_accepted()); },
+                                    {{"result", "accepted"}});
+    stats_registry.counter_function("metricstream_storage_out_of_order_samples_total", ooo_help,
+                                    [] { return static_cast<double>(storage->out_of_order_rejected()); },
+                                    {{"result", "too_old"}});
+
+    const char* lookups_help = "Block cache lookups by query reads";
+    stats_registry.counter_function("metricstream_block_cache_lookups_total", lookups_help,
+                                    [] { return static_cast<double>(storage->block_cache_stats().hits); },
+                                    {{"result", "hit"}});
+    stats_registry.counter_function("metricstream_block_cache_lookups_total", lookups_help,
+                                    [] { return static_cast<double>(storage->block_cache_stats().misses); },
+                                    {{"result", "miss"}});
+    stats_registry.counter_function("metricstream_block_cache_rejected_total",
+                                    "Decoded series kept out by the frequency filter",
+                                    [] { return static_cast<double>(storage->block_cache_stats().rejected); });
+    stats_registry.counter_function("metricstream_block_cache_evictions_total", "Entries evicted for room",
+                                    [] { return static_cast<double>(storage->block_cache_stats().evictions); });
+    stats_registry.gauge_function("metricstream_block_cache_bytes", "Bytes held by the block cache",
+                                  [] { return static_cast<double>(storage->block_cache_stats().bytes); });
+    stats_registry.gauge_function("metricstream_block_cache_hit_ratio", "Hits per lookup since start",
+                                  [] { return storage->block_cache_stats().hit_ratio(); });
+}
+
+std::string alert_rules_path;
+
+// One "name: <op>_over_time(selector[window]) <cmp> <threshold> [for <duration>]"
+// per line; blank lines and lines starting with # are skipped
+std::vector<metricstream::AlertRule> read_alert_rules(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open alert rules file " + path);
+    }
+    std::vector<metricstream::AlertRule> rules;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        rules.push_back(metricstream::AlertRule::parse(line));
+    }
+    return rules;
+}
+
+void load_alert_rules(const std::string& path) {
+    alert_rules_path = path;
+    alerts = std::make_unique<metricstream::AlertEvaluator>();
+    alerts->set_rules(read_alert_rules(path));
+    std::cout << "Alert rules: " << alerts->rule_count() << " from " << path
+              << " (send SIGHUP to reload)\n";
+}
+
+// Called from the main thread; consumers keep evaluating during the rebuild
+void reload_alert_rules_if_requested() {
+    if (!reload_requested.exchange(false) || !alerts) {
+        return;
+    }
+    try {
+        alerts->set_rules(read_alert_rules(alert_rules_path));
+        std::cout << "Alert rules reloaded: " << alerts->rule_count() << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Alert rules reload failed, keeping previous rules: " << e.what() << "\n";
+    }
+}
+
+// Called from the main thread; resolves alerts of series that stopped
+// reporting and frees their windows
+void expire_stale_alerts() {
+    static auto last_sweep = std::chrono::steady_clock::now();
+    auto now = std::chrono::steady_clock::now();
+    if (!alerts || now - last_sweep < std::chrono::seconds(10)) {
+        return;
+    }
+    last_sweep = now;
+    size_t expired = alerts->expire_stale(metricstream::to_unix_millis(std::chrono::system_clock::now()));
+    if (expired > 0) {
+        MS_LOG_INFO("[Alerting] Expired {} idle series", expired);
+    }
+}
+
+void start_storage(int argc, char* argv[]) {
+    if (argc < 6) {
+        return;
+    }
+
+    metricstream::StorageEngine::Options options;
+    options.data_dir = argv[5];
+    if (const char* value = std::getenv("METRICSTREAM_COMPACTION_STRATEGY")) {
+        options.compaction.strategy = metricstream::parse_compaction_strategy(value);
+    }
+    if (const char* value = std::getenv("METRICSTREAM_COMPACTION_MB_PER_SEC")) {
+        options.compaction.io_bytes_per_second = std::stoull(value) * 1024 * 1024;
+    }
+    if (const char* value = std::getenv("METRICSTREAM_BLOCK_CACHE_MB")) {
+        options.block_cache_bytes = std::stoull(value) * 1024 * 1024;
+    }
+    if (const char* value = std::getenv("METRICSTREAM_OUT_OF_ORDER_WINDOW_SECONDS")) {
+        options.out_of_order_window_ms = std::stoll(value) * 1000;
+    }
+    int query_port = argc > 6 ? std::stoi(argv[6]) : 9090;
+    if (argc > 7) {
+        load_alert_rules(argv[7]);
+    }
+
+    storage = std::make_unique<metricstream::StorageEngine>(options);
+    query_service = std::make_unique<metricstream::QueryService>(query_port, *storage);
+    query_service->start();
+    register_storage_metrics();
+
+    std::cout << "Storage directory: " << options.data_dir << "\n";
+    std::cout << "Compaction: " << metricstream::compaction_strategy_name(options.compaction.strategy) << "\n";
+    std::cout << "Query endpoint: http://localhost:" << query_port << "/query\n";
+}
+
+void stop_storage() {
+    if (query_service) {
+        query_service->stop();
+    }
+    if (storage) {
+        storage->flush();
+    }
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         std::cerr << "Usage:\n";
-        std::cerr << "  File-based: " << argv[0] << " file <queue_path> <consumer_group> <num_partitions>\n";
-        std::cerr << "  Kafka:       " << argv[0] << " kafka <brokers> <topic> <group_id>\n";
+        std::cerr << "  File-based: " << argv[0] << " file <queue_path> <consumer_group> <num_partitions> [storage_dir] [query_port] [alert_rules]\n";
+        std::cerr << "  Kafka:       " << argv[0] << " kafka <brokers> <topic> <group_id> [storage_dir] [query_port] [alert_rules]\n";
         std::cerr << "Examples:\n";
         std::cerr << "  " << argv[0] << " file queue storage-writer 4\n";
+        std::cerr << "  " << argv[0] << " file queue storage-writer 4 storage 9090\n";
         std::cerr << "  " << argv[0] << " kafka localhost:9092 metrics consumer-group-1\n";
         return 1;
     }
@@ -34,11 +262,14 @@ int main(int argc, char* argv[]) {
     // Set up signal handler for graceful shutdown
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
+    std::signal(SIGHUP, reload_signal_handler);
 
     try {
+        metricstream::Logger::instance().configure_from_env();
+
         if (mode == "file") {
-            if (argc != 5) {
-                std::cerr << "File mode requires: <queue_path> <consumer_group> <num_partitions>\n";
+            if (argc < 5 || argc > 8) {
+                std::cerr << "File mode requires: <queue_path> <consumer_group> <num_partitions> [storage_dir] [query_port] [alert_rules]\n";
                 return 1;
             }
 
@@ -52,12 +283,31 @@ int main(int argc, char* argv[]) {
             std::cout << "Partitions: " << num_partitions << "\n";
             std::cout << "Press Ctrl+C to stop\n\n";
 
+            start_storage(argc, argv);
+            start_stats_server();
+
             QueueConsumer consumer(queue_path, consumer_group, num_partitions);
-            consumer.start();
+            consumer.set_message_handler([](const Message& msg) { handle_batch(msg.partition, msg.data); });
+
+            // Run consumer in a separate thread so we can handle signals
+            std::thread consumer_thread([&consumer]() {
+                consumer.start();
+            });
+
+            while (running) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                reload_alert_rules_if_requested();
+                expire_stale_alerts();
+            }
+
+            consumer.stop();
+            consumer_thread.join();
+            stop_storage();
+            stop_stats_server();
 
         } else if (mode == "kafka") {
-            if (argc != 5) {
-                std::cerr << "Kafka mode requires: <brokers> <topic> <group_id>\n";
+            if (argc < 5 || argc > 8) {
+                std::cerr << "Kafka mode requires: <brokers> <topic> <group_id> [storage_dir] [query_port] [alert_rules]\n";
                 return 1;
             }
 
@@ -71,20 +321,33 @@ int main(int argc, char* argv[]) {
             std::cout << "Group ID: " << group_id << "\n";
             std::cout << "Press Ctrl+C to stop\n\n";
 
+            start_storage(argc, argv);
+            start_stats_server();
+
             KafkaConsumer consumer(brokers, topic, group_id);
 
             // Run consumer in a separate thread so we can handle signals
             std::thread consumer_thread([&consumer]() {
-                consumer.start(message_handler);
+                consumer.start([](const std::string&, const std::string& message, int32_t partition) {
+                    try {
+                        handle_batch(partition, message);
+                    } catch (const std::exception& e) {
+                        MS_LOG_ERROR("[Consumer] Failed to store message: {}", e.what());
+                    }
+                });
             });
 
             // Wait for stop signal
             while (running) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                reload_alert_rules_if_requested();
+                expire_stale_alerts();
             }
 
             consumer.stop();
             consumer_thread.join();
+            stop_storage();
+            stop_stats_server();
 
         } else {
             std::cerr << "Unknown mode: " << mode << ". Use 'file' or 'kafka'\n";
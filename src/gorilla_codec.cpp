@@ -0,0 +1,213 @@
+#include "gorilla_codec.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+uint64_t double_bits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bits_double(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t low_mask(int bits) {
+    return bits >= 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1;
+}
+
+int64_t sign_extend(uint64_t value, int bits) {
+    uint64_t sign = uint64_t{1} << (bits - 1);
+    return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    uint64_t read_bits(int num_bits) {
+        uint64_t value = 0;
+        while (num_bits > 0) {
+            if (byte_ >= size_) {
+                throw std::runtime_error("Gorilla stream truncated");
+            }
+            int available = 8 - bit_;
+            int take = num_bits < available ? num_bits : available;
+            uint8_t chunk = static_cast<uint8_t>(data_[byte_] >> (available - take)) &
+                            static_cast<uint8_t>((1u << take) - 1);
+            value = (value << take) | chunk;
+            num_bits -= take;
+            bit_ += take;
+            if (bit_ == 8) {
+                bit_ = 0;
+                byte_++;
+            }
+        }
+        return value;
+    }
+
+    bool read_bit() { return read_bits(1) != 0; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t byte_ = 0;
+    int bit_ = 0;
+};
+
+} // namespace
+
+void GorillaEncoder::write_bits(uint64_t value, int num_bits) {
+    // MSB-first packing
+    while (num_bits > 0) {
+        if (bit_pos_ == 0) {
+            bytes_.push_back(0);
+        }
+        int available = 8 - bit_pos_;
+        int take = num_bits < available ? num_bits : available;
+        uint8_t chunk = static_cast<uint8_t>((value >> (num_bits - take)) & ((1u << take) - 1));
+        bytes_.back() |= static_cast<uint8_t>(chunk << (available - take));
+        num_bits -= take;
+        bit_pos_ = static_cast<uint8_t>((bit_pos_ + take) % 8);
+    }
+}
+
+void GorillaEncoder::append(int64_t timestamp_ms, double value) {
+    uint64_t value_bits = double_bits(value);
+
+    if (count_ == 0) {
+        write_bits(static_cast<uint64_t>(timestamp_ms), 64);
+        write_bits(value_bits, 64);
+        prev_ts_ = timestamp_ms;
+        prev_value_bits_ = value_bits;
+        count_++;
+        return;
+    }
+
+    // Timestamp: delta-of-delta in the smallest bucket that fits
+    // (two's complement wraparound keeps extreme jumps lossless)
+    int64_t delta = static_cast<int64_t>(static_cast<uint64_t>(timestamp_ms) - static_cast<uint64_t>(prev_ts_));
+    int64_t dod = static_cast<int64_t>(static_cast<uint64_t>(delta) - static_cast<uint64_t>(prev_delta_));
+    if (dod == 0) {
+        write_bit(false);
+    } else if (dod >= -64 && dod <= 63) {
+        write_bits(0b10, 2);
+        write_bits(static_cast<uint64_t>(dod) & low_mask(7), 7);
+    } else if (dod >= -256 && dod <= 255) {
+        write_bits(0b110, 3);
+        write_bits(static_cast<uint64_t>(dod) & low_mask(9), 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+        write_bits(0b1110, 4);
+        write_bits(static_cast<uint64_t>(dod) & low_mask(12), 12);
+    } else if (dod >= INT32_MIN && dod <= INT32_MAX) {
+        write_bits(0b11110, 5);
+        write_bits(static_cast<uint64_t>(dod) & low_mask(32), 32);
+    } else {
+        write_bits(0b11111, 5);
+        write_bits(static_cast<uint64_t>(dod), 64);
+    }
+    prev_delta_ = delta;
+    prev_ts_ = timestamp_ms;
+
+    // Value: XOR against previous, reuse the previous bit window when it fits
+    uint64_t xored = value_bits ^ prev_value_bits_;
+    if (xored == 0) {
+        write_bit(false);
+    } else {
+        write_bit(true);
+        uint8_t leading = static_cast<uint8_t>(__builtin_clzll(xored));
+        uint8_t trailing = static_cast<uint8_t>(__builtin_ctzll(xored));
+        if (leading > 31) leading = 31;  // 5-bit field
+
+        if (prev_leading_ != 0xFF && leading >= prev_leading_ && trailing >= prev_trailing_) {
+            write_bit(false);
+            int meaningful = 64 - prev_leading_ - prev_trailing_;
+            write_bits(xored >> prev_trailing_, meaningful);
+        } else {
+            write_bit(true);
+            int meaningful = 64 - leading - trailing;
+            write_bits(leading, 5);
+            write_bits(static_cast<uint64_t>(meaningful) & 0x3F, 6);  // 64 stored as 0
+            write_bits(xored >> trailing, meaningful);
+            prev_leading_ = leading;
+            prev_trailing_ = trailing;
+        }
+    }
+    prev_value_bits_ = value_bits;
+    count_++;
+}
+
+std::string GorillaEncoder::finish() const {
+    std::string out;
+    out.reserve(sizeof(uint32_t) + bytes_.size());
+    uint32_t count = static_cast<uint32_t>(count_);
+    out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.append(reinterpret_cast<const char*>(bytes_.data()), bytes_.size());
+    return out;
+}
+
+void gorilla_decode(const char* data, size_t size,
+                    std::vector<int64_t>& timestamps, std::vector<double>& values) {
+    if (size < sizeof(uint32_t)) {
+        throw std::runtime_error("Gorilla stream truncated");
+    }
+    uint32_t count;
+    std::memcpy(&count, data, sizeof(count));
+    if (count == 0) {
+        return;
+    }
+
+    BitReader reader(reinterpret_cast<const uint8_t*>(data + sizeof(count)), size - sizeof(count));
+    timestamps.reserve(timestamps.size() + count);
+    values.reserve(values.size() + count);
+
+    int64_t ts = static_cast<int64_t>(reader.read_bits(64));
+    uint64_t value_bits = reader.read_bits(64);
+    timestamps.push_back(ts);
+    values.push_back(bits_double(value_bits));
+
+    int64_t delta = 0;
+    int leading = 0;
+    int trailing = 0;
+
+    for (uint32_t i = 1; i < count; ++i) {
+        int64_t dod;
+        if (!reader.read_bit()) {
+            dod = 0;
+        } else if (!reader.read_bit()) {
+            dod = sign_extend(reader.read_bits(7), 7);
+        } else if (!reader.read_bit()) {
+            dod = sign_extend(reader.read_bits(9), 9);
+        } else if (!reader.read_bit()) {
+            dod = sign_extend(reader.read_bits(12), 12);
+        } else if (!reader.read_bit()) {
+            dod = sign_extend(reader.read_bits(32), 32);
+        } else {
+            dod = static_cast<int64_t>(reader.read_bits(64));
+        }
+        delta = static_cast<int64_t>(static_cast<uint64_t>(delta) + static_cast<uint64_t>(dod));
+        ts = static_cast<int64_t>(static_cast<uint64_t>(ts) + static_cast<uint64_t>(delta));
+
+        if (reader.read_bit()) {
+            if (reader.read_bit()) {
+                leading = static_cast<int>(reader.read_bits(5));
+                int meaningful = static_cast<int>(reader.read_bits(6));
+                if (meaningful == 0) meaningful = 64;
+                trailing = 64 - leading - meaningful;
+            }
+            int meaningful = 64 - leading - trailing;
+            value_bits ^= reader.read_bits(meaningful) << trailing;
+        }
+
+        timestamps.push_back(ts);
+        values.push_back(bits_double(value_bits));
+    }
+}
+
+} // namespace metricstream
@@ -0,0 +1,146 @@
+#include "hdr_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+int bit_length(uint64_t value) {
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+} // namespace
+
+HdrHistogram::HdrHistogram(int64_t highest_trackable, int significant_digits)
+    : highest_trackable_(highest_trackable), significant_digits_(significant_digits) {
+    if (highest_trackable_ < 2) {
+        throw std::invalid_argument("HdrHistogram highest trackable value must be at least 2");
+    }
+    if (significant_digits_ < 1 || significant_digits_ > 5) {
+        throw std::invalid_argument("HdrHistogram significant digits must be 1-5");
+    }
+
+    // Enough sub-buckets that adjacent values differ by at most 10^-digits
+    int64_t largest_single_unit = 2 * static_cast<int64_t>(std::pow(10, significant_digits_));
+    int sub_bucket_count_magnitude = bit_length(static_cast<uint64_t>(largest_single_unit - 1));
+    sub_bucket_half_count_magnitude_ = sub_bucket_count_magnitude - 1;
+    sub_bucket_count_ = int64_t{1} << sub_bucket_count_magnitude;
+    sub_bucket_half_count_ = sub_bucket_count_ / 2;
+    sub_bucket_mask_ = sub_bucket_count_ - 1;
+
+    // Each further bucket doubles the covered range
+    int bucket_count = 1;
+    int64_t smallest_untrackable = sub_bucket_count_;
+    while (smallest_untrackable <= highest_trackable_) {
+        if (smallest_untrackable > INT64_MAX / 2) {
+            bucket_count++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        bucket_count++;
+    }
+    counts_.assign(static_cast<size_t>((bucket_count + 1) * sub_bucket_half_count_), 0);
+}
+
+size_t HdrHistogram::counts_index(int64_t value) const {
+    int bucket_index = bit_length(static_cast<uint64_t>(value | sub_bucket_mask_)) -
+                       (sub_bucket_half_count_magnitude_ + 1);
+    int64_t sub_bucket_index = value >> bucket_index;
+    int64_t bucket_base = static_cast<int64_t>(bucket_index + 1) << sub_bucket_half_count_magnitude_;
+    return static_cast<size_t>(bucket_base + (sub_bucket_index - sub_bucket_half_count_));
+}
+
+int64_t HdrHistogram::value_at_index(size_t index) const {
+    int bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+    int64_t sub_bucket_index = static_cast<int64_t>(index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+    if (bucket_index < 0) {
+        sub_bucket_index -= sub_bucket_half_count_;
+        bucket_index = 0;
+    }
+    return sub_bucket_index << bucket_index;
+}
+
+int64_t HdrHistogram::highest_equivalent_value(int64_t value) const {
+    int bucket_index = bit_length(static_cast<uint64_t>(value | sub_bucket_mask_)) -
+                       (sub_bucket_half_count_magnitude_ + 1);
+    int64_t lowest = (value >> bucket_index) << bucket_index;
+    return lowest + (int64_t{1} << bucket_index) - 1;
+}
+
+void HdrHistogram::record(int64_t value, uint64_t count) {
+    if (value < 0) {
+        value = 0;
+    }
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value) * static_cast<double>(count);
+    counts_[counts_index(std::min(value, highest_trackable_))] += count;
+    total_count_ += count;
+}
+
+void HdrHistogram::merge(const HdrHistogram& other) {
+    if (other.counts_.size() != counts_.size() || other.sub_bucket_count_ != sub_bucket_count_) {
+        throw std::invalid_argument("Cannot merge HdrHistograms with different configurations");
+    }
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+void HdrHistogram::reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+    min_ = INT64_MAX;
+    max_ = 0;
+    sum_ = 0.0;
+}
+
+int64_t HdrHistogram::min() const {
+    return total_count_ ? min_ : 0;
+}
+
+double HdrHistogram::mean() const {
+    return total_count_ ? sum_ / static_cast<double>(total_count_) : 0.0;
+}
+
+int64_t HdrHistogram::value_at_percentile(double percentile) const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total_count_)));
+    target = std::max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) {
+            // Never report beyond what was actually recorded
+            return std::min(highest_equivalent_value(value_at_index(i)), max_);
+        }
+    }
+    return max_;
+}
+
+std::string HdrHistogram::summary(const std::string& unit) const {
+    static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+    std::string out;
+    char buf[64];
+    for (double p : percentiles) {
+        std::snprintf(buf, sizeof(buf), "p%g=%lld%s ", p,
+                      static_cast<long long>(value_at_percentile(p)), unit.c_str());
+        out += buf;
+    }
+    std::snprintf(buf, sizeof(buf), "max=%lld%s", static_cast<long long>(max()), unit.c_str());
+    out += buf;
+    return out;
+}
+
+} // namespace metricstream
@@ -0,0 +1,314 @@
+#include "head_block.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace metricstream {
+
+HeadBlock::HeadBlock(int64_t block_duration_ms, int64_t out_of_order_window_ms)
+    : block_duration_ms_(block_duration_ms), out_of_order_window_ms_(out_of_order_window_ms) {
+    if (block_duration_ms_ <= 0) {
+        throw std::invalid_argument("Block duration must be positive");
+    }
+    if (out_of_order_window_ms_ < 0) {
+        throw std::invalid_argument("Out-of-order window must not be negative");
+    }
+}
+
+int64_t HeadBlock::bucket_start(int64_t ts) const {
+    int64_t bucket = ts / block_duration_ms_;
+    if (ts < 0 && ts % block_duration_ms_ != 0) {
+        bucket--;
+    }
+    return bucket * block_duration_ms_;
+}
+
+std::shared_ptr<HeadBlock::MemSeries> HeadBlock::get_or_create(SeriesId id) {
+    Shard& shard = shard_for(id);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.series.find(id);
+        if (it != shard.series.end()) {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto& slot = shard.series[id];
+    if (!slot) {
+        slot = std::make_shared<MemSeries>();
+    }
+    return slot;
+}
+
+std::shared_ptr<const HeadBlock::MemSeries> HeadBlock::find(SeriesId id) const {
+    const Shard& shard = shard_for(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.series.find(id);
+    return it == shard.series.end() ? nullptr : it->second;
+}
+
+bool HeadBlock::append(SeriesId id, int64_t timestamp_ms, double value) {
+    std::shared_ptr<MemSeries> held = get_or_create(id);
+    {
+        std::unique_lock<std::mutex> lock(held->mutex);
+        while (held->evicted) {
+            // Evicted between the lookup and the lock: append to its successor
+            lock.unlock();
+            held = get_or_create(id);
+            lock = std::unique_lock<std::mutex>(held->mutex);
+        }
+        MemSeries& series = *held;
+
+        HeadChunk* open = series.chunks.empty() ? nullptr : series.chunks.back().get();
+        if (timestamp_ms <= series.last_ts) {
+            if (timestamp_ms == series.last_ts && open && !open->sealed && open->max_ts() == timestamp_ms) {
+                open->values[open->count - 1] = value;  // duplicate timestamp: last write wins
+                return true;
+            }
+            // Lateness is per series: a sample is late relative to its own
+            // series, not to whichever series has the newest timestamp
+            if (series.last_ts - timestamp_ms > out_of_order_window_ms_) {
+                out_of_order_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            out_of_order_accepted_.fetch_add(1, std::memory_order_relaxed);
+            if (append_out_of_order(series, timestamp_ms, value)) {
+                sample_count_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+
+        // Cut a new chunk when full, sealed, or the sample starts a new bucket
+        if (!open || open->sealed || open->full() ||
+            bucket_start(timestamp_ms) != bucket_start(open->min_ts())) {
+            if (open) open->sealed = true;
+            series.chunks.push_back(std::make_unique<HeadChunk>());
+            open = series.chunks.back().get();
+            chunk_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        open->timestamps[open->count] = timestamp_ms;
+        open->values[open->count] = value;
+        open->count++;
+        series.last_ts = timestamp_ms;
+    }
+    sample_count_.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t seen = max_timestamp_.load(std::memory_order_relaxed);
+    while (timestamp_ms > seen &&
+           !max_timestamp_.compare_exchange_weak(seen, timestamp_ms, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+bool HeadBlock::append_out_of_order(MemSeries& series, int64_t timestamp_ms, double value) {
+    if (!series.out_of_order) {
+        series.out_of_order = std::make_unique<OutOfOrderBuffer>();
+    }
+    OutOfOrderSamples& pending = series.out_of_order->pending;
+
+    auto it = std::lower_bound(pending.timestamps.begin(), pending.timestamps.end(), timestamp_ms);
+    size_t pos = static_cast<size_t>(it - pending.timestamps.begin());
+    if (it != pending.timestamps.end() && *it == timestamp_ms) {
+        pending.values[pos] = value;
+        return false;
+    }
+    pending.timestamps.insert(it, timestamp_ms);
+    pending.values.insert(pending.values.begin() + static_cast<std::ptrdiff_t>(pos), value);
+    return true;
+}
+
+void HeadBlock::scan(SeriesId id, int64_t start_ts, int64_t end_ts, const ChunkVisitor& visitor) const {
+    std::shared_ptr<const MemSeries> series = find(id);
+    if (!series) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(series->mutex);
+    for (const auto& chunk : series->chunks) {
+        if (chunk->count == 0 || chunk->max_ts() < start_ts) continue;
+        if (chunk->min_ts() > end_ts) break;
+
+        const int64_t* begin = chunk->timestamps;
+        const int64_t* end = chunk->timestamps + chunk->count;
+        const int64_t* first = std::lower_bound(begin, end, start_ts);
+        const int64_t* last = std::upper_bound(first, end, end_ts);
+        if (first != last) {
+            visitor(first, chunk->values + (first - begin), static_cast<size_t>(last - first));
+        }
+    }
+
+    if (!series->out_of_order) {
+        return;
+    }
+    // Flushing first, so a pending rewrite of the same timestamp comes later
+    for (const OutOfOrderSamples* samples : {&series->out_of_order->flushing, &series->out_of_order->pending}) {
+        auto first = std::lower_bound(samples->timestamps.begin(), samples->timestamps.end(), start_ts);
+        auto last = std::upper_bound(first, samples->timestamps.end(), end_ts);
+        if (first != last) {
+            size_t offset = static_cast<size_t>(first - samples->timestamps.begin());
+            visitor(&*first, samples->values.data() + offset, static_cast<size_t>(last - first));
+        }
+    }
+}
+
+void HeadBlock::read(SeriesId id, int64_t start_ts, int64_t end_ts, std::vector<Sample>& out) const {
+    size_t begin = out.size();
+    bool sorted = true;
+    scan(id, start_ts, end_ts, [&](const int64_t* timestamps, const double* values, size_t count) {
+        if (out.size() > begin && timestamps[0] < out.back().timestamp_ms) {
+            sorted = false;  // an out-of-order run
+        }
+        out.reserve(out.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            out.push_back(Sample{timestamps[i], values[i]});
+        }
+    });
+    if (!sorted) {
+        std::stable_sort(out.begin() + static_cast<std::ptrdiff_t>(begin), out.end(),
+                         [](const Sample& a, const Sample& b) { return a.timestamp_ms < b.timestamp_ms; });
+    }
+}
+
+HeadBlock::FlushBatch HeadBlock::collect_flushable(int64_t cutoff_ts) {
+    FlushBatch batch;
+    for (auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> shard_lock(shard.mutex);
+        for (auto& [id, series] : shard.series) {
+            std::lock_guard<std::mutex> lock(series->mutex);
+
+            size_t taken = 0;
+            for (auto& chunk : series->chunks) {
+                if (chunk->count == 0 || chunk->max_ts() >= cutoff_ts) break;
+
+                // Sealing the open chunk sends later appends to a fresh one,
+                // so the copy below stays complete
+                chunk->sealed = true;
+                auto& dest = batch.buckets[bucket_start(chunk->min_ts())][id];
+                dest.reserve(dest.size() + chunk->count);
+                for (uint32_t i = 0; i < chunk->count; ++i) {
+                    dest.push_back(Sample{chunk->timestamps[i], chunk->values[i]});
+                }
+                batch.sample_count += chunk->count;
+                taken++;
+            }
+            if (taken > 0) {
+                batch.taken.emplace_back(id, taken);
+            }
+
+            if (series->out_of_order) {
+                // Only behind every in-order sample left in memory, so a late
+                // rewrite of a timestamp is never written before the original
+                int64_t oldest_left = taken < series->chunks.size() && series->chunks[taken]->count > 0
+                                          ? series->chunks[taken]->min_ts()
+                                          : INT64_MAX;
+                collect_out_of_order(id, *series->out_of_order, std::min(cutoff_ts, oldest_left), batch);
+            }
+        }
+    }
+    return batch;
+}
+
+void HeadBlock::collect_out_of_order(SeriesId id, OutOfOrderBuffer& buffer, int64_t cutoff_ts, FlushBatch& batch) {
+    OutOfOrderSamples& pending = buffer.pending;
+    OutOfOrderSamples& flushing = buffer.flushing;
+
+    // Move pending samples older than the cutoff over to flushing, merged by
+    // timestamp; on a tie the pending (newer) value wins
+    size_t moved = static_cast<size_t>(
+        std::lower_bound(pending.timestamps.begin(), pending.timestamps.end(), cutoff_ts) - pending.timestamps.begin());
+    if (moved > 0) {
+        OutOfOrderSamples merged;
+        merged.timestamps.reserve(flushing.size() + moved);
+        merged.values.reserve(flushing.size() + moved);
+        size_t f = 0;
+        size_t p = 0;
+        size_t duplicates = 0;
+        while (f < flushing.size() || p < moved) {
+            if (p == moved || (f < flushing.size() && flushing.timestamps[f] < pending.timestamps[p])) {
+                merged.timestamps.push_back(flushing.timestamps[f]);
+                merged.values.push_back(flushing.values[f++]);
+                continue;
+            }
+            if (f < flushing.size() && flushing.timestamps[f] == pending.timestamps[p]) {
+                f++;
+                duplicates++;
+            }
+            merged.timestamps.push_back(pending.timestamps[p]);
+            merged.values.push_back(pending.values[p++]);
+        }
+        flushing = std::move(merged);
+        pending.timestamps.erase(pending.timestamps.begin(), pending.timestamps.begin() + static_cast<std::ptrdiff_t>(moved));
+        pending.values.erase(pending.values.begin(), pending.values.begin() + static_cast<std::ptrdiff_t>(moved));
+        sample_count_.fetch_sub(duplicates, std::memory_order_relaxed);
+    }
+
+    if (flushing.size() == 0) {
+        return;
+    }
+    // Includes samples left from a failed flush, which was never released
+    for (size_t i = 0; i < flushing.size(); ++i) {
+        batch.out_of_order_buckets[bucket_start(flushing.timestamps[i])][id].push_back(
+            Sample{flushing.timestamps[i], flushing.values[i]});
+    }
+    batch.sample_count += flushing.size();
+    batch.out_of_order_taken.push_back(id);
+}
+
+void HeadBlock::release(const FlushBatch& batch) {
+    for (const auto& [id, taken] : batch.taken) {
+        MemSeries& series = *get_or_create(id);
+        std::lock_guard<std::mutex> lock(series.mutex);
+
+        size_t released_samples = 0;
+        for (size_t i = 0; i < taken && !series.chunks.empty(); ++i) {
+            released_samples += series.chunks.front()->count;
+            series.chunks.pop_front();
+        }
+        sample_count_.fetch_sub(released_samples, std::memory_order_relaxed);
+        chunk_count_.fetch_sub(taken, std::memory_order_relaxed);
+    }
+
+    for (SeriesId id : batch.out_of_order_taken) {
+        MemSeries& series = *get_or_create(id);
+        std::lock_guard<std::mutex> lock(series.mutex);
+        if (!series.out_of_order) {
+            continue;
+        }
+        sample_count_.fetch_sub(series.out_of_order->flushing.size(), std::memory_order_relaxed);
+        if (series.out_of_order->pending.size() == 0) {
+            series.out_of_order.reset();
+        } else {
+            series.out_of_order->flushing = OutOfOrderSamples{};
+        }
+    }
+}
+
+size_t HeadBlock::evict_idle(int64_t before_ts) {
+    size_t evicted = 0;
+    for (auto& shard : shards_) {
+        std::unique_lock<std::shared_mutex> shard_lock(shard.mutex);
+        for (auto it = shard.series.begin(); it != shard.series.end();) {
+            MemSeries& series = *it->second;
+            std::lock_guard<std::mutex> lock(series.mutex);
+            if (!series.chunks.empty() || series.out_of_order || series.last_ts >= before_ts) {
+                ++it;
+                continue;
+            }
+            series.evicted = true;
+            it = shard.series.erase(it);
+            evicted++;
+        }
+    }
+    return evicted;
+}
+
+size_t HeadBlock::series_count() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        total += shard.series.size();
+    }
+    return total;
+}
+
+} // namespace metricstream
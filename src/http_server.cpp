@@ -1,13 +1,91 @@
 #include "http_server.h"
+#include "pipeline_stats.h"
+#include "tracing.h"
+#include "logging.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
-#include <iostream>
 #include <sstream>
 #include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
 
 namespace metricstream {
 
+namespace {
+
+constexpr size_t MAX_REQUEST_BYTES = 8 * 1024 * 1024;
+
+// An accepted connection: closes the socket and gives back its
+// active_connections_ slot however the request ends, exceptions included
+class ClientConnection {
+public:
+    ClientConnection(int socket, std::atomic<size_t>& active) : socket_(socket), active_(active) {}
+    ~ClientConnection() {
+        close(socket_);
+        active_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    ClientConnection(const ClientConnection&) = delete;
+    ClientConnection& operator=(const ClientConnection&) = delete;
+
+private:
+    int socket_;
+    std::atomic<size_t>& active_;
+};
+
+HttpResponse internal_error_response() {
+    HttpResponse response;
+    response.status_code = 500;
+    response.set_json_content();
+    response.body = "{\"error\":\"Internal server error\"}";
+    return response;
+}
+
+// Reads one request: the headers, then as much body as Content-Length says,
+// so batches larger than a single read arrive whole. Returns false if the
+// client sent nothing.
+bool read_request(int client_socket, std::string& out) {
+    char buffer[16384];
+    size_t expected = 0;  // total bytes once the header end is known
+    while (out.size() < MAX_REQUEST_BYTES) {
+        ssize_t n = read(client_socket, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;  // e.g. SIGPROF while the profiler runs
+        }
+        if (n <= 0) {
+            break;
+        }
+        out.append(buffer, static_cast<size_t>(n));
+
+        if (expected == 0) {
+            size_t header_end = out.find("\r\n\r\n");
+            if (header_end == std::string::npos) {
+                continue;
+            }
+            size_t content_length = 0;
+            std::string headers = out.substr(0, header_end);
+            for (auto& c : headers) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            size_t pos = headers.find("\r\ncontent-length:");
+            if (pos != std::string::npos) {
+                content_length = std::strtoul(headers.c_str() + pos + 17, nullptr, 10);
+            }
+            expected = header_end + 4 + std::min(content_length, MAX_REQUEST_BYTES);
+        }
+        if (out.size() >= expected) {
+            break;
+        }
+    }
+    return !out.empty();
+}
+
+} // namespace
+
 HttpServer::HttpServer(int port, size_t thread_pool_size)
     : port_(port), running_(false) {
     // Phase 6: Initialize thread pool
@@ -29,7 +107,7 @@ void HttpServer::start() {
     
     running_ = true;
     server_thread_ = std::make_unique<std::thread>(&HttpServer::run_server, this);
-    std::cout << "HTTP server started on port " << port_ << std::endl;
+    MS_LOG_INFO("HTTP server started on port {}", port_);
 }
 
 void HttpServer::stop() {
@@ -38,16 +116,23 @@ void HttpServer::stop() {
     }
     
     running_ = false;
+    
+    // Wake the accept() loop so the server thread can observe running_ == false
+    int fd = server_fd_.load();
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+    }
+    
     if (server_thread_ && server_thread_->joinable()) {
         server_thread_->join();
     }
-    std::cout << "HTTP server stopped" << std::endl;
+    MS_LOG_INFO("HTTP server stopped");
 }
 
 void HttpServer::run_server() {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd == -1) {
-        std::cerr << "Failed to create socket" << std::endl;
+        MS_LOG_ERROR("Failed to create socket: {}", std::strerror(errno));
         return;
     }
 
@@ -61,16 +146,17 @@ void HttpServer::run_server() {
     address.sin_port = htons(port_);
 
     if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "Bind failed on port " << port_ << std::endl;
+        MS_LOG_ERROR("Bind failed on port {}: {}", port_, std::strerror(errno));
         close(server_fd);
         return;
     }
 
     if (listen(server_fd, 10) < 0) {
-        std::cerr << "Listen failed" << std::endl;
+        MS_LOG_ERROR("Listen failed: {}", std::strerror(errno));
         close(server_fd);
         return;
     }
+    server_fd_ = server_fd;
 
     while (running_.load()) {
         struct sockaddr_in client_addr;
@@ -78,28 +164,58 @@ void HttpServer::run_server() {
         
         int client_socket = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
         if (client_socket < 0) {
-            if (running_.load()) {
-                std::cerr << "Accept failed" << std::endl;
+            if (running_.load() && errno != EINTR) {
+                MS_LOG_ERROR("Accept failed: {}", std::strerror(errno));
             }
             continue;
         }
 
+        active_connections_.fetch_add(1, std::memory_order_relaxed);
+
+        // Sampling is decided here so the span covers the thread-pool wait
+        uint64_t trace_id = Tracer::instance().start_trace();
+        int64_t accepted_ns = trace_id != 0 ? trace_clock_ns() : 0;
+
         // PHASE 6: Enqueue request to thread pool (eliminates thread creation overhead)
-        bool enqueued = thread_pool_->enqueue([this, client_socket]() {
-            // Read request
-            char buffer[4096] = {0};
-            ssize_t bytes_read = read(client_socket, buffer, sizeof(buffer) - 1);
-
-            if (bytes_read > 0) {
-                std::string request_data(buffer, bytes_read);
-                HttpRequest request = parse_request(request_data);
-                HttpResponse response = handle_request(request);
-
-                std::string response_str = format_response(response);
-                write(client_socket, response_str.c_str(), response_str.length());
+        bool enqueued = thread_pool_->enqueue([this, client_socket, trace_id, accepted_ns]() {
+            ClientConnection connection(client_socket, active_connections_);
+            TraceScope trace(trace_id);
+            if (trace_id != 0) {
+                Tracer::instance().record(trace_id, "http_pool_wait", accepted_ns, trace_clock_ns());
             }
 
-            close(client_socket);
+            std::string request_data;
+            bool received;
+            {
+                TraceSpan span("http_read");
+                received = read_request(client_socket, request_data);
+            }
+            if (received) {
+                HttpRequest request;
+                {
+                    StageTimer timer(Stage::HTTP_PARSE);
+                    request = parse_request(request_data);
+                }
+                request.client_connected = [client_socket]() {
+                    // Non-blocking peek: 0 means orderly shutdown by the peer
+                    char probe;
+                    ssize_t n = recv(client_socket, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+                    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+                };
+                HttpResponse response;
+                {
+                    TraceSpan span("http_handle");
+                    response = handle_request(request);
+                }
+
+                TraceSpan span("http_write");
+                if (response.body_stream) {
+                    send_streamed_response(client_socket, response);
+                } else {
+                    std::string response_str = format_response(response);
+                    write(client_socket, response_str.c_str(), response_str.length());
+                }
+            }
         });
 
         // If queue is full (backpressure), reject request immediately
@@ -108,13 +224,16 @@ void HttpServer::run_server() {
                 "HTTP/1.1 503 Service Unavailable\r\n"
                 "Content-Type: application/json\r\n"
                 "Content-Length: 47\r\n"
+                "Connection: close\r\n"
                 "\r\n"
                 "{\"error\":\"Server overloaded, try again later\"}";
             write(client_socket, overload_response, strlen(overload_response));
             close(client_socket);
+            active_connections_.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
+    server_fd_ = -1;
     close(server_fd);
 }
 
@@ -127,6 +246,13 @@ HttpRequest HttpServer::parse_request(const std::string& raw_request) {
     if (std::getline(stream, line)) {
         std::istringstream request_line(line);
         request_line >> request.method >> request.path;
+        
+        // Split off the query string: /query?name=cpu&start=0 -> /query + params
+        size_t query_pos = request.path.find('?');
+        if (query_pos != std::string::npos) {
+            request.query_params = parse_query_string(request.path.substr(query_pos + 1));
+            request.path.resize(query_pos);
+        }
     }
     
     // Parse headers
@@ -160,6 +286,52 @@ HttpRequest HttpServer::parse_request(const std::string& raw_request) {
     return request;
 }
 
+std::unordered_map<std::string, std::string> HttpServer::parse_query_string(const std::string& query) {
+    std::unordered_map<std::string, std::string> params;
+    size_t pos = 0;
+    
+    while (pos <= query.length()) {
+        size_t amp_pos = query.find('&', pos);
+        if (amp_pos == std::string::npos) {
+            amp_pos = query.length();
+        }
+        
+        std::string pair = query.substr(pos, amp_pos - pos);
+        if (!pair.empty()) {
+            size_t eq_pos = pair.find('=');
+            if (eq_pos == std::string::npos) {
+                params[url_decode(pair)] = "";
+            } else {
+                params[url_decode(pair.substr(0, eq_pos))] = url_decode(pair.substr(eq_pos + 1));
+            }
+        }
+        
+        pos = amp_pos + 1;
+    }
+    
+    return params;
+}
+
+std::string HttpServer::url_decode(const std::string& value) {
+    std::string decoded;
+    decoded.reserve(value.length());
+    
+    for (size_t i = 0; i < value.length(); ++i) {
+        if (value[i] == '+') {
+            decoded += ' ';
+        } else if (value[i] == '%' && i + 2 < value.length() &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            decoded += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += value[i];
+        }
+    }
+    
+    return decoded;
+}
+
 std::string HttpServer::format_response(const HttpResponse& response) {
     std::ostringstream stream;
     
@@ -168,6 +340,8 @@ std::string HttpServer::format_response(const HttpResponse& response) {
     switch (response.status_code) {
         case 200: stream << "OK"; break;
         case 400: stream << "Bad Request"; break;
+        case 404: stream << "Not Found"; break;
+        case 405: stream << "Method Not Allowed"; break;
         case 429: stream << "Too Many Requests"; break;
         case 500: stream << "Internal Server Error"; break;
         default: stream << "Unknown"; break;
@@ -175,18 +349,74 @@ std::string HttpServer::format_response(const HttpResponse& response) {
     stream << "\r\n";
     
     // Headers
-    stream << "Content-Length: " << response.body.length() << "\r\n";
+    if (response.body_stream) {
+        stream << "Transfer-Encoding: chunked\r\n";
+    } else {
+        stream << "Content-Length: " << response.body.length() << "\r\n";
+    }
+    // One request per connection; saying so stops keep-alive clients from
+    // sending a second request that the close would reset
+    stream << "Connection: close\r\n";
     for (const auto& header : response.headers) {
         stream << header.first << ": " << header.second << "\r\n";
     }
     stream << "\r\n";
     
     // Body
-    stream << response.body;
+    if (!response.body_stream) {
+        stream << response.body;
+    }
     
     return stream.str();
 }
 
+namespace {
+
+// send() until everything is written; MSG_NOSIGNAL turns a closed peer into
+// an error instead of SIGPIPE
+bool send_all(int socket, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(socket, data, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+void HttpServer::send_streamed_response(int client_socket, const HttpResponse& response) {
+    std::string head = format_response(response);
+    bool connected = send_all(client_socket, head.data(), head.size());
+
+    ChunkWriter write_chunk = [client_socket, &connected](const std::string& chunk) {
+        if (!connected) return false;
+        if (chunk.empty()) return true;  // an empty chunk would end the body
+        char size_line[24];
+        int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", chunk.size());
+        connected = send_all(client_socket, size_line, static_cast<size_t>(n)) &&
+                    send_all(client_socket, chunk.data(), chunk.size()) &&
+                    send_all(client_socket, "\r\n", 2);
+        return connected;
+    };
+
+    if (connected) {
+        try {
+            response.body_stream(write_chunk);
+        } catch (const std::exception& e) {
+            // Headers are gone already; leaving out the final chunk tells the
+            // client the body is incomplete
+            MS_LOG_ERROR("Streamed response failed: {}", e.what());
+            connected = false;
+        }
+    }
+    if (connected) {
+        send_all(client_socket, "0\r\n\r\n", 5);
+    }
+}
+
 HttpResponse HttpServer::handle_request(const HttpRequest& request) {
     auto path_it = handlers_.find(request.path);
     if (path_it == handlers_.end()) {
@@ -204,7 +434,15 @@ HttpResponse HttpServer::handle_request(const HttpRequest& request) {
         return response;
     }
     
-    return method_it->second(request);
+    // A throwing handler must not take the connection down with it
+    try {
+        return method_it->second(request);
+    } catch (const std::exception& e) {
+        MS_LOG_ERROR("{} {} failed: {}", request.method, request.path, e.what());
+    } catch (...) {
+        MS_LOG_ERROR("{} {} failed with an unknown exception", request.method, request.path);
+    }
+    return internal_error_response();
 }
 
 } // namespace metricstream
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "hyperloglog.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace metricstream {
+
+HyperLogLog::HyperLogLog(uint8_t precision)
+    : precision_(precision), num_registers_(size_t{1} << precision) {
+    if (precision < 4 || precision > 18) {
+        throw std::invalid_argument("HyperLogLog precision must be in [4, 18]");
+    }
+    registers_ = std::make_unique<std::atomic<uint8_t>[]>(num_registers_);
+    for (size_t i = 0; i < num_registers_; ++i) {
+        registers_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void HyperLogLog::add(uint64_t hash) {
+    // Top `precision` bits pick the register, the rest give the rank
+    size_t index = hash >> (64 - precision_);
+    uint64_t rest = (hash << precision_) | (uint64_t{1} << (precision_ - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+
+    // Monotonic max via CAS - registers only ever grow
+    auto& reg = registers_[index];
+    uint8_t current = reg.load(std::memory_order_relaxed);
+    while (rank > current &&
+           !reg.compare_exchange_weak(current, rank, std::memory_order_relaxed)) {
+    }
+}
+
+double HyperLogLog::estimate() const {
+    const double m = static_cast<double>(num_registers_);
+    double alpha;
+    switch (num_registers_) {
+        case 16: alpha = 0.673; break;
+        case 32: alpha = 0.697; break;
+        case 64: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / m); break;
+    }
+
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < num_registers_; ++i) {
+        uint8_t r = registers_[i].load(std::memory_order_relaxed);
+        sum += std::ldexp(1.0, -static_cast<int>(r));
+        if (r == 0) zeros++;
+    }
+
+    double raw = alpha * m * m / sum;
+
+    // Small-range correction: linear counting while registers are sparse
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / static_cast<double>(zeros));
+    }
+    return raw;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.precision_ != precision_) {
+        throw std::invalid_argument("Cannot merge HyperLogLog sketches of different precision");
+    }
+    for (size_t i = 0; i < num_registers_; ++i) {
+        uint8_t theirs = other.registers_[i].load(std::memory_order_relaxed);
+        uint8_t current = registers_[i].load(std::memory_order_relaxed);
+        while (theirs > current &&
+               !registers_[i].compare_exchange_weak(current, theirs, std::memory_order_relaxed)) {
+        }
+    }
+}
+
+} // namespace metricstream
@@ -1,5 +1,11 @@
 #include "ingestion_service.h"
-#include <iostream>
+#include "batch_codec.h"
+#include "pipeline_stats.h"
+#include "tracing.h"
+#include "sampling_profiler.h"
+#include "logging.h"
+#include "common.h"
+#include <cstdio>
 #include <thread>
 #include <cmath>
 #include <iomanip>
@@ -15,8 +21,13 @@ namespace metricstream {
 
 //
 
-RateLimiter::RateLimiter(size_t max_requests_per_second) 
-    : max_requests_(max_requests_per_second) {
+RateLimiter::RateLimiter(size_t max_requests_per_second, MetricsRegistry* registry)
+    : max_requests_(max_requests_per_second),
+      own_registry_(registry ? nullptr : std::make_unique<MetricsRegistry>()),
+      registry_(registry ? registry : own_registry_.get()) {
+    const char* help = "Rate limiter decisions";
+    allowed_ = &registry_->counter("metricstream_rate_limit_decisions_total", help, {{"decision", "allowed"}});
+    rejected_ = &registry_->counter("metricstream_rate_limit_decisions_total", help, {{"decision", "rejected"}});
 }
 
 // Hash-based per-client mutex selection (Phase 4 optimization)
@@ -81,25 +92,34 @@ bool RateLimiter::allow_request(const std::string& client_id) {
             auto total_lock_time = std::chrono::duration_cast<std::chrono::microseconds>(
                 decision_end - lock_acquired).count();
 
-            std::cerr << "[PROFILE] Wait: " << wait_time << "μs | "
-                      << "Cleanup: " << cleanup_time << "μs (" << removed_count << " items) | "
-                      << "Decision: " << decision_time << "μs | "
-                      << "Total-in-lock: " << total_lock_time << "μs | "
-                      << "Queue-size: " << client_queue.size() << "\n";
+            MS_LOG_DEBUG("[PROFILE] Wait: {}μs | Cleanup: {}μs ({} items) | Decision: {}μs | "
+                         "Total-in-lock: {}μs | Queue-size: {}",
+                         wait_time, cleanup_time, removed_count, decision_time, total_lock_time,
+                         client_queue.size());
         }
-    } // Lock released here
 
-    // LOCK-FREE metrics collection using atomic ring buffer
-    // Single-writer (this thread) / single-reader (flush thread) pattern
-    auto& metrics = client_metrics_[client_id];
-    size_t write_idx = metrics.write_index.load(std::memory_order_relaxed);
+        // LOCK-FREE metrics collection using atomic ring buffer
+        // Single-writer (holder of the client lock) / single-reader (flush) pattern
+        ClientMetrics* metrics;
+        {
+            std::shared_lock<std::shared_mutex> map_lock(client_metrics_mutex_);
+            auto it = client_metrics_.find(client_id);
+            metrics = it != client_metrics_.end() ? &it->second : nullptr;
+        }
+        if (!metrics) {
+            std::unique_lock<std::shared_mutex> map_lock(client_metrics_mutex_);
+            metrics = &client_metrics_[client_id];  // node-based: the address stays valid
+        }
+        size_t write_idx = metrics->write_index.load(std::memory_order_relaxed);
 
-    // Write event to ring buffer
-    metrics.ring_buffer[write_idx % ClientMetrics::BUFFER_SIZE] = MetricEvent{now, decision};
+        // Write event to ring buffer
+        metrics->ring_buffer[write_idx % ClientMetrics::BUFFER_SIZE] = MetricEvent{now, decision};
 
-    // Publish write with release semantics - ensures buffer write visible before index update
-    metrics.write_index.store(write_idx + 1, std::memory_order_release);
+        // Publish write with release semantics - ensures buffer write visible before index update
+        metrics->write_index.store(write_idx + 1, std::memory_order_release);
+    } // Lock released here
 
+    (decision ? allowed_ : rejected_)->inc();
     return decision;
 }
 
@@ -108,40 +128,38 @@ void RateLimiter::flush_metrics() {
     // No longer need complex lock ordering since metrics use atomic ring buffer
     // Only client_metrics_ map iteration needs protection (for concurrent insertions)
 
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+
     // Get snapshot of current clients
-    std::vector<std::string> client_ids;
+    std::vector<std::pair<std::string, ClientMetrics*>> clients;
     {
-        static std::mutex client_list_mutex;
-        std::lock_guard<std::mutex> list_lock(client_list_mutex);
-
-        client_ids.reserve(client_metrics_.size());
-        for (const auto& [client_id, _] : client_metrics_) {
-            client_ids.push_back(client_id);
+        std::shared_lock<std::shared_mutex> map_lock(client_metrics_mutex_);
+        clients.reserve(client_metrics_.size());
+        for (auto& [client_id, metrics] : client_metrics_) {
+            clients.emplace_back(client_id, &metrics);
         }
     }
 
     // Process each client's metrics using lock-free reads
-    for (const auto& client_id : client_ids) {
-        auto it = client_metrics_.find(client_id);
-        if (it == client_metrics_.end()) {
-            continue;
-        }
-
-        auto& metrics = it->second;
+    for (const auto& [client_id, metrics_ptr] : clients) {
+        auto& metrics = *metrics_ptr;
 
         // LOCK-FREE READ: Use acquire semantics to see all writes before write_index update
         size_t read_idx = metrics.read_index.load(std::memory_order_acquire);
         size_t write_idx = metrics.write_index.load(std::memory_order_acquire);
+        if (write_idx - read_idx > ClientMetrics::BUFFER_SIZE) {
+            read_idx = write_idx - ClientMetrics::BUFFER_SIZE;  // older events were overwritten
+        }
 
         // Process all events between read and write indices
         size_t events_processed = 0;
+        size_t rejected = 0;
         for (size_t i = read_idx; i < write_idx; ++i) {
             const auto& event = metrics.ring_buffer[i % ClientMetrics::BUFFER_SIZE];
-
-            // Send to monitoring (I/O operation outside any critical section)
-            send_to_monitoring(client_id, event.timestamp, event.allowed);
+            rejected += event.allowed ? 0 : 1;
             events_processed++;
         }
+        send_to_monitoring(client_id, rejected);
 
         // Update read index with release semantics to mark events as processed
         if (events_processed > 0) {
@@ -150,70 +168,28 @@ void RateLimiter::flush_metrics() {
     }
 }
 
-void RateLimiter::send_to_monitoring(const std::string& client_id,
-                                   const std::chrono::time_point<std::chrono::steady_clock>& timestamp,
-                                   bool allowed) {
-    // Convert timestamp to milliseconds since epoch for monitoring
-    auto ms_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
-        timestamp.time_since_epoch()).count();
-    
-    // In production, this would send to your monitoring system (Prometheus, DataDog, etc.)
-    std::cout << "[METRICS] client=" << client_id 
-              << " timestamp=" << ms_since_epoch 
-              << " allowed=" << (allowed ? "true" : "false") << std::endl;
-}
-
-MetricValidator::ValidationResult MetricValidator::validate_metric(const Metric& metric) const {
-    ValidationResult result;
-    result.valid = true;
-    
-    if (metric.name.empty()) {
-        result.valid = false;
-        result.error_message = "Metric name cannot be empty";
-        return result;
-    }
-    
-    if (metric.name.length() > 255) {
-        result.valid = false;
-        result.error_message = "Metric name too long (max 255 characters)";
-        return result;
-    }
-    
-    if (std::isnan(metric.value) || std::isinf(metric.value)) {
-        result.valid = false;
-        result.error_message = "Metric value must be a finite number";
-        return result;
-    }
-    
-    return result;
-}
-
-MetricValidator::ValidationResult MetricValidator::validate_batch(const MetricBatch& batch) const {
-    ValidationResult result;
-    result.valid = true;
-    
-    if (batch.empty()) {
-        result.valid = false;
-        result.error_message = "Batch cannot be empty";
-        return result;
+void RateLimiter::send_to_monitoring(const std::string& client_id, size_t rejected) {
+    // Totals are counted exactly in allow_request; this per-client view is
+    // best effort (events that overflow a ring before a flush are lost)
+    if (rejected == 0) {
+        return;
     }
-    
-    if (batch.size() > 1000) {
-        result.valid = false;
-        result.error_message = "Batch size exceeds maximum (1000 metrics)";
-        return result;
-    }
-    
-    for (const auto& metric : batch.metrics) {
-        ValidationResult metric_result = validate_metric(metric);
-        if (!metric_result.valid) {
-            result.valid = false;
-            result.error_message = "Invalid metric: " + metric_result.error_message;
-            return result;
+    static const char* NAME = "metricstream_rate_limit_client_rejections_total";
+    static const char* HELP = "Requests rejected by the rate limiter, per client (capped, then \"other\")";
+    Counter* counter;
+    auto it = client_rejections_.find(client_id);
+    if (it != client_rejections_.end()) {
+        counter = it->second;
+    } else if (client_rejections_.size() < MAX_LABELED_CLIENTS) {
+        counter = &registry_->counter(NAME, HELP, {{"client", client_id}});
+        client_rejections_.emplace(client_id, counter);
+    } else {
+        if (!other_rejections_) {
+            other_rejections_ = &registry_->counter(NAME, HELP, {{"client", "other"}});
         }
+        counter = other_rejections_;
     }
-    
-    return result;
+    counter->inc(rejected);
 }
 
 IngestionService::IngestionService(int port, size_t rate_limit, int num_partitions,
@@ -223,15 +199,16 @@ IngestionService::IngestionService(int port, size_t rate_limit, int num_partitio
     
     server_ = std::make_unique<HttpServer>(port);
     validator_ = std::make_unique<MetricValidator>();
-    rate_limiter_ = std::make_unique<RateLimiter>(rate_limit);
+    rate_limiter_ = std::make_unique<RateLimiter>(rate_limit, &metrics_registry_);
+    series_registry_ = std::make_unique<SeriesRegistry>();
 
     // Initialize the appropriate queue based on mode
     if (queue_mode_ == QueueMode::FILE_BASED) {
         file_queue_ = std::make_unique<PartitionedQueue>("queue", num_partitions);
-        std::cout << "Initialized file-based partitioned queue with " << num_partitions << " partitions\n";
+        MS_LOG_INFO("Initialized file-based partitioned queue with {} partitions", num_partitions);
     } else if (queue_mode_ == QueueMode::KAFKA) {
         kafka_producer_ = std::make_unique<KafkaProducer>(kafka_brokers, "metrics");
-        std::cout << "Initialized Kafka producer: brokers=" << kafka_brokers << ", topic=metrics\n";
+        MS_LOG_INFO("Initialized Kafka producer: brokers={}, topic=metrics", kafka_brokers);
     }
 
     // Start async writer thread
@@ -244,6 +221,14 @@ IngestionService::IngestionService(int port, size_t rate_limit, int num_partitio
         [this](const HttpRequest& req) { return handle_health_check(req); });
     server_->add_handler("/metrics", "GET", 
         [this](const HttpRequest& req) { return handle_metrics_get(req); });
+    server_->add_handler("/internal/metrics", "GET",
+        [this](const HttpRequest& req) { return handle_internal_metrics(req); });
+    server_->add_handler("/internal/traces", "GET",
+        [this](const HttpRequest& req) { return handle_internal_traces(req); });
+    server_->add_handler("/internal/profile", "GET",
+        [this](const HttpRequest& req) { return handle_internal_profile(req); });
+
+    register_self_metrics();
 }
 
 IngestionService::~IngestionService() {
@@ -263,17 +248,18 @@ IngestionService::~IngestionService() {
 
 void IngestionService::start() {
     server_->start();
-    std::cout << "Ingestion service started" << std::endl;
+    MS_LOG_INFO("Ingestion service started");
 }
 
 void IngestionService::stop() {
     if (server_) {
         server_->stop();
     }
-    std::cout << "Ingestion service stopped" << std::endl;
+    MS_LOG_INFO("Ingestion service stopped");
 }
 
 HttpResponse IngestionService::handle_metrics_post(const HttpRequest& request) {
+    const Timestamp received_at = std::chrono::system_clock::now();  // start of end-to-end latency
     HttpResponse response;
     response.set_json_content();
     
@@ -285,7 +271,12 @@ HttpResponse IngestionService::handle_metrics_post(const HttpRequest& request) {
     }
     
     // Check rate limiting
-    if (!rate_limiter_->allow_request(client_id)) {
+    bool allowed;
+    {
+        StageTimer timer(Stage::RATE_LIMIT);
+        allowed = rate_limiter_->allow_request(client_id);
+    }
+    if (!allowed) {
         rate_limited_++;
         response.status_code = 429;
         response.body = create_error_response("Rate limit exceeded");
@@ -293,9 +284,18 @@ HttpResponse IngestionService::handle_metrics_post(const HttpRequest& request) {
     }
     
     try {
-        MetricBatch batch = parse_json_metrics_optimized(request.body);
-        
-        auto validation_result = validator_->validate_batch(batch);
+        MetricBatch batch;
+        {
+            StageTimer timer(Stage::JSON_PARSE);
+            batch = parse_json_metrics_optimized(request.body);
+        }
+        batch.received_at = received_at;
+
+        MetricValidator::ValidationResult validation_result;
+        {
+            StageTimer timer(Stage::VALIDATE);
+            validation_result = validator_->validate_batch(batch);
+        }
         if (!validation_result.valid) {
             validation_errors_++;
             response.status_code = 400;
@@ -303,11 +303,20 @@ HttpResponse IngestionService::handle_metrics_post(const HttpRequest& request) {
             return response;
         }
         
+        // Resolve each metric to its series ID; downstream stages key by ID
+        {
+            TraceSpan span("series_resolve");
+            for (auto& metric : batch.metrics) {
+                metric.series_id = series_registry_->resolve(metric.name, metric.tags, client_id).id;
+            }
+        }
+        
         metrics_received_ += batch.size();
         batches_processed_++;
         
         // For Kafka mode, write synchronously to avoid async thread issues
         // For file mode, use async writer for better throughput
+        StageTimer enqueue_timer(Stage::ENQUEUE);
         if (queue_mode_ == QueueMode::KAFKA) {
             store_metrics_to_queue(batch, client_id);
         } else {
@@ -336,17 +345,200 @@ HttpResponse IngestionService::handle_metrics_get(const HttpRequest& request) {
     HttpResponse response;
     response.set_json_content();
     
+    // Per-tenant cardinality estimates (HyperLogLog)
+    std::string tenants = "{";
+    bool first = true;
+    for (const auto& [tenant, estimate] : series_registry_->tenant_cardinalities()) {
+        if (!first) tenants += ",";
+        append_json_string(tenants, tenant);  // client-supplied
+        tenants += ":" + std::to_string(static_cast<uint64_t>(estimate));
+        first = false;
+    }
+    tenants += "}";
+    
+    // Per-stage latency, merged from every thread's histograms
+    std::string stages = "{";
+    auto snapshots = PipelineStats::instance().snapshot();
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const LatencySnapshot& latency = snapshots[i];
+        char buf[256];
+        std::snprintf(buf, sizeof(buf),
+                      "%s\"%s\":{\"count\":%llu,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,"
+                      "\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}",
+                      i > 0 ? "," : "", stage_name(static_cast<Stage>(i)),
+                      static_cast<unsigned long long>(latency.count()), latency.mean() / 1000.0,
+                      latency.value_at_percentile(50.0) / 1000.0, latency.value_at_percentile(90.0) / 1000.0,
+                      latency.value_at_percentile(99.0) / 1000.0, latency.value_at_percentile(99.9) / 1000.0,
+                      latency.max() / 1000.0);
+        stages += buf;
+    }
+    stages += "}";
+
+    size_t write_queue_batches;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        write_queue_batches = write_queue_.size();
+    }
+    std::string gauges = "{"
+        "\"thread_pool_queue_depth\":" + std::to_string(server_->queue_depth()) + ","
+        "\"active_connections\":" + std::to_string(server_->active_connections()) + ","
+        "\"write_queue_batches\":" + std::to_string(write_queue_batches) + ","
+        "\"write_queue_bytes\":" + std::to_string(write_queue_bytes_.load()) + ","
+        "\"rss_bytes\":" + std::to_string(resident_memory_bytes()) +
+        "}";
+
     // Return service statistics
     response.body = "{"
         "\"metrics_received\":" + std::to_string(metrics_received_) + ","
         "\"batches_processed\":" + std::to_string(batches_processed_) + ","
         "\"validation_errors\":" + std::to_string(validation_errors_) + ","
-        "\"rate_limited_requests\":" + std::to_string(rate_limited_) +
+        "\"rate_limited_requests\":" + std::to_string(rate_limited_) + ","
+        "\"series_count\":" + std::to_string(series_registry_->series_count()) + ","
+        "\"tenant_cardinality\":" + tenants + ","
+        "\"stage_latency\":" + stages + ","
+        "\"gauges\":" + gauges +
         "}";
     
     return response;
 }
 
+namespace {
+
+// Prometheus buckets for the stage latency histograms, in seconds
+const std::vector<double>& stage_latency_bounds() {
+    static const std::vector<double> bounds = {
+        0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001,
+        0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0};
+    return bounds;
+}
+
+// PipelineStats bucket index -> Prometheus bucket holding its upper bound
+const std::vector<size_t>& stage_latency_bucket_map() {
+    static const std::vector<size_t> map = [] {
+        const auto& bounds = stage_latency_bounds();
+        std::vector<size_t> result(latency_buckets::COUNT);
+        for (size_t i = 0; i < result.size(); ++i) {
+            double upper_seconds = static_cast<double>(latency_buckets::upper_bound(i)) / 1e9;
+            result[i] = static_cast<size_t>(
+                std::lower_bound(bounds.begin(), bounds.end(), upper_seconds) - bounds.begin());
+        }
+        return result;
+    }();
+    return map;
+}
+
+} // namespace
+
+void IngestionService::register_self_metrics() {
+    auto& registry = metrics_registry_;
+    registry.counter_function("metricstream_ingest_metrics_received_total", "Metrics accepted on POST /metrics",
+        [this] { return static_cast<double>(metrics_received_.load()); });
+    registry.counter_function("metricstream_ingest_batches_total", "Batches accepted on POST /metrics",
+        [this] { return static_cast<double>(batches_processed_.load()); });
+    registry.counter_function("metricstream_ingest_validation_errors_total", "Batches rejected as invalid",
+        [this] { return static_cast<double>(validation_errors_.load()); });
+    registry.counter_function("metricstream_ingest_rate_limited_total", "Requests rejected by the rate limiter",
+        [this] { return static_cast<double>(rate_limited_.load()); });
+
+    registry.gauge_function("metricstream_series", "Distinct series seen by this ingester",
+        [this] { return static_cast<double>(series_registry_->series_count()); });
+    registry.gauge_function("metricstream_http_queued_connections", "Accepted connections waiting for a worker",
+        [this] { return static_cast<double>(server_->queue_depth()); });
+    registry.gauge_function("metricstream_http_active_connections", "Open client connections",
+        [this] { return static_cast<double>(server_->active_connections()); });
+    registry.gauge_function("metricstream_write_queue_batches", "Batches waiting for the async writer",
+        [this] {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            return static_cast<double>(write_queue_.size());
+        });
+    registry.gauge_function("metricstream_write_queue_bytes", "Approximate memory held by the async write queue",
+        [this] { return static_cast<double>(write_queue_bytes_.load()); });
+    registry.gauge_function("process_resident_memory_bytes", "Resident memory size in bytes",
+        [] { return static_cast<double>(resident_memory_bytes()); });
+    registry.counter_function("metricstream_log_records_dropped_total", "Log records dropped on a full thread buffer",
+        [] { return static_cast<double>(Logger::instance().dropped()); });
+
+    registry.add_collector([](PrometheusWriter& writer) {
+        const std::string name = "metricstream_ingest_stage_duration_seconds";
+        const auto& bounds = stage_latency_bounds();
+        const auto& bucket_map = stage_latency_bucket_map();
+        writer.family(name, "Time spent in each ingest pipeline stage", "histogram");
+
+        auto snapshots = PipelineStats::instance().snapshot();
+        std::vector<uint64_t> counts(bounds.size() + 1);
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            std::fill(counts.begin(), counts.end(), 0);
+            const auto& snapshot_counts = snapshots[s].counts();
+            for (size_t i = 0; i < snapshot_counts.size(); ++i) {
+                counts[bucket_map[i]] += snapshot_counts[i];
+            }
+            std::string labels = std::string("stage=\"") + stage_name(static_cast<Stage>(s)) + "\"";
+            writer.histogram(name, labels, bounds, counts, static_cast<double>(snapshots[s].sum()) / 1e9);
+        }
+    });
+}
+
+HttpResponse IngestionService::handle_internal_metrics(const HttpRequest&) {
+    rate_limiter_->flush_metrics();
+
+    // Rendering reuses this thread's buffer, so a scrape allocates only the body
+    thread_local std::string buffer;
+    metrics_registry_.write_prometheus(buffer);
+
+    HttpResponse response;
+    response.headers["Content-Type"] = "text/plain; version=0.0.4; charset=utf-8";
+    response.body = buffer;
+    return response;
+}
+
+// Recent sampled spans as Chrome trace JSON (open in ui.perfetto.dev)
+HttpResponse IngestionService::handle_internal_traces(const HttpRequest&) {
+    HttpResponse response;
+    response.set_json_content();
+    response.body = Tracer::instance().dump_chrome_json();
+    return response;
+}
+
+// CPU profile of the whole process as folded stacks (flamegraph.pl,
+// speedscope): GET /internal/profile?seconds=10&hz=99. Holds this worker
+// thread for the duration, or until the client disconnects.
+HttpResponse IngestionService::handle_internal_profile(const HttpRequest& request) {
+    constexpr double MAX_PROFILE_SECONDS = 60;
+
+    HttpResponse response;
+    double seconds = 10;
+    int hz = 99;  // off the 100 Hz beat of periodic work
+    try {
+        auto seconds_it = request.query_params.find("seconds");
+        if (seconds_it != request.query_params.end()) seconds = std::stod(seconds_it->second);
+        auto hz_it = request.query_params.find("hz");
+        if (hz_it != request.query_params.end()) hz = std::stoi(hz_it->second);
+        if (!(seconds > 0 && seconds <= MAX_PROFILE_SECONDS)) {
+            throw std::invalid_argument("seconds must be in (0, 60]");
+        }
+    } catch (const std::exception& e) {
+        response.status_code = 400;
+        response.set_json_content();
+        response.body = create_error_response(std::string("Invalid profile request: ") + e.what());
+        return response;
+    }
+
+    try {
+        response.body = SamplingProfiler::instance().profile(
+            std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000)), hz, request.client_connected);
+        response.headers["Content-Type"] = "text/plain; charset=utf-8";
+    } catch (const std::invalid_argument& e) {
+        response.status_code = 400;
+        response.set_json_content();
+        response.body = create_error_response(std::string("Invalid profile request: ") + e.what());
+    } catch (const std::exception& e) {
+        response.status_code = 409;
+        response.set_json_content();
+        response.body = create_error_response(e.what());
+    }
+    return response;
+}
+
 MetricBatch IngestionService::parse_json_metrics_optimized(const std::string& json_body) {
     MetricBatch batch;
     
@@ -374,6 +566,7 @@ MetricBatch IngestionService::parse_json_metrics_optimized(const std::string& js
     // Current metric being parsed
     std::string metric_name, metric_type = "gauge";
     double metric_value = 0.0;
+    std::optional<double> metric_timestamp_ms;  // client-supplied; absent = stamp with the server clock
     Tags metric_tags;
     metric_name.reserve(64);
     metric_type.reserve(16);
@@ -453,6 +646,7 @@ MetricBatch IngestionService::parse_json_metrics_optimized(const std::string& js
                     metric_name.clear();
                     metric_type = "gauge";
                     metric_value = 0.0;
+                    metric_timestamp_ms.reset();
                     metric_tags.clear();
                 } else if (c == ']') {
                     state = ParseState::DONE;
@@ -479,6 +673,8 @@ MetricBatch IngestionService::parse_json_metrics_optimized(const std::string& js
                                 }
                             } else if (current_field == "value") {
                                 metric_value = parse_number();
+                            } else if (current_field == "timestamp") {
+                                metric_timestamp_ms = parse_number();
                             } else if (current_field == "tags" && i < len && json_body[i] == '{') {
                                 i++;
                                 state = ParseState::IN_TAGS_OBJECT;
@@ -493,7 +689,8 @@ MetricBatch IngestionService::parse_json_metrics_optimized(const std::string& js
                         else if (metric_type == "histogram") type = MetricType::HISTOGRAM;
                         else if (metric_type == "summary") type = MetricType::SUMMARY;
                         
-                        batch.add_metric(Metric(std::move(metric_name), metric_value, type, std::move(metric_tags)));
+                        batch.add_metric(Metric(std::move(metric_name), metric_value, type, std::move(metric_tags),
+                                                client_timestamp(metric_timestamp_ms)));
                     }
                     i++;
                     state = ParseState::IN_METRICS_ARRAY;
@@ -537,6 +734,7 @@ MetricBatch IngestionService::parse_json_metrics(const std::string& json_body) {
     try {
         // Simple JSON parsing for metrics array
         // Expected format: {"metrics": [{"name": "cpu_usage", "value": 75.5, "type": "gauge", "tags": {"host": "server1"}}]}
+        // with an optional "timestamp" (Unix milliseconds) per metric
         
         size_t metrics_pos = json_body.find("\"metrics\"");
         if (metrics_pos == std::string::npos) {
@@ -591,8 +789,14 @@ Metric IngestionService::parse_single_metric(const std::string& metric_json) {
     
     // Extract tags (simple key-value parsing)
     Tags tags = extract_tags(metric_json);
-    
-    return Metric(name, value, type, tags);
+
+    // Client timestamp (Unix milliseconds), e.g. from an agent sending buffered samples late
+    std::optional<double> timestamp_ms;
+    if (metric_json.find("\"timestamp\"") != std::string::npos) {
+        timestamp_ms = extract_numeric_field(metric_json, "timestamp");
+    }
+
+    return Metric(name, value, type, tags, client_timestamp(timestamp_ms));
 }
 
 std::string IngestionService::extract_string_field(const std::string& json, const std::string& field) {
@@ -679,38 +883,13 @@ Tags IngestionService::extract_tags(const std::string& json) {
 }
 
 std::string IngestionService::serialize_metrics_batch_to_json(const MetricBatch& batch) {
-    // Simple JSON serialization for learning - in production you'd use a proper JSON library
-    std::string json = R"(
-{
-  "batch_timestamp": ")" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count()) + R"(",
-  "metrics": [)";
-
-    for (size_t i = 0; i < batch.metrics.size(); ++i) {
-        const auto& metric = batch.metrics[i];
-        json += "\n    {\n";
-        json += "      \"name\": \"" + metric.name + "\",\n";
-        json += "      \"value\": " + std::to_string(metric.value) + ",\n";
-
-        std::string type_str;
-        switch (metric.type) {
-            case MetricType::COUNTER: type_str = "counter"; break;
-            case MetricType::GAUGE: type_str = "gauge"; break;
-            case MetricType::HISTOGRAM: type_str = "histogram"; break;
-            case MetricType::SUMMARY: type_str = "summary"; break;
-        }
-        json += "      \"type\": \"" + type_str + "\"\n    }";
-
-        if (i < batch.metrics.size() - 1) {
-            json += ",";
-        }
-    }
-
-    json += "\n  ]\n}\n";
-    return json;
+    // Series-keyed wire format shared with consumers (see batch_codec.h)
+    return encode_metrics_batch(batch);
 }
 
 void IngestionService::store_metrics_to_queue(const MetricBatch& batch, const std::string& client_id) {
+StageTimer timer(Stage::QUEUE_WRITE);
+
 // Serialize entire batch as JSON message
 std::string message = serialize_metrics_batch_to_json(batch);
 
@@ -718,10 +897,8 @@ try {
     if (queue_mode_ == QueueMode::FILE_BASED) {
         // Write to partitioned file queue
         auto [partition, offset] = file_queue_->produce(client_id, message);
-    std::cout << "Queued metrics batch (file): partition=" << partition
-              << ", offset=" << offset
-              << ", client=" << client_id
-          << ", metrics=" << batch.size() << "\n";
+    MS_LOG_DEBUG("Queued metrics batch (file): partition={}, offset={}, client={}, metrics={}",
+                 partition, offset, client_id, batch.size());
 
 } else if (queue_mode_ == QueueMode::KAFKA) {
     // Write to Kafka
@@ -729,18 +906,17 @@ try {
     if (err != RdKafka::ERR_NO_ERROR) {
         throw std::runtime_error("Kafka produce failed: " + RdKafka::err2str(err));
     }
-std::cout << "Queued metrics batch (kafka): client=" << client_id
-          << ", metrics=" << batch.size() << "\n";
+MS_LOG_DEBUG("Queued metrics batch (kafka): client={}, metrics={}", client_id, batch.size());
 }
 
 } catch (const std::exception& e) {
-std::cerr << "Failed to write metrics batch to queue: " << e.what() << "\n";
+MS_LOG_ERROR("Failed to write metrics batch to queue: {}", e.what());
 // In production, you might want to retry or write to a fallback location
 }
 }
 
 std::string IngestionService::create_error_response(const std::string& message) {
-    return "{\"error\":\"" + message + "\"}";
+    return "{\"error\":" + json_string(message) + "}";
 }
 
 std::string IngestionService::create_success_response(size_t metrics_count) {
@@ -748,13 +924,26 @@ std::string IngestionService::create_success_response(size_t metrics_count) {
 }
 
 void IngestionService::queue_metrics_for_async_write(const MetricBatch& batch, const std::string& client_id) {
+    write_queue_bytes_ += approximate_batch_bytes(batch);
     {
         std::lock_guard<std::mutex> lock(queue_mutex_);
-        write_queue_.push({batch, client_id});
+        write_queue_.push(PendingWrite{batch, client_id, current_trace_id,
+                                       current_trace_id != 0 ? trace_clock_ns() : 0});
     }
     queue_cv_.notify_one(); // Wake up writer thread
 }
 
+size_t IngestionService::approximate_batch_bytes(const MetricBatch& batch) {
+    size_t bytes = sizeof(MetricBatch) + batch.source_id.size();
+    for (const auto& metric : batch.metrics) {
+        bytes += sizeof(Metric) + metric.name.size();
+        for (const auto& [key, value] : metric.tags) {
+            bytes += key.size() + value.size();
+        }
+    }
+    return bytes;
+}
+
 void IngestionService::async_writer_loop() {
     while (writer_running_) {
         std::unique_lock<std::mutex> lock(queue_mutex_);
@@ -766,14 +955,21 @@ void IngestionService::async_writer_loop() {
         
         // Process all pending batches
         while (!write_queue_.empty() && writer_running_) {
-            auto [batch, client_id] = write_queue_.front();
+            PendingWrite pending = std::move(write_queue_.front());
             write_queue_.pop();
 
             // Release lock before expensive I/O operation
             lock.unlock();
 
+            // The request's trace continues on this thread
+            TraceScope trace(pending.trace_id);
+            if (pending.trace_id != 0) {
+                Tracer::instance().record(pending.trace_id, "writer_queue_wait", pending.enqueued_ns, trace_clock_ns());
+            }
+
             // Write batch to queue (file-based or Kafka)
-            store_metrics_to_queue(batch, client_id);
+            store_metrics_to_queue(pending.batch, pending.client_id);
+            write_queue_bytes_ -= approximate_batch_bytes(pending.batch);
 
             // Reacquire lock for next iteration
             lock.lock();
@@ -0,0 +1,57 @@
+#include "io_rate_limiter.h"
+#include <algorithm>
+
+namespace metricstream {
+
+IoRateLimiter::IoRateLimiter(uint64_t bytes_per_second)
+    : rate_(bytes_per_second), tokens_(static_cast<double>(bytes_per_second)), last_refill_(Clock::now()) {}
+
+void IoRateLimiter::refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    tokens_ = std::min(static_cast<double>(rate_), tokens_ + elapsed * static_cast<double>(rate_));
+    last_refill_ = now;
+}
+
+bool IoRateLimiter::acquire(uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (rate_ == 0) {
+        return !cancelled_;
+    }
+
+    Clock::time_point start = Clock::now();
+    double needed = std::min(static_cast<double>(bytes), static_cast<double>(rate_));
+    while (true) {
+        if (cancelled_) {
+            return false;
+        }
+        Clock::time_point now = Clock::now();
+        refill(now);
+        if (tokens_ >= needed) {
+            tokens_ -= static_cast<double>(bytes);
+            throttled_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+            return true;
+        }
+        double wait_s = (needed - tokens_) / static_cast<double>(rate_);
+        cv_.wait_for(lock, std::chrono::duration<double>(wait_s));
+    }
+}
+
+void IoRateLimiter::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    cv_.notify_all();
+}
+
+uint64_t IoRateLimiter::bytes_per_second() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rate_;
+}
+
+uint64_t IoRateLimiter::throttled_ns() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return throttled_ns_;
+}
+
+} // namespace metricstream
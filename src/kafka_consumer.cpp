@@ -1,5 +1,5 @@
 #include "kafka_consumer.h"
-#include <iostream>
+#include "logging.h"
 #include <chrono>
 #include <thread>
 
@@ -40,15 +40,14 @@ KafkaConsumer::KafkaConsumer(const std::string& brokers, const std::string& topi
 
     delete conf;
 
-    std::cout << "Kafka consumer initialized: brokers=" << brokers
-              << ", topic=" << topic << ", group=" << group_id << "\n";
+    MS_LOG_INFO("Kafka consumer initialized: brokers={}, topic={}, group={}", brokers, topic, group_id);
 }
 
 KafkaConsumer::~KafkaConsumer() {
     stop();
 }
 
-void KafkaConsumer::start(std::function<void(const std::string& key, const std::string& message)> message_handler) {
+void KafkaConsumer::start(MessageHandler message_handler) {
     running_ = true;
 
     // Subscribe to topic
@@ -58,7 +57,7 @@ void KafkaConsumer::start(std::function<void(const std::string& key, const std::
         throw std::runtime_error("Failed to subscribe to topic: " + RdKafka::err2str(err));
     }
 
-    std::cout << "Subscribed to topic: " << topic_ << "\n";
+    MS_LOG_INFO("Subscribed to topic: {}", topic_);
 
     // Main consumption loop
     while (running_) {
@@ -79,7 +78,7 @@ void KafkaConsumer::start(std::function<void(const std::string& key, const std::
                     }
 
                     message_count_++;
-                    message_handler(key, payload);
+                    message_handler(key, payload, msg->partition());
                 }
                 break;
 
@@ -92,7 +91,7 @@ void KafkaConsumer::start(std::function<void(const std::string& key, const std::
                 break;
 
             default:
-                std::cerr << "Consume error: " << msg->errstr() << "\n";
+                MS_LOG_ERROR("Consume error: {}", msg->errstr());
                 break;
         }
 
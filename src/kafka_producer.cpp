@@ -1,12 +1,12 @@
 #include "kafka_producer.h"
-#include <iostream>
+#include "logging.h"
 #include <chrono>
 #include <thread>
 
 KafkaProducer::KafkaProducer(const std::string& brokers, const std::string& topic, size_t num_partitions)
     : brokers_(brokers), topic_(topic), num_partitions_(num_partitions) {
 
-    std::cout << "Initializing " << num_partitions << " parallel Kafka producers for maximum throughput...\n";
+    MS_LOG_INFO("Initializing {} parallel Kafka producers for maximum throughput", num_partitions);
 
     // Reserve space to avoid reallocations
     partition_producers_.reserve(num_partitions);
@@ -65,12 +65,12 @@ KafkaProducer::KafkaProducer(const std::string& brokers, const std::string& topi
         partition_producers_.push_back(std::move(pp));
     }
 
-    std::cout << "Kafka producer pool initialized: " << num_partitions << " producers, "
-              << "brokers=" << brokers << ", topic=" << topic << "\n";
+    MS_LOG_INFO("Kafka producer pool initialized: {} producers, brokers={}, topic={}", num_partitions, brokers,
+                topic);
 }
 
 KafkaProducer::~KafkaProducer() {
-    std::cout << "Shutting down Kafka producer pool (" << num_partitions_ << " producers)...\n";
+    MS_LOG_INFO("Shutting down Kafka producer pool ({} producers)", num_partitions_);
 
     // Stop all background polling threads
     for (auto& pp : partition_producers_) {
@@ -81,7 +81,7 @@ KafkaProducer::~KafkaProducer() {
     }
 
     // Flush all producers
-    std::cout << "Flushing all producers (may take a few seconds)...\n";
+    MS_LOG_INFO("Flushing all producers (may take a few seconds)");
     flush(std::chrono::milliseconds(10000));  // 10 seconds
 
     // Final poll to drain callbacks
@@ -95,14 +95,12 @@ KafkaProducer::~KafkaProducer() {
             }
 
             if (pp->producer->outq_len() > 0) {
-                std::cerr << "Warning: Producer has " << pp->producer->outq_len()
-                          << " messages still in queue at shutdown\n";
+                MS_LOG_WARN("Producer has {} messages still in queue at shutdown", pp->producer->outq_len());
             }
         }
     }
 
-    std::cout << "Kafka producer pool shutdown complete. Total sent: "
-              << total_message_count_ << " messages.\n";
+    MS_LOG_INFO("Kafka producer pool shutdown complete. Total sent: {} messages", total_message_count_.load());
 }
 
 size_t KafkaProducer::select_partition(const std::string& key) const {
@@ -166,10 +164,10 @@ RdKafka::ErrorCode KafkaProducer::produce(const std::string& key, const std::str
             pp.message_count++;
             total_message_count_++;
         } else {
-            std::cerr << "Failed to produce message after retry: " << RdKafka::err2str(err) << "\n";
+            MS_LOG_ERROR("Failed to produce message after retry: {}", RdKafka::err2str(err));
         }
     } else {
-        std::cerr << "Failed to produce message: " << RdKafka::err2str(err) << "\n";
+        MS_LOG_ERROR("Failed to produce message: {}", RdKafka::err2str(err));
     }
 
     return err;
@@ -208,7 +206,7 @@ RdKafka::ErrorCode KafkaProducer::flush(std::chrono::milliseconds timeout) {
 
         RdKafka::ErrorCode err = pp->producer->flush(timeout.count());
         if (err != RdKafka::ERR_NO_ERROR) {
-            std::cerr << "Failed to flush producer: " << RdKafka::err2str(err) << "\n";
+            MS_LOG_ERROR("Failed to flush producer: {}", RdKafka::err2str(err));
             final_err = err;  // Track last error
         }
     }
@@ -0,0 +1,397 @@
+#include "logging.h"
+#include "common.h"
+#include <cerrno>
+#include <cstddef>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace metricstream {
+
+namespace {
+
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(20);
+
+size_t align8(size_t size) {
+    return (size + 7) & ~size_t{7};
+}
+
+const char* base_name(const char* path) {
+    const char* slash = std::strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// One decoded record, formatted at drain time
+struct PendingLine {
+    int64_t timestamp_ns;
+    size_t thread_index;
+    LogLevel level;
+    const LogSite* site;
+    uint64_t suppressed;
+    std::string message;
+};
+
+// Replaces each "{}" in `format` with the next encoded argument; arguments
+// left over are appended, so a mismatched format still shows every value
+void format_message(std::string& out, const char* format, const char* args, uint16_t arg_count) {
+    using log_detail::ArgType;
+    auto append_arg = [&]() {
+        ArgType type = static_cast<ArgType>(*args++);
+        if (type == ArgType::STRING) {
+            uint32_t length;
+            std::memcpy(&length, args, sizeof(length));
+            out.append(args + sizeof(length), length);
+            args += sizeof(length) + length;
+            return;
+        }
+        char buf[32];
+        int n = 0;
+        uint64_t bits;
+        std::memcpy(&bits, args, sizeof(bits));
+        args += sizeof(bits);
+        switch (type) {
+        case ArgType::INT:
+            n = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(bits));
+            break;
+        case ArgType::UINT:
+            n = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(bits));
+            break;
+        case ArgType::DOUBLE: {
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            n = std::snprintf(buf, sizeof(buf), "%g", value);
+            break;
+        }
+        case ArgType::BOOL:
+            n = std::snprintf(buf, sizeof(buf), "%s", bits ? "true" : "false");
+            break;
+        case ArgType::CHAR:
+            buf[0] = static_cast<char>(bits);
+            n = 1;
+            break;
+        case ArgType::POINTER:
+            n = std::snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(bits));
+            break;
+        case ArgType::STRING:
+            break;
+        }
+        out.append(buf, static_cast<size_t>(n));
+    };
+
+    uint16_t used = 0;
+    for (const char* p = format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}' && used < arg_count) {
+            append_arg();
+            ++used;
+            ++p;
+        } else {
+            out += *p;
+        }
+    }
+    for (; used < arg_count; ++used) {
+        out += ' ';
+        append_arg();
+    }
+}
+
+// "2026-01-02T03:04:05.678901Z"
+void append_timestamp(std::string& out, int64_t timestamp_ns) {
+    time_t seconds = static_cast<time_t>(timestamp_ns / 1000000000);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char buf[40];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &utc);
+    n += static_cast<size_t>(std::snprintf(buf + n, sizeof(buf) - n, ".%06dZ",
+                                           static_cast<int>(timestamp_ns % 1000000000 / 1000)));
+    out.append(buf, n);
+}
+
+} // namespace
+
+const char* log_level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::DEBUG: return "debug";
+    case LogLevel::INFO: return "info";
+    case LogLevel::WARN: return "warn";
+    case LogLevel::ERROR: return "error";
+    case LogLevel::OFF: return "off";
+    }
+    return "?";
+}
+
+// Gives the calling thread's ring back when the thread exits; its pending
+// records are still drained
+struct LogRingHandle {
+    Logger::ThreadRing* ring = nullptr;
+
+    ~LogRingHandle() {
+        if (ring) {
+            Logger::instance().release_ring(ring);
+        }
+    }
+};
+
+Logger& Logger::instance() {
+    // Never destroyed: threads may still log during static destruction
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() {
+    flusher_ = std::thread(&Logger::flusher_loop, this);
+    std::atexit([] { Logger::instance().shutdown(); });
+}
+
+void Logger::configure_from_env() {
+    if (const char* level = std::getenv("METRICSTREAM_LOG_LEVEL")) {
+        std::string value = level;
+        LogLevel parsed = LogLevel::OFF;
+        bool found = false;
+        for (LogLevel candidate : {LogLevel::DEBUG, LogLevel::INFO, LogLevel::WARN, LogLevel::ERROR, LogLevel::OFF}) {
+            if (value == log_level_name(candidate)) {
+                parsed = candidate;
+                found = true;
+            }
+        }
+        if (!found) {
+            throw std::invalid_argument("METRICSTREAM_LOG_LEVEL must be debug, info, warn, error or off");
+        }
+        set_level(parsed);
+    }
+    if (const char* format = std::getenv("METRICSTREAM_LOG_FORMAT")) {
+        std::string value = format;
+        if (value != "text" && value != "json") {
+            throw std::invalid_argument("METRICSTREAM_LOG_FORMAT must be text or json");
+        }
+        set_json(value == "json");
+    }
+    if (const char* rate = std::getenv("METRICSTREAM_LOG_RATE_LIMIT")) {
+        char* end = nullptr;
+        unsigned long value = std::strtoul(rate, &end, 10);
+        if (end == rate || *end != '\0') {
+            throw std::invalid_argument("METRICSTREAM_LOG_RATE_LIMIT must be a non-negative integer");
+        }
+        set_site_rate_limit(static_cast<uint32_t>(value));
+    }
+}
+
+int64_t Logger::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool Logger::admit(LogSite& site, int64_t timestamp_ns, uint64_t& suppressed) {
+    uint32_t limit = site.max_per_second ? site.max_per_second : site_rate_limit_.load(std::memory_order_relaxed);
+    if (limit == 0) {
+        suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    int64_t window = timestamp_ns / 1000000000;
+    int64_t current = site.window.load(std::memory_order_relaxed);
+    if (current != window && site.window.compare_exchange_strong(current, window, std::memory_order_relaxed)) {
+        site.window_count.store(0, std::memory_order_relaxed);
+    }
+    if (site.window_count.fetch_add(1, std::memory_order_relaxed) >= limit) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+Logger::ThreadRing* Logger::claim_ring() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (auto& ring : rings_) {
+        if (!ring->in_use) {
+            ring->in_use = true;
+            return ring.get();
+        }
+    }
+    rings_.push_back(std::make_unique<ThreadRing>());
+    rings_.back()->thread_index = rings_.size();
+    rings_.back()->in_use = true;
+    return rings_.back().get();
+}
+
+void Logger::release_ring(ThreadRing* ring) {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    ring->in_use = false;
+}
+
+namespace {
+thread_local LogRingHandle ring_handle;
+} // namespace
+
+char* Logger::reserve(size_t size) {
+    if (!ring_handle.ring) {
+        ring_handle.ring = claim_ring();
+    }
+    ThreadRing& ring = *ring_handle.ring;
+
+    size_t needed = align8(size);
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    size_t offset = static_cast<size_t>(head % RING_BYTES);
+    size_t to_end = RING_BYTES - offset;
+    size_t padding = needed > to_end ? to_end : 0;
+    uint64_t tail = ring.tail.load(std::memory_order_acquire);
+    if (needed > RING_BYTES / 2 || RING_BYTES - (head - tail) < padding + needed) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        dropped_total_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    if (padding) {
+        // Only the leading size and flags of a padding record are read
+        uint32_t pad_size = static_cast<uint32_t>(padding);
+        uint8_t flags = PADDING;
+        std::memcpy(ring.data.get() + offset + offsetof(RecordHeader, size), &pad_size, sizeof(pad_size));
+        std::memcpy(ring.data.get() + offset + offsetof(RecordHeader, flags), &flags, sizeof(flags));
+        ring.head.store(head + padding, std::memory_order_relaxed);
+        offset = 0;
+    }
+    return ring.data.get() + offset;
+}
+
+void Logger::commit(size_t size) {
+    ThreadRing& ring = *ring_handle.ring;
+    uint64_t head = ring.head.load(std::memory_order_relaxed) + align8(size);
+    ring.head.store(head, std::memory_order_release);
+    if (synchronous_.load(std::memory_order_relaxed)) {
+        flush();
+    } else if (head - ring.tail.load(std::memory_order_relaxed) > RING_BYTES / 2 &&
+               !wake_pending_.exchange(true, std::memory_order_relaxed)) {
+        // Bursts drain early instead of waiting out the interval
+        flusher_cv_.notify_one();
+    }
+}
+
+void Logger::flush() {
+    drain();
+}
+
+void Logger::flusher_loop() {
+    std::unique_lock<std::mutex> lock(flusher_mutex_);
+    while (!stopping_) {
+        flusher_cv_.wait_for(lock, FLUSH_INTERVAL);
+        wake_pending_.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    flusher_cv_.notify_all();
+    flusher_.join();
+    synchronous_.store(true, std::memory_order_relaxed);
+    drain();
+}
+
+void Logger::drain() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+
+    std::vector<ThreadRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (auto& ring : rings_) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    std::vector<PendingLine> lines;
+    uint64_t dropped = 0;
+    for (ThreadRing* ring : rings) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        while (tail < head) {
+            const char* record = ring->data.get() + tail % RING_BYTES;
+            RecordHeader header;
+            std::memcpy(&header.size, record + offsetof(RecordHeader, size), sizeof(header.size));
+            std::memcpy(&header.flags, record + offsetof(RecordHeader, flags), sizeof(header.flags));
+            if (header.flags & PADDING) {
+                tail += header.size;
+                continue;
+            }
+            std::memcpy(&header, record, sizeof(header));
+            PendingLine line{header.timestamp_ns, ring->thread_index, header.level, header.site,
+                             header.suppressed, {}};
+            format_message(line.message, header.format, record + sizeof(header), header.arg_count);
+            lines.push_back(std::move(line));
+            tail += align8(header.size);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    if (lines.empty() && dropped == 0) {
+        return;
+    }
+
+    std::stable_sort(lines.begin(), lines.end(),
+                     [](const PendingLine& a, const PendingLine& b) { return a.timestamp_ns < b.timestamp_ns; });
+    if (dropped) {
+        static LogSite drop_site{__FILE__, __LINE__, LogLevel::WARN, 0};
+        lines.push_back(PendingLine{now_ns(), 0, LogLevel::WARN, &drop_site, 0,
+                                    "Dropped " + std::to_string(dropped) + " log records (thread buffer full)"});
+    }
+
+    bool json = json_.load(std::memory_order_relaxed);
+    std::string& out = drain_buffer_;
+    out.clear();
+    char buf[64];
+    for (const PendingLine& line : lines) {
+        const char* file = base_name(line.site->file);
+        if (json) {
+            out += "{\"ts\":\"";
+            append_timestamp(out, line.timestamp_ns);
+            std::snprintf(buf, sizeof(buf), "\",\"level\":\"%s\",\"thread\":%zu,\"source\":\"",
+                          log_level_name(line.level), line.thread_index);
+            out += buf;
+            out += file;
+            std::snprintf(buf, sizeof(buf), ":%d\",\"msg\":", line.site->line);
+            out += buf;
+            append_json_string(out, line.message);
+            if (line.suppressed) {
+                std::snprintf(buf, sizeof(buf), ",\"suppressed\":%llu",
+                              static_cast<unsigned long long>(line.suppressed));
+                out += buf;
+            }
+            out += "}\n";
+        } else {
+            append_timestamp(out, line.timestamp_ns);
+            std::snprintf(buf, sizeof(buf), " %-5s [t%zu] ", log_level_name(line.level), line.thread_index);
+            out += buf;
+            out += file;
+            std::snprintf(buf, sizeof(buf), ":%d ", line.site->line);
+            out += buf;
+            out += line.message;
+            if (line.suppressed) {
+                std::snprintf(buf, sizeof(buf), " [%llu similar suppressed]",
+                              static_cast<unsigned long long>(line.suppressed));
+                out += buf;
+            }
+            out += '\n';
+        }
+    }
+
+    int fd = output_fd_.load(std::memory_order_relaxed);
+    const char* data = out.data();
+    size_t remaining = out.size();
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, data, remaining);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        data += n;
+        remaining -= static_cast<size_t>(n);
+    }
+}
+
+} // namespace metricstream
@@ -1,9 +1,12 @@
 #include "ingestion_service.h"
 #include "partitioned_queue.h"
+#include "tracing.h"
+#include "logging.h"
 #include <iostream>
 #include <signal.h>
 #include <thread>
 #include <chrono>
+#include <cstdlib>
 
 std::unique_ptr<metricstream::IngestionService> service;
 
@@ -52,6 +55,20 @@ int main(int argc, char* argv[]) {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
+    try {
+        metricstream::Logger::instance().configure_from_env();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Fraction of requests traced (GET /internal/traces); 0 disables tracing
+    double trace_sample_rate = 0.001;
+    if (const char* rate = std::getenv("METRICSTREAM_TRACE_SAMPLE_RATE")) {
+        trace_sample_rate = std::atof(rate);
+    }
+    metricstream::Tracer::instance().set_sample_rate(trace_sample_rate);
+
     service = std::make_unique<metricstream::IngestionService>(port, 10000, num_partitions, queue_mode, kafka_brokers);
     service->start();
     
@@ -59,14 +76,9 @@ int main(int argc, char* argv[]) {
     while (true) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
-        // TODO(human): Add performance monitoring here
-        // Consider tracking and logging:
-        // - Active connection count
-        // - Request processing time distribution
-        // - Queue depths and memory usage
-        // - Failed vs successful request ratios
-        // This will help identify bottlenecks at high load
-        
+        // Per-stage latency histograms, queue depths, active connections and
+        // RSS are served on GET /metrics (see PipelineStats)
+
         // Phase 3 Analysis: JSON parsing optimization needed
         // Current bottleneck: Multiple string::find() calls and substr() allocations
         // Target: Single-pass parser with string views and pre-allocated containers
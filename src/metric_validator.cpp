@@ -0,0 +1,85 @@
+#include "metric_validator.h"
+#include "batch_codec.h"
+#include <algorithm>
+#include <cmath>
+
+namespace metricstream {
+
+MetricValidator::ValidationResult MetricValidator::validate_metric(const Metric& metric) const {
+    ValidationResult result;
+    result.valid = true;
+    
+    if (metric.name.empty()) {
+        result.valid = false;
+        result.error_message = "Metric name cannot be empty";
+        return result;
+    }
+    
+    if (metric.name.length() > 255) {
+        result.valid = false;
+        result.error_message = "Metric name too long (max 255 characters)";
+        return result;
+    }
+    
+    if (std::isnan(metric.value) || std::isinf(metric.value)) {
+        result.valid = false;
+        result.error_message = "Metric value must be a finite number";
+        return result;
+    }
+
+    int64_t timestamp_ms = to_unix_millis(metric.timestamp);
+    if (timestamp_ms < MIN_TIMESTAMP_MS) {
+        result.valid = false;
+        result.error_message = "Metric timestamp must be Unix milliseconds after 2001-09-09";
+        return result;
+    }
+    if (timestamp_ms > to_unix_millis(std::chrono::system_clock::now()) + MAX_FUTURE_SKEW_MS) {
+        result.valid = false;
+        result.error_message = "Metric timestamp is more than " + std::to_string(MAX_FUTURE_SKEW_MS / 1000) +
+                               "s ahead of the server clock";
+        return result;
+    }
+    
+    return result;
+}
+
+MetricValidator::ValidationResult MetricValidator::validate_batch(const MetricBatch& batch) const {
+    ValidationResult result;
+    result.valid = true;
+    
+    if (batch.empty()) {
+        result.valid = false;
+        result.error_message = "Batch cannot be empty";
+        return result;
+    }
+    
+    if (batch.size() > 1000) {
+        result.valid = false;
+        result.error_message = "Batch size exceeds maximum (1000 metrics)";
+        return result;
+    }
+    
+    for (const auto& metric : batch.metrics) {
+        ValidationResult metric_result = validate_metric(metric);
+        if (!metric_result.valid) {
+            result.valid = false;
+            result.error_message = "Invalid metric: " + metric_result.error_message;
+            return result;
+        }
+    }
+    
+    return result;
+}
+
+Timestamp client_timestamp(std::optional<double> timestamp_ms) {
+    if (!timestamp_ms) {
+        return std::chrono::system_clock::now();
+    }
+    if (!(*timestamp_ms > 0)) {
+        return Timestamp();  // the epoch, below MIN_TIMESTAMP_MS
+    }
+    constexpr double MAX_TIMESTAMP_MS = 9e12;  // year 2255: fits the nanosecond clock, fails as future
+    return Timestamp(std::chrono::milliseconds(static_cast<int64_t>(std::min(*timestamp_ms, MAX_TIMESTAMP_MS))));
+}
+
+} // namespace metricstream
@@ -0,0 +1,322 @@
+#include "metrics_registry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+bool valid_name(const std::string& name, bool allow_colon) {
+    if (name.empty()) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (allow_colon && c == ':') ||
+                  (i > 0 && c >= '0' && c <= '9');
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Shortest of %.15g / %.17g that round-trips, so 0.001 stays "0.001"
+int format_double(char* buf, size_t size, double value) {
+    int n = std::snprintf(buf, size, "%.15g", value);
+    if (std::strtod(buf, nullptr) != value) {
+        n = std::snprintf(buf, size, "%.17g", value);
+    }
+    return n;
+}
+
+void append_double(std::string& out, double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+    } else if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+    } else {
+        char buf[32];
+        int n = format_double(buf, sizeof(buf), value);
+        out.append(buf, static_cast<size_t>(n));
+    }
+}
+
+void append_uint(std::string& out, uint64_t value) {
+    char buf[24];
+    int n = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(value));
+    out.append(buf, static_cast<size_t>(n));
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// Gauge / Histogram
+// ----------------------------------------------------------------------------
+
+uint64_t Gauge::to_bits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double Gauge::from_bits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void Gauge::add(double delta) {
+    uint64_t expected = bits_.load(std::memory_order_relaxed);
+    while (!bits_.compare_exchange_weak(expected, to_bits(from_bits(expected) + delta), std::memory_order_relaxed)) {
+    }
+}
+
+Histogram::Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)) {
+    if (!std::is_sorted(bounds_.begin(), bounds_.end()) ||
+        std::adjacent_find(bounds_.begin(), bounds_.end()) != bounds_.end()) {
+        throw std::invalid_argument("Histogram bounds must be strictly increasing");
+    }
+    counts_ = std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1);
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    size_t bucket = static_cast<size_t>(std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin());
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_.add(value);
+}
+
+std::vector<uint64_t> Histogram::bucket_counts() const {
+    std::vector<uint64_t> counts(bounds_.size() + 1);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+double Histogram::sum() const {
+    return sum_.value();
+}
+
+// ----------------------------------------------------------------------------
+// PrometheusWriter
+// ----------------------------------------------------------------------------
+
+void PrometheusWriter::family(const std::string& name, const std::string& help, const char* type) {
+    out_ += "# HELP ";
+    out_ += name;
+    out_ += ' ';
+    for (char c : help) {
+        if (c == '\\') out_ += "\\\\";
+        else if (c == '\n') out_ += "\\n";
+        else out_ += c;
+    }
+    out_ += "\n# TYPE ";
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += '\n';
+}
+
+void PrometheusWriter::append_series(const std::string& name, const std::string& labels, const char* extra_label,
+                                     const char* extra_value) {
+    out_ += name;
+    if (!labels.empty() || extra_label) {
+        out_ += '{';
+        out_ += labels;
+        if (extra_label) {
+            if (!labels.empty()) out_ += ',';
+            out_ += extra_label;
+            out_ += "=\"";
+            out_ += extra_value;
+            out_ += '"';
+        }
+        out_ += '}';
+    }
+    out_ += ' ';
+}
+
+void PrometheusWriter::sample(const std::string& name, const std::string& labels, double value) {
+    append_series(name, labels);
+    append_double(out_, value);
+    out_ += '\n';
+}
+
+void PrometheusWriter::sample(const std::string& name, const std::string& labels, uint64_t value) {
+    append_series(name, labels);
+    append_uint(out_, value);
+    out_ += '\n';
+}
+
+void PrometheusWriter::histogram(const std::string& name, const std::string& labels, const std::vector<double>& bounds,
+                                 const std::vector<uint64_t>& counts, double sum) {
+    const std::string bucket_name = name + "_bucket";
+    uint64_t cumulative = 0;
+    char le[32];
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        cumulative += counts[i];
+        format_double(le, sizeof(le), bounds[i]);
+        append_series(bucket_name, labels, "le", le);
+        append_uint(out_, cumulative);
+        out_ += '\n';
+    }
+    // Derived from the buckets so _count always equals the +Inf bucket
+    cumulative += counts.size() > bounds.size() ? counts[bounds.size()] : 0;
+    append_series(bucket_name, labels, "le", "+Inf");
+    append_uint(out_, cumulative);
+    out_ += '\n';
+    sample(name + "_sum", labels, sum);
+    sample(name + "_count", labels, cumulative);
+}
+
+std::string PrometheusWriter::render_labels(const MetricLabels& labels) {
+    std::string out;
+    for (const auto& [key, value] : labels) {
+        if (!out.empty()) out += ',';
+        out += key;
+        out += "=\"";
+        for (char c : value) {
+            if (c == '\\') out += "\\\\";
+            else if (c == '"') out += "\\\"";
+            else if (c == '\n') out += "\\n";
+            else out += c;
+        }
+        out += '"';
+    }
+    return out;
+}
+
+// ----------------------------------------------------------------------------
+// MetricsRegistry
+// ----------------------------------------------------------------------------
+
+MetricsRegistry::Child& MetricsRegistry::child(const std::string& name, const std::string& help, Type type,
+                                               const MetricLabels& labels) {
+    if (!valid_name(name, true)) {
+        throw std::invalid_argument("Invalid metric name '" + name + "'");
+    }
+    for (const auto& label : labels) {
+        if (!valid_name(label.first, false) || label.first.rfind("__", 0) == 0 || label.first == "le") {
+            throw std::invalid_argument("Invalid label name '" + label.first + "' on " + name);
+        }
+    }
+
+    Family* family;
+    auto it = families_by_name_.find(name);
+    if (it == families_by_name_.end()) {
+        families_.push_back(std::make_unique<Family>(Family{name, help, type, {}, {}}));
+        family = families_.back().get();
+        families_by_name_.emplace(name, family);
+    } else {
+        family = it->second;
+        if (family->type != type) {
+            throw std::invalid_argument("Metric " + name + " already registered with a different type");
+        }
+    }
+
+    std::string rendered = PrometheusWriter::render_labels(labels);
+    auto existing = family->children_by_labels.find(rendered);
+    if (existing != family->children_by_labels.end()) {
+        return *existing->second;
+    }
+    family->children.push_back(std::make_unique<Child>());
+    Child& c = *family->children.back();
+    c.labels = rendered;
+    family->children_by_labels.emplace(std::move(rendered), &c);
+    return c;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Child& c = child(name, help, Type::COUNTER, labels);
+    if (c.sample) {
+        throw std::invalid_argument("Metric " + name + " is already a sampled counter");
+    }
+    if (!c.counter) {
+        c.counter = std::make_unique<Counter>();
+    }
+    return *c.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Child& c = child(name, help, Type::GAUGE, labels);
+    if (c.sample) {
+        throw std::invalid_argument("Metric " + name + " is already a sampled gauge");
+    }
+    if (!c.gauge) {
+        c.gauge = std::make_unique<Gauge>();
+    }
+    return *c.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const std::vector<double>& bounds, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Child& c = child(name, help, Type::HISTOGRAM, labels);
+    if (!c.histogram) {
+        c.histogram = std::make_unique<Histogram>(bounds);
+    } else if (c.histogram->bounds() != bounds) {
+        throw std::invalid_argument("Histogram " + name + " already registered with different buckets");
+    }
+    return *c.histogram;
+}
+
+void MetricsRegistry::counter_function(const std::string& name, const std::string& help,
+                                       std::function<double()> sample, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Child& c = child(name, help, Type::COUNTER, labels);
+    if (c.counter) {
+        throw std::invalid_argument("Metric " + name + " is already a counter");
+    }
+    c.sample = std::move(sample);
+}
+
+void MetricsRegistry::gauge_function(const std::string& name, const std::string& help,
+                                     std::function<double()> sample, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Child& c = child(name, help, Type::GAUGE, labels);
+    if (c.gauge) {
+        throw std::invalid_argument("Metric " + name + " is already a gauge");
+    }
+    c.sample = std::move(sample);
+}
+
+void MetricsRegistry::add_collector(Collector collector) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors_.push_back(std::move(collector));
+}
+
+void MetricsRegistry::write_prometheus(std::string& out) const {
+    out.clear();
+    PrometheusWriter writer(out);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& family : families_) {
+        static const char* const type_names[] = {"counter", "gauge", "histogram"};
+        writer.family(family->name, family->help, type_names[static_cast<int>(family->type)]);
+        for (const auto& c : family->children) {
+            if (c->sample) {
+                writer.sample(family->name, c->labels, c->sample());
+            } else if (c->counter) {
+                writer.sample(family->name, c->labels, c->counter->value());
+            } else if (c->gauge) {
+                writer.sample(family->name, c->labels, c->gauge->value());
+            } else if (c->histogram) {
+                writer.histogram(family->name, c->labels, c->histogram->bounds(), c->histogram->bucket_counts(),
+                                 c->histogram->sum());
+            }
+        }
+    }
+    for (const auto& collector : collectors_) {
+        collector(writer);
+    }
+}
+
+} // namespace metricstream
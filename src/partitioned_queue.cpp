@@ -1,4 +1,5 @@
 #include "partitioned_queue.h"
+#include "tracing.h"
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -28,11 +29,17 @@ PartitionedQueue::PartitionedQueue(const std::string& path, int num_partitions)
 
 std::pair<int, uint64_t> PartitionedQueue::produce(const std::string& key,
                                                    const std::string& message) {
+    metricstream::TraceSpan span("queue_produce");
+
     // 1. Determine partition using hash
     int partition = get_partition(key);
 
     // 2. Lock only this partition (allows parallel writes to other partitions)
-    std::lock_guard<std::mutex> lock(*mutexes_[partition]);
+    std::unique_lock<std::mutex> lock(*mutexes_[partition], std::defer_lock);
+    {
+        metricstream::TraceSpan lock_span("queue_partition_lock");
+        lock.lock();
+    }
 
     // 3. Get next offset
     uint64_t offset = ++offsets_[partition];
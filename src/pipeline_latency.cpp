@@ -0,0 +1,122 @@
+#include "pipeline_latency.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace metricstream {
+
+namespace {
+
+// Seconds; the file consumer polls every 100ms, so most batches land low
+const std::vector<double>& latency_bounds() {
+    static const std::vector<double> bounds = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25,
+                                               0.5,   1,      2.5,   5,    10,    30,   60,  120, 300};
+    return bounds;
+}
+
+// Upper bound of the bucket holding the percentile, in seconds; +Inf
+// bucket falls back to `max`
+double bucket_percentile(const std::vector<double>& bounds, const std::vector<uint64_t>& counts, uint64_t total,
+                         double percentile, double max) {
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        cumulative += counts[i];
+        if (cumulative >= rank) {
+            return std::min(bounds[i], max);
+        }
+    }
+    return max;
+}
+
+} // namespace
+
+PipelineLatencyStats::PipelineLatencyStats(MetricsRegistry& registry)
+    : registry_(registry),
+      untimed_(registry.counter("metricstream_consumer_untimed_batches_total",
+                                "Batches without an ingest timestamp (older producers)")) {}
+
+int64_t PipelineLatencyStats::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+PipelineLatencyStats::Partition& PipelineLatencyStats::partition(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = partitions_.find(id);
+    if (it != partitions_.end()) {
+        return *it->second;
+    }
+
+    MetricLabels labels = {{"partition", std::to_string(id)}};
+    auto p = std::make_unique<Partition>();
+    p->delivery = &registry_.histogram("metricstream_consumer_delivery_latency_seconds",
+                                       "Time from POST /metrics to the consumer reading the batch",
+                                       latency_bounds(), labels);
+    p->end_to_end = &registry_.histogram("metricstream_consumer_e2e_latency_seconds",
+                                         "Time from POST /metrics to the consumer finishing the batch",
+                                         latency_bounds(), labels);
+    Partition* raw = p.get();
+    registry_.gauge_function("metricstream_consumer_freshness_seconds",
+                             "Seconds since the newest batch this consumer handled was ingested",
+                             [raw] {
+                                 int64_t newest = raw->newest_ingest_us.load(std::memory_order_relaxed);
+                                 return newest ? std::max<int64_t>(now_us() - newest, 0) / 1e6 : 0.0;
+                             },
+                             labels);
+    return *partitions_.emplace(id, std::move(p)).first->second;
+}
+
+void PipelineLatencyStats::record(int partition_id, int64_t ingest_us, int64_t received_us, int64_t processed_us) {
+    if (ingest_us <= 0) {
+        untimed_.inc();
+        return;
+    }
+    Partition& p = partition(partition_id);
+    int64_t delivery_us = std::max<int64_t>(received_us - ingest_us, 0);
+    int64_t end_to_end_us = std::max<int64_t>(processed_us - ingest_us, 0);
+    p.delivery->observe(delivery_us / 1e6);
+    p.end_to_end->observe(end_to_end_us / 1e6);
+
+    int64_t newest = p.newest_ingest_us.load(std::memory_order_relaxed);
+    while (ingest_us > newest &&
+           !p.newest_ingest_us.compare_exchange_weak(newest, ingest_us, std::memory_order_relaxed)) {
+    }
+    int64_t max = p.max_end_to_end_us.load(std::memory_order_relaxed);
+    while (end_to_end_us > max &&
+           !p.max_end_to_end_us.compare_exchange_weak(max, end_to_end_us, std::memory_order_relaxed)) {
+    }
+}
+
+std::string PipelineLatencyStats::to_json() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto& bounds = latency_bounds();
+    int64_t now = now_us();
+
+    std::string json = "{\"partitions\":[";
+    char buf[320];
+    bool first = true;
+    for (const auto& [id, p] : partitions_) {
+        std::vector<uint64_t> counts = p->end_to_end->bucket_counts();
+        uint64_t total = 0;
+        for (uint64_t c : counts) total += c;
+        double max_s = p->max_end_to_end_us.load(std::memory_order_relaxed) / 1e6;
+        double mean_s = total ? p->end_to_end->sum() / static_cast<double>(total) : 0.0;
+        int64_t newest = p->newest_ingest_us.load(std::memory_order_relaxed);
+
+        std::snprintf(buf, sizeof(buf),
+                      "%s{\"partition\":%d,\"batches\":%llu,\"e2e_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f,"
+                      "\"max\":%.3f},\"freshness_seconds\":%.3f}",
+                      first ? "" : ",", id, static_cast<unsigned long long>(total), mean_s * 1e3,
+                      bucket_percentile(bounds, counts, total, 50, max_s) * 1e3,
+                      bucket_percentile(bounds, counts, total, 99, max_s) * 1e3, max_s * 1e3,
+                      newest ? std::max<int64_t>(now - newest, 0) / 1e6 : 0.0);
+        json += buf;
+        first = false;
+    }
+    json += "]}";
+    return json;
+}
+
+} // namespace metricstream
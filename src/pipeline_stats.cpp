@@ -0,0 +1,161 @@
+#include "pipeline_stats.h"
+#include <algorithm>
+#include <fstream>
+#include <unistd.h>
+
+namespace metricstream {
+
+const char* stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::HTTP_PARSE: return "http_parse";
+        case Stage::RATE_LIMIT: return "rate_limit";
+        case Stage::JSON_PARSE: return "json_parse";
+        case Stage::VALIDATE: return "validate";
+        case Stage::ENQUEUE: return "enqueue";
+        case Stage::QUEUE_WRITE: return "queue_write";
+        case Stage::COUNT: break;
+    }
+    return "unknown";
+}
+
+// ----------------------------------------------------------------------------
+// Bucket layout
+// ----------------------------------------------------------------------------
+
+namespace latency_buckets {
+
+size_t index_of(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    value = std::min<uint64_t>(value, (uint64_t{1} << MAX_EXPONENT) - 1);
+    int exponent = 63 - __builtin_clzll(value);
+    uint64_t sub = (value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t upper_bound(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = static_cast<int>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    int shift = exponent - SUB_BUCKET_BITS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+} // namespace latency_buckets
+
+// ----------------------------------------------------------------------------
+// Histograms
+// ----------------------------------------------------------------------------
+
+uint64_t LatencySnapshot::value_at_percentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) {
+            return std::min(latency_buckets::upper_bound(i), max_);
+        }
+    }
+    return max_;
+}
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+    bump(counts_[latency_buckets::index_of(nanos)], 1);
+    bump(sum_, nanos);
+    if (nanos > max_.load(std::memory_order_relaxed)) {
+        max_.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::add_to(LatencySnapshot& snapshot) const {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        uint64_t count = counts_[i].load(std::memory_order_relaxed);
+        snapshot.counts_[i] += count;
+        snapshot.count_ += count;
+    }
+    snapshot.sum_ += sum_.load(std::memory_order_relaxed);
+    snapshot.max_ = std::max(snapshot.max_, max_.load(std::memory_order_relaxed));
+}
+
+// ----------------------------------------------------------------------------
+// PipelineStats
+// ----------------------------------------------------------------------------
+
+// Gives the calling thread's slot back when the thread exits
+struct ThreadSlotHandle {
+    PipelineStats::ThreadSlot* slot = nullptr;
+
+    ~ThreadSlotHandle() {
+        if (slot) {
+            PipelineStats::instance().release_slot(slot);
+        }
+    }
+};
+
+PipelineStats& PipelineStats::instance() {
+    // Never destroyed: threads may still record during static destruction
+    static PipelineStats* stats = new PipelineStats();
+    return *stats;
+}
+
+PipelineStats::ThreadSlot* PipelineStats::claim_slot() {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (auto& slot : slots_) {
+        if (!slot->in_use) {
+            slot->in_use = true;  // keeps the previous owner's counts
+            return slot.get();
+        }
+    }
+    slots_.push_back(std::make_unique<ThreadSlot>());
+    slots_.back()->in_use = true;
+    return slots_.back().get();
+}
+
+void PipelineStats::release_slot(ThreadSlot* slot) {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    slot->in_use = false;
+}
+
+void PipelineStats::record(Stage stage, uint64_t nanos) {
+    thread_local ThreadSlotHandle handle;
+    if (!handle.slot) {
+        handle.slot = claim_slot();
+    }
+    handle.slot->stages[static_cast<size_t>(stage)].record(nanos);
+}
+
+std::array<LatencySnapshot, STAGE_COUNT> PipelineStats::snapshot() const {
+    std::array<LatencySnapshot, STAGE_COUNT> result;
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (const auto& slot : slots_) {
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            slot->stages[s].add_to(result[s]);
+        }
+    }
+    return result;
+}
+
+size_t resident_memory_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+} // namespace metricstream
@@ -0,0 +1,157 @@
+#include "query_cache.h"
+#include <algorithm>
+
+namespace metricstream {
+
+QueryResultCache::Fill::~Fill() {
+    cache_.end_fill(id_);
+}
+
+QueryResultCache::QueryResultCache(const Options& options)
+    : options_(options), max_tracked_ts_(INT64_MIN) {
+    if (options_.steps_per_bucket == 0) {
+        options_.steps_per_bucket = 1;
+    }
+}
+
+std::string QueryResultCache::entry_key(const std::string& key, int64_t first_step_ts) {
+    return key + "@" + std::to_string(first_step_ts);
+}
+
+size_t QueryResultCache::bucket_bytes(const Bucket& bucket) {
+    size_t bytes = sizeof(Entry) + bucket.size() * sizeof(StepSeries);
+    for (const auto& series : bucket) {
+        bytes += series.name.size() + series.values.size() * sizeof(double) + series.present.size();
+        for (const auto& tag : series.tags) {
+            bytes += sizeof(tag) + tag.first.size() + tag.second.size();
+        }
+    }
+    return bytes;
+}
+
+std::shared_ptr<const QueryResultCache::Bucket> QueryResultCache::get(const std::string& key,
+                                                                      int64_t first_step_ts) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(entry_key(key, first_step_ts));
+    if (it == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    hits_++;
+    return it->second->bucket;
+}
+
+std::unique_ptr<QueryResultCache::Fill> QueryResultCache::begin_fill(int64_t last_step_ts) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = next_fill_id_++;
+    fills_.emplace(id, std::make_pair(last_step_ts, INT64_MAX));
+    if (last_step_ts > max_tracked_ts_.load(std::memory_order_relaxed)) {
+        max_tracked_ts_.store(last_step_ts, std::memory_order_relaxed);
+    }
+    return std::unique_ptr<Fill>(new Fill(*this, id));
+}
+
+void QueryResultCache::end_fill(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fills_.erase(id);
+    update_max_tracked();
+}
+
+void QueryResultCache::put(const Fill& fill, const std::string& key, int64_t first_step_ts,
+                           int64_t first_data_ts, int64_t last_step_ts, Bucket bucket) {
+    size_t bytes = bucket_bytes(bucket);
+    if (bytes > options_.max_bytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto fill_it = fills_.find(fill.id_);
+    if (fill_it == fills_.end() || fill_it->second.second <= last_step_ts) {
+        return;  // a write landed in the bucket's range while it was computed
+    }
+
+    std::string full_key = entry_key(key, first_step_ts);
+    auto existing = entries_.find(full_key);
+    if (existing != entries_.end()) {
+        erase(existing->second);
+    }
+
+    lru_.push_front(Entry{full_key, std::make_shared<const Bucket>(std::move(bucket)),
+                          first_data_ts, last_step_ts, bytes});
+    entries_.emplace(std::move(full_key), lru_.begin());
+    bytes_ += bytes;
+    max_cached_ts_ = std::max(max_cached_ts_, last_step_ts);
+
+    while (bytes_ > options_.max_bytes && !lru_.empty()) {
+        erase(std::prev(lru_.end()));
+        evictions_++;
+    }
+}
+
+void QueryResultCache::invalidate(int64_t oldest_ts, int64_t newest_ts) {
+    // Fast path: fresh samples land after everything cached or being computed
+    if (oldest_ts > max_tracked_ts_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [id, fill] : fills_) {
+        if (oldest_ts <= fill.first) {
+            fill.second = std::min(fill.second, oldest_ts);
+        }
+    }
+
+    // Only the range is known, so drop every bucket it overlaps: a batch with
+    // one old and one new sample may have written anywhere in between
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        auto current = it++;
+        if (oldest_ts <= current->last_step_ts && newest_ts >= current->first_data_ts) {
+            erase(current);
+            invalidations_++;
+        }
+    }
+
+    max_cached_ts_ = INT64_MIN;
+    for (const auto& entry : lru_) {
+        max_cached_ts_ = std::max(max_cached_ts_, entry.last_step_ts);
+    }
+    update_max_tracked();
+}
+
+void QueryResultCache::update_max_tracked() {
+    int64_t max_ts = max_cached_ts_;
+    for (const auto& [id, fill] : fills_) {
+        max_ts = std::max(max_ts, fill.first);
+    }
+    max_tracked_ts_.store(max_ts, std::memory_order_relaxed);
+}
+
+void QueryResultCache::erase(std::list<Entry>::iterator it) {
+    bytes_ -= it->bytes;
+    entries_.erase(it->key);
+    lru_.erase(it);
+}
+
+void QueryResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    entries_.clear();
+    bytes_ = 0;
+    max_cached_ts_ = INT64_MIN;
+    update_max_tracked();
+}
+
+QueryResultCache::Stats QueryResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.invalidations = invalidations_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+} // namespace metricstream
@@ -0,0 +1,710 @@
+#include "query_engine.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+AggregateOp over_time_op(const std::string& function) {
+    // "<op>_over_time"
+    return parse_aggregate_op(function.substr(0, function.find('_')));
+}
+
+int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+} // namespace
+
+bool QueryContext::cancelled() const {
+    return cancelled_.load(std::memory_order_relaxed) || disconnected_.load(std::memory_order_relaxed) ||
+           Clock::now() >= deadline_;
+}
+
+void QueryContext::check() const {
+    if (cancelled_.load(std::memory_order_relaxed)) {
+        throw QueryCancelled("query cancelled");
+    }
+    if (disconnected_.load(std::memory_order_relaxed)) {
+        throw QueryCancelled("client disconnected");
+    }
+    if (Clock::now() >= deadline_) {
+        throw QueryCancelled("query deadline exceeded");
+    }
+}
+
+void QueryContext::poll() {
+    if (client_connected_ && !disconnected_.load(std::memory_order_relaxed) && !client_connected_()) {
+        disconnected_.store(true, std::memory_order_relaxed);
+    }
+    check();
+}
+
+QueryEngine::QueryEngine(const StorageEngine& storage, ThreadPool* pool, int64_t lookback_ms)
+    : storage_(storage), pool_(pool), lookback_ms_(lookback_ms) {}
+
+// ----------------------------------------------------------------------------
+// Planning
+// ----------------------------------------------------------------------------
+
+std::vector<QueryEngine::ScanPlan> QueryEngine::plan(const QueryExpr& expr, int64_t first_step_ts,
+                                                     int64_t last_step_ts) const {
+    std::vector<ScanPlan> scans;
+    collect_scans(expr, first_step_ts, last_step_ts, scans);
+    return scans;
+}
+
+void QueryEngine::collect_scans(const QueryExpr& expr, int64_t first_step_ts, int64_t last_step_ts,
+                                std::vector<ScanPlan>& scans) const {
+    if (expr.kind == QueryExpr::Kind::VECTOR_SELECTOR || expr.kind == QueryExpr::Kind::MATRIX_SELECTOR) {
+        // The first step looks back over (t - window, t]
+        int64_t window = expr.kind == QueryExpr::Kind::MATRIX_SELECTOR ? expr.range_ms : lookback_ms_;
+        ScanPlan scan;
+        scan.selector = expr.to_string();
+        scan.matchers = expr.matchers;
+        scan.start_ts = first_step_ts - window + 1;
+        scan.end_ts = last_step_ts;
+        scans.push_back(std::move(scan));
+        return;
+    }
+    for (const auto& arg : expr.args) {
+        collect_scans(*arg, first_step_ts, last_step_ts, scans);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sharded scans
+// ----------------------------------------------------------------------------
+
+void QueryEngine::run_sharded(size_t count, const std::function<void(size_t)>& task,
+                              QueryContext* context) const {
+    // Shared with the helper tasks, which may be dequeued after this returns;
+    // by then every index is claimed, so they never touch `task`
+    struct State {
+        std::function<void(size_t)> task;
+        QueryContext* context = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        size_t done = 0;
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+    };
+    auto state = std::make_shared<State>();
+    state->task = task;
+    state->context = context;
+    state->count = count;
+
+    // Each worker pulls the next unclaimed shard, so fast workers take more
+    // shards and one slow shard (e.g. a series with many blocks) can't idle the rest
+    auto work = [](State& st) {
+        while (true) {
+            size_t index = st.next.fetch_add(1, std::memory_order_relaxed);
+            if (index >= st.count) return;
+            if (!st.failed.load(std::memory_order_relaxed)) {
+                try {
+                    if (st.context) st.context->poll();
+                    st.task(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(st.mutex);
+                    if (!st.error) st.error = std::current_exception();
+                    st.failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            std::lock_guard<std::mutex> lock(st.mutex);
+            if (++st.done == st.count) st.done_cv.notify_all();
+        }
+    };
+
+    if (pool_ && count > 1) {
+        size_t helpers = std::min(pool_->worker_count(), count - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            if (!pool_->enqueue([state, work]() { work(*state); })) {
+                break;  // queue full: the calling thread picks up the slack
+            }
+        }
+    }
+    work(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done_cv.wait(lock, [&state] { return state->done == state->count; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+QueryEngine::ShardedScan QueryEngine::select_series(const QueryExpr& selector, const std::vector<int64_t>& steps,
+                                                    Stats& stats, int64_t rollup_resolution_ms) const {
+    std::vector<ScanPlan> scans;
+    collect_scans(selector, steps.front(), steps.back(), scans);
+
+    // Index lookup happens once; shards only read their own series
+    ShardedScan scan;
+    scan.plan = std::move(scans.front());
+    if (rollup_resolution_ms > 0) {
+        // Bucket ends in (first - range, last]
+        scan.plan.rollup_resolution_ms = rollup_resolution_ms;
+        scan.plan.start_ts = steps.front() - selector.range_ms + rollup_resolution_ms;
+    }
+    scan.ids = storage_.select(scan.plan.matchers);
+    stats.series_matched += scan.ids.size();
+    stats.scans.push_back(scan.plan);
+    return scan;
+}
+
+std::vector<QueryEngine::ShardedScan> QueryEngine::waves(const ShardedScan& scan) {
+    constexpr size_t WAVE_SERIES = STREAM_SHARDS * SERIES_PER_TASK;
+    std::vector<ShardedScan> out;
+    for (size_t first = 0; first < scan.ids.size(); first += WAVE_SERIES) {
+        size_t last = std::min(first + WAVE_SERIES, scan.ids.size());
+        ShardedScan wave;
+        wave.plan = scan.plan;
+        wave.ids.assign(scan.ids.begin() + static_cast<std::ptrdiff_t>(first),
+                        scan.ids.begin() + static_cast<std::ptrdiff_t>(last));
+        out.push_back(std::move(wave));
+    }
+    return out;
+}
+
+void QueryEngine::read_shards(const ShardedScan& scan, Stats& stats, QueryContext* context,
+                              const std::function<void(size_t, SeriesColumns&)>& visit) const {
+    std::vector<StorageEngine::QueryStats> shard_stats(scan.shard_count());
+    run_sharded(scan.shard_count(), [&](size_t shard) {
+        size_t first = shard * SERIES_PER_TASK;
+        size_t last = std::min(first + SERIES_PER_TASK, scan.ids.size());
+        std::vector<SeriesId> shard_ids(scan.ids.begin() + first, scan.ids.begin() + last);
+
+        auto results = storage_.query_series(shard_ids, scan.plan.start_ts, scan.plan.end_ts, &shard_stats[shard]);
+        for (auto& result : results) {
+            if (context) context->check();
+            SeriesColumns series;
+            series.series = std::move(result.series);
+            series.timestamps.reserve(result.samples.size());
+            series.values.reserve(result.samples.size());
+            for (const auto& s : result.samples) {
+                series.timestamps.push_back(s.timestamp_ms);
+                series.values.push_back(s.value);
+            }
+            visit(shard, series);
+        }
+    }, context);
+
+    for (const auto& shard : shard_stats) {
+        stats.blocks_read += shard.blocks_read;
+        stats.samples_scanned += shard.samples_returned;
+    }
+}
+
+void QueryEngine::read_rollup_shards(const ShardedScan& scan, Stats& stats, QueryContext* context,
+                                     const std::function<void(size_t, StorageEngine::RollupResult&)>& visit) const {
+    std::vector<StorageEngine::QueryStats> shard_stats(scan.shard_count());
+    run_sharded(scan.shard_count(), [&](size_t shard) {
+        size_t first = shard * SERIES_PER_TASK;
+        size_t last = std::min(first + SERIES_PER_TASK, scan.ids.size());
+        std::vector<SeriesId> shard_ids(scan.ids.begin() + first, scan.ids.begin() + last);
+
+        auto results = storage_.query_rollups(shard_ids, scan.plan.rollup_resolution_ms, scan.plan.start_ts,
+                                              scan.plan.end_ts, &shard_stats[shard]);
+        for (auto& result : results) {
+            if (context) context->check();
+            visit(shard, result);
+        }
+    }, context);
+
+    for (const auto& shard : shard_stats) {
+        stats.blocks_read += shard.blocks_read;
+        stats.samples_scanned += shard.samples_returned;
+    }
+}
+
+int64_t QueryEngine::pick_rollup_resolution(const QueryExpr& function, const std::vector<int64_t>& steps) const {
+    if (function.function.find("_over_time") == std::string::npos) {
+        return 0;  // rate/increase need the first and last raw samples
+    }
+    const int64_t range_ms = function.args[0]->range_ms;
+    const int64_t step_ms = steps.size() > 1 ? steps[1] - steps[0] : 0;
+
+    // Window (t - range, t] is a whole number of (end - res, end] buckets
+    // when t and range are multiples of the resolution
+    std::vector<int64_t> resolutions = storage_.rollup_resolutions();
+    for (auto it = resolutions.rbegin(); it != resolutions.rend(); ++it) {
+        int64_t res = *it;
+        if (range_ms % res == 0 && step_ms % res == 0 && steps.front() % res == 0) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Execution
+// ----------------------------------------------------------------------------
+
+QueryEngine::Result QueryEngine::execute(const std::string& query, int64_t start_ts, int64_t end_ts,
+                                         int64_t step_ms, QueryContext* context) const {
+    auto expr = parse_query(query);
+    return execute(*expr, start_ts, end_ts, step_ms, context);
+}
+
+QueryEngine::Result QueryEngine::execute(const QueryExpr& expr, int64_t start_ts, int64_t end_ts,
+                                         int64_t step_ms, QueryContext* context) const {
+    std::vector<ResultSeries> series;
+    Result result = execute_streaming(expr, start_ts, end_ts, step_ms, [&series](ResultSeries&& out) {
+        series.push_back(std::move(out));
+    }, context);
+    result.series = std::move(series);
+    return result;
+}
+
+std::vector<int64_t> QueryEngine::evaluation_steps(const QueryExpr& expr, int64_t start_ts, int64_t end_ts,
+                                                   int64_t step_ms) {
+    if (step_ms < 0) {
+        throw std::invalid_argument("step must not be negative");
+    }
+    if (end_ts < start_ts) {
+        throw std::invalid_argument("end must not be before start");
+    }
+    // A bare range vector returns raw samples, which only makes sense at one instant
+    if (expr.kind == QueryExpr::Kind::MATRIX_SELECTOR && step_ms != 0) {
+        throw std::invalid_argument("range vector selector is only valid in an instant query");
+    }
+
+    std::vector<int64_t> steps;
+    if (step_ms == 0) {
+        steps.push_back(end_ts);
+        return steps;
+    }
+    uint64_t span = static_cast<uint64_t>(end_ts) - static_cast<uint64_t>(start_ts);
+    if (span / static_cast<uint64_t>(step_ms) >= MAX_STEPS) {
+        throw std::invalid_argument("too many steps (max " + std::to_string(MAX_STEPS) + "), increase step");
+    }
+    size_t step_count = static_cast<size_t>(span / static_cast<uint64_t>(step_ms)) + 1;
+    steps.reserve(step_count);
+    for (size_t i = 0; i < step_count; ++i) {
+        steps.push_back(start_ts + static_cast<int64_t>(i) * step_ms);
+    }
+    return steps;
+}
+
+QueryEngine::Result QueryEngine::execute_streaming(const QueryExpr& expr, int64_t start_ts, int64_t end_ts,
+                                                   int64_t step_ms, const SeriesSink& sink,
+                                                   QueryContext* context) const {
+    const std::vector<int64_t> steps = evaluation_steps(expr, start_ts, end_ts, step_ms);
+    Result result;
+    result.is_matrix = step_ms != 0 || expr.kind == QueryExpr::Kind::MATRIX_SELECTOR;
+
+    if (expr.kind == QueryExpr::Kind::MATRIX_SELECTOR) {
+        ShardedScan scan = select_series(expr, steps, result.stats);
+        for (const ShardedScan& wave : waves(scan)) {
+            std::vector<std::vector<ResultSeries>> shards(wave.shard_count());
+            read_shards(wave, result.stats, context, [&shards](size_t shard, SeriesColumns& series) {
+                ResultSeries out;
+                out.name = std::move(series.series.name);
+                out.tags = std::move(series.series.tags);
+                out.points.reserve(series.timestamps.size());
+                for (size_t i = 0; i < series.timestamps.size(); ++i) {
+                    out.points.push_back(Sample{series.timestamps[i], series.values[i]});
+                }
+                shards[shard].push_back(std::move(out));
+            });
+            for (auto& shard : shards) {
+                for (auto& out : shard) {
+                    sink(std::move(out));
+                }
+            }
+        }
+        return result;
+    }
+
+    auto emit = [&](std::vector<StepSeries>& evaluated) {
+        for (auto& series : evaluated) {
+            ResultSeries out;
+            out.name = std::move(series.name);
+            out.tags = std::move(series.tags);
+            for (size_t i = 0; i < steps.size(); ++i) {
+                if (series.present[i]) {
+                    out.points.push_back(Sample{steps[i], series.values[i]});
+                }
+            }
+            if (!out.points.empty()) {
+                sink(std::move(out));
+            }
+        }
+    };
+
+    const bool cached = cache_ && step_ms > 0;
+    if (!cached && (expr.kind == QueryExpr::Kind::VECTOR_SELECTOR || expr.kind == QueryExpr::Kind::FUNCTION_CALL)) {
+        // One output series per input series: evaluate and hand over a wave at a time
+        ShardedScan scan = select_leaf(expr, steps, result.stats);
+        for (const ShardedScan& wave : waves(scan)) {
+            std::vector<StepSeries> evaluated =
+                evaluate_leaf_scan(expr, wave, steps, result.stats, context, nullptr, nullptr);
+            emit(evaluated);
+        }
+        return result;
+    }
+
+    std::vector<StepSeries> evaluated = cached
+        ? evaluate_cached(expr, steps, step_ms, result.stats, context)
+        : evaluate(expr, steps, result.stats, context);
+    emit(evaluated);
+    return result;
+}
+
+std::vector<StepSeries> QueryEngine::evaluate_cached(const QueryExpr& expr, const std::vector<int64_t>& steps,
+                                                     int64_t step_ms, Stats& stats,
+                                                     QueryContext* context) const {
+    // Steps sit on the grid offset + n * step; buckets are K consecutive n
+    const int64_t per_bucket = static_cast<int64_t>(cache_->steps_per_bucket());
+    const int64_t offset = steps.front() - floor_div(steps.front(), step_ms) * step_ms;
+    const int64_t first_n = floor_div(steps.front() - offset, step_ms);
+    const int64_t last_n = first_n + static_cast<int64_t>(steps.size()) - 1;
+    const std::string key = expr.to_string() + "|" + std::to_string(step_ms) + "|" + std::to_string(offset);
+    auto step_ts = [&](int64_t n) { return offset + n * step_ms; };
+
+    // How far before a step its selectors read (for invalidation ranges)
+    std::vector<ScanPlan> step_scans;
+    collect_scans(expr, 0, 0, step_scans);
+    int64_t lookbehind = 0;
+    for (const auto& scan : step_scans) {
+        lookbehind = std::min(lookbehind, scan.start_ts);
+    }
+
+    // Output series in first-seen order, one slot per requested step
+    std::vector<StepSeries> output;
+    std::map<std::pair<std::string, GroupKey>, size_t> output_index;
+    auto place = [&](const StepSeries& series, size_t from, size_t count, int64_t first_step_n) {
+        auto id = std::make_pair(series.name, series.tags);
+        auto it = output_index.find(id);
+        if (it == output_index.end()) {
+            StepSeries out;
+            out.name = series.name;
+            out.tags = series.tags;
+            out.values.assign(steps.size(), 0.0);
+            out.present.assign(steps.size(), 0);
+            it = output_index.emplace(std::move(id), output.size()).first;
+            output.push_back(std::move(out));
+        }
+        StepSeries& out = output[it->second];
+        size_t dest = static_cast<size_t>(first_step_n - first_n);
+        for (size_t i = 0; i < count; ++i) {
+            out.values[dest + i] = series.values[from + i];
+            out.present[dest + i] = series.present[from + i];
+        }
+    };
+
+    // Evaluate [segment_start, n) from storage, caching its complete buckets
+    auto compute = [&](int64_t segment_start, int64_t segment_end) {
+        std::vector<int64_t> segment_steps;
+        segment_steps.reserve(static_cast<size_t>(segment_end - segment_start));
+        for (int64_t n = segment_start; n < segment_end; ++n) {
+            segment_steps.push_back(step_ts(n));
+        }
+
+        int64_t first_full = floor_div(segment_start + per_bucket - 1, per_bucket) * per_bucket;
+        int64_t full_end = floor_div(segment_end, per_bucket) * per_bucket;
+        std::unique_ptr<QueryResultCache::Fill> fill;
+        if (first_full < full_end) {
+            fill = cache_->begin_fill(step_ts(full_end - 1));
+        }
+
+        std::vector<StepSeries> computed = evaluate(expr, segment_steps, stats, context);
+        for (const auto& series : computed) {
+            place(series, 0, segment_steps.size(), segment_start);
+        }
+
+        for (int64_t bucket_n = first_full; fill && bucket_n < full_end; bucket_n += per_bucket) {
+            size_t from = static_cast<size_t>(bucket_n - segment_start);
+            QueryResultCache::Bucket bucket;
+            for (const auto& series : computed) {
+                auto first = series.present.begin() + static_cast<std::ptrdiff_t>(from);
+                if (std::find(first, first + per_bucket, 1) == first + per_bucket) {
+                    continue;
+                }
+                StepSeries slice;
+                slice.name = series.name;
+                slice.tags = series.tags;
+                slice.values.assign(series.values.begin() + static_cast<std::ptrdiff_t>(from),
+                                    series.values.begin() + static_cast<std::ptrdiff_t>(from) + per_bucket);
+                slice.present.assign(first, first + per_bucket);
+                bucket.push_back(std::move(slice));
+            }
+            cache_->put(*fill, key, step_ts(bucket_n), step_ts(bucket_n) + lookbehind,
+                        step_ts(bucket_n + per_bucket - 1), std::move(bucket));
+        }
+    };
+
+    // Walk the buckets in order: complete ones come from the cache, and runs
+    // of misses and the partial edges are evaluated together
+    int64_t pending_start = first_n;
+    for (int64_t bucket_n = floor_div(first_n, per_bucket) * per_bucket; bucket_n <= last_n;
+         bucket_n += per_bucket) {
+        if (bucket_n < first_n || bucket_n + per_bucket - 1 > last_n) {
+            continue;
+        }
+        auto cached = cache_->get(key, step_ts(bucket_n));
+        if (!cached) {
+            continue;
+        }
+        if (pending_start < bucket_n) {
+            compute(pending_start, bucket_n);
+        }
+        for (const auto& series : *cached) {
+            place(series, 0, static_cast<size_t>(per_bucket), bucket_n);
+        }
+        stats.cached_steps += static_cast<size_t>(per_bucket);
+        pending_start = bucket_n + per_bucket;
+    }
+    if (pending_start <= last_n) {
+        compute(pending_start, last_n + 1);
+    }
+    return output;
+}
+
+std::vector<StepSeries> QueryEngine::evaluate(const QueryExpr& expr,
+                                              const std::vector<int64_t>& steps,
+                                              Stats& stats, QueryContext* context) const {
+    switch (expr.kind) {
+        case QueryExpr::Kind::NUMBER: {
+            StepSeries series;
+            series.values.assign(steps.size(), expr.number);
+            series.present.assign(steps.size(), 1);
+            return {std::move(series)};
+        }
+        case QueryExpr::Kind::VECTOR_SELECTOR:
+        case QueryExpr::Kind::FUNCTION_CALL:
+            return evaluate_leaf(expr, steps, stats, context, nullptr, nullptr);
+        case QueryExpr::Kind::AGGREGATION:
+            return evaluate_aggregation(expr, steps, stats, context);
+        case QueryExpr::Kind::MATRIX_SELECTOR:
+            break;
+    }
+    throw std::invalid_argument("range vector selector must be wrapped in a function");
+}
+
+std::vector<StepSeries> QueryEngine::evaluate_leaf(const QueryExpr& expr,
+                                                   const std::vector<int64_t>& steps,
+                                                   Stats& stats, QueryContext* context,
+                                                   const QueryExpr* aggregation,
+                                                   GroupPartials* groups) const {
+    return evaluate_leaf_scan(expr, select_leaf(expr, steps, stats), steps, stats, context, aggregation, groups);
+}
+
+QueryEngine::ShardedScan QueryEngine::select_leaf(const QueryExpr& expr, const std::vector<int64_t>& steps,
+                                                  Stats& stats) const {
+    if (expr.kind == QueryExpr::Kind::FUNCTION_CALL) {
+        return select_series(*expr.args[0], steps, stats, pick_rollup_resolution(expr, steps));
+    }
+    return select_series(expr, steps, stats);
+}
+
+std::vector<StepSeries> QueryEngine::evaluate_leaf_scan(const QueryExpr& expr, const ShardedScan& scan,
+                                                        const std::vector<int64_t>& steps, Stats& stats,
+                                                        QueryContext* context, const QueryExpr* aggregation,
+                                                        GroupPartials* groups) const {
+    const bool is_function = expr.kind == QueryExpr::Kind::FUNCTION_CALL;
+    const int64_t rollup_resolution = scan.plan.rollup_resolution_ms;
+
+    // Per-shard output, merged in shard order so results stay in index order
+    struct ShardOutput {
+        std::vector<StepSeries> series;
+        GroupPartials groups;
+    };
+    std::vector<ShardOutput> shards(scan.shard_count());
+    auto emit = [&](size_t shard, StepSeries&& out) {
+        if (aggregation) {
+            add_to_groups(*aggregation, out, steps.size(), shards[shard].groups);
+        } else {
+            shards[shard].series.push_back(std::move(out));
+        }
+    };
+    if (rollup_resolution > 0) {
+        read_rollup_shards(scan, stats, context, [&](size_t shard, StorageEngine::RollupResult& series) {
+            emit(shard, apply_rollup_function(expr, series, steps));
+        });
+    } else {
+        read_shards(scan, stats, context, [&](size_t shard, SeriesColumns& columns) {
+            emit(shard, is_function ? apply_function(expr, columns, steps) : apply_selector(columns, steps));
+        });
+    }
+
+    std::vector<StepSeries> output;
+    for (auto& shard : shards) {
+        if (aggregation) {
+            // Reduce: merge the shard's partials into the final groups
+            for (auto& [key, partials] : shard.groups) {
+                auto& merged = (*groups)[key];
+                if (merged.empty()) {
+                    merged = std::move(partials);
+                    continue;
+                }
+                for (size_t s = 0; s < partials.size(); ++s) {
+                    merged[s].merge(partials[s]);
+                }
+            }
+        } else {
+            for (auto& series : shard.series) {
+                output.push_back(std::move(series));
+            }
+        }
+    }
+    return output;
+}
+
+StepSeries QueryEngine::apply_selector(SeriesColumns& series,
+                                       const std::vector<int64_t>& steps) const {
+    StepSeries out;
+    out.name = std::move(series.series.name);
+    out.tags = std::move(series.series.tags);
+    out.values.assign(steps.size(), 0.0);
+    out.present.assign(steps.size(), 0);
+
+    // Latest sample in (t - lookback, t]; steps ascend, so one forward pass
+    size_t next = 0;
+    for (size_t s = 0; s < steps.size(); ++s) {
+        while (next < series.timestamps.size() && series.timestamps[next] <= steps[s]) next++;
+        if (next > 0 && series.timestamps[next - 1] > steps[s] - lookback_ms_) {
+            out.values[s] = series.values[next - 1];
+            out.present[s] = 1;
+        }
+    }
+    return out;
+}
+
+StepSeries QueryEngine::apply_function(const QueryExpr& expr, SeriesColumns& series,
+                                       const std::vector<int64_t>& steps) {
+    const int64_t range_ms = expr.args[0]->range_ms;
+    const bool is_rate = expr.function == "rate";
+    const bool is_increase = expr.function == "increase";
+    const AggregateOp op = (is_rate || is_increase) ? AggregateOp::SUM : over_time_op(expr.function);
+
+    StepSeries out;
+    out.tags = std::move(series.series.tags);  // functions drop the metric name
+    out.values.assign(steps.size(), 0.0);
+    out.present.assign(steps.size(), 0);
+
+    // Sliding window (t - range, t] as [lo, hi) over the sorted columns
+    const int64_t* ts = series.timestamps.data();
+    const double* values = series.values.data();
+    size_t lo = 0;
+    size_t hi = 0;
+    for (size_t s = 0; s < steps.size(); ++s) {
+        while (hi < series.timestamps.size() && ts[hi] <= steps[s]) hi++;
+        while (lo < hi && ts[lo] <= steps[s] - range_ms) lo++;
+        size_t count = hi - lo;
+
+        if (is_rate || is_increase) {
+            if (count < 2) continue;
+            double rate = counter_rate(ts + lo, values + lo, count);
+            // increase() extrapolates the observed rate over the whole range
+            out.values[s] = is_rate ? rate : rate * (static_cast<double>(range_ms) / 1000.0);
+            out.present[s] = 1;
+        } else {
+            if (count == 0) continue;
+            out.values[s] = aggregate_values(values + lo, count).value(op);
+            out.present[s] = 1;
+        }
+    }
+    return out;
+}
+
+StepSeries QueryEngine::apply_rollup_function(const QueryExpr& expr, StorageEngine::RollupResult& series,
+                                              const std::vector<int64_t>& steps) {
+    const int64_t range_ms = expr.args[0]->range_ms;
+    const AggregateOp op = over_time_op(expr.function);
+
+    StepSeries out;
+    out.tags = std::move(series.series.tags);
+    out.values.assign(steps.size(), 0.0);
+    out.present.assign(steps.size(), 0);
+
+    // Buckets ending in (t - range, t] as [lo, hi)
+    const auto& points = series.points;
+    size_t lo = 0;
+    size_t hi = 0;
+    for (size_t s = 0; s < steps.size(); ++s) {
+        while (hi < points.size() && points[hi].timestamp_ms <= steps[s]) hi++;
+        while (lo < hi && points[lo].timestamp_ms <= steps[s] - range_ms) lo++;
+        if (lo == hi) continue;
+
+        Aggregate window;
+        for (size_t i = lo; i < hi; ++i) {
+            window.merge(points[i].aggregate);
+        }
+        out.values[s] = window.value(op);
+        out.present[s] = 1;
+    }
+    return out;
+}
+
+void QueryEngine::add_to_groups(const QueryExpr& aggregation, const StepSeries& series, size_t step_count,
+                                GroupPartials& groups) {
+    // Group key = the labels kept by by/without; grouping is sorted
+    GroupKey key;
+    for (const auto& tag : series.tags) {
+        bool listed = std::binary_search(aggregation.grouping.begin(), aggregation.grouping.end(), tag.first);
+        if (listed != aggregation.without) {
+            key.push_back(tag);
+        }
+    }
+
+    auto& aggregates = groups[key];
+    if (aggregates.empty()) {
+        aggregates.resize(step_count);
+    }
+    for (size_t s = 0; s < step_count; ++s) {
+        if (!series.present[s]) continue;
+        Aggregate& agg = aggregates[s];
+        double v = series.values[s];
+        agg.sum += v;
+        agg.min = std::min(agg.min, v);
+        agg.max = std::max(agg.max, v);
+        agg.count++;
+    }
+}
+
+std::vector<StepSeries> QueryEngine::groups_to_series(const QueryExpr& aggregation,
+                                                      GroupPartials& groups, size_t step_count) {
+    std::vector<StepSeries> output;
+    output.reserve(groups.size());
+    for (auto& [key, aggregates] : groups) {
+        StepSeries out;
+        out.tags = key;
+        out.values.assign(step_count, 0.0);
+        out.present.assign(step_count, 0);
+        for (size_t s = 0; s < step_count; ++s) {
+            if (aggregates[s].count == 0) continue;
+            out.values[s] = aggregates[s].value(aggregation.aggregate_op);
+            out.present[s] = 1;
+        }
+        output.push_back(std::move(out));
+    }
+    return output;
+}
+
+std::vector<StepSeries> QueryEngine::evaluate_aggregation(const QueryExpr& expr,
+                                                          const std::vector<int64_t>& steps,
+                                                          Stats& stats, QueryContext* context) const {
+    const QueryExpr& arg = *expr.args[0];
+    GroupPartials groups;
+    if (arg.kind == QueryExpr::Kind::VECTOR_SELECTOR || arg.kind == QueryExpr::Kind::FUNCTION_CALL) {
+        // Map-reduce: shards fold straight into partials, no per-series output
+        evaluate_leaf(arg, steps, stats, context, &expr, &groups);
+    } else {
+        // Nested aggregation: the input is already one series per group
+        for (const auto& series : evaluate(arg, steps, stats, context)) {
+            add_to_groups(expr, series, steps.size(), groups);
+        }
+    }
+    return groups_to_series(expr, groups, steps.size());
+}
+
+} // namespace metricstream
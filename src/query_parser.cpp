@@ -0,0 +1,529 @@
+#include "query_parser.h"
+#include "common.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <regex>
+#include <set>
+
+namespace metricstream {
+
+namespace {
+
+// \uXXXX inside a string literal (pos is just past the 'u'), as UTF-8
+void append_code_point(std::string& out, const std::string& query, size_t& pos, size_t start) {
+    std::string hex = query.substr(pos, 4);
+    if (hex.size() != 4 || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        throw QueryParseError("Bad \\u escape", start);
+    }
+    pos += 4;
+    append_utf8(out, static_cast<uint32_t>(std::stoul(hex, nullptr, 16)));
+}
+
+bool is_identifier_start(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+}
+
+bool is_identifier_char(char c) {
+    return is_identifier_start(c) || std::isdigit(static_cast<unsigned char>(c));
+}
+
+// Unit at text[pos] -> milliseconds per unit (0 if none); sets the unit length
+int64_t duration_unit(const std::string& text, size_t pos, size_t& length) {
+    if (pos >= text.size()) return 0;
+    char c = text[pos];
+    if (c == 'm' && pos + 1 < text.size() && text[pos + 1] == 's') { length = 2; return 1; }
+    length = 1;
+    switch (c) {
+        case 's': return 1000;
+        case 'm': return 60 * 1000;
+        case 'h': return 60 * 60 * 1000;
+        case 'd': return 24 * 60 * 60 * 1000LL;
+        case 'w': return 7 * 24 * 60 * 60 * 1000LL;
+        case 'y': return 365 * 24 * 60 * 60 * 1000LL;
+        default: return 0;
+    }
+}
+
+bool is_aggregate_op(const std::string& name) {
+    return name == "sum" || name == "avg" || name == "min" || name == "max" || name == "count";
+}
+
+bool is_range_function(const std::string& name) {
+    static const std::set<std::string> functions = {
+        "rate", "increase",
+        "sum_over_time", "avg_over_time", "min_over_time", "max_over_time", "count_over_time"};
+    return functions.count(name) > 0;
+}
+
+const char* matcher_op_text(TagMatcher::Op op) {
+    switch (op) {
+        case TagMatcher::Op::EQUAL:          return "=";
+        case TagMatcher::Op::NOT_EQUAL:      return "!=";
+        case TagMatcher::Op::REGEX_MATCH:    return "=~";
+        case TagMatcher::Op::REGEX_NO_MATCH: return "!~";
+    }
+    return "=";
+}
+
+const char* aggregate_op_text(AggregateOp op) {
+    switch (op) {
+        case AggregateOp::SUM:   return "sum";
+        case AggregateOp::MIN:   return "min";
+        case AggregateOp::MAX:   return "max";
+        case AggregateOp::AVG:   return "avg";
+        case AggregateOp::COUNT: return "count";
+    }
+    return "sum";
+}
+
+class Parser {
+public:
+    explicit Parser(std::vector<QueryToken> tokens) : tokens_(std::move(tokens)) {}
+
+    std::unique_ptr<QueryExpr> parse() {
+        auto expr = parse_expr();
+        if (peek().type != QueryToken::Type::END) {
+            fail("Unexpected '" + peek().text + "'");
+        }
+        return expr;
+    }
+
+private:
+    std::vector<QueryToken> tokens_;
+    size_t pos_ = 0;
+    size_t depth_ = 0;
+
+    const QueryToken& peek(size_t ahead = 0) const {
+        size_t index = std::min(pos_ + ahead, tokens_.size() - 1);
+        return tokens_[index];
+    }
+
+    const QueryToken& next() {
+        const QueryToken& token = tokens_[pos_];
+        if (pos_ + 1 < tokens_.size()) pos_++;
+        return token;
+    }
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw QueryParseError(message, peek().position);
+    }
+
+    void expect(QueryToken::Type type, const char* what) {
+        if (peek().type != type) {
+            fail(std::string("Expected ") + what);
+        }
+        next();
+    }
+
+    // Every nesting level (parentheses, function and aggregation arguments)
+    // recurses through parse_expr(); bounding it keeps a hostile query from
+    // overflowing the stack of the thread serving it
+    std::unique_ptr<QueryExpr> parse_expr() {
+        if (depth_ >= MAX_QUERY_DEPTH) {
+            fail("Query nested deeper than " + std::to_string(MAX_QUERY_DEPTH) + " levels");
+        }
+        depth_++;
+        auto expr = parse_operand();
+        depth_--;
+        return expr;
+    }
+
+    std::unique_ptr<QueryExpr> parse_operand() {
+        const QueryToken& token = peek();
+        switch (token.type) {
+            case QueryToken::Type::NUMBER: {
+                auto expr = std::make_unique<QueryExpr>();
+                expr->kind = QueryExpr::Kind::NUMBER;
+                expr->number = next().number;
+                return expr;
+            }
+            case QueryToken::Type::LEFT_PAREN: {
+                next();
+                auto expr = parse_expr();
+                expect(QueryToken::Type::RIGHT_PAREN, "')'");
+                return expr;
+            }
+            case QueryToken::Type::LEFT_BRACE:
+                return parse_selector("");
+            case QueryToken::Type::IDENTIFIER: {
+                const std::string& name = token.text;
+                const QueryToken& after = peek(1);
+                bool grouping_follows = after.type == QueryToken::Type::IDENTIFIER &&
+                                        (after.text == "by" || after.text == "without");
+                if (is_aggregate_op(name) && (after.type == QueryToken::Type::LEFT_PAREN || grouping_follows)) {
+                    return parse_aggregation();
+                }
+                if (after.type == QueryToken::Type::LEFT_PAREN) {
+                    return parse_function();
+                }
+                std::string metric = next().text;
+                return parse_selector(metric);
+            }
+            default:
+                fail("Expected expression");
+        }
+    }
+
+    std::unique_ptr<QueryExpr> parse_selector(const std::string& metric) {
+        auto expr = std::make_unique<QueryExpr>();
+        expr->kind = QueryExpr::Kind::VECTOR_SELECTOR;
+        size_t selector_pos = peek().position;
+        if (!metric.empty()) {
+            expr->matchers.emplace_back(TagIndex::NAME_TAG, metric);
+        }
+
+        if (peek().type == QueryToken::Type::LEFT_BRACE) {
+            next();
+            while (peek().type != QueryToken::Type::RIGHT_BRACE) {
+                if (peek().type != QueryToken::Type::IDENTIFIER) fail("Expected tag name");
+                std::string key = next().text;
+
+                TagMatcher::Op op;
+                switch (peek().type) {
+                    case QueryToken::Type::EQUAL:          op = TagMatcher::Op::EQUAL; break;
+                    case QueryToken::Type::NOT_EQUAL:      op = TagMatcher::Op::NOT_EQUAL; break;
+                    case QueryToken::Type::REGEX_MATCH:    op = TagMatcher::Op::REGEX_MATCH; break;
+                    case QueryToken::Type::REGEX_NO_MATCH: op = TagMatcher::Op::REGEX_NO_MATCH; break;
+                    default: fail("Expected =, !=, =~ or !~");
+                }
+                next();
+
+                if (peek().type != QueryToken::Type::STRING) fail("Expected quoted tag value");
+                try {
+                    expr->matchers.emplace_back(key, peek().text, op);
+                } catch (const std::regex_error& e) {
+                    fail(std::string("Bad regex: ") + e.what());
+                }
+                next();
+
+                if (peek().type == QueryToken::Type::COMMA) {
+                    next();
+                } else if (peek().type != QueryToken::Type::RIGHT_BRACE) {
+                    fail("Expected ',' or '}'");
+                }
+            }
+            next();
+        }
+
+        // Like Prometheus: refuse selectors that would match every series
+        bool selective = std::any_of(expr->matchers.begin(), expr->matchers.end(),
+                                     [](const TagMatcher& m) { return !m.matches(""); });
+        if (!selective) {
+            throw QueryParseError("Selector must contain at least one non-empty matcher", selector_pos);
+        }
+
+        if (peek().type == QueryToken::Type::LEFT_BRACKET) {
+            next();
+            if (peek().type != QueryToken::Type::DURATION) fail("Expected range duration");
+            expr->range_ms = static_cast<int64_t>(next().number);
+            if (expr->range_ms <= 0) fail("Range must be positive");
+            expect(QueryToken::Type::RIGHT_BRACKET, "']'");
+            expr->kind = QueryExpr::Kind::MATRIX_SELECTOR;
+        }
+        return expr;
+    }
+
+    std::unique_ptr<QueryExpr> parse_function() {
+        size_t name_pos = peek().position;
+        std::string name = next().text;
+        if (!is_range_function(name)) {
+            throw QueryParseError("Unknown function '" + name + "'", name_pos);
+        }
+
+        auto expr = std::make_unique<QueryExpr>();
+        expr->kind = QueryExpr::Kind::FUNCTION_CALL;
+        expr->function = name;
+
+        expect(QueryToken::Type::LEFT_PAREN, "'('");
+        size_t arg_pos = peek().position;
+        expr->args.push_back(parse_expr());
+        expect(QueryToken::Type::RIGHT_PAREN, "')'");
+
+        if (expr->args[0]->kind != QueryExpr::Kind::MATRIX_SELECTOR) {
+            throw QueryParseError(name + "() expects a range vector, e.g. " + name + "(metric[5m])", arg_pos);
+        }
+        return expr;
+    }
+
+    void parse_grouping(QueryExpr& expr) {
+        expr.without = next().text == "without";
+        expect(QueryToken::Type::LEFT_PAREN, "'('");
+        std::set<std::string> labels;
+        while (peek().type != QueryToken::Type::RIGHT_PAREN) {
+            if (peek().type != QueryToken::Type::IDENTIFIER) fail("Expected label name");
+            labels.insert(next().text);
+            if (peek().type == QueryToken::Type::COMMA) {
+                next();
+            } else if (peek().type != QueryToken::Type::RIGHT_PAREN) {
+                fail("Expected ',' or ')'");
+            }
+        }
+        next();
+        expr.grouping.assign(labels.begin(), labels.end());
+    }
+
+    bool at_grouping_keyword() const {
+        return peek().type == QueryToken::Type::IDENTIFIER &&
+               (peek().text == "by" || peek().text == "without");
+    }
+
+    std::unique_ptr<QueryExpr> parse_aggregation() {
+        auto expr = std::make_unique<QueryExpr>();
+        expr->kind = QueryExpr::Kind::AGGREGATION;
+        expr->aggregate_op = parse_aggregate_op(next().text);
+
+        bool grouped = false;
+        if (at_grouping_keyword()) {
+            parse_grouping(*expr);
+            grouped = true;
+        }
+
+        expect(QueryToken::Type::LEFT_PAREN, "'('");
+        size_t arg_pos = peek().position;
+        expr->args.push_back(parse_expr());
+        expect(QueryToken::Type::RIGHT_PAREN, "')'");
+
+        if (!grouped && at_grouping_keyword()) {
+            parse_grouping(*expr);
+        }
+
+        if (expr->args[0]->kind == QueryExpr::Kind::MATRIX_SELECTOR) {
+            throw QueryParseError("Aggregation expects an instant vector; use *_over_time for ranges", arg_pos);
+        }
+        return expr;
+    }
+};
+
+} // namespace
+
+int64_t parse_duration_ms(const std::string& text) {
+    if (text.empty()) {
+        throw std::invalid_argument("Empty duration");
+    }
+    int64_t total = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t digits_start = pos;
+        while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) pos++;
+        if (pos == digits_start) {
+            throw std::invalid_argument("Bad duration: " + text);
+        }
+        size_t unit_length = 0;
+        int64_t unit = duration_unit(text, pos, unit_length);
+        if (unit == 0) {
+            throw std::invalid_argument("Bad duration unit: " + text);
+        }
+        // Digits only, so the amount is non-negative; reject what int64 cannot hold
+        int64_t amount = 0;
+        for (size_t i = digits_start; i < pos; ++i) {
+            int64_t digit = text[i] - '0';
+            if (amount > (INT64_MAX - digit) / 10) {
+                throw std::invalid_argument("Duration too large: " + text);
+            }
+            amount = amount * 10 + digit;
+        }
+        if (amount > (INT64_MAX - total) / unit) {
+            throw std::invalid_argument("Duration too large: " + text);
+        }
+        total += amount * unit;
+        pos += unit_length;
+    }
+    return total;
+}
+
+std::vector<QueryToken> tokenize_query(const std::string& query) {
+    std::vector<QueryToken> tokens;
+    size_t pos = 0;
+
+    auto push = [&tokens](QueryToken::Type type, std::string text, size_t at) {
+        QueryToken token;
+        token.type = type;
+        token.text = std::move(text);
+        token.position = at;
+        tokens.push_back(std::move(token));
+    };
+
+    while (pos < query.size()) {
+        char c = query[pos];
+        size_t start = pos;
+
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pos++;
+            continue;
+        }
+
+        if (is_identifier_start(c)) {
+            while (pos < query.size() && is_identifier_char(query[pos])) pos++;
+            push(QueryToken::Type::IDENTIFIER, query.substr(start, pos - start), start);
+            continue;
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && pos + 1 < query.size() &&
+                                                            std::isdigit(static_cast<unsigned char>(query[pos + 1])))) {
+            while (pos < query.size() &&
+                   (std::isdigit(static_cast<unsigned char>(query[pos])) || query[pos] == '.')) pos++;
+
+            size_t unit_length = 0;
+            if (duration_unit(query, pos, unit_length) != 0 &&
+                query.find('.', start) >= pos) {
+                // Duration: digits+unit, possibly repeated ("1h30m")
+                while (pos < query.size() && (std::isdigit(static_cast<unsigned char>(query[pos])) ||
+                                              duration_unit(query, pos, unit_length) != 0)) {
+                    pos += std::isdigit(static_cast<unsigned char>(query[pos])) ? 1 : unit_length;
+                }
+                std::string text = query.substr(start, pos - start);
+                try {
+                    push(QueryToken::Type::DURATION, text, start);
+                    tokens.back().number = static_cast<double>(parse_duration_ms(text));
+                } catch (const std::invalid_argument&) {
+                    throw QueryParseError("Bad duration '" + text + "'", start);
+                }
+                continue;
+            }
+
+            // Optional exponent
+            if (pos < query.size() && (query[pos] == 'e' || query[pos] == 'E')) {
+                pos++;
+                if (pos < query.size() && (query[pos] == '+' || query[pos] == '-')) pos++;
+                while (pos < query.size() && std::isdigit(static_cast<unsigned char>(query[pos]))) pos++;
+            }
+            std::string text = query.substr(start, pos - start);
+            try {
+                size_t used = 0;
+                double value = std::stod(text, &used);
+                if (used != text.size()) throw std::invalid_argument(text);
+                push(QueryToken::Type::NUMBER, text, start);
+                tokens.back().number = value;
+            } catch (const std::exception&) {
+                throw QueryParseError("Bad number '" + text + "'", start);
+            }
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            std::string value;
+            pos++;
+            while (true) {
+                if (pos >= query.size()) {
+                    throw QueryParseError("Unterminated string", start);
+                }
+                char s = query[pos++];
+                if (s == c) break;
+                if (s == '\\' && pos < query.size()) {
+                    char e = query[pos++];
+                    switch (e) {
+                        case 'n': value += '\n'; break;
+                        case 't': value += '\t'; break;
+                        case 'r': value += '\r'; break;
+                        case 'b': value += '\b'; break;
+                        case 'f': value += '\f'; break;
+                        case 'u': append_code_point(value, query, pos, start); break;
+                        default:  value += e; break;
+                    }
+                    continue;
+                }
+                value += s;
+            }
+            push(QueryToken::Type::STRING, std::move(value), start);
+            continue;
+        }
+
+        QueryToken::Type type;
+        size_t length = 1;
+        switch (c) {
+            case '(': type = QueryToken::Type::LEFT_PAREN; break;
+            case ')': type = QueryToken::Type::RIGHT_PAREN; break;
+            case '{': type = QueryToken::Type::LEFT_BRACE; break;
+            case '}': type = QueryToken::Type::RIGHT_BRACE; break;
+            case '[': type = QueryToken::Type::LEFT_BRACKET; break;
+            case ']': type = QueryToken::Type::RIGHT_BRACKET; break;
+            case ',': type = QueryToken::Type::COMMA; break;
+            case '=':
+                if (pos + 1 < query.size() && query[pos + 1] == '~') {
+                    type = QueryToken::Type::REGEX_MATCH;
+                    length = 2;
+                } else {
+                    type = QueryToken::Type::EQUAL;
+                }
+                break;
+            case '!':
+                if (pos + 1 < query.size() && query[pos + 1] == '=') {
+                    type = QueryToken::Type::NOT_EQUAL;
+                } else if (pos + 1 < query.size() && query[pos + 1] == '~') {
+                    type = QueryToken::Type::REGEX_NO_MATCH;
+                } else {
+                    throw QueryParseError("Unexpected '!'", start);
+                }
+                length = 2;
+                break;
+            default:
+                throw QueryParseError(std::string("Unexpected character '") + c + "'", start);
+        }
+        pos += length;
+        push(type, query.substr(start, length), start);
+    }
+
+    push(QueryToken::Type::END, "end of query", query.size());
+    return tokens;
+}
+
+std::unique_ptr<QueryExpr> parse_query(const std::string& query) {
+    return Parser(tokenize_query(query)).parse();
+}
+
+std::string QueryExpr::to_string() const {
+    std::string out;
+    switch (kind) {
+        case Kind::NUMBER: {
+            char buf[32];
+            int n = std::snprintf(buf, sizeof(buf), "%.17g", number);
+            out.append(buf, n);
+            break;
+        }
+        case Kind::VECTOR_SELECTOR:
+        case Kind::MATRIX_SELECTOR: {
+            std::vector<const TagMatcher*> sorted;
+            for (const auto& m : matchers) {
+                if (m.key == TagIndex::NAME_TAG && m.op == TagMatcher::Op::EQUAL && out.empty()) {
+                    out = m.value;  // metric name prefix
+                } else {
+                    sorted.push_back(&m);
+                }
+            }
+            std::sort(sorted.begin(), sorted.end(), [](const TagMatcher* a, const TagMatcher* b) {
+                if (a->key != b->key) return a->key < b->key;
+                if (a->op != b->op) return a->op < b->op;
+                return a->value < b->value;
+            });
+            out += '{';
+            for (size_t i = 0; i < sorted.size(); ++i) {
+                if (i > 0) out += ',';
+                out += sorted[i]->key;
+                out += matcher_op_text(sorted[i]->op);
+                append_json_string(out, sorted[i]->value);
+            }
+            out += '}';
+            if (kind == Kind::MATRIX_SELECTOR) {
+                out += "[" + std::to_string(range_ms) + "ms]";
+            }
+            break;
+        }
+        case Kind::FUNCTION_CALL:
+            out = function + "(" + args[0]->to_string() + ")";
+            break;
+        case Kind::AGGREGATION: {
+            out = aggregate_op_text(aggregate_op);
+            out += without ? " without (" : " by (";
+            for (size_t i = 0; i < grouping.size(); ++i) {
+                if (i > 0) out += ',';
+                out += grouping[i];
+            }
+            out += ") (" + args[0]->to_string() + ")";
+            break;
+        }
+    }
+    return out;
+}
+
+} // namespace metricstream
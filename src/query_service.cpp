@@ -0,0 +1,349 @@
+#include "query_service.h"
+#include "aggregation_kernels.h"
+#include "common.h"
+#include "logging.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <thread>
+
+namespace metricstream {
+
+namespace {
+
+void append_series_json(std::string& out, const StorageEngine::SeriesResult& result) {
+    out += "{\"id\":" + std::to_string(result.series.id) + ",\"name\":";
+    append_json_string(out, result.series.name);
+    out += ",\"tags\":{";
+    for (size_t t = 0; t < result.series.tags.size(); ++t) {
+        if (t > 0) out += ",";
+        append_json_string(out, result.series.tags[t].first);
+        out += ":";
+        append_json_string(out, result.series.tags[t].second);
+    }
+    out += "},\"points\":[";
+
+    char value_buf[32];
+    for (size_t i = 0; i < result.samples.size(); ++i) {
+        if (i > 0) out += ",";
+        out += "[" + std::to_string(result.samples[i].timestamp_ms) + ",";
+        int n = std::snprintf(value_buf, sizeof(value_buf), "%.17g", result.samples[i].value);
+        out.append(value_buf, n);
+        out += "]";
+    }
+    out += "]}";
+}
+
+// Replace raw samples with one point per step bucket (bucket start, aggregate)
+void downsample_result(StorageEngine::SeriesResult& result, int64_t start_ts, int64_t end_ts,
+                       int64_t step_ms, AggregateOp op) {
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    timestamps.reserve(result.samples.size());
+    values.reserve(result.samples.size());
+    for (const auto& s : result.samples) {
+        timestamps.push_back(s.timestamp_ms);
+        values.push_back(s.value);
+    }
+
+    std::vector<Aggregate> buckets;
+    downsample(timestamps.data(), values.data(), timestamps.size(), start_ts, end_ts, step_ms, buckets);
+
+    result.samples.clear();
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        if (buckets[i].count == 0) continue;
+        result.samples.push_back(Sample{start_ts + static_cast<int64_t>(i) * step_ms, buckets[i].value(op)});
+    }
+}
+
+} // namespace
+
+QueryService::QueryService(int port, StorageEngine& storage)
+    : storage_(storage),
+      query_pool_(std::make_unique<ThreadPool>(std::max(1u, std::thread::hardware_concurrency()))),
+      engine_(storage, query_pool_.get()) {
+    engine_.set_result_cache(&cache_);
+    storage_.set_write_observer([this](int64_t oldest_ts, int64_t newest_ts) {
+        cache_.invalidate(oldest_ts, newest_ts);
+    });
+
+    server_ = std::make_unique<HttpServer>(port);
+
+    server_->add_handler("/query", "GET",
+        [this](const HttpRequest& req) { return handle_query(req); });
+    server_->add_handler("/health", "GET",
+        [this](const HttpRequest& req) { return handle_health_check(req); });
+}
+
+QueryService::~QueryService() {
+    stop();
+    storage_.set_write_observer(nullptr);
+}
+
+void QueryService::start() {
+    server_->start();
+    MS_LOG_INFO("Query service started");
+}
+
+void QueryService::stop() {
+    if (server_) {
+        server_->stop();
+    }
+}
+
+std::vector<TagMatcher> QueryService::parse_tag_filters(const std::string& tags) {
+    // "host:web-1,region:us" -> [host="web-1", region="us"]
+    std::vector<TagMatcher> matchers;
+    size_t pos = 0;
+    while (pos < tags.length()) {
+        size_t comma = tags.find(',', pos);
+        if (comma == std::string::npos) comma = tags.length();
+
+        std::string pair = tags.substr(pos, comma - pos);
+        size_t colon = pair.find(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument("Tag filter must be key:value, got '" + pair + "'");
+        }
+        matchers.emplace_back(pair.substr(0, colon), pair.substr(colon + 1));
+        pos = comma + 1;
+    }
+    return matchers;
+}
+
+HttpResponse QueryService::handle_query(const HttpRequest& request) {
+    HttpResponse response;
+    response.set_json_content();
+
+    if (request.query_params.count("query")) {
+        return handle_expression_query(request);
+    }
+
+    auto name_it = request.query_params.find("name");
+    if (name_it == request.query_params.end() || name_it->second.empty()) {
+        response.status_code = 400;
+        response.body = create_error_response("Missing required parameter: name");
+        return response;
+    }
+
+    std::vector<TagMatcher> matchers;
+    int64_t start_ts = 0;
+    int64_t end_ts = LLONG_MAX;
+    int64_t step_ms = 0;
+    AggregateOp op = AggregateOp::AVG;
+    try {
+        matchers.emplace_back(TagIndex::NAME_TAG, name_it->second);
+
+        auto tags_it = request.query_params.find("tags");
+        if (tags_it != request.query_params.end()) {
+            auto tag_matchers = parse_tag_filters(tags_it->second);
+            matchers.insert(matchers.end(), tag_matchers.begin(), tag_matchers.end());
+        }
+
+        auto start_it = request.query_params.find("start");
+        if (start_it != request.query_params.end()) start_ts = std::stoll(start_it->second);
+        auto end_it = request.query_params.find("end");
+        if (end_it != request.query_params.end()) end_ts = std::stoll(end_it->second);
+        if (end_ts < start_ts) throw std::invalid_argument("end must not be before start");
+
+        auto step_it = request.query_params.find("step");
+        if (step_it != request.query_params.end()) {
+            step_ms = std::stoll(step_it->second);
+            if (step_ms <= 0) throw std::invalid_argument("step must be positive");
+            if (start_it == request.query_params.end() || end_it == request.query_params.end()) {
+                throw std::invalid_argument("step requires start and end");
+            }
+            // Unsigned: the span of two extreme timestamps overflows int64
+            uint64_t span = static_cast<uint64_t>(end_ts) - static_cast<uint64_t>(start_ts);
+            if (span / static_cast<uint64_t>(step_ms) > MAX_STEP_BUCKETS) {
+                throw std::invalid_argument("too many steps, increase step");
+            }
+        }
+        auto agg_it = request.query_params.find("agg");
+        if (agg_it != request.query_params.end()) op = parse_aggregate_op(agg_it->second);
+    } catch (const std::exception& e) {
+        response.status_code = 400;
+        response.body = create_error_response(std::string("Invalid query: ") + e.what());
+        return response;
+    }
+
+    // Stream the series a slice at a time, so memory stays bounded by one
+    // slice however many series and points the export covers
+    auto query_start = std::chrono::steady_clock::now();
+    auto ids = std::make_shared<std::vector<SeriesId>>(storage_.select(matchers));
+    response.body_stream = [this, ids, start_ts, end_ts, step_ms, op, query_start](const ChunkWriter& write_chunk) {
+        StorageEngine::QueryStats stats;
+        stats.series_matched = ids->size();
+
+        std::string buffer = "{\"status\":\"success\",\"series\":[";
+        bool first = true;
+        for (size_t begin = 0; begin < ids->size(); begin += STREAM_SERIES_PER_READ) {
+            size_t end = std::min(begin + STREAM_SERIES_PER_READ, ids->size());
+            std::vector<SeriesId> slice(ids->begin() + begin, ids->begin() + end);
+
+            StorageEngine::QueryStats slice_stats;
+            for (auto& result : storage_.query_series(slice, start_ts, end_ts, &slice_stats)) {
+                if (step_ms > 0) {
+                    downsample_result(result, start_ts, end_ts, step_ms, op);
+                }
+                if (!first) buffer += ",";
+                first = false;
+                append_series_json(buffer, result);
+                if (buffer.size() >= STREAM_CHUNK_BYTES) {
+                    if (!write_chunk(buffer)) return;  // client went away
+                    buffer.clear();
+                }
+            }
+            stats.blocks_read += slice_stats.blocks_read;
+            stats.samples_returned += slice_stats.samples_returned;
+        }
+
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - query_start).count();
+        buffer += "],\"stats\":{\"series_matched\":" + std::to_string(stats.series_matched) +
+                  ",\"blocks_read\":" + std::to_string(stats.blocks_read) +
+                  ",\"samples\":" + std::to_string(stats.samples_returned) +
+                  ",\"elapsed_us\":" + std::to_string(elapsed_us) + "}}";
+        write_chunk(buffer);
+    };
+    return response;
+}
+
+HttpResponse QueryService::handle_expression_query(const HttpRequest& request) {
+    HttpResponse response;
+    response.set_json_content();
+
+    int64_t end_ts = 0;
+    int64_t start_ts = 0;
+    int64_t step_ms = 0;
+    int64_t timeout_ms = DEFAULT_TIMEOUT_MS;
+    std::unique_ptr<QueryExpr> expr;
+    try {
+        expr = parse_query(request.query_params.at("query"));
+
+        auto end_it = request.query_params.find("end");
+        end_ts = end_it != request.query_params.end()
+            ? std::stoll(end_it->second)
+            : std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::system_clock::now().time_since_epoch()).count();
+        start_ts = end_ts;
+
+        auto step_it = request.query_params.find("step");
+        if (step_it != request.query_params.end()) {
+            step_ms = std::stoll(step_it->second);
+            if (step_ms <= 0) throw std::invalid_argument("step must be positive");
+            auto start_it = request.query_params.find("start");
+            if (start_it == request.query_params.end()) {
+                throw std::invalid_argument("step requires start");
+            }
+            start_ts = std::stoll(start_it->second);
+        }
+
+        auto timeout_it = request.query_params.find("timeout");
+        if (timeout_it != request.query_params.end()) {
+            timeout_ms = std::stoll(timeout_it->second);
+            if (timeout_ms <= 0) throw std::invalid_argument("timeout must be positive");
+        }
+
+        // Shape errors (too many steps, ...) are caught before the body starts
+        QueryEngine::evaluation_steps(*expr, start_ts, end_ts, step_ms);
+    } catch (const std::exception& e) {
+        response.status_code = 400;
+        response.body = create_error_response(std::string("Invalid query: ") + e.what());
+        return response;
+    }
+
+    // Series are written as the engine hands them over, so memory stays
+    // bounded by one wave of shards for selector and function queries. Once
+    // the body has started, a failure (e.g. the deadline) can only end it
+    // without the final chunk, which the server does when the stream throws.
+    auto query_start = std::chrono::steady_clock::now();
+    std::shared_ptr<const QueryExpr> shared_expr = std::move(expr);
+    std::function<bool()> client_connected = request.client_connected;
+    response.body_stream = [this, shared_expr, start_ts, end_ts, step_ms, timeout_ms, query_start,
+                            client_connected](const ChunkWriter& write_chunk) {
+        QueryContext context(query_start + std::chrono::milliseconds(timeout_ms), client_connected);
+        bool client_gone = false;
+        bool first = true;
+        std::string body = "{\"status\":\"success\",\"result_type\":";
+        body += step_ms != 0 || shared_expr->kind == QueryExpr::Kind::MATRIX_SELECTOR ? "\"matrix\"" : "\"vector\"";
+        body += ",\"series\":[";
+        char value_buf[32];
+        auto write_series = [&](QueryEngine::ResultSeries&& series) {
+            if (client_gone) return;
+            if (!first) body += ",";
+            first = false;
+            body += "{\"name\":";
+            append_json_string(body, series.name);
+            body += ",\"tags\":{";
+            for (size_t t = 0; t < series.tags.size(); ++t) {
+                if (t > 0) body += ",";
+                append_json_string(body, series.tags[t].first);
+                body += ":";
+                append_json_string(body, series.tags[t].second);
+            }
+            body += "},\"points\":[";
+            for (size_t p = 0; p < series.points.size(); ++p) {
+                if (p > 0) body += ",";
+                body += "[" + std::to_string(series.points[p].timestamp_ms) + ",";
+                int n = std::snprintf(value_buf, sizeof(value_buf), "%.17g", series.points[p].value);
+                body.append(value_buf, n);
+                body += "]";
+            }
+            body += "]}";
+            if (body.size() >= STREAM_CHUNK_BYTES) {
+                if (!write_chunk(body)) {
+                    client_gone = true;
+                    context.cancel();  // stops the remaining shards
+                }
+                body.clear();
+            }
+        };
+
+        QueryEngine::Result result;
+        try {
+            result = engine_.execute_streaming(*shared_expr, start_ts, end_ts, step_ms, write_series, &context);
+        } catch (const QueryCancelled&) {
+            if (client_gone) return;
+            throw;
+        }
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - query_start).count();
+
+        body += "],\"plan\":[";
+        for (size_t i = 0; i < result.stats.scans.size(); ++i) {
+            const auto& scan = result.stats.scans[i];
+            if (i > 0) body += ",";
+            body += "{\"selector\":";
+            append_json_string(body, scan.selector);
+            body += ",\"start\":" + std::to_string(scan.start_ts) +
+                    ",\"end\":" + std::to_string(scan.end_ts) +
+                    ",\"resolution\":" + std::to_string(scan.rollup_resolution_ms) + "}";
+        }
+        body += "],\"stats\":{\"series_matched\":" + std::to_string(result.stats.series_matched) +
+                ",\"blocks_read\":" + std::to_string(result.stats.blocks_read) +
+                ",\"samples\":" + std::to_string(result.stats.samples_scanned) +
+                ",\"cached_steps\":" + std::to_string(result.stats.cached_steps) +
+                ",\"elapsed_us\":" + std::to_string(elapsed_us) + "}}";
+        write_chunk(body);
+    };
+    return response;
+}
+
+HttpResponse QueryService::handle_health_check(const HttpRequest&) {
+    HttpResponse response;
+    response.set_json_content();
+    response.body = "{\"status\":\"healthy\",\"service\":\"query\""
+                    ",\"series\":" + std::to_string(storage_.series_count()) +
+                    ",\"blocks\":" + std::to_string(storage_.block_count()) + "}";
+    return response;
+}
+
+std::string QueryService::create_error_response(const std::string& message) {
+    std::string body = "{\"error\":";
+    append_json_string(body, message);
+    body += "}";
+    return body;
+}
+
+} // namespace metricstream
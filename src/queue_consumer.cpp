@@ -1,7 +1,7 @@
 #include "queue_consumer.h"
+#include "logging.h"
 #include <filesystem>
 #include <fstream>
-#include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <chrono>
@@ -31,7 +31,7 @@ QueueConsumer::QueueConsumer(const std::string& queue_path,
 void QueueConsumer::start() {
     running_ = true;
 
-    std::cout << "Starting consumer with " << num_partitions_ << " partitions...\n";
+    MS_LOG_INFO("Starting consumer with {} partitions", num_partitions_);
 
     // Spawn one thread per partition (simple parallelism)
     std::vector<std::thread> threads;
@@ -52,17 +52,25 @@ void QueueConsumer::stop() {
 }
 
 void QueueConsumer::consume_partition(int partition) {
-    std::cout << "Consumer thread for partition " << partition << " started\n";
+    MS_LOG_INFO("Consumer thread for partition {} started", partition);
 
     while (running_) {
         auto msg = read_next(partition);
 
         if (msg) {
-            // Process message (Phase 9: just log it)
-            std::cout << "[Partition " << msg->partition
-                      << " | Offset " << msg->offset << "] "
-                      << msg->data.substr(0, 100)  // First 100 chars
-                      << (msg->data.size() > 100 ? "..." : "") << "\n";
+            if (handler_) {
+                try {
+                    handler_(*msg);
+                } catch (const std::exception& e) {
+                    MS_LOG_ERROR("[Partition {} | Offset {}] Handler failed: {}", msg->partition, msg->offset,
+                                 e.what());
+                }
+            } else {
+                // No handler installed: just log it (Phase 9 behaviour)
+                MS_LOG_INFO("[Partition {} | Offset {}] {}{}", msg->partition, msg->offset,
+                            std::string_view(msg->data).substr(0, 100),  // First 100 chars
+                            msg->data.size() > 100 ? "..." : "");
+            }
 
             // Commit offset (mark as processed)
             commit_offset(partition, msg->offset);
@@ -73,7 +81,7 @@ void QueueConsumer::consume_partition(int partition) {
         }
     }
 
-    std::cout << "Consumer thread for partition " << partition << " stopped\n";
+    MS_LOG_INFO("Consumer thread for partition {} stopped", partition);
 }
 
 std::optional<Message> QueueConsumer::read_next(int partition) {
@@ -105,7 +113,7 @@ void QueueConsumer::commit_offset(int partition, uint64_t offset) {
 
     std::ofstream file(offset_file);
     if (!file.is_open()) {
-        std::cerr << "Failed to open offset file: " << offset_file << "\n";
+        MS_LOG_ERROR("Failed to open offset file: {}", offset_file);
         return;
     }
     file << offset;
@@ -120,8 +128,7 @@ void QueueConsumer::load_offsets() {
         std::ifstream file(offset_file);
         if (file.is_open()) {
             file >> read_offsets_[i];
-            std::cout << "Loaded offset for partition " << i
-                      << ": " << read_offsets_[i] << "\n";
+            MS_LOG_INFO("Loaded offset for partition {}: {}", i, read_offsets_[i]);
         }
     }
 }
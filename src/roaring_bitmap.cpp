@@ -0,0 +1,361 @@
+#include "roaring_bitmap.h"
+#include <algorithm>
+#include <iterator>
+
+namespace metricstream {
+
+// ----------------------------------------------------------------------------
+// Container
+// ----------------------------------------------------------------------------
+
+RoaringBitmap::Container::Container(const Container& other)
+    : is_bitset(other.is_bitset), cardinality(other.cardinality), array(other.array) {
+    if (other.bits) {
+        bits = std::make_unique<std::array<uint64_t, BITSET_WORDS>>(*other.bits);
+    }
+}
+
+RoaringBitmap::Container& RoaringBitmap::Container::operator=(const Container& other) {
+    if (this != &other) {
+        Container copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+bool RoaringBitmap::Container::add(uint16_t low) {
+    if (is_bitset) {
+        uint64_t& word = (*bits)[low >> 6];
+        uint64_t mask = uint64_t{1} << (low & 63);
+        if (word & mask) return false;
+        word |= mask;
+        cardinality++;
+        return true;
+    }
+
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) return false;
+    array.insert(it, low);
+    cardinality++;
+
+    // Array containers stop paying off past 4096 entries (8KB either way)
+    if (array.size() > ARRAY_MAX_SIZE) {
+        to_bitset();
+    }
+    return true;
+}
+
+bool RoaringBitmap::Container::remove(uint16_t low) {
+    if (is_bitset) {
+        uint64_t& word = (*bits)[low >> 6];
+        uint64_t mask = uint64_t{1} << (low & 63);
+        if (!(word & mask)) return false;
+        word &= ~mask;
+        cardinality--;
+        if (cardinality <= ARRAY_MAX_SIZE) {
+            to_array();
+        }
+        return true;
+    }
+
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it == array.end() || *it != low) return false;
+    array.erase(it);
+    cardinality--;
+    return true;
+}
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (is_bitset) {
+        return ((*bits)[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::to_bitset() {
+    if (is_bitset) return;
+    bits = std::make_unique<std::array<uint64_t, BITSET_WORDS>>();
+    bits->fill(0);
+    for (uint16_t v : array) {
+        (*bits)[v >> 6] |= uint64_t{1} << (v & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+    is_bitset = true;
+}
+
+void RoaringBitmap::Container::to_array() {
+    if (!is_bitset) return;
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t w = 0; w < BITSET_WORDS; ++w) {
+        uint64_t word = (*bits)[w];
+        while (word) {
+            int bit = __builtin_ctzll(word);
+            array.push_back(static_cast<uint16_t>(w * 64 + bit));
+            word &= word - 1;
+        }
+    }
+    bits.reset();
+    is_bitset = false;
+}
+
+void RoaringBitmap::Container::for_each(uint32_t high_bits,
+                                        const std::function<void(uint32_t)>& fn) const {
+    if (!is_bitset) {
+        for (uint16_t v : array) fn(high_bits | v);
+        return;
+    }
+    for (size_t w = 0; w < BITSET_WORDS; ++w) {
+        uint64_t word = (*bits)[w];
+        while (word) {
+            int bit = __builtin_ctzll(word);
+            fn(high_bits | static_cast<uint32_t>(w * 64 + bit));
+            word &= word - 1;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Container set operations
+// ----------------------------------------------------------------------------
+
+namespace {
+
+// Set bits in n words, the cardinality of a bitset result
+uint32_t popcount_words(const uint64_t* words, size_t n) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < n; ++i) total += __builtin_popcountll(words[i]);
+    return total;
+}
+
+} // namespace
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b) {
+    Container out;
+    if (!a.is_bitset && !b.is_bitset) {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+    if (a.is_bitset != b.is_bitset) {
+        // Probe the array side against the bitset side
+        const Container& arr = a.is_bitset ? b : a;
+        const Container& bs = a.is_bitset ? a : b;
+        for (uint16_t v : arr.array) {
+            if (bs.contains(v)) out.array.push_back(v);
+        }
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+    out.is_bitset = true;
+    out.bits = std::make_unique<std::array<uint64_t, BITSET_WORDS>>();
+    for (size_t w = 0; w < BITSET_WORDS; ++w) {
+        (*out.bits)[w] = (*a.bits)[w] & (*b.bits)[w];
+    }
+    out.cardinality = popcount_words(out.bits->data(), BITSET_WORDS);
+    if (out.cardinality <= ARRAY_MAX_SIZE) out.to_array();
+    return out;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container& a, const Container& b) {
+    Container out;
+    if (!a.is_bitset && !b.is_bitset) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        if (out.array.size() > ARRAY_MAX_SIZE) out.to_bitset();
+        return out;
+    }
+    out.is_bitset = true;
+    out.bits = std::make_unique<std::array<uint64_t, BITSET_WORDS>>();
+    out.bits->fill(0);
+    for (const Container* c : {&a, &b}) {
+        if (c->is_bitset) {
+            for (size_t w = 0; w < BITSET_WORDS; ++w) (*out.bits)[w] |= (*c->bits)[w];
+        } else {
+            for (uint16_t v : c->array) (*out.bits)[v >> 6] |= uint64_t{1} << (v & 63);
+        }
+    }
+    out.cardinality = popcount_words(out.bits->data(), BITSET_WORDS);
+    if (out.cardinality <= ARRAY_MAX_SIZE) out.to_array();
+    return out;
+}
+
+RoaringBitmap::Container RoaringBitmap::subtract(const Container& a, const Container& b) {
+    Container out;
+    if (!a.is_bitset) {
+        if (!b.is_bitset) {
+            std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                std::back_inserter(out.array));
+        } else {
+            for (uint16_t v : a.array) {
+                if (!b.contains(v)) out.array.push_back(v);
+            }
+        }
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+    out.is_bitset = true;
+    out.bits = std::make_unique<std::array<uint64_t, BITSET_WORDS>>(*a.bits);
+    if (b.is_bitset) {
+        for (size_t w = 0; w < BITSET_WORDS; ++w) (*out.bits)[w] &= ~(*b.bits)[w];
+    } else {
+        for (uint16_t v : b.array) (*out.bits)[v >> 6] &= ~(uint64_t{1} << (v & 63));
+    }
+    out.cardinality = popcount_words(out.bits->data(), BITSET_WORDS);
+    if (out.cardinality <= ARRAY_MAX_SIZE) out.to_array();
+    return out;
+}
+
+// ----------------------------------------------------------------------------
+// RoaringBitmap
+// ----------------------------------------------------------------------------
+
+RoaringBitmap::RoaringBitmap(const RoaringBitmap& other)
+    : keys_(other.keys_), containers_(other.containers_) {}
+
+RoaringBitmap& RoaringBitmap::operator=(const RoaringBitmap& other) {
+    if (this != &other) {
+        keys_ = other.keys_;
+        containers_ = other.containers_;
+    }
+    return *this;
+}
+
+size_t RoaringBitmap::find_container(uint16_t key) const {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it != keys_.end() && *it == key) {
+        return static_cast<size_t>(it - keys_.begin());
+    }
+    return keys_.size();
+}
+
+RoaringBitmap::Container& RoaringBitmap::get_or_create(uint16_t key) {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    size_t idx = static_cast<size_t>(it - keys_.begin());
+    if (it == keys_.end() || *it != key) {
+        keys_.insert(it, key);
+        containers_.insert(containers_.begin() + idx, Container{});
+    }
+    return containers_[idx];
+}
+
+void RoaringBitmap::add(uint32_t value) {
+    // Postings are mostly appended in ascending order: check the last container first
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    if (!keys_.empty() && keys_.back() == key) {
+        containers_.back().add(static_cast<uint16_t>(value & 0xFFFF));
+        return;
+    }
+    get_or_create(key).add(static_cast<uint16_t>(value & 0xFFFF));
+}
+
+bool RoaringBitmap::remove(uint32_t value) {
+    size_t idx = find_container(static_cast<uint16_t>(value >> 16));
+    if (idx == keys_.size()) return false;
+    bool removed = containers_[idx].remove(static_cast<uint16_t>(value & 0xFFFF));
+    if (removed && containers_[idx].cardinality == 0) {
+        keys_.erase(keys_.begin() + idx);
+        containers_.erase(containers_.begin() + idx);
+    }
+    return removed;
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+    size_t idx = find_container(static_cast<uint16_t>(value >> 16));
+    if (idx == keys_.size()) return false;
+    return containers_[idx].contains(static_cast<uint16_t>(value & 0xFFFF));
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+    uint64_t total = 0;
+    for (const auto& c : containers_) total += c.cardinality;
+    return total;
+}
+
+RoaringBitmap RoaringBitmap::and_(const RoaringBitmap& other) const {
+    RoaringBitmap out;
+    size_t i = 0, j = 0;
+    while (i < keys_.size() && j < other.keys_.size()) {
+        if (keys_[i] < other.keys_[j]) {
+            i++;
+        } else if (keys_[i] > other.keys_[j]) {
+            j++;
+        } else {
+            Container c = intersect(containers_[i], other.containers_[j]);
+            if (c.cardinality > 0) {
+                out.keys_.push_back(keys_[i]);
+                out.containers_.push_back(std::move(c));
+            }
+            i++;
+            j++;
+        }
+    }
+    return out;
+}
+
+RoaringBitmap RoaringBitmap::or_(const RoaringBitmap& other) const {
+    RoaringBitmap out;
+    size_t i = 0, j = 0;
+    while (i < keys_.size() || j < other.keys_.size()) {
+        if (j == other.keys_.size() || (i < keys_.size() && keys_[i] < other.keys_[j])) {
+            out.keys_.push_back(keys_[i]);
+            out.containers_.push_back(containers_[i]);
+            i++;
+        } else if (i == keys_.size() || other.keys_[j] < keys_[i]) {
+            out.keys_.push_back(other.keys_[j]);
+            out.containers_.push_back(other.containers_[j]);
+            j++;
+        } else {
+            out.keys_.push_back(keys_[i]);
+            out.containers_.push_back(unite(containers_[i], other.containers_[j]));
+            i++;
+            j++;
+        }
+    }
+    return out;
+}
+
+RoaringBitmap RoaringBitmap::andnot(const RoaringBitmap& other) const {
+    RoaringBitmap out;
+    size_t j = 0;
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        while (j < other.keys_.size() && other.keys_[j] < keys_[i]) j++;
+        if (j < other.keys_.size() && other.keys_[j] == keys_[i]) {
+            Container c = subtract(containers_[i], other.containers_[j]);
+            if (c.cardinality > 0) {
+                out.keys_.push_back(keys_[i]);
+                out.containers_.push_back(std::move(c));
+            }
+        } else {
+            out.keys_.push_back(keys_[i]);
+            out.containers_.push_back(containers_[i]);
+        }
+    }
+    return out;
+}
+
+void RoaringBitmap::for_each(const std::function<void(uint32_t)>& fn) const {
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        containers_[i].for_each(static_cast<uint32_t>(keys_[i]) << 16, fn);
+    }
+}
+
+std::vector<uint32_t> RoaringBitmap::to_vector() const {
+    std::vector<uint32_t> out;
+    out.reserve(cardinality());
+    for_each([&out](uint32_t v) { out.push_back(v); });
+    return out;
+}
+
+size_t RoaringBitmap::memory_bytes() const {
+    size_t total = keys_.capacity() * sizeof(uint16_t) + containers_.capacity() * sizeof(Container);
+    for (const auto& c : containers_) {
+        total += c.is_bitset ? BITSET_WORDS * sizeof(uint64_t) : c.array.capacity() * sizeof(uint16_t);
+    }
+    return total;
+}
+
+} // namespace metricstream
@@ -0,0 +1,190 @@
+#include "rollup_store.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace metricstream {
+
+int64_t rollup_bucket_end(int64_t ts, int64_t resolution_ms) {
+    int64_t q = ts / resolution_ms;
+    if (ts % resolution_ms != 0 && ts > 0) {
+        q++;  // ceiling division
+    }
+    return q * resolution_ms;
+}
+
+void fold_rollup(const Sample* samples, size_t count, int64_t resolution_ms, std::vector<RollupPoint>& out) {
+    for (size_t i = 0; i < count; ++i) {
+        int64_t end = rollup_bucket_end(samples[i].timestamp_ms, resolution_ms);
+        if (out.empty() || out.back().timestamp_ms != end) {
+            out.push_back(RollupPoint{end, Aggregate{}});
+        }
+        Aggregate& agg = out.back().aggregate;
+        double v = samples[i].value;
+        agg.sum += v;
+        agg.min = std::min(agg.min, v);
+        agg.max = std::max(agg.max, v);
+        agg.count++;
+    }
+}
+
+void merge_rollup_points(std::vector<RollupPoint>& points) {
+    std::stable_sort(points.begin(), points.end(),
+                     [](const RollupPoint& a, const RollupPoint& b) { return a.timestamp_ms < b.timestamp_ms; });
+    size_t kept = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (kept > 0 && points[kept - 1].timestamp_ms == points[i].timestamp_ms) {
+            if (points[i].complete) {
+                points[kept - 1] = points[i];
+            } else {
+                points[kept - 1].aggregate.merge(points[i].aggregate);
+            }
+        } else {
+            points[kept++] = points[i];
+        }
+    }
+    points.resize(kept);
+}
+
+RollupStore::RollupStore(const std::string& directory, int64_t resolution_ms, int64_t block_duration_ms,
+                         BlockCache* cache, const CompactionOptions& compaction)
+    : blocks_(directory, block_duration_ms, cache),
+      resolution_ms_(resolution_ms),
+      compactor_(blocks_, compaction, &RollupStore::merge_fields) {
+    if (resolution_ms_ <= 0) {
+        throw std::invalid_argument("Rollup resolution must be positive");
+    }
+}
+
+SeriesId RollupStore::field_id(SeriesId id, int field) {
+    // Pseudo-series IDs only live in this tier's blocks, never in the tag index
+    return id ^ (0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(field + 1));
+}
+
+void RollupStore::append_point(SeriesId id, const RollupPoint& point, SeriesSamples& fields) {
+    const Aggregate& agg = point.aggregate;
+    fields[field_id(id, SUM)].push_back(Sample{point.timestamp_ms, agg.sum});
+    fields[field_id(id, MIN)].push_back(Sample{point.timestamp_ms, agg.min});
+    fields[field_id(id, MAX)].push_back(Sample{point.timestamp_ms, agg.max});
+    double count = static_cast<double>(agg.count);
+    fields[field_id(id, COUNT)].push_back(Sample{point.timestamp_ms, point.complete ? -count : count});
+}
+
+bool RollupStore::decode(SeriesId id, const SeriesSamples& fields, std::vector<RollupPoint>& out) {
+    const std::vector<Sample>* columns[FIELD_COUNT];
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        auto it = fields.find(field_id(id, field));
+        if (it == fields.end() && field == SUM) {
+            return false;
+        }
+        // All four fields come from the same blocks in the same order
+        if (it == fields.end() || (field != SUM && it->second.size() != columns[SUM]->size())) {
+            throw std::runtime_error("Rollup fields out of step for series " + std::to_string(id));
+        }
+        columns[field] = &it->second;
+    }
+    const auto& sums = *columns[SUM];
+
+    for (size_t i = 0; i < sums.size(); ++i) {
+        Aggregate agg;
+        agg.sum = sums[i].value;
+        agg.min = (*columns[MIN])[i].value;
+        agg.max = (*columns[MAX])[i].value;
+        double count = (*columns[COUNT])[i].value;
+        bool complete = count < 0;
+        agg.count = static_cast<uint64_t>(complete ? -count : count);
+        out.push_back(RollupPoint{sums[i].timestamp_ms, agg, complete});
+    }
+    return !sums.empty();
+}
+
+void RollupStore::merge_fields(SeriesSamples& fields) {
+    // Inputs are concatenated in sequence order, as reads see them, so the
+    // merged point of a bucket is what a read would have returned
+    SeriesSamples merged;
+    std::vector<RollupPoint> points;
+    for (const auto& entry : fields) {
+        if (merged.count(entry.first)) {
+            continue;
+        }
+        // The series is whichever one has all four fields
+        bool found = false;
+        for (int field = 0; field < FIELD_COUNT && !found; ++field) {
+            SeriesId id = entry.first ^ field_id(0, field);
+            found = true;
+            for (int other = 0; other < FIELD_COUNT && found; ++other) {
+                found = fields.count(field_id(id, other)) > 0;
+            }
+            if (!found) {
+                continue;
+            }
+            points.clear();
+            decode(id, fields, points);
+            merge_rollup_points(points);
+            for (const auto& point : points) {
+                append_point(id, point, merged);
+            }
+        }
+        if (!found) {
+            throw std::runtime_error("Rollup block has a partial series " + std::to_string(entry.first));
+        }
+    }
+    fields.swap(merged);
+}
+
+void RollupStore::add(const SeriesSamples& samples) {
+    write(samples, false);
+}
+
+void RollupStore::replace(const SeriesSamples& samples) {
+    write(samples, true);
+}
+
+void RollupStore::write(const SeriesSamples& samples, bool complete) {
+    // Group points by the store's block bucket: a block must not span two
+    std::map<int64_t, SeriesSamples> by_bucket;
+    std::vector<RollupPoint> points;
+    for (const auto& [id, series_samples] : samples) {
+        points.clear();
+        fold_rollup(series_samples.data(), series_samples.size(), resolution_ms_, points);
+        for (auto& point : points) {
+            point.complete = complete;
+            append_point(id, point, by_bucket[blocks_.bucket_start(point.timestamp_ms)]);
+        }
+    }
+
+    for (const auto& [bucket, bucket_samples] : by_bucket) {
+        std::vector<SeriesDescriptor> descriptors;
+        descriptors.reserve(bucket_samples.size());
+        for (const auto& entry : bucket_samples) {
+            descriptors.push_back(SeriesDescriptor{entry.first, "", {}});
+        }
+        compactor_.record_flush(blocks_.add_block(descriptors, bucket_samples).size_bytes);
+    }
+}
+
+size_t RollupStore::read(const std::vector<SeriesId>& ids, int64_t start_ts, int64_t end_ts,
+                         SeriesRollups& out) const {
+    std::vector<SeriesId> field_ids;
+    field_ids.reserve(ids.size() * FIELD_COUNT);
+    for (SeriesId id : ids) {
+        for (int field = 0; field < FIELD_COUNT; ++field) {
+            field_ids.push_back(field_id(id, field));
+        }
+    }
+
+    SeriesSamples fields;
+    size_t blocks_read = blocks_.read(field_ids, start_ts, end_ts, fields);
+
+    std::vector<RollupPoint> points;
+    for (SeriesId id : ids) {
+        points.clear();
+        if (decode(id, fields, points)) {
+            std::vector<RollupPoint>& merged = out[id];
+            merged.insert(merged.end(), points.begin(), points.end());
+            merge_rollup_points(merged);
+        }
+    }
+    return blocks_read;
+}
+
+} // namespace metricstream
@@ -0,0 +1,203 @@
+#include "sampling_profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdexcept>
+#include <sys/time.h>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace metricstream {
+
+namespace {
+
+// backtrace() frames belonging to the handler itself and the kernel's signal
+// return trampoline; the interrupted code starts after them
+constexpr int HANDLER_FRAMES = 2;
+
+void set_timer(int hz) {
+    itimerval timer{};
+    if (hz > 0) {
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = 1000000 / hz;
+        timer.it_value = timer.it_interval;
+    }
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        throw std::runtime_error(std::string("setitimer failed: ") + std::strerror(errno));
+    }
+}
+
+// Function name for a frame; return addresses are looked up one byte back
+// so a call at the very end of a function is attributed to that function
+std::string symbolize(void* frame, bool is_leaf) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(frame) - (is_leaf ? 0 : 1);
+    Dl_info info{};
+    if (dladdr(reinterpret_cast<void*>(address), &info) == 0) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(address));
+        return buf;
+    }
+    std::string name;
+    if (info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        name = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+    } else {
+        const char* module = info.dli_fname ? info.dli_fname : "?";
+        const char* slash = std::strrchr(module, '/');
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "+0x%llx",
+                      static_cast<unsigned long long>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+        name = std::string(slash ? slash + 1 : module) + buf;
+    }
+    std::replace(name.begin(), name.end(), ';', ':');  // ';' separates frames
+    return name;
+}
+
+} // namespace
+
+SamplingProfiler& SamplingProfiler::instance() {
+    // Never destroyed: a late SIGPROF may still reach the handler at exit
+    static SamplingProfiler* profiler = new SamplingProfiler();
+    return *profiler;
+}
+
+void SamplingProfiler::on_sigprof(int, siginfo_t*, void*) {
+    SamplingProfiler& self = instance();
+    int saved_errno = errno;
+    self.handlers_active_.fetch_add(1);
+    if (self.running_.load()) {
+        size_t index = self.next_sample_.fetch_add(1, std::memory_order_relaxed);
+        if (index < MAX_SAMPLES) {
+            Sample& sample = self.samples_[index];
+            int depth = backtrace(sample.frames, MAX_DEPTH);
+            sample.depth.store(depth, std::memory_order_release);
+        }
+    }
+    self.handlers_active_.fetch_sub(1);
+    errno = saved_errno;
+}
+
+void SamplingProfiler::install_handler() {
+    if (handler_installed_) {
+        return;
+    }
+    // The first backtrace() loads the unwinder (dlopen, malloc), which is not
+    // safe inside a signal handler, so do it here
+    void* warm_up[4];
+    backtrace(warm_up, 4);
+
+    // Left installed after the profile: a SIGPROF still pending when the
+    // timer is disarmed would otherwise kill the process
+    struct sigaction action{};
+    action.sa_sigaction = &SamplingProfiler::on_sigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+        throw std::runtime_error(std::string("sigaction(SIGPROF) failed: ") + std::strerror(errno));
+    }
+    handler_installed_ = true;
+}
+
+std::string SamplingProfiler::profile(std::chrono::milliseconds duration, int hz,
+                                      const std::function<bool()>& keep_going) {
+    if (duration.count() <= 0) {
+        throw std::invalid_argument("Profile duration must be positive");
+    }
+    if (hz < 1 || hz > MAX_HZ) {
+        throw std::invalid_argument("Sampling frequency must be between 1 and " + std::to_string(MAX_HZ) + " Hz");
+    }
+    std::unique_lock<std::mutex> lock(profile_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        throw std::runtime_error("A profile is already running");
+    }
+
+    install_handler();
+    samples_ = std::make_unique<Sample[]>(MAX_SAMPLES);
+    next_sample_.store(0, std::memory_order_relaxed);
+    running_.store(true);
+    try {
+        set_timer(hz);
+    } catch (...) {
+        running_.store(false);
+        samples_.reset();
+        throw;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < deadline && (!keep_going || keep_going())) {
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(remaining,
+                                                                                 std::chrono::milliseconds(100)));
+    }
+
+    set_timer(0);
+    // A handler that entered before this store may still be writing its
+    // sample; one that enters after it sees running_ == false
+    running_.store(false);
+    while (handlers_active_.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    std::string folded = fold_samples(next_sample_.load(std::memory_order_relaxed));
+    samples_.reset();
+    return folded;
+}
+
+std::string SamplingProfiler::fold_samples(size_t count) const {
+    size_t kept = std::min(count, MAX_SAMPLES);
+    std::unordered_map<void*, std::string> names;  // frame -> symbol, each symbolized once
+    std::unordered_map<std::string, uint64_t> stacks;
+
+    std::string stack;
+    for (size_t i = 0; i < kept; ++i) {
+        const Sample& sample = samples_[i];
+        int depth = sample.depth.load(std::memory_order_acquire);
+        if (depth <= HANDLER_FRAMES) {
+            continue;
+        }
+        // Root first, as the folded format expects
+        stack.clear();
+        for (int f = depth - 1; f >= HANDLER_FRAMES; --f) {
+            bool is_leaf = f == HANDLER_FRAMES;
+            void* key = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(sample.frames[f]) - (is_leaf ? 0 : 1));
+            auto it = names.find(key);
+            if (it == names.end()) {
+                it = names.emplace(key, symbolize(sample.frames[f], is_leaf)).first;
+            }
+            if (!stack.empty()) {
+                stack += ';';
+            }
+            stack += it->second;
+        }
+        ++stacks[stack];
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> sorted(stacks.begin(), stacks.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+
+    std::string out;
+    for (const auto& [folded, samples] : sorted) {
+        out += folded;
+        out += ' ';
+        out += std::to_string(samples);
+        out += '\n';
+    }
+    if (count > kept) {
+        out += "[dropped] " + std::to_string(count - kept) + '\n';
+    }
+    return out;
+}
+
+} // namespace metricstream
@@ -0,0 +1,189 @@
+#include "series_registry.h"
+#include "logging.h"
+#include <algorithm>
+#include <mutex>
+
+namespace metricstream {
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+inline uint64_t fnv1a(uint64_t hash, const std::string& s) {
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a(uint64_t hash, unsigned char c) {
+    hash ^= c;
+    return hash * FNV_PRIME;
+}
+
+// Final avalanche so shard selection and HLL ranks see well-mixed bits
+inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+SeriesRegistry::SeriesRegistry(size_t tenant_cardinality_warning)
+    : tenant_cardinality_warning_(tenant_cardinality_warning) {}
+
+SeriesRegistry::SortedTags SeriesRegistry::sort_tags(const Tags& tags) {
+    SortedTags sorted;
+    sorted.reserve(tags.size());
+    for (const auto& entry : tags) {
+        sorted.push_back(&entry);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto* a, const auto* b) { return a->first < b->first; });
+    return sorted;
+}
+
+SeriesId SeriesRegistry::hash_canonical(const std::string& name, const SortedTags& tags) {
+    // Equivalent to hashing name{k1="v1",k2="v2"} with NUL separators, so no
+    // key/value concatenation can alias another series
+    uint64_t hash = fnv1a(FNV_OFFSET, name);
+    for (const auto* tag : tags) {
+        hash = fnv1a(hash, '\0');
+        hash = fnv1a(hash, tag->first);
+        hash = fnv1a(hash, '=');
+        hash = fnv1a(hash, tag->second);
+    }
+    return mix64(hash);
+}
+
+SeriesId SeriesRegistry::compute_series_id(const std::string& name, const Tags& tags) {
+    return hash_canonical(name, sort_tags(tags));
+}
+
+bool SeriesRegistry::same_series(const SeriesDescriptor& desc, const std::string& name,
+                                 const SortedTags& tags) {
+    if (desc.name != name || desc.tags.size() != tags.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < tags.size(); ++i) {
+        if (desc.tags[i].first != tags[i]->first || desc.tags[i].second != tags[i]->second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SeriesRegistry::Resolution SeriesRegistry::resolve(const std::string& name, const Tags& tags,
+                                                   const std::string& tenant) {
+    SortedTags sorted = sort_tags(tags);
+    SeriesId id = hash_canonical(name, sorted);
+
+    // Fast path: series already known (shared lock only)
+    {
+        const Shard& shard = shard_for(id);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.series.find(id);
+        if (it != shard.series.end() && same_series(it->second, name, sorted)) {
+            lock.unlock();
+            record_tenant_series(tenant, id, false);
+            return {id, false};
+        }
+    }
+
+    // Slow path: register it. A 64-bit collision between two different series
+    // is astronomically rare; if it happens, probe to the next free ID.
+    while (true) {
+        Shard& shard = shard_for(id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.series.find(id);
+        if (it == shard.series.end()) {
+            SeriesDescriptor desc;
+            desc.id = id;
+            desc.name = name;
+            desc.tags.reserve(sorted.size());
+            for (const auto* tag : sorted) {
+                desc.tags.emplace_back(tag->first, tag->second);
+            }
+            shard.series.emplace(id, std::move(desc));
+            lock.unlock();
+
+            series_count_.fetch_add(1, std::memory_order_relaxed);
+            record_tenant_series(tenant, id, true);
+            return {id, true};
+        }
+        if (same_series(it->second, name, sorted)) {
+            lock.unlock();
+            record_tenant_series(tenant, id, false);
+            return {id, false};  // Lost the race to another inserting thread
+        }
+        MS_LOG_WARN("[SeriesRegistry] Series ID collision on {} for metric {}, probing", id, name);
+        id = mix64(id + 1);
+    }
+}
+
+std::optional<SeriesDescriptor> SeriesRegistry::lookup(SeriesId id) const {
+    const Shard& shard = shard_for(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.series.find(id);
+    if (it == shard.series.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+SeriesRegistry::TenantStats& SeriesRegistry::tenant_stats(const std::string& tenant) {
+    {
+        std::shared_lock<std::shared_mutex> lock(tenants_mutex_);
+        auto it = tenants_.find(tenant);
+        if (it != tenants_.end()) {
+            return *it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(tenants_mutex_);
+    auto& stats = tenants_[tenant];
+    if (!stats) {
+        stats = std::make_unique<TenantStats>();
+    }
+    return *stats;
+}
+
+void SeriesRegistry::record_tenant_series(const std::string& tenant, SeriesId id, bool created) {
+    TenantStats& stats = tenant_stats(tenant);
+    stats.sketch.add(id);  // IDs are already well-mixed hashes
+
+    // A full estimate walks every register, so only re-check the warning
+    // threshold periodically as new series arrive
+    if (!created) {
+        return;
+    }
+    uint64_t seen = stats.new_series.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (seen % 1024 == 0 && !stats.warned.load(std::memory_order_relaxed)) {
+        double estimate = stats.sketch.estimate();
+        if (estimate >= static_cast<double>(tenant_cardinality_warning_) &&
+            !stats.warned.exchange(true)) {
+            MS_LOG_WARN("[SeriesRegistry] Tenant '{}' cardinality ~{} series exceeds {}", tenant,
+                        static_cast<uint64_t>(estimate), tenant_cardinality_warning_);
+        }
+    }
+}
+
+double SeriesRegistry::tenant_cardinality(const std::string& tenant) const {
+    std::shared_lock<std::shared_mutex> lock(tenants_mutex_);
+    auto it = tenants_.find(tenant);
+    return it == tenants_.end() ? 0.0 : it->second->sketch.estimate();
+}
+
+std::vector<std::pair<std::string, double>> SeriesRegistry::tenant_cardinalities() const {
+    std::vector<std::pair<std::string, double>> result;
+    std::shared_lock<std::shared_mutex> lock(tenants_mutex_);
+    result.reserve(tenants_.size());
+    for (const auto& [tenant, stats] : tenants_) {
+        result.emplace_back(tenant, stats->sketch.estimate());
+    }
+    return result;
+}
+
+} // namespace metricstream
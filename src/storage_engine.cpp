@@ -0,0 +1,551 @@
+#include "storage_engine.h"
+#include "logging.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+// Sorts by timestamp keeping the last copy of each one: callers append older
+// sources first, so the latest write wins
+void keep_latest(std::vector<Sample>& points) {
+    std::stable_sort(points.begin(), points.end(),
+                     [](const Sample& a, const Sample& b) { return a.timestamp_ms < b.timestamp_ms; });
+    size_t kept = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (kept > 0 && points[kept - 1].timestamp_ms == points[i].timestamp_ms) {
+            points[kept - 1] = points[i];
+        } else {
+            points[kept++] = points[i];
+        }
+    }
+    points.resize(kept);
+}
+
+CompactionOptions effective_compaction(const StorageEngine::Options& options) {
+    // The head still flushes into a window for head_window_ms after it
+    // ends, and late samples keep arriving for the out-of-order window
+    CompactionOptions compaction = options.compaction;
+    compaction.window_grace_ms =
+        std::max({compaction.window_grace_ms, options.head_window_ms, options.out_of_order_window_ms});
+    return compaction;
+}
+
+} // namespace
+
+StorageEngine::StorageEngine(const Options& options)
+    : options_(options),
+      block_cache_(options.block_cache_bytes > 0 ? std::make_unique<BlockCache>(options.block_cache_bytes)
+                                                 : nullptr),
+      blocks_(options.data_dir, options.block_duration_ms, block_cache_.get()),
+      head_(options.block_duration_ms, options.out_of_order_window_ms),
+      compactor_(blocks_, effective_compaction(options)) {
+    // Rebuild the in-memory tag index from labels persisted in the blocks
+    for (const auto& desc : blocks_.loaded_series()) {
+        register_series(desc);
+    }
+
+    std::vector<int64_t> resolutions = options_.rollup_resolutions_ms;
+    std::sort(resolutions.begin(), resolutions.end());
+    if (!resolutions.empty()) {
+        // Per-block bounds are enough: an overestimate only rebuilds a bucket
+        for (const auto& block : blocks_.all_blocks()) {
+            for (const auto& desc : block->series()) {
+                int64_t& until = rolled_up_until_.emplace(desc.id, INT64_MIN).first->second;
+                until = std::max(until, block->meta().max_ts);
+            }
+        }
+    }
+    for (int64_t resolution : resolutions) {
+        // Coarse tiers get longer blocks so a long range opens fewer files
+        int64_t block_duration = std::max(options_.block_duration_ms, resolution * 24);
+        std::string directory = options_.data_dir + "/rollup_" + std::to_string(resolution) + "ms";
+        rollups_.push_back(std::make_unique<RollupStore>(directory, resolution, block_duration, block_cache_.get(),
+                                                         effective_compaction(options_)));
+        if (rollups_.back()->block_count() == 0 && blocks_.block_count() > 0) {
+            backfill_rollup(*rollups_.back());
+        }
+    }
+
+    if (options_.flush_interval_ms > 0) {
+        running_ = true;
+        flusher_thread_ = std::thread(&StorageEngine::flusher_loop, this);
+    }
+    compactor_.start();
+    for (const auto& rollup : rollups_) {
+        rollup->compactor().start();
+    }
+}
+
+StorageEngine::~StorageEngine() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_wait_mutex_);
+        running_ = false;
+    }
+    flusher_cv_.notify_all();
+    if (flusher_thread_.joinable()) {
+        flusher_thread_.join();
+    }
+    compactor_.stop();
+    for (const auto& rollup : rollups_) {
+        rollup->compactor().stop();
+    }
+
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        MS_LOG_ERROR("[Storage] Flush on shutdown failed: {}", e.what());
+    }
+}
+
+void StorageEngine::register_series(const SeriesDescriptor& desc) {
+    {
+        std::shared_lock<std::shared_mutex> lock(series_mutex_);
+        if (series_.count(desc.id)) {
+            return;
+        }
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(series_mutex_);
+        if (!series_.emplace(desc.id, desc).second) {
+            return;
+        }
+    }
+    index_.add_series(desc.id, desc.name, desc.tag_map());
+}
+
+void StorageEngine::ingest(const DecodedBatch& batch) {
+    for (const auto& decoded : batch.series) {
+        register_series(decoded.descriptor);
+    }
+    int64_t oldest = INT64_MAX;
+    int64_t newest = INT64_MIN;
+    for (const auto& point : batch.points) {
+        append_sample(point.series_id, point.timestamp_ms, point.value);
+        oldest = std::min(oldest, point.timestamp_ms);
+        newest = std::max(newest, point.timestamp_ms);
+    }
+    if (write_observer_ && !batch.points.empty()) {
+        write_observer_(oldest, newest);
+    }
+}
+
+void StorageEngine::append(SeriesId id, int64_t timestamp_ms, double value) {
+    append_sample(id, timestamp_ms, value);
+    if (write_observer_) {
+        write_observer_(timestamp_ms, timestamp_ms);
+    }
+}
+
+void StorageEngine::append_sample(SeriesId id, int64_t timestamp_ms, double value) {
+    head_.append(id, timestamp_ms, value);
+
+    if (head_.sample_count() > options_.max_head_samples) {
+        if (running_) {
+            flusher_cv_.notify_one();
+        } else {
+            flush_head(head_newest());
+        }
+    }
+}
+
+int64_t StorageEngine::head_newest() const {
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::min(head_.max_timestamp(), now_ms);
+}
+
+void StorageEngine::flusher_loop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(flusher_wait_mutex_);
+            flusher_cv_.wait_for(lock, std::chrono::milliseconds(options_.flush_interval_ms), [this] {
+                return !running_ || head_.sample_count() > options_.max_head_samples;
+            });
+            if (!running_) {
+                return;
+            }
+        }
+
+        int64_t newest = head_newest();
+        if (newest == INT64_MIN) {
+            continue;
+        }
+        // Over the memory bound: spill everything but the newest samples
+        int64_t cutoff = head_.sample_count() > options_.max_head_samples
+                             ? newest
+                             : newest - options_.head_window_ms;
+        try {
+            flush_head(cutoff);
+        } catch (const std::exception& e) {
+            // Chunks stay in the head and are retried on the next pass
+            MS_LOG_ERROR("[Storage] Head flush failed: {}", e.what());
+        }
+    }
+}
+
+void StorageEngine::flush_head(int64_t cutoff_ts) {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+
+    HeadBlock::FlushBatch batch = head_.collect_flushable(cutoff_ts);
+    if (batch.empty()) {
+        evict_idle_series();
+        return;
+    }
+
+    // Out-of-order samples get blocks of their own; compaction merges them
+    SeriesSamples flushed;  // every written sample, for the rollup tiers
+    write_buckets(batch.buckets, flushed);
+    write_buckets(batch.out_of_order_buckets, flushed);
+    if (!batch.out_of_order_buckets.empty()) {
+        // Rollup folding needs each series in timestamp order, and a late
+        // rewrite flushed with its original must count once
+        for (auto& [id, points] : flushed) {
+            keep_latest(points);
+        }
+    }
+
+    // Rollup readers fold head samples into the tiers, so the tier blocks and
+    // the head release must become visible together
+    std::unique_lock<std::shared_mutex> rollup_lock(rollup_mutex_);
+    for (auto& rollup : rollups_) {
+        try {
+            add_to_rollup(*rollup, flushed);
+        } catch (const std::exception& e) {
+            // Raw blocks are the source of truth; a retry would double-count
+            // the buckets already written, so the tier is left short instead
+            MS_LOG_ERROR("[Storage] Rollup {}ms write failed: {}", rollup->resolution_ms(), e.what());
+        }
+    }
+    for (const auto& [id, points] : flushed) {
+        if (!points.empty()) {
+            int64_t& until = rolled_up_until_.emplace(id, INT64_MIN).first->second;
+            until = std::max(until, points.back().timestamp_ms);
+        }
+    }
+
+    // Blocks are visible now; drop the chunks from memory
+    head_.release(batch);
+    evict_idle_series();
+    compactor_.notify();
+    for (const auto& rollup : rollups_) {
+        rollup->compactor().notify();
+    }
+}
+
+void StorageEngine::evict_idle_series() {
+    int64_t newest = head_newest();
+    if (newest == INT64_MIN) {
+        return;
+    }
+    // An evicted series forgets its newest timestamp, so samples for it are
+    // not judged late until it is idle for the out-of-order window too
+    size_t evicted = head_.evict_idle(newest - std::max(options_.head_window_ms, options_.out_of_order_window_ms));
+    if (evicted > 0) {
+        MS_LOG_DEBUG("[Storage] Evicted {} idle series from the head", evicted);
+    }
+}
+
+void StorageEngine::write_buckets(std::map<int64_t, SeriesSamples>& buckets, SeriesSamples& flushed) {
+    // One block per bucket keeps the single-bucket-per-block invariant
+    for (auto& [bucket, bucket_samples] : buckets) {
+        std::vector<SeriesDescriptor> labels;
+        {
+            std::shared_lock<std::shared_mutex> series_lock(series_mutex_);
+            for (auto it = bucket_samples.begin(); it != bucket_samples.end();) {
+                auto desc_it = series_.find(it->first);
+                if (desc_it == series_.end()) {
+                    MS_LOG_WARN("[Storage] Dropping {} samples for unknown series {}", it->second.size(), it->first);
+                    it = bucket_samples.erase(it);
+                    continue;
+                }
+                labels.push_back(desc_it->second);
+                ++it;
+            }
+        }
+        if (bucket_samples.empty()) {
+            continue;
+        }
+
+        BlockMeta meta = blocks_.add_block(labels, bucket_samples);
+        compactor_.record_flush(meta.size_bytes);
+        MS_LOG_INFO("[Storage] Wrote block {} ({} series, {} samples, {} bytes)", meta.path, meta.series_count,
+                    meta.sample_count, meta.size_bytes);
+
+        if (!rollups_.empty()) {
+            for (const auto& [id, points] : bucket_samples) {
+                auto& dest = flushed[id];
+                dest.insert(dest.end(), points.begin(), points.end());
+            }
+        }
+    }
+}
+
+void StorageEngine::flush() {
+    flush_head(INT64_MAX);
+}
+
+size_t StorageEngine::compact() {
+    size_t merges = 0;
+    while (compactor_.compact_once()) {
+        merges++;
+    }
+    for (const auto& rollup : rollups_) {
+        while (rollup->compactor().compact_once()) {
+            merges++;
+        }
+    }
+    return merges;
+}
+
+void StorageEngine::backfill_rollup(RollupStore& rollup) {
+    // A new tier over existing data: fold every raw block window once, with
+    // rewritten samples deduplicated across the window's blocks
+    std::map<int64_t, std::set<SeriesId>> windows;
+    auto blocks = blocks_.all_blocks();
+    for (const auto& block : blocks) {
+        auto& ids = windows[blocks_.bucket_start(block->meta().min_ts)];
+        for (const auto& desc : block->series()) {
+            ids.insert(desc.id);
+        }
+    }
+    for (const auto& [window, ids] : windows) {
+        SeriesSamples samples;
+        blocks_.read(std::vector<SeriesId>(ids.begin(), ids.end()), window,
+                     window + blocks_.block_duration_ms() - 1, samples);
+        for (auto& [id, points] : samples) {
+            keep_latest(points);
+        }
+        rollup.add(samples);
+    }
+    MS_LOG_INFO("[Storage] Backfilled {}ms rollups from {} blocks", rollup.resolution_ms(), blocks.size());
+}
+
+int64_t StorageEngine::rolled_up_until(SeriesId id) const {
+    auto it = rolled_up_until_.find(id);
+    return it == rolled_up_until_.end() ? INT64_MIN : it->second;
+}
+
+std::vector<Sample> StorageEngine::rebuild_buckets(SeriesId id, const std::set<int64_t>& bucket_ends,
+                                                   int64_t resolution_ms, const std::vector<Sample>& recent) const {
+    SeriesSamples raw;
+    blocks_.read({id}, *bucket_ends.begin() - resolution_ms + 1, *bucket_ends.rbegin(), raw);
+    std::vector<Sample>& points = raw[id];
+    for (const Sample& sample : recent) {
+        if (bucket_ends.count(rollup_bucket_end(sample.timestamp_ms, resolution_ms))) {
+            points.push_back(sample);
+        }
+    }
+    keep_latest(points);
+
+    std::vector<Sample> rebuilt;
+    for (const Sample& sample : points) {
+        if (bucket_ends.count(rollup_bucket_end(sample.timestamp_ms, resolution_ms))) {
+            rebuilt.push_back(sample);
+        }
+    }
+    return rebuilt;
+}
+
+void StorageEngine::add_to_rollup(RollupStore& rollup, const SeriesSamples& flushed) const {
+    // A sample at or before the newest one already rolled up may rewrite a
+    // sample the tier counted, so its bucket is rebuilt whole from the raw
+    // blocks (which already hold this flush) and replaces the tier's points.
+    // Newer samples are merged in as partial buckets.
+    const int64_t resolution = rollup.resolution_ms();
+    SeriesSamples partial;
+    SeriesSamples rebuilt;
+    bool any_rewrites = false;
+    for (const auto& [id, points] : flushed) {
+        int64_t until = rolled_up_until(id);
+        if (points.empty() || points.front().timestamp_ms > until) {
+            continue;
+        }
+        any_rewrites = true;
+        std::set<int64_t> bucket_ends;
+        for (const Sample& sample : points) {
+            if (sample.timestamp_ms > until) break;
+            bucket_ends.insert(rollup_bucket_end(sample.timestamp_ms, resolution));
+        }
+        for (const Sample& sample : points) {
+            if (!bucket_ends.count(rollup_bucket_end(sample.timestamp_ms, resolution))) {
+                partial[id].push_back(sample);
+            }
+        }
+        rebuilt[id] = rebuild_buckets(id, bucket_ends, resolution, {});
+    }
+    if (!any_rewrites) {
+        rollup.add(flushed);
+        return;
+    }
+    for (const auto& [id, points] : flushed) {
+        if (!rebuilt.count(id)) {
+            partial[id] = points;
+        }
+    }
+    rollup.add(partial);
+    rollup.replace(rebuilt);
+}
+
+std::vector<int64_t> StorageEngine::rollup_resolutions() const {
+    std::vector<int64_t> resolutions;
+    for (const auto& rollup : rollups_) {
+        resolutions.push_back(rollup->resolution_ms());
+    }
+    return resolutions;
+}
+
+std::vector<StorageEngine::RollupResult> StorageEngine::query_rollups(const std::vector<SeriesId>& ids,
+                                                                      int64_t resolution_ms,
+                                                                      int64_t start_ts, int64_t end_ts,
+                                                                      QueryStats* stats) const {
+    auto rollup = std::find_if(rollups_.begin(), rollups_.end(),
+                               [resolution_ms](const auto& r) { return r->resolution_ms() == resolution_ms; });
+    if (rollup == rollups_.end()) {
+        throw std::invalid_argument("No rollup tier at " + std::to_string(resolution_ms) + "ms");
+    }
+
+    SeriesRollups points;
+    size_t blocks_read = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(rollup_mutex_);
+        blocks_read = (*rollup)->read(ids, start_ts, end_ts, points);
+
+        // Samples still in the head go into the same buckets; a bucket where
+        // the head may rewrite a rolled-up sample is rebuilt from raw data
+        std::vector<Sample> recent;
+        for (SeriesId id : ids) {
+            recent.clear();
+            head_.read(id, start_ts - resolution_ms + 1, end_ts, recent);
+            if (recent.empty()) {
+                continue;
+            }
+            keep_latest(recent);
+            auto& series_points = points[id];
+            int64_t until = rolled_up_until(id);
+            if (recent.front().timestamp_ms > until) {
+                fold_rollup(recent.data(), recent.size(), resolution_ms, series_points);
+                merge_rollup_points(series_points);
+                continue;
+            }
+
+            std::set<int64_t> bucket_ends;
+            std::vector<Sample> fresh;
+            for (const Sample& sample : recent) {
+                if (sample.timestamp_ms <= until) {
+                    bucket_ends.insert(rollup_bucket_end(sample.timestamp_ms, resolution_ms));
+                }
+            }
+            for (const Sample& sample : recent) {
+                if (!bucket_ends.count(rollup_bucket_end(sample.timestamp_ms, resolution_ms))) {
+                    fresh.push_back(sample);
+                }
+            }
+            std::vector<Sample> rebuilt = rebuild_buckets(id, bucket_ends, resolution_ms, recent);
+            size_t first_rebuilt = series_points.size();
+            fold_rollup(rebuilt.data(), rebuilt.size(), resolution_ms, series_points);
+            for (size_t i = first_rebuilt; i < series_points.size(); ++i) {
+                series_points[i].complete = true;
+            }
+            fold_rollup(fresh.data(), fresh.size(), resolution_ms, series_points);
+            merge_rollup_points(series_points);
+        }
+    }
+
+    std::vector<RollupResult> results;
+    results.reserve(points.size());
+    size_t total_points = 0;
+    for (SeriesId id : ids) {
+        auto it = points.find(id);
+        if (it == points.end() || it->second.empty()) {
+            continue;
+        }
+        RollupResult result;
+        result.series = series(id).value_or(SeriesDescriptor{id, "", {}});
+        result.points = std::move(it->second);
+        total_points += result.points.size();
+        results.push_back(std::move(result));
+    }
+
+    if (stats) {
+        stats->series_matched = ids.size();
+        stats->blocks_read = blocks_read;
+        stats->samples_returned = total_points;
+    }
+    return results;
+}
+
+std::vector<SeriesId> StorageEngine::select(const std::vector<TagMatcher>& matchers) const {
+    return index_.select(matchers);
+}
+
+std::optional<SeriesDescriptor> StorageEngine::series(SeriesId id) const {
+    std::shared_lock<std::shared_mutex> lock(series_mutex_);
+    auto it = series_.find(id);
+    if (it == series_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::vector<StorageEngine::SeriesResult> StorageEngine::query(const std::vector<TagMatcher>& matchers,
+                                                              int64_t start_ts, int64_t end_ts,
+                                                              QueryStats* stats) const {
+    return query_series(index_.select(matchers), start_ts, end_ts, stats);
+}
+
+std::vector<StorageEngine::SeriesResult> StorageEngine::query_series(const std::vector<SeriesId>& ids,
+                                                                     int64_t start_ts, int64_t end_ts,
+                                                                     QueryStats* stats) const {
+    // Head first: a concurrent flush only moves chunks from the head into a
+    // block, so reading in this order sees every chunk at least once (a copy
+    // in both is deduped below). Reading the blocks first could miss a chunk
+    // flushed and released in between.
+    SeriesSamples recent;
+    for (SeriesId id : ids) {
+        head_.read(id, start_ts, end_ts, recent[id]);
+    }
+
+    SeriesSamples samples;
+    size_t blocks_read = blocks_.read(ids, start_ts, end_ts, samples);
+
+    // Head samples go after block data so they win on duplicates
+    for (auto& [id, points] : recent) {
+        if (!points.empty()) {
+            auto& dest = samples[id];
+            dest.insert(dest.end(), points.begin(), points.end());
+        }
+    }
+
+    std::vector<SeriesResult> results;
+    results.reserve(ids.size());
+    size_t total_samples = 0;
+    for (SeriesId id : ids) {
+        auto it = samples.find(id);
+        if (it == samples.end() || it->second.empty()) {
+            continue;
+        }
+
+        // Several blocks (or blocks plus head) can cover the same bucket, and a
+        // chunk is briefly in both while its block is being made visible
+        keep_latest(it->second);
+
+        SeriesResult result;
+        result.series = series(id).value_or(SeriesDescriptor{id, "", {}});
+        result.samples = std::move(it->second);
+        total_samples += result.samples.size();
+        results.push_back(std::move(result));
+    }
+
+    if (stats) {
+        stats->series_matched = ids.size();
+        stats->blocks_read = blocks_read;
+        stats->samples_returned = total_samples;
+    }
+    return results;
+}
+
+} // namespace metricstream
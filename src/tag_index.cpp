@@ -0,0 +1,210 @@
+#include "tag_index.h"
+#include <algorithm>
+#include <regex>
+#include <mutex>
+
+namespace metricstream {
+
+TagMatcher::TagMatcher(std::string k, std::string v, Op o) : key(std::move(k)), value(std::move(v)), op(o) {
+    if (op == Op::REGEX_MATCH || op == Op::REGEX_NO_MATCH) {
+        regex = std::make_shared<const std::regex>(value);
+    }
+}
+
+bool TagMatcher::matches(const std::string& tag_value) const {
+    switch (op) {
+        case Op::EQUAL: return tag_value == value;
+        case Op::NOT_EQUAL: return tag_value != value;
+        case Op::REGEX_MATCH: return std::regex_match(tag_value, *regex);
+        case Op::REGEX_NO_MATCH: return !std::regex_match(tag_value, *regex);
+    }
+    return false;
+}
+
+bool TagIndex::add_series(SeriesId id, const std::string& name, const Tags& tags) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    if (ordinals_.count(id)) {
+        return false;
+    }
+
+    uint32_t ordinal = static_cast<uint32_t>(series_by_ordinal_.size());
+    ordinals_.emplace(id, ordinal);
+    series_by_ordinal_.push_back(id);
+    all_series_.add(ordinal);
+
+    // Ordinals only grow, so every add() appends to the tail container
+    postings_[NAME_TAG][name].add(ordinal);
+    for (const auto& [key, value] : tags) {
+        postings_[key][value].add(ordinal);
+    }
+    return true;
+}
+
+RoaringBitmap TagIndex::union_of_key(const std::string& key) const {
+    RoaringBitmap result;
+    auto key_it = postings_.find(key);
+    if (key_it == postings_.end()) {
+        return result;
+    }
+    for (const auto& [value, bitmap] : key_it->second) {
+        result = result.or_(bitmap);
+    }
+    return result;
+}
+
+RoaringBitmap TagIndex::equal_postings(const std::string& key, const std::string& value) const {
+    // A missing tag behaves as the empty string, matching Prometheus
+    // selector semantics
+    if (value.empty()) {
+        return all_series_.andnot(union_of_key(key));
+    }
+    auto key_it = postings_.find(key);
+    if (key_it == postings_.end()) return {};
+    auto value_it = key_it->second.find(value);
+    return value_it == key_it->second.end() ? RoaringBitmap{} : value_it->second;
+}
+
+RoaringBitmap TagIndex::regex_postings(const std::string& key, const std::regex& pattern) const {
+    RoaringBitmap result;
+    auto key_it = postings_.find(key);
+    if (key_it != postings_.end()) {
+        for (const auto& [value, bitmap] : key_it->second) {
+            if (std::regex_match(value, pattern)) {
+                result = result.or_(bitmap);
+            }
+        }
+    }
+    if (std::regex_match(std::string(), pattern)) {
+        result = result.or_(all_series_.andnot(union_of_key(key)));
+    }
+    return result;
+}
+
+RoaringBitmap TagIndex::postings_for(const TagMatcher& matcher) const {
+    // Returns the series the matcher ACCEPTS
+    switch (matcher.op) {
+        case TagMatcher::Op::EQUAL: return equal_postings(matcher.key, matcher.value);
+        case TagMatcher::Op::NOT_EQUAL: return all_series_.andnot(equal_postings(matcher.key, matcher.value));
+        case TagMatcher::Op::REGEX_MATCH: return regex_postings(matcher.key, *matcher.regex);
+        case TagMatcher::Op::REGEX_NO_MATCH: return all_series_.andnot(regex_postings(matcher.key, *matcher.regex));
+    }
+    return {};
+}
+
+std::vector<SeriesId> TagIndex::select(const std::vector<TagMatcher>& matchers) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    if (matchers.empty()) {
+        return to_series_ids(all_series_);
+    }
+
+    // Positive matchers (=, =~ on non-empty values) narrow the candidate set
+    // cheaply; negative ones are applied as subtractions from that set.
+    std::vector<RoaringBitmap> positive;
+    std::vector<const TagMatcher*> negative;
+    for (const auto& matcher : matchers) {
+        bool is_negative = matcher.op == TagMatcher::Op::NOT_EQUAL ||
+                           matcher.op == TagMatcher::Op::REGEX_NO_MATCH;
+        if (is_negative) {
+            negative.push_back(&matcher);
+        } else {
+            positive.push_back(postings_for(matcher));
+            if (positive.back().empty()) {
+                return {};  // Intersection is empty, skip the rest
+            }
+        }
+    }
+
+    RoaringBitmap result;
+    if (positive.empty()) {
+        result = all_series_;
+    } else {
+        // Intersect smallest lists first to keep intermediates small
+        std::sort(positive.begin(), positive.end(),
+                  [](const RoaringBitmap& a, const RoaringBitmap& b) {
+                      return a.cardinality() < b.cardinality();
+                  });
+        result = std::move(positive.front());
+        for (size_t i = 1; i < positive.size() && !result.empty(); ++i) {
+            result = result.and_(positive[i]);
+        }
+    }
+
+    for (const TagMatcher* matcher : negative) {
+        if (result.empty()) break;
+        result = result.andnot(matcher->op == TagMatcher::Op::NOT_EQUAL
+                                   ? equal_postings(matcher->key, matcher->value)
+                                   : regex_postings(matcher->key, *matcher->regex));
+    }
+
+    return to_series_ids(result);
+}
+
+std::vector<SeriesId> TagIndex::select(const std::string& name, const Tags& tags) const {
+    std::vector<TagMatcher> matchers;
+    matchers.reserve(tags.size() + 1);
+    matchers.emplace_back(NAME_TAG, name);
+    for (const auto& [key, value] : tags) {
+        matchers.emplace_back(key, value);
+    }
+    return select(matchers);
+}
+
+bool TagIndex::contains(SeriesId id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return ordinals_.count(id) > 0;
+}
+
+std::vector<std::string> TagIndex::tag_values(const std::string& key) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::string> values;
+    auto key_it = postings_.find(key);
+    if (key_it != postings_.end()) {
+        values.reserve(key_it->second.size());
+        for (const auto& entry : key_it->second) {
+            values.push_back(entry.first);
+        }
+    }
+    return values;
+}
+
+size_t TagIndex::series_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return series_by_ordinal_.size();
+}
+
+size_t TagIndex::postings_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto& entry : postings_) {
+        total += entry.second.size();
+    }
+    return total;
+}
+
+size_t TagIndex::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t total = series_by_ordinal_.capacity() * sizeof(SeriesId) +
+                   ordinals_.size() * (sizeof(SeriesId) + sizeof(uint32_t)) +
+                   all_series_.memory_bytes();
+    for (const auto& [key, values] : postings_) {
+        total += key.capacity();
+        for (const auto& [value, bitmap] : values) {
+            total += value.capacity() + bitmap.memory_bytes();
+        }
+    }
+    return total;
+}
+
+std::vector<SeriesId> TagIndex::to_series_ids(const RoaringBitmap& ordinals) const {
+    std::vector<SeriesId> ids;
+    ids.reserve(ordinals.cardinality());
+    ordinals.for_each([&](uint32_t ordinal) {
+        ids.push_back(series_by_ordinal_[ordinal]);
+    });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace metricstream
@@ -1,5 +1,5 @@
 #include "thread_pool.h"
-#include <iostream>
+#include "logging.h"
 
 namespace metricstream {
 
@@ -12,8 +12,7 @@ ThreadPool::ThreadPool(size_t num_threads, size_t max_queue_size)
         workers_.emplace_back(&ThreadPool::worker_loop, this);
     }
 
-    std::cerr << "[ThreadPool] Started with " << num_threads
-              << " workers, max queue size: " << max_queue_size << std::endl;
+    MS_LOG_INFO("[ThreadPool] Started with {} workers, max queue size: {}", num_threads, max_queue_size);
 }
 
 ThreadPool::~ThreadPool() {
@@ -33,7 +32,7 @@ ThreadPool::~ThreadPool() {
         }
     }
 
-    std::cerr << "[ThreadPool] Shutdown complete" << std::endl;
+    MS_LOG_INFO("[ThreadPool] Shutdown complete");
 }
 
 bool ThreadPool::enqueue(std::function<void()> task) {
@@ -92,11 +91,9 @@ void ThreadPool::worker_loop() {
             try {
                 task();
             } catch (const std::exception& e) {
-                std::cerr << "[ThreadPool] Task threw exception: "
-                          << e.what() << std::endl;
+                MS_LOG_ERROR("[ThreadPool] Task threw exception: {}", e.what());
             } catch (...) {
-                std::cerr << "[ThreadPool] Task threw unknown exception"
-                          << std::endl;
+                MS_LOG_ERROR("[ThreadPool] Task threw unknown exception");
             }
         }
     }
@@ -0,0 +1,139 @@
+#include "tracing.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+namespace metricstream {
+
+// Gives the calling thread's ring back when the thread exits
+struct ThreadRingHandle {
+    Tracer::ThreadRing* ring = nullptr;
+
+    ~ThreadRingHandle() {
+        if (ring) {
+            Tracer::instance().release_ring(ring);
+        }
+    }
+};
+
+Tracer& Tracer::instance() {
+    // Never destroyed: threads may still record during static destruction
+    static Tracer* tracer = new Tracer();
+    return *tracer;
+}
+
+void Tracer::set_sample_rate(double rate) {
+    rate = std::min(std::max(rate, 0.0), 1.0);
+    uint64_t threshold = rate >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(rate * 18446744073709551616.0);
+    sample_threshold_.store(threshold, std::memory_order_relaxed);
+}
+
+double Tracer::sample_rate() const {
+    uint64_t threshold = sample_threshold_.load(std::memory_order_relaxed);
+    return threshold == UINT64_MAX ? 1.0 : static_cast<double>(threshold) / 18446744073709551616.0;
+}
+
+uint64_t Tracer::start_trace_slow(uint64_t threshold) {
+    thread_local uint64_t state = std::random_device{}() | 1;
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (threshold != UINT64_MAX && state >= threshold) {
+        return 0;
+    }
+    return next_trace_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+Tracer::ThreadRing* Tracer::claim_ring() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (auto& ring : rings_) {
+        if (!ring->in_use) {
+            ring->in_use = true;  // keeps the previous owner's spans
+            return ring.get();
+        }
+    }
+    rings_.push_back(std::make_unique<ThreadRing>());
+    rings_.back()->thread_index = rings_.size();
+    rings_.back()->in_use = true;
+    return rings_.back().get();
+}
+
+void Tracer::release_ring(ThreadRing* ring) {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    ring->in_use = false;
+}
+
+void Tracer::record(uint64_t trace_id, const char* name, int64_t start_ns, int64_t end_ns) {
+    thread_local ThreadRingHandle handle;
+    if (!handle.ring) {
+        handle.ring = claim_ring();
+    }
+    ThreadRing& ring = *handle.ring;
+
+    // Seqlock-style publish: readers treat the slot at `written` as in flux
+    uint64_t written = ring.written.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    SpanRecord& span = ring.spans[written % RING_SIZE];
+    span.trace_id.store(trace_id, std::memory_order_relaxed);
+    span.name.store(name, std::memory_order_relaxed);
+    span.start_ns.store(start_ns, std::memory_order_relaxed);
+    span.end_ns.store(end_ns, std::memory_order_relaxed);
+    ring.written.store(written + 1, std::memory_order_release);
+}
+
+std::string Tracer::dump_chrome_json() const {
+    struct Copied {
+        uint64_t trace_id;
+        const char* name;
+        int64_t start_ns;
+        int64_t end_ns;
+        size_t thread_index;
+    };
+    std::vector<Copied> spans;
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_) {
+            uint64_t end = ring->written.load(std::memory_order_acquire);
+            uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+            size_t first = spans.size();
+            for (uint64_t i = begin; i < end; ++i) {
+                const SpanRecord& span = ring->spans[i % RING_SIZE];
+                spans.push_back(Copied{span.trace_id.load(std::memory_order_relaxed),
+                                       span.name.load(std::memory_order_relaxed),
+                                       span.start_ns.load(std::memory_order_relaxed),
+                                       span.end_ns.load(std::memory_order_relaxed), ring->thread_index});
+            }
+            // Slots the writer reached while we were copying may be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now_written = ring->written.load(std::memory_order_relaxed);
+            uint64_t valid_from = now_written >= RING_SIZE ? now_written - RING_SIZE + 1 : 0;
+            if (valid_from > begin) {
+                size_t torn = static_cast<size_t>(std::min(valid_from, end) - begin);
+                spans.erase(spans.begin() + static_cast<std::ptrdiff_t>(first),
+                            spans.begin() + static_cast<std::ptrdiff_t>(first + torn));
+            }
+        }
+    }
+
+    std::sort(spans.begin(), spans.end(),
+              [](const Copied& a, const Copied& b) { return a.start_ns < b.start_ns; });
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char buf[256];
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const Copied& span = spans[i];
+        int n = std::snprintf(buf, sizeof(buf),
+                              "%s{\"name\":\"%s\",\"cat\":\"metricstream\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                              "\"pid\":1,\"tid\":%zu,\"args\":{\"trace_id\":%llu}}",
+                              i > 0 ? "," : "", span.name ? span.name : "?", span.start_ns / 1000.0,
+                              (span.end_ns - span.start_ns) / 1000.0, span.thread_index,
+                              static_cast<unsigned long long>(span.trace_id));
+        out.append(buf, static_cast<size_t>(std::min(n, static_cast<int>(sizeof(buf) - 1))));
+    }
+    out += "]}";
+    return out;
+}
+
+} // namespace metricstream
@@ -0,0 +1,267 @@
+#include "workload_model.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace metricstream {
+
+namespace {
+
+// log1p(x) / x and expm1(x) / x, with Taylor series near 0
+double helper1(double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+double helper2(double x) {
+    return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+void append_token(std::string& out, uint64_t hash, size_t length) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    for (size_t i = 0; i < length; ++i) {
+        if (i % 10 == 0 && i > 0) {
+            hash = mix(hash);
+        }
+        out += alphabet[hash % 36];
+        hash /= 36;
+    }
+}
+
+void parse_range(const std::string& key, const std::string& value, size_t& lo, size_t& hi) {
+    size_t dash = value.find('-');
+    try {
+        lo = std::stoul(value.substr(0, dash));
+        hi = dash == std::string::npos ? lo : std::stoul(value.substr(dash + 1));
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Bad range for " + key + ": '" + value + "'");
+    }
+    if (lo > hi) {
+        throw std::invalid_argument("Empty range for " + key + ": '" + value + "'");
+    }
+}
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// ZipfDistribution
+// ----------------------------------------------------------------------------
+
+ZipfDistribution::ZipfDistribution(uint64_t n, double s) : n_(n), s_(s) {
+    if (n_ == 0) {
+        throw std::invalid_argument("Zipf distribution needs at least one element");
+    }
+    if (s_ < 0.0) {
+        throw std::invalid_argument("Zipf exponent must be non-negative");
+    }
+    h_integral_x1_ = h_integral(1.5) - 1.0;
+    h_integral_n_ = h_integral(static_cast<double>(n_) + 0.5);
+    threshold_ = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+}
+
+double ZipfDistribution::h(double x) const {
+    return std::exp(-s_ * std::log(x));
+}
+
+double ZipfDistribution::h_integral(double x) const {
+    double log_x = std::log(x);
+    return helper2((1.0 - s_) * log_x) * log_x;
+}
+
+double ZipfDistribution::h_integral_inverse(double x) const {
+    double t = x * (1.0 - s_);
+    if (t < -1.0) {
+        t = -1.0;  // numerical safety near the upper end
+    }
+    return std::exp(helper1(t) * x);
+}
+
+uint64_t ZipfDistribution::operator()(std::mt19937_64& gen) const {
+    if (s_ == 0.0) {
+        return std::uniform_int_distribution<uint64_t>(0, n_ - 1)(gen);
+    }
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    while (true) {
+        double u = h_integral_n_ + uniform(gen) * (h_integral_x1_ - h_integral_n_);
+        double x = h_integral_inverse(u);
+        double k = std::floor(x + 0.5);
+        k = std::min(std::max(k, 1.0), static_cast<double>(n_));
+        if (k - x <= threshold_ || u >= h_integral(k + 0.5) - h(k)) {
+            return static_cast<uint64_t>(k) - 1;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// WorkloadConfig
+// ----------------------------------------------------------------------------
+
+WorkloadConfig WorkloadConfig::parse(const std::string& spec) {
+    WorkloadConfig config;
+    std::istringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("Workload option '" + item + "' must be key=value");
+        }
+        std::string key = item.substr(0, eq);
+        std::string value = item.substr(eq + 1);
+        try {
+            if (key == "clients") config.clients = std::stoull(value);
+            else if (key == "client_skew") config.client_skew = std::stod(value);
+            else if (key == "series") config.series = std::stoull(value);
+            else if (key == "series_skew") config.series_skew = std::stod(value);
+            else if (key == "names") config.metric_names = std::stoull(value);
+            else if (key == "seed") config.seed = std::stoull(value);
+            else if (key == "tags") parse_range(key, value, config.min_tags, config.max_tags);
+            else if (key == "tag_len") parse_range(key, value, config.min_tag_value_length, config.max_tag_value_length);
+            else if (key == "batch") parse_range(key, value, config.min_batch, config.max_batch);
+            else throw std::invalid_argument("Unknown workload option '" + key + "'");
+        } catch (const std::invalid_argument&) {
+            throw;
+        } catch (const std::exception&) {
+            throw std::invalid_argument("Bad value for workload option " + key + ": '" + value + "'");
+        }
+    }
+
+    config.validate();
+    return config;
+}
+
+void WorkloadConfig::validate() const {
+    if (clients == 0 || series == 0 || metric_names == 0) {
+        throw std::invalid_argument("Workload clients, series and names must be positive");
+    }
+    if (min_batch == 0 || min_batch > max_batch || max_batch > MAX_BATCH) {
+        throw std::invalid_argument("Workload batch size must be within 1-" + std::to_string(MAX_BATCH));
+    }
+    if (min_tags > max_tags || min_tag_value_length == 0 || min_tag_value_length > max_tag_value_length) {
+        throw std::invalid_argument("Workload tag ranges must be non-empty (tag values at least one character)");
+    }
+}
+
+std::string WorkloadConfig::describe() const {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "series=%llu (skew %.2f), clients=%llu (skew %.2f), names=%llu, tags=%zu-%zu, "
+                  "tag_len=%zu-%zu, batch=%zu-%zu, seed=%llu",
+                  static_cast<unsigned long long>(series), series_skew, static_cast<unsigned long long>(clients),
+                  client_skew, static_cast<unsigned long long>(metric_names), min_tags, max_tags,
+                  min_tag_value_length, max_tag_value_length, min_batch, max_batch,
+                  static_cast<unsigned long long>(seed));
+    return buf;
+}
+
+// ----------------------------------------------------------------------------
+// WorkloadModel
+// ----------------------------------------------------------------------------
+
+WorkloadModel::WorkloadModel(const WorkloadConfig& config)
+    : config_((config.validate(), config)),
+      clients_(config.clients, config.client_skew),
+      series_(config.series, config.series_skew) {}
+
+void WorkloadModel::append_metric(uint64_t index, std::mt19937_64& gen, std::string& out) const {
+    uint64_t hash = mix(config_.seed ^ mix(index));
+
+    out += R"({"name":"metric_)";
+    out += std::to_string(hash % config_.metric_names);
+
+    // The instance tag makes every series index a distinct (name, tags) pair
+    out += R"(","type":"gauge","tags":{"instance":"i)";
+    out += std::to_string(index);
+    out += '"';
+
+    hash = mix(hash);
+    size_t tag_count = config_.min_tags + hash % (config_.max_tags - config_.min_tags + 1);
+    for (size_t t = 0; t < tag_count; ++t) {
+        hash = mix(hash);
+        size_t length = config_.min_tag_value_length +
+                        hash % (config_.max_tag_value_length - config_.min_tag_value_length + 1);
+        out += R"(,"tag_)";
+        out += std::to_string(t);
+        out += R"(":")";
+        append_token(out, mix(hash), length);
+        out += '"';
+    }
+
+    // Per-series level plus noise, so values look like a real gauge
+    double level = static_cast<double>(hash % 1000);
+    std::normal_distribution<double> noise(0.0, 1.0 + level * 0.05);
+    char value[32];
+    std::snprintf(value, sizeof(value), "%.3f", std::max(0.0, level + noise(gen)));
+    out += R"(},"value":)";
+    out += value;
+    out += '}';
+}
+
+WorkloadRequest WorkloadModel::next(std::mt19937_64& gen) const {
+    WorkloadRequest request;
+    request.client_id = "client_" + std::to_string(clients_(gen));
+
+    size_t batch = std::uniform_int_distribution<size_t>(config_.min_batch, config_.max_batch)(gen);
+    request.body = R"({"metrics":[)";
+    request.body.reserve(batch * (96 + config_.max_tags * (12 + config_.max_tag_value_length)));
+    for (size_t i = 0; i < batch; ++i) {
+        if (i > 0) {
+            request.body += ',';
+        }
+        append_metric(series_(gen), gen, request.body);
+    }
+    request.body += "]}";
+    return request;
+}
+
+// ----------------------------------------------------------------------------
+// Request log
+// ----------------------------------------------------------------------------
+
+namespace request_log {
+
+void append(std::ostream& out, const WorkloadRequest& request) {
+    out << request.client_id << '\t' << request.body << '\n';
+}
+
+std::vector<WorkloadRequest> load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open request log " + path);
+    }
+    std::vector<WorkloadRequest> requests;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        if (line.empty()) {
+            continue;
+        }
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": expected <client_id>\\t<body>");
+        }
+        requests.push_back(WorkloadRequest{line.substr(0, tab), line.substr(tab + 1)});
+    }
+    if (requests.empty()) {
+        throw std::runtime_error("Request log " + path + " is empty");
+    }
+    return requests;
+}
+
+} // namespace request_log
+
+} // namespace metricstream
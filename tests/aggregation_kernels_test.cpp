@@ -0,0 +1,143 @@
+#include "aggregation_kernels.h"
+#include "test_support.h"
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace metricstream;
+
+namespace {
+
+// Odd lengths exercise the vector tails as well as the full lanes
+std::vector<double> values_of(size_t count) {
+    std::vector<double> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = static_cast<double>((i * 37) % 101) - 50.0 + 0.25;
+    }
+    return values;
+}
+
+void kernels_match_scalar_reference() {
+    for (size_t count : {0ul, 1ul, 3ul, 7ul, 8ul, 15ul, 16ul, 17ul, 1000ul, 1023ul}) {
+        std::vector<double> values = values_of(count);
+        double sum = 0.0;
+        double min = INFINITY;
+        double max = -INFINITY;
+        for (double v : values) {
+            sum += v;
+            min = std::min(min, v);
+            max = std::max(max, v);
+        }
+        CHECK_NEAR(sum_values(values.data(), count), sum, 1e-9);
+        CHECK_EQ(min_values(values.data(), count), min);
+        CHECK_EQ(max_values(values.data(), count), max);
+
+        Aggregate agg = aggregate_values(values.data(), count);
+        CHECK_EQ(agg.count, count);
+        CHECK_NEAR(agg.sum, sum, 1e-9);
+        CHECK_EQ(agg.min, min);
+        CHECK_EQ(agg.max, max);
+    }
+    CHECK(std::string(aggregation_isa()) == "avx512" || std::string(aggregation_isa()) == "avx2" ||
+          std::string(aggregation_isa()) == "scalar");
+}
+
+void aggregate_merges_and_picks_op() {
+    std::vector<double> values = values_of(33);
+    Aggregate left = aggregate_values(values.data(), 10);
+    Aggregate right = aggregate_values(values.data() + 10, 23);
+    left.merge(right);
+    Aggregate whole = aggregate_values(values.data(), 33);
+    CHECK_EQ(left.count, whole.count);
+    CHECK_NEAR(left.sum, whole.sum, 1e-9);
+    CHECK_EQ(left.min, whole.min);
+    CHECK_EQ(left.max, whole.max);
+
+    CHECK_NEAR(whole.value(AggregateOp::AVG), whole.sum / 33.0, 1e-12);
+    CHECK_EQ(whole.value(AggregateOp::COUNT), 33.0);
+    CHECK_EQ(Aggregate().avg(), 0.0);
+
+    CHECK(parse_aggregate_op("max") == AggregateOp::MAX);
+    CHECK_THROWS(parse_aggregate_op("median"), std::invalid_argument);
+}
+
+void mask_selects_matching_positions() {
+    std::vector<double> values = values_of(19);
+    std::vector<uint8_t> mask(values.size());
+    size_t selected = build_mask(values.data(), values.size(), CompareOp::GT, 0.0, mask.data());
+
+    size_t expected = 0;
+    double expected_sum = 0.0;
+    for (double v : values) {
+        if (v > 0.0) {
+            expected++;
+            expected_sum += v;
+        }
+    }
+    CHECK_EQ(selected, expected);
+    Aggregate agg = aggregate_masked(values.data(), mask.data(), values.size());
+    CHECK_EQ(agg.count, expected);
+    CHECK_NEAR(agg.sum, expected_sum, 1e-9);
+    CHECK(agg.min > 0.0);
+
+    CHECK_EQ(build_mask(values.data(), values.size(), CompareOp::EQ, values[4], mask.data()), 1u);
+    CHECK_EQ(build_mask(values.data(), values.size(), CompareOp::NE, values[4], mask.data()), values.size() - 1);
+}
+
+void counters_handle_resets() {
+    std::vector<double> values{10, 15, 20, 3, 8};  // reset after 20
+    CHECK_EQ(counter_increase(values.data(), values.size()), 10.0 + 8.0);
+    CHECK_EQ(counter_increase(values.data(), 1), 0.0);
+
+    std::vector<int64_t> timestamps{0, 1000, 2000, 3000, 4000};
+    CHECK_NEAR(counter_rate(timestamps.data(), values.data(), values.size()), 18.0 / 4.0, 1e-12);
+    CHECK_EQ(counter_rate(timestamps.data(), values.data(), 1), 0.0);
+}
+
+void downsample_buckets_by_step() {
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    for (int64_t ts = 0; ts < 300; ts += 10) {
+        timestamps.push_back(ts);
+        values.push_back(1.0);
+    }
+    std::vector<Aggregate> buckets;
+    // Fed in two pieces, as successive chunks of one series would be
+    downsample(timestamps.data(), values.data(), 12, 0, 299, 100, buckets);
+    downsample(timestamps.data() + 12, values.data() + 12, timestamps.size() - 12, 0, 299, 100, buckets);
+    CHECK_EQ(buckets.size(), 3u);
+    for (const Aggregate& bucket : buckets) {
+        CHECK_EQ(bucket.count, 10u);
+        CHECK_EQ(bucket.sum, 10.0);
+    }
+
+    // Samples outside [start, end] are ignored
+    buckets.clear();
+    downsample(timestamps.data(), values.data(), timestamps.size(), 50, 149, 50, buckets);
+    CHECK_EQ(buckets.size(), 2u);
+    if (buckets.size() == 2) CHECK_EQ(buckets[0].count + buckets[1].count, 10u);
+
+    // The whole int64 range does not overflow the bucket arithmetic
+    buckets.clear();
+    std::vector<int64_t> extremes{INT64_MIN, -1, 0, INT64_MAX};
+    std::vector<double> ones(extremes.size(), 1.0);
+    downsample(extremes.data(), ones.data(), extremes.size(), INT64_MIN, INT64_MAX, INT64_MAX, buckets);
+    CHECK_EQ(buckets.size(), 3u);
+    if (buckets.size() == 3) {
+        CHECK_EQ(buckets[0].count, 1u);  // [MIN, -2]
+        CHECK_EQ(buckets[1].count, 2u);  // [-1, MAX - 2]
+        CHECK_EQ(buckets[2].count, 1u);
+    }
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(kernels_match_scalar_reference);
+    RUN_TEST(aggregate_merges_and_picks_op);
+    RUN_TEST(mask_selects_matching_positions);
+    RUN_TEST(counters_handle_resets);
+    RUN_TEST(downsample_buckets_by_step);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,173 @@
+#include "alert_evaluator.h"
+#include "test_support.h"
+
+using namespace metricstream;
+
+namespace {
+
+// One point per series, all at `ts`, received by the server at `received_ms`
+DecodedBatch batch_of(const std::vector<std::pair<SeriesDescriptor, double>>& values, int64_t ts,
+                      int64_t received_ms) {
+    DecodedBatch batch;
+    batch.batch_timestamp_ms = received_ms;
+    for (const auto& [series, value] : values) {
+        batch.series.push_back({series, MetricType::GAUGE});
+        batch.points.push_back({series.id, value, ts});
+    }
+    return batch;
+}
+
+SeriesDescriptor cpu(SeriesId id, const std::string& host) {
+    return {id, "cpu", {{"host", host}}};
+}
+
+struct Recorder {
+    std::vector<AlertEvent> events;
+
+    void attach(AlertEvaluator& evaluator) {
+        evaluator.set_event_handler([this](const AlertEvent& event) { events.push_back(event); });
+    }
+};
+
+void windows_drive_pending_and_firing() {
+    AlertEvaluator evaluator;
+    Recorder recorder;
+    recorder.attach(evaluator);
+    evaluator.set_rules({AlertRule::parse("hot: avg_over_time(cpu[30s]) > 80 for 20s")});
+
+    const auto host = cpu(1, "a");
+    for (int64_t ts = 0; ts <= 40000; ts += 10000) {
+        evaluator.on_batch(batch_of({{host, 90.0}}, ts, ts));
+    }
+    CHECK_EQ(recorder.events.size(), 2u);
+    if (recorder.events.size() == 2) {
+        CHECK(recorder.events[0].to == AlertState::PENDING && recorder.events[0].timestamp_ms == 0);
+        CHECK(recorder.events[1].to == AlertState::FIRING && recorder.events[1].timestamp_ms == 20000);
+    }
+    CHECK_EQ(evaluator.stats().firing, 1u);
+    CHECK_EQ(evaluator.active_alerts().size(), 1u);
+
+    // The 30s average drops below the threshold once two low points are in
+    evaluator.on_batch(batch_of({{host, 10.0}}, 50000, 50000));
+    evaluator.on_batch(batch_of({{host, 10.0}}, 60000, 60000));
+    CHECK(!recorder.events.empty() && recorder.events.back().to == AlertState::INACTIVE);
+    CHECK_EQ(evaluator.stats().firing, 0u);
+
+    // Old points are ignored rather than rewinding the window
+    evaluator.on_batch(batch_of({{host, 1000.0}}, 5000, 70000));
+    CHECK_EQ(evaluator.stats().out_of_order, 1u);
+}
+
+void window_aggregates_slide() {
+    AlertEvaluator evaluator;
+    Recorder recorder;
+    recorder.attach(evaluator);
+    evaluator.set_rules({AlertRule::parse("peak: max_over_time(cpu[3s]) >= 5"),
+                         AlertRule::parse("many: count_over_time(cpu[3s]) > 2")});
+
+    const auto host = cpu(1, "a");
+    const double values[] = {5, 1, 1, 1, 1};
+    for (int64_t i = 0; i < 5; ++i) {
+        evaluator.on_batch(batch_of({{host, values[i]}}, i * 1000, 0));
+    }
+    // peak fires at 0s and clears when the 5 leaves the (ts - 3s, ts] window
+    // at 3s; many fires once three points are in the window at 2s
+    std::vector<std::pair<std::string, int64_t>> seen;
+    for (const auto& event : recorder.events) seen.emplace_back(event.rule, event.timestamp_ms);
+    CHECK(seen == (std::vector<std::pair<std::string, int64_t>>{{"peak", 0}, {"many", 2000}, {"peak", 3000}}));
+}
+
+void only_matching_series_are_tracked() {
+    AlertEvaluator evaluator;
+    evaluator.set_rules({AlertRule::parse("hot: max_over_time(cpu{host=\"a\"}[1m]) > 80")});
+
+    std::vector<std::pair<SeriesDescriptor, double>> values;
+    for (SeriesId id = 1; id <= 100; ++id) {
+        values.push_back({cpu(id, id == 1 ? "a" : "h" + std::to_string(id)), 1.0});
+    }
+    evaluator.on_batch(batch_of(values, 1000, 1000));
+    evaluator.on_batch(batch_of(values, 2000, 2000));
+    CHECK_EQ(evaluator.stats().series_tracked, 1u);
+    CHECK_EQ(evaluator.stats().series_unmatched, 99u);
+    CHECK_EQ(evaluator.stats().points_evaluated, 2u);
+
+    // A reload that no longer selects the series drops its state, and the
+    // cached misses are matched against the new rules
+    evaluator.set_rules({AlertRule::parse("disk: max_over_time(disk[1m]) > 80")});
+    CHECK_EQ(evaluator.stats().series_unmatched, 0u);
+    evaluator.on_batch(batch_of(values, 3000, 3000));
+    CHECK_EQ(evaluator.stats().series_tracked, 0u);
+    CHECK_EQ(evaluator.stats().series_unmatched, 100u);
+
+    // Misses expire with the series that stopped reporting
+    evaluator.on_batch(batch_of({values[0]}, 4000, 700000));
+    CHECK_EQ(evaluator.expire_stale(700000), 0u);
+    CHECK_EQ(evaluator.stats().series_unmatched, 1u);
+}
+
+void reload_resolves_removed_rules() {
+    AlertEvaluator evaluator;
+    Recorder recorder;
+    recorder.attach(evaluator);
+    const AlertRule kept = AlertRule::parse("low: min_over_time(cpu[1m]) < 1000");
+    evaluator.set_rules({AlertRule::parse("hot: max_over_time(cpu[1m]) > 80"), kept});
+
+    const auto host = cpu(1, "a");
+    evaluator.on_batch(batch_of({{host, 90.0}}, 1000, 1000));
+    CHECK_EQ(evaluator.stats().firing, 2u);
+    recorder.events.clear();
+
+    // The firing rule is gone: its alert resolves on the series' next point,
+    // while the unchanged rule keeps firing without a new event
+    evaluator.set_rules({kept});
+    evaluator.on_batch(batch_of({{host, 90.0}}, 2000, 2000));
+    CHECK_EQ(recorder.events.size(), 1u);
+    if (recorder.events.size() == 1) {
+        const AlertEvent& event = recorder.events[0];
+        CHECK(event.rule == "hot" && event.from == AlertState::FIRING && event.to == AlertState::INACTIVE);
+        CHECK_EQ(event.timestamp_ms, int64_t{2000});
+    }
+    CHECK_EQ(evaluator.active_alerts().size(), 1u);
+
+    // Removing the last rule the series matched resolves it too
+    evaluator.set_rules({AlertRule::parse("disk: max_over_time(disk[1m]) > 80")});
+    evaluator.on_batch(batch_of({{host, 90.0}}, 3000, 3000));
+    CHECK(recorder.events.size() == 2 && recorder.events[1].rule == "low" &&
+          recorder.events[1].to == AlertState::INACTIVE);
+    CHECK_EQ(evaluator.stats().series_tracked, 0u);
+}
+
+void idle_series_expire_and_resolve() {
+    AlertEvaluator evaluator(60000);
+    Recorder recorder;
+    recorder.attach(evaluator);
+    evaluator.set_rules({AlertRule::parse("hot: max_over_time(cpu[1m]) > 80")});
+
+    evaluator.on_batch(batch_of({{cpu(1, "a"), 90.0}, {cpu(2, "b"), 10.0}}, 1000, 100000));
+    evaluator.on_batch(batch_of({{cpu(2, "b"), 10.0}}, 2000, 150000));
+    CHECK_EQ(evaluator.stats().firing, 1u);
+
+    CHECK_EQ(evaluator.expire_stale(150000), 0u);
+    CHECK_EQ(evaluator.expire_stale(160000), 1u);  // series 1 last seen at 100000
+    CHECK_EQ(evaluator.stats().series_tracked, 1u);
+    CHECK_EQ(evaluator.stats().expired, 1u);
+    CHECK(evaluator.active_alerts().empty());
+    CHECK(!recorder.events.empty() && recorder.events.back().to == AlertState::INACTIVE &&
+          recorder.events.back().from == AlertState::FIRING && recorder.events.back().timestamp_ms == 160000);
+
+    // A series that comes back starts from a fresh window
+    evaluator.on_batch(batch_of({{cpu(1, "a"), 10.0}}, 500, 170000));
+    CHECK_EQ(evaluator.stats().out_of_order, 0u);
+    CHECK_EQ(evaluator.stats().series_tracked, 2u);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(windows_drive_pending_and_firing);
+    RUN_TEST(window_aggregates_slide);
+    RUN_TEST(only_matching_series_are_tracked);
+    RUN_TEST(idle_series_expire_and_resolve);
+    RUN_TEST(reload_resolves_removed_rules);
+    return metricstream::test::exit_code();
+}
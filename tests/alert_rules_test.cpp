@@ -0,0 +1,114 @@
+#include "alert_rules.h"
+#include "test_support.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace metricstream;
+
+namespace {
+
+std::vector<std::string> matched_names(const RuleSet& rules, const SeriesDescriptor& series) {
+    std::vector<std::string> names;
+    for (const AlertRule* rule : rules.match(series)) {
+        names.push_back(rule->name);
+    }
+    return names;
+}
+
+void rules_parse_and_print_canonically() {
+    AlertRule rule = AlertRule::parse("cpu_high: avg_over_time(cpu_usage{region=\"us\"}[1m]) > 80 for 30s");
+    CHECK_EQ(rule.name, std::string("cpu_high"));
+    CHECK(rule.aggregate == AggregateOp::AVG);
+    CHECK(rule.comparison == CompareOp::GT);
+    CHECK_EQ(rule.threshold, 80.0);
+    CHECK_EQ(rule.window_ms, int64_t{60000});
+    CHECK_EQ(rule.for_ms, int64_t{30000});
+    CHECK_EQ(AlertRule::parse(rule.to_string()).to_string(), rule.to_string());
+
+    CHECK_THROWS(AlertRule::parse("no_colon avg_over_time(cpu[1m]) > 1"), std::invalid_argument);
+    CHECK_THROWS(AlertRule::parse("bad: rate(cpu[1m]) > 1"), std::invalid_argument);
+    CHECK_THROWS(AlertRule::parse("bad: avg_over_time(cpu[1m]) 1"), std::invalid_argument);
+}
+
+void index_routes_by_name_and_tag() {
+    RuleSet rules({
+        AlertRule::parse("us: max_over_time(cpu{region=\"us\"}[1m]) > 1"),
+        AlertRule::parse("eu: max_over_time(cpu{region=\"eu\"}[1m]) > 1"),
+        AlertRule::parse("any_cpu: max_over_time(cpu[1m]) > 1"),
+        AlertRule::parse("not_a: max_over_time(cpu{host!=\"a\"}[1m]) > 1"),
+        AlertRule::parse("by_regex: max_over_time({__name__=~\"cp.*\", region=\"us\"}[1m]) > 1"),
+        AlertRule::parse("disk: max_over_time(disk[1m]) > 1"),
+    });
+    auto stats = rules.stats();
+    CHECK_EQ(stats.rules, 6u);
+    CHECK_EQ(stats.name_buckets, 2u);
+    CHECK_EQ(stats.tag_routed, 2u);
+    CHECK_EQ(stats.scanned, 1u);
+
+    SeriesDescriptor us_a{1, "cpu", {{"host", "a"}, {"region", "us"}}};
+    CHECK(matched_names(rules, us_a) == (std::vector<std::string>{"us", "any_cpu", "by_regex"}));
+    SeriesDescriptor eu_b{2, "cpu", {{"host", "b"}, {"region", "eu"}}};
+    CHECK(matched_names(rules, eu_b) == (std::vector<std::string>{"eu", "any_cpu", "not_a"}));
+    SeriesDescriptor mem{3, "mem", {{"region", "us"}}};
+    CHECK(matched_names(rules, mem).empty());
+}
+
+// The index must agree with checking every rule's matchers directly
+void index_matches_brute_force() {
+    std::vector<AlertRule> parsed;
+    const char* regions[] = {"us", "eu", "ap"};
+    for (int i = 0; i < 300; ++i) {
+        std::string metric = "m" + std::to_string(i % 7);
+        std::string selector;
+        switch (i % 4) {
+            case 0: selector = metric; break;
+            case 1: selector = metric + "{region=\"" + regions[i % 3] + "\"}"; break;
+            case 2: selector = metric + "{host=~\"h[0-4]\", region!=\"" + regions[i % 3] + "\"}"; break;
+            case 3: selector = "{__name__=~\"m[0-3]\", host=\"h" + std::to_string(i % 10) + "\"}"; break;
+        }
+        parsed.push_back(AlertRule::parse("r" + std::to_string(i) + ": sum_over_time(" + selector + "[1m]) > 0"));
+    }
+    RuleSet rules(parsed);
+
+    for (int s = 0; s < 200; ++s) {
+        SeriesDescriptor series{static_cast<SeriesId>(s), "m" + std::to_string(s % 9),
+                                {{"host", "h" + std::to_string(s % 10)}, {"region", regions[s % 3]}}};
+        std::vector<const AlertRule*> expected;
+        for (const auto& rule : rules.rules()) {
+            bool all = std::all_of(rule->matchers.begin(), rule->matchers.end(), [&](const TagMatcher& m) {
+                if (m.key == TagIndex::NAME_TAG) return m.matches(series.name);
+                auto tag = std::find_if(series.tags.begin(), series.tags.end(),
+                                        [&](const auto& t) { return t.first == m.key; });
+                return m.matches(tag == series.tags.end() ? std::string() : tag->second);
+            });
+            if (all) expected.push_back(rule.get());
+        }
+        CHECK(rules.match(series) == expected);
+    }
+}
+
+void reloads_keep_unchanged_rules() {
+    RuleSet first({AlertRule::parse("a: max_over_time(cpu[1m]) > 1"),
+                   AlertRule::parse("b: max_over_time(cpu[1m]) > 2")});
+    RuleSet second({AlertRule::parse("a: max_over_time(cpu[60s]) > 1"),
+                    AlertRule::parse("b: max_over_time(cpu[1m]) > 3"),
+                    AlertRule::parse("a: max_over_time(cpu[1m]) > 1")},  // duplicate dropped
+                   &first);
+    CHECK_EQ(second.size(), 2u);
+    CHECK(second.contains(first.rules()[0].get()));   // same rule, same pointer
+    CHECK(!second.contains(first.rules()[1].get()));  // threshold changed
+
+    AlertRule empty_window = AlertRule::parse("w: max_over_time(cpu[1m]) > 1");
+    empty_window.window_ms = 0;
+    CHECK_THROWS(RuleSet({empty_window}), std::invalid_argument);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(rules_parse_and_print_canonically);
+    RUN_TEST(index_routes_by_name_and_tag);
+    RUN_TEST(index_matches_brute_force);
+    RUN_TEST(reloads_keep_unchanged_rules);
+    return metricstream::test::exit_code();
+}
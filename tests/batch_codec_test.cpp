@@ -0,0 +1,74 @@
+#include "batch_codec.h"
+#include "common.h"
+#include "test_support.h"
+#include <stdexcept>
+
+using namespace metricstream;
+
+namespace {
+
+void json_string_escapes_everything_json_requires() {
+    CHECK_EQ(json_string("plain"), std::string("\"plain\""));
+    CHECK_EQ(json_string("a\"b\\c"), std::string("\"a\\\"b\\\\c\""));
+    CHECK_EQ(json_string("\n\r\t\b\f"), std::string("\"\\n\\r\\t\\b\\f\""));
+    CHECK_EQ(json_string(std::string("\x01\x1f", 2)), std::string("\"\\u0001\\u001f\""));
+    CHECK_EQ(json_string(std::string("nul\0byte", 8)), std::string("\"nul\\u0000byte\""));
+    CHECK_EQ(json_string("caf\xc3\xa9"), std::string("\"caf\xc3\xa9\""));  // UTF-8 passes through
+
+    std::string out = "x=";
+    append_json_string(out, "y");
+    CHECK_EQ(out, std::string("x=\"y\""));
+}
+
+void append_utf8_encodes_code_points() {
+    std::string out;
+    append_utf8(out, 0x41);
+    append_utf8(out, 0xe9);
+    append_utf8(out, 0x20ac);
+    CHECK_EQ(out, std::string("A\xc3\xa9\xe2\x82\xac"));
+}
+
+void batch_round_trips_series_and_points() {
+    MetricBatch batch;
+    Tags tags{{"host", "web \"1\"\n"}, {"path", "C:\\tmp\x01"}};
+    Timestamp ts{std::chrono::milliseconds(1700000000123)};
+    Metric first("cpu\tusage", 75.5, MetricType::GAUGE, tags, ts);
+    first.series_id = SeriesRegistry::compute_series_id(first.name, tags);
+    Metric second = first;
+    second.value = -1.25;
+    second.timestamp = ts + std::chrono::milliseconds(10);
+    batch.add_metric(std::move(first));
+    batch.add_metric(std::move(second));
+
+    DecodedBatch decoded = decode_metrics_batch(encode_metrics_batch(batch));
+    CHECK_EQ(decoded.series.size(), 1u);  // described once
+    CHECK_EQ(decoded.points.size(), 2u);
+    if (decoded.series.size() != 1 || decoded.points.size() != 2) return;
+
+    const SeriesDescriptor& desc = decoded.series[0].descriptor;
+    CHECK_EQ(desc.name, std::string("cpu\tusage"));
+    CHECK(desc.tag_map() == tags);
+    CHECK_EQ(desc.id, SeriesRegistry::compute_series_id("cpu\tusage", tags));
+    CHECK(decoded.series[0].type == MetricType::GAUGE);
+
+    CHECK_EQ(decoded.points[0].value, 75.5);
+    CHECK_EQ(decoded.points[1].value, -1.25);
+    CHECK_EQ(decoded.points[0].timestamp_ms, 1700000000123);
+    CHECK_EQ(decoded.points[1].timestamp_ms, 1700000000133);
+    CHECK_EQ(decoded.ingest_timestamp_us, to_unix_micros(batch.received_at));
+}
+
+void batch_rejects_malformed_input() {
+    CHECK_THROWS(decode_metrics_batch("{\"series\":[{\"id\":1,\"name\":\"a\\uzz\"}]}"), std::runtime_error);
+    CHECK_THROWS(decode_metrics_batch("{\"series\":["), std::runtime_error);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(json_string_escapes_everything_json_requires);
+    RUN_TEST(append_utf8_encodes_code_points);
+    RUN_TEST(batch_round_trips_series_and_points);
+    RUN_TEST(batch_rejects_malformed_input);
+    return metricstream::test::exit_code();
+}
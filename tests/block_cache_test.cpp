@@ -0,0 +1,130 @@
+#include "block_cache.h"
+#include "block_storage.h"
+#include "test_support.h"
+#include <thread>
+#include <vector>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+
+namespace {
+
+constexpr int64_t HOUR_MS = 60 * 60 * 1000;
+constexpr size_t SHARD_BYTES = 8 * 1024;  // four 100-sample entries
+
+std::shared_ptr<const DecodedColumns> columns(size_t count, double value = 0.0) {
+    auto decoded = std::make_shared<DecodedColumns>();
+    decoded->timestamps.assign(count, 0);
+    decoded->values.assign(count, value);
+    return decoded;
+}
+
+// A miss followed by the decode a read would do
+void fetch(BlockCache& cache, uint64_t block_id, SeriesId series) {
+    if (!cache.get(block_id, series)) {
+        cache.put(block_id, series, columns(100));
+    }
+}
+
+void hits_misses_and_budget() {
+    BlockCache cache(BlockCache::SHARD_COUNT * SHARD_BYTES);
+    CHECK(cache.get(1, 7) == nullptr);
+    auto decoded = columns(100, 2.5);
+    cache.put(1, 7, decoded);
+    CHECK(cache.get(1, 7) == decoded);
+    CHECK(cache.get(2, 7) == nullptr);  // same series of another block
+
+    // Larger than a whole shard: never cached
+    cache.put(1, 8, columns(SHARD_BYTES));
+    CHECK(cache.get(1, 8) == nullptr);
+
+    BlockCache::Stats stats = cache.stats();
+    CHECK_EQ(stats.hits, 1u);
+    CHECK_EQ(stats.misses, 3u);
+    CHECK_EQ(stats.admitted, 1u);
+    CHECK_EQ(stats.entries, 1u);
+    CHECK_NEAR(stats.hit_ratio(), 0.25, 1e-9);
+
+    for (SeriesId series = 0; series < 1000; ++series) {
+        fetch(cache, 3, series);
+    }
+    stats = cache.stats();
+    CHECK(stats.bytes <= cache.max_bytes());
+    CHECK(stats.rejected + stats.evictions > 0);
+    CHECK_EQ(stats.entries, stats.admitted - stats.evictions);
+}
+
+void scans_do_not_flush_the_working_set() {
+    BlockCache cache(BlockCache::SHARD_COUNT * SHARD_BYTES);
+    for (int round = 0; round < 10; ++round) {
+        for (SeriesId series = 0; series < 8; ++series) {
+            fetch(cache, 1, series);
+        }
+    }
+    // A one-off export touching every key once
+    for (SeriesId series = 0; series < 2000; ++series) {
+        fetch(cache, 2, series);
+    }
+    for (SeriesId series = 0; series < 8; ++series) {
+        CHECK(cache.get(1, series) != nullptr);
+    }
+    CHECK(cache.stats().rejected > 0);
+
+    // A key asked for more often than the scan's does get in
+    BlockCache scanned(BlockCache::SHARD_COUNT * SHARD_BYTES);
+    for (SeriesId series = 0; series < 2000; ++series) {
+        fetch(scanned, 2, series);
+    }
+    for (int i = 0; i < 3; ++i) {
+        scanned.get(3, 1);
+    }
+    scanned.put(3, 1, columns(100));
+    CHECK(scanned.get(3, 1) != nullptr);
+}
+
+void store_reads_go_through_the_cache() {
+    TempDir dir;
+    BlockCache cache(1024 * 1024);
+    BlockStore store(dir.path(), HOUR_MS, &cache);
+    SeriesSamples samples{{1, {{1000, 1.0}, {2000, 2.0}}}};
+    store.add_block({SeriesDescriptor{1, "cpu", {}}}, samples);
+
+    SeriesSamples out;
+    store.read({1}, 0, HOUR_MS, out);
+    store.read({1}, 0, HOUR_MS, out);
+    CHECK_EQ(out[1].size(), 4u);
+    CHECK_EQ(cache.stats().hits, 1u);
+
+    // The replacement is a new reader, so stale entries are never served
+    SeriesSamples rewritten{{1, {{1000, 10.0}}}};
+    store.replace_blocks(store.all_blocks(), {SeriesDescriptor{1, "cpu", {}}}, rewritten, 1);
+    out.clear();
+    store.read({1}, 0, HOUR_MS, out);
+    CHECK(out[1].size() == 1 && out[1][0].value == 10.0);
+}
+
+void concurrent_use_stays_within_budget() {
+    BlockCache cache(BlockCache::SHARD_COUNT * SHARD_BYTES);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, t] {
+            for (int i = 0; i < 5000; ++i) {
+                fetch(cache, static_cast<uint64_t>(i % 3), static_cast<SeriesId>((i * (t + 1)) % 200));
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    BlockCache::Stats stats = cache.stats();
+    CHECK(stats.bytes <= cache.max_bytes());
+    CHECK_EQ(stats.hits + stats.misses, 20000u);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(hits_misses_and_budget);
+    RUN_TEST(scans_do_not_flush_the_working_set);
+    RUN_TEST(store_reads_go_through_the_cache);
+    RUN_TEST(concurrent_use_stays_within_budget);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,176 @@
+#include "block_storage.h"
+#include "test_support.h"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+
+namespace {
+
+constexpr int64_t HOUR_MS = 60 * 60 * 1000;
+
+SeriesDescriptor descriptor(SeriesId id, const std::string& name, const std::string& host) {
+    SeriesDescriptor desc;
+    desc.id = id;
+    desc.name = name;
+    desc.tags = {{"host", host}};
+    return desc;
+}
+
+// Samples every `step` ms over [start, start + count * step)
+std::vector<Sample> ramp(int64_t start, int64_t step, size_t count, double base) {
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < count; ++i) {
+        samples.push_back({start + static_cast<int64_t>(i) * step, base + static_cast<double>(i) * 0.5});
+    }
+    return samples;
+}
+
+void bucket_start_floors_including_pre_epoch() {
+    TempDir dir;
+    BlockStore store(dir.path(), 2 * HOUR_MS);
+    CHECK_EQ(store.bucket_start(0), int64_t{0});
+    CHECK_EQ(store.bucket_start(2 * HOUR_MS - 1), int64_t{0});
+    CHECK_EQ(store.bucket_start(2 * HOUR_MS), 2 * HOUR_MS);
+    CHECK_EQ(store.bucket_start(-1), -2 * HOUR_MS);
+    CHECK_THROWS(BlockStore(dir.path(), 0), std::invalid_argument);
+}
+
+void block_round_trips_samples_and_labels() {
+    TempDir dir;
+    std::string path = dir.path() + "/test.block";
+    SeriesSamples samples;
+    samples[1] = ramp(1000, 15000, 500, 10.0);
+    samples[2] = {{1000, -3.5}, {2000, 1e300}, {3000, 0.0}};
+    std::vector<SeriesDescriptor> series{descriptor(1, "cpu", "web-1"), descriptor(2, "mem", "web \"2\"")};
+
+    BlockMeta meta = BlockWriter::write(path, 7, series, samples);
+    CHECK_EQ(meta.sequence, 7u);
+    CHECK_EQ(meta.min_ts, int64_t{1000});
+    CHECK_EQ(meta.max_ts, int64_t{1000 + 499 * 15000});
+    CHECK_EQ(meta.sample_count, 503u);
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+
+    BlockReader reader(path);
+    CHECK_EQ(reader.meta().series_count, 2u);
+    CHECK(reader.might_contain(1));
+    CHECK_EQ(reader.series().size(), 2u);
+    CHECK_EQ(reader.series()[1].tags[0].second, std::string("web \"2\""));
+
+    std::vector<Sample> out;
+    CHECK(reader.read_series(1, INT64_MIN, INT64_MAX, out));
+    CHECK_EQ(out.size(), 500u);
+    bool identical = out.size() == samples[1].size();
+    for (size_t i = 0; identical && i < out.size(); ++i) {
+        identical = out[i].timestamp_ms == samples[1][i].timestamp_ms && out[i].value == samples[1][i].value;
+    }
+    CHECK(identical);
+
+    // Range slice is inclusive on both ends
+    out.clear();
+    CHECK(reader.read_series(1, 16000, 46000, out));
+    CHECK_EQ(out.size(), 3u);
+
+    out.clear();
+    CHECK(reader.read_series(2, INT64_MIN, INT64_MAX, out));
+    CHECK_EQ(out.size(), 3u);
+    CHECK_EQ(out[1].value, 1e300);
+    CHECK(!reader.read_series(99, INT64_MIN, INT64_MAX, out));
+}
+
+void reader_rejects_garbage() {
+    TempDir dir;
+    std::string path = dir.path() + "/bad.block";
+    std::ofstream(path) << "definitely not a block";
+    CHECK_THROWS(BlockReader(path), std::runtime_error);
+    CHECK_THROWS(BlockReader(dir.path() + "/missing.block"), std::runtime_error);
+}
+
+void store_reads_only_overlapping_blocks() {
+    TempDir dir;
+    BlockStore store(dir.path(), 2 * HOUR_MS);
+    std::vector<SeriesDescriptor> series{descriptor(1, "cpu", "a"), descriptor(2, "cpu", "b")};
+
+    for (int bucket = 0; bucket < 4; ++bucket) {
+        SeriesSamples samples;
+        samples[1] = ramp(bucket * 2 * HOUR_MS, 60000, 120, bucket * 100.0);
+        if (bucket % 2 == 0) samples[2] = ramp(bucket * 2 * HOUR_MS, 60000, 10, -1.0);
+        store.add_block(series, samples);
+    }
+    CHECK_EQ(store.block_count(), 4u);
+    CHECK_EQ(store.blocks_overlapping(2 * HOUR_MS, 4 * HOUR_MS - 1).size(), 1u);
+    CHECK_EQ(store.blocks_overlapping(0, INT64_MAX).size(), 4u);
+
+    SeriesSamples out;
+    size_t blocks_read = store.read({1}, 2 * HOUR_MS, 2 * HOUR_MS + 10 * 60000, out);
+    CHECK_EQ(blocks_read, 1u);
+    CHECK_EQ(out[1].size(), 11u);
+    CHECK_EQ(out[1].front().value, 100.0);
+
+    // Bloom filters skip the blocks without series 2
+    out.clear();
+    CHECK_EQ(store.read({2}, 2 * HOUR_MS, 4 * HOUR_MS - 1, out), 0u);
+}
+
+void store_reloads_blocks_and_sequences() {
+    TempDir dir;
+    std::vector<SeriesDescriptor> series{descriptor(5, "disk", "x")};
+    uint64_t last_sequence = 0;
+    {
+        BlockStore store(dir.path());
+        SeriesSamples samples;
+        samples[5] = ramp(0, 1000, 10, 1.0);
+        store.add_block(series, samples);
+        last_sequence = store.add_block(series, samples).sequence;
+    }
+    std::ofstream(dir.path() + "/0-99-L0.block.tmp") << "crash leftover";
+
+    BlockStore reopened(dir.path());
+    CHECK_EQ(reopened.block_count(), 2u);
+    CHECK(!std::filesystem::exists(dir.path() + "/0-99-L0.block.tmp"));
+    CHECK_EQ(reopened.loaded_series().size(), 1u);
+
+    SeriesSamples samples;
+    samples[5] = ramp(0, 1000, 1, 1.0);
+    CHECK(reopened.add_block(series, samples).sequence > last_sequence);
+}
+
+void store_reads_blocks_in_write_order() {
+    // Two blocks of one bucket hold the same timestamp; the later write must
+    // come last so "latest wins" dedup keeps it
+    TempDir dir;
+    BlockStore store(dir.path());
+    std::vector<SeriesDescriptor> series{descriptor(1, "cpu", "a")};
+    SeriesSamples newer, older;
+    newer[1] = {{5000, 2.0}};
+    older[1] = {{1000, 0.0}, {5000, 1.0}};
+    store.add_block(series, older);
+    store.add_block(series, newer);  // min_ts 5000 sorts after, but check order anyway
+
+    SeriesSamples late;
+    late[1] = {{500, 9.0}, {5000, 3.0}};  // smallest min_ts, newest sequence
+    store.add_block(series, late);
+
+    SeriesSamples out;
+    store.read({1}, 0, 10000, out);
+    CHECK(!out[1].empty());
+    double last_at_5000 = 0;
+    for (const Sample& s : out[1]) {
+        if (s.timestamp_ms == 5000) last_at_5000 = s.value;
+    }
+    CHECK_EQ(last_at_5000, 3.0);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(bucket_start_floors_including_pre_epoch);
+    RUN_TEST(block_round_trips_samples_and_labels);
+    RUN_TEST(reader_rejects_garbage);
+    RUN_TEST(store_reads_only_overlapping_blocks);
+    RUN_TEST(store_reloads_blocks_and_sequences);
+    RUN_TEST(store_reads_blocks_in_write_order);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,164 @@
+#include "compaction.h"
+#include "storage_engine.h"
+#include "test_support.h"
+#include <stdexcept>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+
+namespace {
+
+constexpr int64_t HOUR_MS = 60 * 60 * 1000;
+constexpr int64_t MINUTE = 60 * 1000;
+
+BlockMeta meta(uint64_t sequence, int64_t min_ts, int64_t max_ts, uint32_t level, uint64_t size_bytes = 100) {
+    BlockMeta meta;
+    meta.sequence = sequence;
+    meta.min_ts = min_ts;
+    meta.max_ts = max_ts;
+    meta.level = level;
+    meta.size_bytes = size_bytes;
+    return meta;
+}
+
+CompactionOptions manual_options(CompactionStrategy strategy) {
+    CompactionOptions options;
+    options.strategy = strategy;
+    options.min_input_blocks = 2;
+    options.max_level = 3;
+    options.level_base_bytes = 1000;
+    options.io_bytes_per_second = 0;
+    options.interval_ms = 0;
+    options.window_grace_ms = HOUR_MS;
+    return options;
+}
+
+BlockMeta add(BlockStore& store, SeriesId id, std::vector<Sample> samples) {
+    SeriesSamples series_samples{{id, std::move(samples)}};
+    return store.add_block({SeriesDescriptor{id, "cpu", {}}}, series_samples);
+}
+
+void time_window_plans() {
+    TempDir dir;
+    BlockStore store(dir.path(), HOUR_MS);
+    Compactor compactor(store, manual_options(CompactionStrategy::TIME_WINDOW));
+
+    // Open window: two L0 flushes size-tier into L1
+    auto plan = compactor.plan({meta(1, 0, 10, 0), meta(2, 5, 20, 0)});
+    CHECK(plan.has_value());
+    if (!plan) return;
+    CHECK_EQ(plan->window_start, int64_t{0});
+    CHECK_EQ(plan->output_level, 1u);
+    CHECK_EQ(plan->sequences.size(), 2u);
+
+    CHECK(!compactor.plan({meta(1, 0, 10, 0)}).has_value());
+
+    // Closed window (an hour of grace past its end): everything goes to the
+    // final level, and a final block is never an input again
+    plan = compactor.plan({meta(1, 0, 10, 0), meta(2, 5, 20, 1), meta(3, 3 * HOUR_MS, 3 * HOUR_MS, 0)});
+    CHECK(plan.has_value() && plan->output_level == 3u && plan->sequences.size() == 2u);
+    CHECK(!compactor.plan({meta(1, 0, 10, 3), meta(2, 30, 40, 0), meta(3, 3 * HOUR_MS, 3 * HOUR_MS, 0)})
+               .has_value());
+
+    Compactor none(store, manual_options(CompactionStrategy::NONE));
+    CHECK(!none.plan({meta(1, 0, 10, 0), meta(2, 5, 20, 0)}).has_value());
+}
+
+void leveled_plans() {
+    TempDir dir;
+    BlockStore store(dir.path(), HOUR_MS);
+    Compactor compactor(store, manual_options(CompactionStrategy::LEVELED));
+
+    // L0 merges with the L1 block below it
+    auto plan = compactor.plan({meta(1, 0, 10, 1), meta(2, 5, 20, 0), meta(3, 6, 30, 0)});
+    CHECK(plan.has_value() && plan->output_level == 1u && plan->sequences.size() == 3u);
+
+    // An oversized L1 moves down, taking L0 and L2 with it
+    plan = compactor.plan({meta(1, 0, 10, 2), meta(2, 5, 20, 1, 5000), meta(3, 6, 30, 0)});
+    CHECK(plan.has_value() && plan->output_level == 2u && plan->sequences.size() == 3u);
+
+    CHECK(!compactor.plan({meta(1, 0, 10, 1), meta(2, 5, 20, 0)}).has_value());
+}
+
+void merge_keeps_latest_copy_and_newest_sequence() {
+    TempDir dir;
+    BlockStore store(dir.path(), HOUR_MS);
+    Compactor compactor(store, manual_options(CompactionStrategy::TIME_WINDOW));
+    add(store, 1, {{1000, 1.0}, {2000, 2.0}});
+    BlockMeta newest = add(store, 1, {{2000, 20.0}, {3000, 3.0}});
+
+    CHECK(compactor.compact_once());
+    auto blocks = store.list_blocks();
+    CHECK_EQ(blocks.size(), 1u);
+    CHECK_EQ(blocks[0].sequence, newest.sequence);
+    CHECK_EQ(blocks[0].level, 1u);
+    CHECK_EQ(compactor.stats().compactions, 1u);
+    CHECK_EQ(compactor.stats().input_blocks, 2u);
+
+    // A flush landing after the merge still reads after its output
+    add(store, 1, {{2000, 200.0}});
+    SeriesSamples out;
+    store.read({1}, 0, HOUR_MS, out);
+    std::vector<Sample>& points = out[1];
+    CHECK_EQ(points.size(), 4u);
+    CHECK_EQ(points[1].value, 20.0);  // dedup of the inputs, latest wins
+    CHECK_EQ(points.back().value, 200.0);
+
+    // The reused sequence must not clash with an input's file name
+    auto readers = store.all_blocks();
+    CHECK_THROWS(store.replace_blocks(readers, readers.front()->series(), out, readers.back()->meta().level),
+                 std::invalid_argument);
+    CHECK_THROWS(store.replace_blocks({}, {}, out, 1), std::invalid_argument);
+}
+
+void rollup_tiers_compact_without_changing_results() {
+    TempDir dir;
+    StorageEngine::Options options;
+    options.data_dir = dir.path();
+    options.flush_interval_ms = 0;
+    options.rollup_resolutions_ms = {MINUTE};
+    options.out_of_order_window_ms = 60 * MINUTE;
+    options.compaction = manual_options(CompactionStrategy::TIME_WINDOW);
+    StorageEngine engine(options);
+    engine.register_series(SeriesDescriptor{1, "cpu", {}});
+
+    // Partials of one bucket across flushes, then a rewrite that makes the
+    // tier write its bucket again as a complete point
+    for (int flush = 0; flush < 4; ++flush) {
+        for (int64_t ts = flush * 10000 + 1000; ts < 2 * MINUTE; ts += 40000) {
+            engine.append(1, ts, static_cast<double>(flush + 1));
+        }
+        engine.flush();
+    }
+    engine.append(1, 1000, 100.0);
+    engine.flush();
+
+    auto before = engine.query_rollups({1}, MINUTE, 0, 2 * MINUTE);
+    CHECK(engine.compact() > 0);
+    auto after = engine.query_rollups({1}, MINUTE, 0, 2 * MINUTE);
+
+    CHECK(before.size() == 1 && after.size() == 1);
+    if (before.size() != 1 || after.size() != 1) return;
+    CHECK_EQ(after[0].points.size(), before[0].points.size());
+    for (size_t i = 0; i < before[0].points.size() && i < after[0].points.size(); ++i) {
+        const Aggregate& want = before[0].points[i].aggregate;
+        const Aggregate& got = after[0].points[i].aggregate;
+        CHECK_EQ(after[0].points[i].timestamp_ms, before[0].points[i].timestamp_ms);
+        CHECK_EQ(got.count, want.count);
+        CHECK_NEAR(got.sum, want.sum, 1e-9);
+        CHECK_EQ(got.min, want.min);
+        CHECK_EQ(got.max, want.max);
+    }
+    auto raw = engine.query_series({1}, 0, MINUTE);
+    CHECK(raw.size() == 1 && after[0].points[0].aggregate.count == raw[0].samples.size());
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(time_window_plans);
+    RUN_TEST(leveled_plans);
+    RUN_TEST(merge_keeps_latest_copy_and_newest_sequence);
+    RUN_TEST(rollup_tiers_compact_without_changing_results);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,77 @@
+#include "hdr_histogram.h"
+#include "test_support.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace metricstream;
+
+namespace {
+
+void percentiles_stay_within_precision() {
+    HdrHistogram histogram(3600LL * 1000 * 1000, 3);
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> latency(7.0, 1.5);  // long tail, microseconds
+    std::vector<int64_t> values;
+    for (int i = 0; i < 100000; ++i) {
+        int64_t value = 1 + static_cast<int64_t>(latency(rng));
+        values.push_back(value);
+        histogram.record(value);
+    }
+    std::sort(values.begin(), values.end());
+
+    CHECK_EQ(histogram.count(), values.size());
+    CHECK_EQ(histogram.max(), values.back());
+    CHECK(std::abs(histogram.min() - values.front()) <= values.front() / 1000 + 1);
+    for (double percentile : {50.0, 90.0, 99.0, 99.9, 99.99}) {
+        size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * values.size())) - 1;
+        int64_t exact = values[rank];
+        int64_t reported = histogram.value_at_percentile(percentile);
+        CHECK(reported >= exact);
+        CHECK(reported - exact <= exact / 1000 + 1);  // 3 significant digits
+    }
+    CHECK_EQ(histogram.value_at_percentile(100.0), histogram.max());
+}
+
+void merge_and_reset() {
+    HdrHistogram a;
+    HdrHistogram b;
+    for (int64_t v = 1; v <= 1000; ++v) a.record(v);
+    b.record(5000, 10);
+    a.merge(b);
+    CHECK_EQ(a.count(), 1010u);
+    CHECK_EQ(a.max(), int64_t{5000});
+    CHECK_NEAR(a.mean(), (500.5 * 1000 + 50000) / 1010.0, 1e-6);
+    CHECK(a.value_at_percentile(99.5) >= 5000);
+
+    a.reset();
+    CHECK_EQ(a.count(), 0u);
+    CHECK_EQ(a.value_at_percentile(50.0), int64_t{0});
+
+    HdrHistogram coarse(1000, 2);
+    CHECK_THROWS(a.merge(coarse), std::invalid_argument);
+}
+
+void out_of_range_values_clamp() {
+    HdrHistogram histogram(1000, 3);
+    histogram.record(0);
+    histogram.record(1000000);  // clamped, but max() stays exact
+    CHECK_EQ(histogram.count(), 2u);
+    CHECK_EQ(histogram.max(), int64_t{1000000});
+    CHECK_EQ(histogram.min(), int64_t{0});
+    CHECK(histogram.summary("us").find("max=1000000us") != std::string::npos);
+
+    CHECK_THROWS(HdrHistogram(1, 3), std::invalid_argument);
+    CHECK_THROWS(HdrHistogram(1000, 6), std::invalid_argument);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(percentiles_stay_within_precision);
+    RUN_TEST(merge_and_reset);
+    RUN_TEST(out_of_range_values_clamp);
+    return metricstream::test::exit_code();
+}
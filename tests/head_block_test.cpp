@@ -0,0 +1,183 @@
+#include "gorilla_codec.h"
+#include "head_block.h"
+#include "test_support.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace metricstream;
+
+namespace {
+
+constexpr int64_t BUCKET_MS = 10000;
+
+void gorilla_round_trips_irregular_series() {
+    std::vector<int64_t> timestamps{-5000, 0, 15000, 30000, 30001, 45000, 45000 + (int64_t{1} << 40)};
+    std::vector<double> values{0.0, -0.0, 1.5, 1.5, std::numeric_limits<double>::infinity(), 1e-300, -7.25};
+
+    GorillaEncoder encoder;
+    for (size_t i = 0; i < timestamps.size(); ++i) {
+        encoder.append(timestamps[i], values[i]);
+    }
+    CHECK_EQ(encoder.count(), timestamps.size());
+    std::string encoded = encoder.finish();
+
+    std::vector<int64_t> decoded_ts;
+    std::vector<double> decoded_values;
+    gorilla_decode(encoded.data(), encoded.size(), decoded_ts, decoded_values);
+    CHECK(decoded_ts == timestamps);
+    CHECK_EQ(decoded_values.size(), values.size());
+    bool identical = decoded_values.size() == values.size();
+    for (size_t i = 0; identical && i < values.size(); ++i) {
+        identical = std::signbit(decoded_values[i]) == std::signbit(values[i]) && decoded_values[i] == values[i];
+    }
+    CHECK(identical);
+
+    CHECK_THROWS(gorilla_decode(encoded.data(), encoded.size() / 2, decoded_ts, decoded_values), std::runtime_error);
+}
+
+void gorilla_compresses_regular_scrapes() {
+    GorillaEncoder encoder;
+    for (int64_t i = 0; i < 1000; ++i) {
+        encoder.append(1700000000000 + i * 15000, 42.0);
+    }
+    // Constant interval and value: about two bits per sample after the first
+    CHECK(encoder.finish().size() < 300);
+}
+
+void head_cuts_chunks_at_capacity_and_buckets() {
+    HeadBlock head(BUCKET_MS);
+    for (int64_t i = 0; i < 100; ++i) {
+        CHECK(head.append(1, i, static_cast<double>(i)));
+    }
+    CHECK_EQ(head.chunk_count(), 2u);  // 64 + 36
+    CHECK(head.append(1, BUCKET_MS, 1.0));
+    CHECK_EQ(head.chunk_count(), 3u);  // a new bucket never shares a chunk
+    CHECK_EQ(head.sample_count(), 101u);
+    CHECK_EQ(head.series_count(), 1u);
+    CHECK_EQ(head.max_timestamp(), BUCKET_MS);
+
+    std::vector<Sample> out;
+    head.read(1, 10, 70, out);
+    CHECK_EQ(out.size(), 61u);
+    CHECK_EQ(out.front().timestamp_ms, int64_t{10});
+    CHECK_EQ(out.back().value, 70.0);
+
+    out.clear();
+    head.read(2, 0, INT64_MAX, out);
+    CHECK(out.empty());
+}
+
+void head_duplicate_timestamp_overwrites() {
+    HeadBlock head(BUCKET_MS);
+    head.append(1, 100, 1.0);
+    CHECK(head.append(1, 100, 2.0));
+    CHECK(!head.append(1, 50, 3.0));  // no out-of-order window
+    CHECK_EQ(head.out_of_order_rejected(), 1u);
+    CHECK_EQ(head.sample_count(), 1u);
+
+    std::vector<Sample> out;
+    head.read(1, 0, INT64_MAX, out);
+    CHECK_EQ(out.size(), 1u);
+    if (!out.empty()) CHECK_EQ(out[0].value, 2.0);
+}
+
+void head_flushes_only_chunks_before_cutoff() {
+    HeadBlock head(BUCKET_MS);
+    for (int64_t ts = 0; ts < 3 * BUCKET_MS; ts += 1000) {
+        head.append(1, ts, 1.0);
+        head.append(2, ts, 2.0);
+    }
+    HeadBlock::FlushBatch batch = head.collect_flushable(2 * BUCKET_MS);
+    CHECK_EQ(batch.buckets.size(), 2u);
+    CHECK_EQ(batch.sample_count, 40u);
+    CHECK_EQ(batch.buckets[0][1].size(), 10u);
+    CHECK_EQ(batch.buckets[BUCKET_MS][2].size(), 10u);
+
+    // Collected chunks stay readable until released
+    std::vector<Sample> out;
+    head.read(1, 0, INT64_MAX, out);
+    CHECK_EQ(out.size(), 30u);
+
+    // Appends after collection go to a fresh chunk
+    head.append(1, 3 * BUCKET_MS, 5.0);
+    head.release(batch);
+    CHECK_EQ(head.sample_count(), 21u);
+    CHECK_EQ(head.chunk_count(), 3u);
+
+    out.clear();
+    head.read(1, 0, INT64_MAX, out);
+    CHECK_EQ(out.size(), 11u);
+    CHECK_EQ(out.front().timestamp_ms, 2 * BUCKET_MS);
+    CHECK(head.collect_flushable(BUCKET_MS).empty());
+}
+
+void head_buffers_late_samples_per_series() {
+    HeadBlock head(BUCKET_MS, 5000);
+    head.append(1, 100000, 1.0);
+    head.append(2, 10000, 2.0);  // a series lagging far behind series 1
+
+    CHECK(head.append(2, 6000, 3.0));    // late for its own series only
+    CHECK(!head.append(2, 4000, 4.0));
+    CHECK(head.append(1, 95000, 5.0));
+    CHECK(!head.append(1, 90000, 6.0));
+    CHECK(head.append(1, 95000, 7.0));   // rewrite of a buffered sample
+    CHECK_EQ(head.out_of_order_accepted(), 3u);
+    CHECK_EQ(head.out_of_order_rejected(), 2u);
+    CHECK_EQ(head.sample_count(), 4u);
+
+    std::vector<Sample> out;
+    head.read(1, 0, INT64_MAX, out);
+    CHECK(out.size() == 2 && out[0].timestamp_ms == 95000 && out[0].value == 7.0);
+
+    // Buffered samples flush once nothing in-order older is left behind them
+    HeadBlock::FlushBatch batch = head.collect_flushable(INT64_MAX);
+    CHECK_EQ(batch.sample_count, 4u);
+    CHECK_EQ(batch.out_of_order_buckets[0][2].size(), 1u);
+    CHECK_EQ(batch.out_of_order_buckets[90000][1].size(), 1u);
+    head.release(batch);
+    CHECK_EQ(head.sample_count(), 0u);
+}
+
+void head_evicts_idle_series_after_churn() {
+    HeadBlock head(BUCKET_MS, 5000);
+    for (SeriesId id = 0; id < 1000; ++id) {
+        head.append(id, 1000, 1.0);  // e.g. one pod per series, gone after one scrape
+    }
+    head.append(5000, 1000, 1.0);
+    head.append(5000, 500, 2.0);     // buffered out of order
+    CHECK_EQ(head.series_count(), 1001u);
+    CHECK_EQ(head.evict_idle(INT64_MAX), 0u);  // everything still has samples in memory
+
+    head.release(head.collect_flushable(2000));
+    CHECK_EQ(head.evict_idle(1000), 0u);  // not idle long enough yet
+    head.append(7, 3 * BUCKET_MS, 1.0);   // still active
+    CHECK_EQ(head.evict_idle(2 * BUCKET_MS), 1000u);
+    CHECK_EQ(head.series_count(), 1u);
+
+    // An evicted series starts afresh
+    CHECK(head.append(3, 500, 4.0));
+    std::vector<Sample> out;
+    head.read(3, 0, INT64_MAX, out);
+    CHECK(out.size() == 1 && out[0].value == 4.0);
+    CHECK_EQ(head.series_count(), 2u);
+}
+
+void head_rejects_bad_options() {
+    CHECK_THROWS(HeadBlock(0), std::invalid_argument);
+    CHECK_THROWS(HeadBlock(BUCKET_MS, -1), std::invalid_argument);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(gorilla_round_trips_irregular_series);
+    RUN_TEST(gorilla_compresses_regular_scrapes);
+    RUN_TEST(head_cuts_chunks_at_capacity_and_buckets);
+    RUN_TEST(head_duplicate_timestamp_overwrites);
+    RUN_TEST(head_flushes_only_chunks_before_cutoff);
+    RUN_TEST(head_buffers_late_samples_per_series);
+    RUN_TEST(head_evicts_idle_series_after_churn);
+    RUN_TEST(head_rejects_bad_options);
+    return metricstream::test::exit_code();
+}
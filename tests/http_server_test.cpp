@@ -0,0 +1,106 @@
+#include "http_server.h"
+#include "test_support.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace metricstream;
+
+namespace {
+
+const int PORT = 20000 + static_cast<int>(getpid() % 20000);
+
+// One request over a fresh connection; returns the raw response ("" if the
+// server could not be reached)
+std::string roundtrip(const std::string& request) {
+    for (int attempt = 0; attempt < 50; ++attempt) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(PORT));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+            std::string response;
+            char buffer[4096];
+            ssize_t n;
+            while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+            }
+            close(fd);
+            return response;
+        }
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));  // server still starting
+    }
+    return "";
+}
+
+std::string get(const std::string& path) {
+    return roundtrip("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+}
+
+bool wait_for_idle(const HttpServer& server) {
+    for (int i = 0; i < 100 && server.active_connections() != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return server.active_connections() == 0;
+}
+
+void server_turns_handler_exceptions_into_500() {
+    HttpServer server(PORT, 2);
+    server.add_handler("/ok", "GET", [](const HttpRequest& request) {
+        HttpResponse response;
+        response.body = "name=" + request.query_params.at("name");
+        return response;
+    });
+    server.add_handler("/throws", "GET", [](const HttpRequest&) -> HttpResponse {
+        throw std::runtime_error("storage read failed");
+    });
+    server.add_handler("/throws_other", "GET", [](const HttpRequest&) -> HttpResponse {
+        throw 42;
+    });
+    server.add_handler("/stream", "GET", [](const HttpRequest&) {
+        HttpResponse response;
+        response.body_stream = [](const ChunkWriter& write_chunk) {
+            write_chunk("hello ");
+            write_chunk("world");
+        };
+        return response;
+    });
+    server.start();
+
+    std::string ok = get("/ok?name=a%20b");
+    CHECK(ok.rfind("HTTP/1.1 200", 0) == 0);
+    CHECK(ok.find("name=a b") != std::string::npos);
+
+    for (int i = 0; i < 5; ++i) {
+        std::string failed = get("/throws");
+        CHECK(failed.rfind("HTTP/1.1 500", 0) == 0);
+        CHECK(failed.find("Internal server error") != std::string::npos);
+        CHECK(failed.find("storage read failed") == std::string::npos);  // not leaked to clients
+    }
+    CHECK(get("/throws_other").rfind("HTTP/1.1 500", 0) == 0);
+
+    CHECK(get("/missing").rfind("HTTP/1.1 404", 0) == 0);
+    CHECK(roundtrip("POST /ok HTTP/1.1\r\nContent-Length: 0\r\n\r\n").rfind("HTTP/1.1 405", 0) == 0);
+
+    std::string streamed = get("/stream");
+    CHECK(streamed.find("Transfer-Encoding: chunked") != std::string::npos);
+    CHECK(streamed.find("6\r\nhello \r\n5\r\nworld\r\n0\r\n\r\n") != std::string::npos);
+
+    // Every connection, failed or not, was closed and released
+    CHECK(wait_for_idle(server));
+    server.stop();
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(server_turns_handler_exceptions_into_500);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,128 @@
+#include "logging.h"
+#include "test_support.h"
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+using metricstream::test::count_of;
+
+namespace {
+
+// Points the logger at a file for the scope and returns what was written
+class CapturedLog {
+public:
+    explicit CapturedLog(const TempDir& dir) : path_(dir.path() + "/log.txt") {
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        Logger::instance().set_output_fd(fd_);
+    }
+    ~CapturedLog() {
+        Logger::instance().flush();
+        Logger::instance().set_output_fd(2);
+        ::close(fd_);
+    }
+
+    std::string text() {
+        Logger::instance().flush();
+        std::ifstream in(path_);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        return buffer.str();
+    }
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+void arguments_are_formatted_in_order() {
+    TempDir dir;
+    CapturedLog log(dir);
+    std::string name = "cpu";
+    MS_LOG_INFO("series={} value={} ok={} id={} extra", name, 2.5, true, int64_t{-7});
+    MS_LOG_INFO("missing {} {}", 1);
+    std::string text = log.text();
+    CHECK(text.find("info  [t") != std::string::npos);
+    CHECK(text.find("logging_test.cpp:") != std::string::npos);
+    CHECK(text.find("series=cpu value=2.5 ok=true id=-7 extra") != std::string::npos);
+    CHECK(text.find("missing 1 {}") != std::string::npos);
+}
+
+void levels_filter_before_evaluation() {
+    TempDir dir;
+    CapturedLog log(dir);
+    int evaluated = 0;
+    auto count = [&evaluated] { return ++evaluated; };
+    Logger::instance().set_level(LogLevel::WARN);
+    MS_LOG_INFO("hidden {}", count());
+    MS_LOG_WARN("shown {}", count());
+    Logger::instance().set_level(LogLevel::INFO);
+    CHECK_EQ(evaluated, 1);
+    std::string text = log.text();
+    CHECK(text.find("hidden") == std::string::npos);
+    CHECK(text.find("shown 1") != std::string::npos);
+}
+
+void limited(int i) {
+    MS_LOG_RATE_LIMITED(LogLevel::INFO, 5, "limited {}", i);
+}
+
+void call_sites_are_rate_limited() {
+    TempDir dir;
+    CapturedLog log(dir);
+    for (int i = 0; i < 50; ++i) {
+        limited(i);
+    }
+    // Five per one-second window (ten if the loop straddled a boundary)
+    size_t admitted = count_of(log.text(), "limited ");
+    CHECK(admitted == 5 || admitted == 10);
+
+    // The next admitted message reports how many were dropped before it
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    limited(99);
+    std::string expected = "limited 99 [" + std::to_string(50 - admitted) + " similar suppressed]";
+    CHECK(log.text().find(expected) != std::string::npos);
+}
+
+void json_lines_are_escaped() {
+    TempDir dir;
+    CapturedLog log(dir);
+    Logger::instance().set_json(true);
+    MS_LOG_ERROR("path {}", "a\"b\\c\n");
+    std::string text = log.text();  // the format applies when records are written
+    Logger::instance().set_json(false);
+    CHECK(text.find("\"level\":\"error\"") != std::string::npos);
+    CHECK(text.find("\"msg\":\"path a\\\"b\\\\c\\n\"") != std::string::npos);
+}
+
+void threads_log_concurrently() {
+    TempDir dir;
+    CapturedLog log(dir);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < 50; ++i) {
+                MS_LOG_RATE_LIMITED(LogLevel::INFO, 1000, "worker {} line {}", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    std::string text = log.text();
+    CHECK_EQ(count_of(text, "worker "), 200u);
+    CHECK_EQ(Logger::instance().dropped(), 0u);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(arguments_are_formatted_in_order);
+    RUN_TEST(levels_filter_before_evaluation);
+    RUN_TEST(call_sites_are_rate_limited);
+    RUN_TEST(json_lines_are_escaped);
+    RUN_TEST(threads_log_concurrently);
+    return metricstream::test::exit_code();
+}
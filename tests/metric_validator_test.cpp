@@ -0,0 +1,66 @@
+#include "metric_validator.h"
+#include "batch_codec.h"
+#include "test_support.h"
+#include <cmath>
+#include <limits>
+
+using namespace metricstream;
+
+namespace {
+
+int64_t now_ms() {
+    return to_unix_millis(std::chrono::system_clock::now());
+}
+
+bool accepts(Timestamp ts) {
+    return MetricValidator().validate_metric(Metric("cpu", 1.0, MetricType::GAUGE, {}, ts)).valid;
+}
+
+void names_and_values() {
+    MetricValidator validator;
+    CHECK(validator.validate_metric(Metric("cpu", 1.0, MetricType::GAUGE)).valid);
+    CHECK(!validator.validate_metric(Metric("", 1.0, MetricType::GAUGE)).valid);
+    CHECK(!validator.validate_metric(Metric(std::string(256, 'x'), 1.0, MetricType::GAUGE)).valid);
+    CHECK(!validator.validate_metric(Metric("cpu", std::nan(""), MetricType::GAUGE)).valid);
+
+    MetricBatch batch;
+    CHECK(!validator.validate_batch(batch).valid);
+    batch.add_metric(Metric("cpu", 1.0, MetricType::GAUGE));
+    batch.add_metric(Metric("cpu", INFINITY, MetricType::GAUGE));
+    auto result = validator.validate_batch(batch);
+    CHECK(!result.valid && result.error_message.rfind("Invalid metric: ", 0) == 0);
+}
+
+void absent_timestamps_use_the_server_clock() {
+    const int64_t before = now_ms();
+    const int64_t stamped = to_unix_millis(client_timestamp(std::nullopt));
+    CHECK(stamped >= before && stamped <= now_ms());
+    CHECK(accepts(client_timestamp(std::nullopt)));
+}
+
+void client_timestamps_are_checked() {
+    const int64_t now = now_ms();
+    CHECK_EQ(to_unix_millis(client_timestamp(static_cast<double>(now))), now);
+    CHECK(accepts(client_timestamp(static_cast<double>(now - 60000))));
+
+    // Sent but unusable: rejected rather than replaced by the server clock
+    CHECK(!accepts(client_timestamp(0.0)));
+    CHECK(!accepts(client_timestamp(-1.0)));
+    CHECK(!accepts(client_timestamp(-1e300)));
+    CHECK(!accepts(client_timestamp(std::numeric_limits<double>::quiet_NaN())));
+    CHECK(!accepts(client_timestamp(-std::numeric_limits<double>::infinity())));
+
+    // Seconds instead of milliseconds, too far ahead, and beyond the clock
+    CHECK(!accepts(client_timestamp(static_cast<double>(now / 1000))));
+    CHECK(!accepts(client_timestamp(static_cast<double>(now + 2 * MetricValidator::MAX_FUTURE_SKEW_MS))));
+    CHECK(!accepts(client_timestamp(std::numeric_limits<double>::infinity())));
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(names_and_values);
+    RUN_TEST(absent_timestamps_use_the_server_clock);
+    RUN_TEST(client_timestamps_are_checked);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,93 @@
+#include "metrics_registry.h"
+#include "test_support.h"
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace metricstream;
+
+namespace {
+
+bool has_line(const std::string& text, const std::string& line) {
+    return text.find(line + "\n") != std::string::npos;
+}
+
+void counters_and_gauges_render() {
+    MetricsRegistry registry;
+    Counter& ok = registry.counter("requests_total", "Requests", {{"code", "200"}});
+    registry.counter("requests_total", "Requests", {{"code", "500"}}).inc(2);
+    ok.inc();
+    CHECK(&registry.counter("requests_total", "Requests", {{"code", "200"}}) == &ok);
+    registry.gauge("temperature", "Degrees").set(-1.5);
+    registry.gauge_function("answer", "Sampled", [] { return 42.0; });
+
+    std::string out;
+    registry.write_prometheus(out);
+    CHECK(has_line(out, "# HELP requests_total Requests"));
+    CHECK(has_line(out, "# TYPE requests_total counter"));
+    CHECK(has_line(out, "requests_total{code=\"200\"} 1"));
+    CHECK(has_line(out, "requests_total{code=\"500\"} 2"));
+    CHECK(has_line(out, "# TYPE temperature gauge"));
+    CHECK(has_line(out, "temperature -1.5"));
+    CHECK(has_line(out, "answer 42"));
+}
+
+void histograms_are_cumulative() {
+    MetricsRegistry registry;
+    Histogram& latency = registry.histogram("latency_seconds", "Latency", {0.1, 1.0});
+    latency.observe(0.05);
+    latency.observe(0.5);
+    latency.observe(0.5);
+    latency.observe(5.0);
+
+    std::string out;
+    registry.write_prometheus(out);
+    CHECK(has_line(out, "latency_seconds_bucket{le=\"0.1\"} 1"));
+    CHECK(has_line(out, "latency_seconds_bucket{le=\"1\"} 3"));
+    CHECK(has_line(out, "latency_seconds_bucket{le=\"+Inf\"} 4"));
+    CHECK(has_line(out, "latency_seconds_count 4"));
+    CHECK(has_line(out, "latency_seconds_sum 6.05"));
+}
+
+void labels_are_escaped_and_names_checked() {
+    CHECK_EQ(PrometheusWriter::render_labels({{"path", "a\"b\\c\nd"}}), std::string("path=\"a\\\"b\\\\c\\nd\""));
+    CHECK_EQ(PrometheusWriter::render_labels({}), std::string());
+
+    MetricsRegistry registry;
+    registry.counter("things_total", "Things");
+    CHECK_THROWS(registry.gauge("things_total", "Things"), std::invalid_argument);
+    CHECK_THROWS(registry.counter("bad-name", "Bad"), std::invalid_argument);
+    CHECK_THROWS(registry.counter("ok_total", "Ok", {{"0bad", "x"}}), std::invalid_argument);
+}
+
+void concurrent_updates_are_not_lost() {
+    MetricsRegistry registry;
+    Counter& counter = registry.counter("hits_total", "Hits");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&counter] {
+            for (int i = 0; i < 10000; ++i) counter.inc();
+        });
+    }
+    std::string out;
+    for (int i = 0; i < 100; ++i) registry.write_prometheus(out);  // scrapes while writers run
+    for (auto& thread : threads) thread.join();
+    CHECK_EQ(counter.value(), 80000u);
+
+    registry.add_collector([](PrometheusWriter& writer) {
+        writer.family("collected", "From a collector", "gauge");
+        writer.sample("collected", "", uint64_t{7});
+    });
+    registry.write_prometheus(out);
+    CHECK(has_line(out, "collected 7"));
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(counters_and_gauges_render);
+    RUN_TEST(histograms_are_cumulative);
+    RUN_TEST(labels_are_escaped_and_names_checked);
+    RUN_TEST(concurrent_updates_are_not_lost);
+    return metricstream::test::exit_code();
+}
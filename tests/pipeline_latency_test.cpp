@@ -0,0 +1,39 @@
+#include "pipeline_latency.h"
+#include "test_support.h"
+
+using namespace metricstream;
+
+namespace {
+
+void latencies_are_recorded_per_partition() {
+    MetricsRegistry registry;
+    PipelineLatencyStats stats(registry);
+    int64_t now = PipelineLatencyStats::now_us();
+    stats.record(0, now - 2000000, now - 1000000, now);  // 1s to deliver, 2s end to end
+    stats.record(0, now - 4000000, now - 3000000, now);  // 1s, 4s
+    stats.record(3, now - 1000, now, now);
+    stats.record(1, 0, now, now);                        // untimed producer
+    stats.record(1, now + 5000000, now, now);            // consumer clock behind: clamped
+
+    std::string json = stats.to_json();
+    CHECK(json.find("{\"partition\":0,\"batches\":2,\"e2e_ms\":{\"mean\":3000.000") != std::string::npos);
+    CHECK(json.find("\"max\":4000.000") != std::string::npos);
+    CHECK(json.find("{\"partition\":1,\"batches\":1,\"e2e_ms\":{\"mean\":0.000") != std::string::npos);
+    CHECK(json.find("{\"partition\":3,\"batches\":1") != std::string::npos);
+    CHECK(json.find("\"partition\":2") == std::string::npos);
+
+    std::string text;
+    registry.write_prometheus(text);
+    CHECK(text.find("metricstream_consumer_untimed_batches_total 1\n") != std::string::npos);
+    CHECK(text.find("metricstream_consumer_e2e_latency_seconds_count{partition=\"0\"} 2\n") != std::string::npos);
+    CHECK(text.find("metricstream_consumer_delivery_latency_seconds_sum{partition=\"0\"} 2\n") !=
+          std::string::npos);
+    CHECK(text.find("metricstream_consumer_freshness_seconds{partition=\"3\"}") != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(latencies_are_recorded_per_partition);
+    return metricstream::test::exit_code();
+}
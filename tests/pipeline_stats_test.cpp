@@ -0,0 +1,70 @@
+#include "pipeline_stats.h"
+#include "test_support.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace metricstream;
+
+namespace {
+
+void buckets_cover_values_with_bounded_error() {
+    size_t previous = 0;
+    for (uint64_t value = 0; value < (uint64_t{1} << 20); value = value * 2 + 1) {
+        size_t index = latency_buckets::index_of(value);
+        CHECK(index < latency_buckets::COUNT);
+        CHECK(index >= previous);
+        previous = index;
+        uint64_t upper = latency_buckets::upper_bound(index);
+        CHECK(upper >= value);
+        CHECK(upper - value <= value / latency_buckets::SUB_BUCKETS + 1);
+    }
+    for (uint64_t value = 0; value < 16; ++value) {
+        CHECK_EQ(latency_buckets::upper_bound(latency_buckets::index_of(value)), value);
+    }
+    // Clamped at the top instead of indexing past the array
+    CHECK_EQ(latency_buckets::index_of(UINT64_MAX), latency_buckets::COUNT - 1);
+}
+
+void histograms_merge_into_snapshots() {
+    LatencyHistogram histogram;
+    for (uint64_t ns = 1; ns <= 1000; ++ns) histogram.record(ns * 1000);
+    LatencySnapshot snapshot;
+    histogram.add_to(snapshot);
+    histogram.add_to(snapshot);
+    CHECK_EQ(snapshot.count(), 2000u);
+    CHECK_EQ(snapshot.max(), 1000000u);
+    CHECK_NEAR(snapshot.mean(), 500500.0, 1e-6);
+    uint64_t p50 = snapshot.value_at_percentile(50.0);
+    CHECK(p50 >= 500000 && p50 <= 500000 + 500000 / 16);
+    CHECK_EQ(LatencySnapshot().value_at_percentile(99.0), 0u);
+}
+
+void stages_record_from_many_threads() {
+    auto before = PipelineStats::instance().snapshot();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 1000; ++i) PipelineStats::instance().record(Stage::VALIDATE, 2000);
+            StageTimer timer(Stage::ENQUEUE);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    auto after = PipelineStats::instance().snapshot();
+    size_t validate = static_cast<size_t>(Stage::VALIDATE);
+    size_t enqueue = static_cast<size_t>(Stage::ENQUEUE);
+    CHECK_EQ(after[validate].count() - before[validate].count(), 8000u);
+    CHECK_EQ(after[enqueue].count() - before[enqueue].count(), 8u);
+    CHECK_EQ(std::string(stage_name(Stage::QUEUE_WRITE)), std::string("queue_write"));
+    CHECK(resident_memory_bytes() > 0);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(buckets_cover_values_with_bounded_error);
+    RUN_TEST(histograms_merge_into_snapshots);
+    RUN_TEST(stages_record_from_many_threads);
+    return metricstream::test::exit_code();
+}
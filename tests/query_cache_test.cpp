@@ -0,0 +1,139 @@
+#include "query_cache.h"
+#include "query_engine.h"
+#include "test_support.h"
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+
+namespace {
+
+QueryResultCache::Bucket one_series(double value, size_t steps = 4) {
+    StepSeries series;
+    series.name = "cpu";
+    series.values.assign(steps, value);
+    series.present.assign(steps, 1);
+    return {series};
+}
+
+void put_bucket(QueryResultCache& cache, const std::string& key, int64_t first_step, int64_t first_data,
+                int64_t last_step, double value) {
+    auto fill = cache.begin_fill(last_step);
+    cache.put(*fill, key, first_step, first_data, last_step, one_series(value));
+}
+
+void buckets_are_found_by_key_and_first_step() {
+    QueryResultCache cache;
+    put_bucket(cache, "q", 100, 50, 130, 1.0);
+    auto hit = cache.get("q", 100);
+    CHECK(hit && hit->size() == 1 && (*hit)[0].values[0] == 1.0);
+    CHECK(!cache.get("q", 110));
+    CHECK(!cache.get("other", 100));
+    auto stats = cache.stats();
+    CHECK_EQ(stats.hits, 1u);
+    CHECK_EQ(stats.misses, 2u);
+    CHECK_EQ(stats.entries, 1u);
+}
+
+void writes_invalidate_overlapping_buckets() {
+    QueryResultCache cache;
+    put_bucket(cache, "q", 100, 50, 130, 1.0);   // data [50, 130]
+    put_bucket(cache, "q", 140, 90, 170, 2.0);   // data [90, 170]
+    put_bucket(cache, "q", 180, 130, 210, 3.0);  // data [130, 210]
+
+    cache.invalidate(300, 400);  // after everything cached
+    CHECK_EQ(cache.stats().entries, 3u);
+
+    cache.invalidate(175, 178);  // inside the third bucket's lookbehind only
+    CHECK(cache.get("q", 100) && cache.get("q", 140));
+    CHECK(!cache.get("q", 180));
+
+    // A batch spanning the whole range: its oldest sample predates every
+    // bucket, but the newest lands inside them
+    put_bucket(cache, "q", 180, 130, 210, 3.0);
+    cache.invalidate(0, 135);
+    CHECK_EQ(cache.stats().entries, 0u);
+    CHECK_EQ(cache.stats().invalidations, 4u);
+}
+
+void writes_during_a_fill_keep_it_out() {
+    QueryResultCache cache;
+    auto fill = cache.begin_fill(130);
+    cache.invalidate(40, 60);  // lands while the bucket is being computed
+    cache.put(*fill, "q", 100, 50, 130, one_series(1.0));
+    CHECK(!cache.get("q", 100));
+
+    auto clean = cache.begin_fill(130);
+    cache.invalidate(500, 600);
+    cache.put(*clean, "q", 100, 50, 130, one_series(1.0));
+    CHECK(cache.get("q", 100) != nullptr);
+}
+
+void lru_evicts_over_budget() {
+    QueryResultCache::Options options;
+    options.max_bytes = 3 * 1024;
+    QueryResultCache cache(options);
+    for (int i = 0; i < 50; ++i) {
+        put_bucket(cache, "q" + std::to_string(i), 0, 0, 10, static_cast<double>(i));
+    }
+    auto stats = cache.stats();
+    CHECK(stats.bytes <= options.max_bytes);
+    CHECK(stats.evictions > 0);
+    CHECK(cache.get("q49", 0) != nullptr);
+    CHECK(!cache.get("q0", 0));
+    cache.clear();
+    CHECK_EQ(cache.stats().entries, 0u);
+}
+
+void engine_serves_fresh_results_after_late_writes() {
+    TempDir dir;
+    StorageEngine::Options options;
+    options.data_dir = dir.path();
+    options.flush_interval_ms = 0;
+    options.rollup_resolutions_ms = {};
+    options.compaction.strategy = CompactionStrategy::NONE;
+    options.out_of_order_window_ms = 60 * 60 * 1000;
+    StorageEngine storage(options);
+
+    QueryResultCache::Options cache_options;
+    cache_options.steps_per_bucket = 10;
+    QueryResultCache cache(cache_options);
+    storage.set_write_observer([&cache](int64_t oldest_ts, int64_t newest_ts) {
+        cache.invalidate(oldest_ts, newest_ts);
+    });
+    QueryEngine engine(storage);
+    engine.set_result_cache(&cache);
+
+    storage.register_series({1, "cpu", {{"host", "a"}}});
+    for (int64_t ts = 0; ts <= 1000; ts += 10) {
+        if (ts != 500) storage.append(1, ts, 1.0);
+    }
+    auto first = engine.execute("sum_over_time(cpu[10ms])", 0, 990, 10);
+    auto cached = engine.execute("sum_over_time(cpu[10ms])", 0, 990, 10);
+    CHECK(cached.stats.cached_steps > 0);
+
+    // A late batch spanning [0, 500] changes the step at 500
+    DecodedBatch late;
+    late.points.push_back({1, 1.0, 0});
+    late.points.push_back({1, 7.0, 500});
+    storage.ingest(late);
+
+    auto fresh = engine.execute("sum_over_time(cpu[10ms])", 0, 990, 10);
+    bool saw_late = false;
+    for (const auto& point : fresh.series.empty() ? std::vector<Sample>{} : fresh.series[0].points) {
+        if (point.timestamp_ms == 500) saw_late = point.value == 7.0;
+    }
+    CHECK(saw_late);
+    CHECK(first.series.size() == 1 && fresh.series.size() == 1 &&
+          fresh.series[0].points.size() == first.series[0].points.size() + 1);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(buckets_are_found_by_key_and_first_step);
+    RUN_TEST(writes_invalidate_overlapping_buckets);
+    RUN_TEST(writes_during_a_fill_keep_it_out);
+    RUN_TEST(lru_evicts_over_budget);
+    RUN_TEST(engine_serves_fresh_results_after_late_writes);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,257 @@
+#include "query_engine.h"
+#include "test_support.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+using metricstream::test::engine_options;
+
+namespace {
+
+constexpr int64_t SECOND = 1000;
+constexpr int64_t MINUTE = 60 * SECOND;
+
+// cpu{host,region} gauges and a reqs counter growing 2/s, sampled every 10s
+// over [0, 10m]; host a holds 1, b holds 2, c holds 4
+void fill(StorageEngine& engine) {
+    struct Host { const char* host; const char* region; double value; };
+    const Host hosts[] = {{"a", "us", 1.0}, {"b", "us", 2.0}, {"c", "eu", 4.0}};
+    SeriesId id = 1;
+    for (const Host& h : hosts) {
+        SeriesId cpu = id++;
+        SeriesId reqs = id++;
+        engine.register_series({cpu, "cpu", {{"host", h.host}, {"region", h.region}}});
+        engine.register_series({reqs, "reqs", {{"host", h.host}, {"region", h.region}}});
+        for (int64_t ts = 0; ts <= 10 * MINUTE; ts += 10 * SECOND) {
+            engine.append(cpu, ts, h.value);
+            engine.append(reqs, ts, 2.0 * static_cast<double>(ts / SECOND));
+        }
+    }
+}
+
+const QueryEngine::ResultSeries* find_host(const QueryEngine::Result& result, const std::string& host) {
+    for (const auto& series : result.series) {
+        for (const auto& [key, value] : series.tags) {
+            if (key == "host" && value == host) return &series;
+        }
+    }
+    return nullptr;
+}
+
+void instant_selector_uses_lookback() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    fill(storage);
+    QueryEngine engine(storage);
+
+    auto result = engine.execute("cpu{region=\"us\"}", 0, 5 * MINUTE + 5 * SECOND, 0);
+    CHECK(!result.is_matrix);
+    CHECK_EQ(result.series.size(), 2u);
+    const auto* b = find_host(result, "b");
+    CHECK(b && b->points.size() == 1 && b->points[0].value == 2.0 && b->points[0].timestamp_ms == 5 * MINUTE + 5 * SECOND);
+    CHECK_EQ(result.stats.series_matched, 2u);
+
+    // Past the lookback after the last sample, nothing is returned
+    CHECK(engine.execute("cpu", 0, 10 * MINUTE + QueryEngine::DEFAULT_LOOKBACK_MS + SECOND, 0).series.empty());
+}
+
+void range_query_rate_and_aggregation() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    fill(storage);
+    QueryEngine engine(storage);
+
+    auto rate = engine.execute("rate(reqs{host=\"a\"}[1m])", 2 * MINUTE, 4 * MINUTE, MINUTE);
+    CHECK(rate.is_matrix);
+    CHECK_EQ(rate.series.size(), 1u);
+    if (rate.series.size() == 1) {
+        CHECK_EQ(rate.series[0].points.size(), 3u);
+        CHECK(rate.series[0].name.empty());
+        for (const auto& point : rate.series[0].points) CHECK_NEAR(point.value, 2.0, 1e-9);
+    }
+
+    auto by_region = engine.execute("sum by (region) (cpu)", 0, 10 * MINUTE, 5 * MINUTE);
+    CHECK_EQ(by_region.series.size(), 2u);
+    for (const auto& series : by_region.series) {
+        CHECK_EQ(series.tags.size(), 1u);
+        CHECK_EQ(series.points.size(), 3u);
+        double expected = series.tags[0].second == "us" ? 3.0 : 4.0;
+        for (const auto& point : series.points) CHECK_EQ(point.value, expected);
+    }
+
+    auto total = engine.execute("count(cpu)", 10 * MINUTE, 10 * MINUTE, 0);
+    CHECK(total.series.size() == 1 && total.series[0].points[0].value == 3.0);
+
+    auto over_time = engine.execute("max_over_time(reqs{host=\"c\"}[2m])", 0, 6 * MINUTE, 0);
+    CHECK(over_time.series.size() == 1 && over_time.series[0].points[0].value == 720.0);
+}
+
+void raw_range_vector_returns_samples() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    fill(storage);
+    QueryEngine engine(storage);
+
+    auto raw = engine.execute("cpu{host=\"a\"}[1m]", 0, 5 * MINUTE, 0);
+    CHECK_EQ(raw.series.size(), 1u);
+    if (!raw.series.empty()) {
+        CHECK_EQ(raw.series[0].name, std::string("cpu"));
+        CHECK_EQ(raw.series[0].points.size(), 6u);  // (4m, 5m]
+    }
+    CHECK_THROWS(engine.execute("cpu[1m]", 0, 5 * MINUTE, MINUTE), std::invalid_argument);
+}
+
+void planner_pushes_bounds_to_scans() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    QueryEngine engine(storage);
+
+    auto expr = parse_query("sum(rate(reqs{host=\"a\"}[5m]))");
+    auto scans = engine.plan(*expr, 10 * MINUTE, 20 * MINUTE);
+    CHECK_EQ(scans.size(), 1u);
+    if (!scans.empty()) {
+        CHECK(scans[0].start_ts > 5 * MINUTE - SECOND && scans[0].start_ts <= 5 * MINUTE + 1);
+        CHECK_EQ(scans[0].end_ts, 20 * MINUTE);
+        CHECK_EQ(scans[0].matchers.size(), 2u);
+        CHECK_EQ(scans[0].rollup_resolution_ms, int64_t{0});
+    }
+}
+
+void invalid_ranges_are_rejected() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    QueryEngine engine(storage);
+    CHECK_THROWS(engine.execute("cpu", 10, 0, 1), std::invalid_argument);
+    CHECK_THROWS(engine.execute("cpu", 0, 10, -1), std::invalid_argument);
+    CHECK_THROWS(engine.execute("cpu", 0, int64_t{QueryEngine::MAX_STEPS} * 10, 10), std::invalid_argument);
+    CHECK_THROWS(engine.execute("rate(cpu)", 0, 10, 0), QueryParseError);
+}
+
+// Enough series for several shards of SERIES_PER_TASK
+void fill_wide(StorageEngine& engine, size_t series_count) {
+    for (size_t i = 0; i < series_count; ++i) {
+        SeriesId id = 1000 + i;
+        engine.register_series({id, "wide", {{"shard", std::to_string(i % 7)}, {"i", std::to_string(i)}}});
+        for (int64_t ts = 0; ts <= 10 * MINUTE; ts += 15 * SECOND) {
+            engine.append(id, ts, static_cast<double>(i) + static_cast<double>(ts / SECOND));
+        }
+    }
+}
+
+void parallel_shards_match_serial_evaluation() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    fill_wide(storage, 5 * QueryEngine::SERIES_PER_TASK + 3);
+    ThreadPool pool(4);
+    QueryEngine serial(storage);
+    QueryEngine parallel(storage, &pool);
+
+    for (const char* query : {"sum by (shard) (wide)", "max_over_time(wide[2m])", "count(rate(wide[1m]))"}) {
+        auto a = serial.execute(query, MINUTE, 10 * MINUTE, MINUTE);
+        auto b = parallel.execute(query, MINUTE, 10 * MINUTE, MINUTE);
+        CHECK_EQ(a.series.size(), b.series.size());
+        CHECK_EQ(a.stats.series_matched, b.stats.series_matched);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < a.series.size() && i < b.series.size(); ++i) {
+            if (a.series[i].tags != b.series[i].tags || a.series[i].points.size() != b.series[i].points.size()) {
+                mismatches++;
+                continue;
+            }
+            for (size_t p = 0; p < a.series[i].points.size(); ++p) {
+                if (std::abs(a.series[i].points[p].value - b.series[i].points[p].value) > 1e-6) mismatches++;
+            }
+        }
+        CHECK_EQ(mismatches, 0u);
+    }
+}
+
+void cancelled_queries_throw() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    fill_wide(storage, 3 * QueryEngine::SERIES_PER_TASK);
+    ThreadPool pool(2);
+    QueryEngine engine(storage, &pool);
+
+    QueryContext cancelled;
+    cancelled.cancel();
+    CHECK(cancelled.cancelled());
+    CHECK_THROWS(engine.execute("sum(wide)", 0, 10 * MINUTE, MINUTE, &cancelled), QueryCancelled);
+
+    QueryContext expired(QueryContext::Clock::now() - std::chrono::milliseconds(1));
+    CHECK_THROWS(engine.execute("wide", 0, 10 * MINUTE, 0, &expired), QueryCancelled);
+
+    // The client probe is asked once per shard; a disconnect stops the query
+    std::atomic<int> probes{0};
+    QueryContext gone(QueryContext::Clock::time_point::max(), [&probes] {
+        probes++;
+        return false;
+    });
+    CHECK_THROWS(engine.execute("wide", 0, 10 * MINUTE, MINUTE, &gone), QueryCancelled);
+    CHECK(probes.load() >= 1);
+    CHECK(gone.cancelled());
+
+    // A live context runs to completion, and the pool stays usable after cancellations
+    QueryContext live(QueryContext::Clock::now() + std::chrono::minutes(1), [] { return true; });
+    auto result = engine.execute("count(wide)", 10 * MINUTE, 10 * MINUTE, 0, &live);
+    CHECK(result.series.size() == 1 &&
+          result.series[0].points[0].value == static_cast<double>(3 * QueryEngine::SERIES_PER_TASK));
+}
+
+void streaming_hands_over_series_in_waves() {
+    TempDir dir;
+    StorageEngine storage(engine_options(dir.path()));
+    const size_t series_count = 2 * QueryEngine::STREAM_SHARDS * QueryEngine::SERIES_PER_TASK + 5;
+    fill_wide(storage, series_count);
+    ThreadPool pool(2);
+    QueryEngine engine(storage, &pool);
+
+    for (const char* query : {"wide", "rate(wide[1m])", "wide[1m]", "sum by (shard) (wide)"}) {
+        auto expr = parse_query(query);
+        auto whole = engine.execute(*expr, 5 * MINUTE, 5 * MINUTE, 0);
+        std::vector<QueryEngine::ResultSeries> streamed;
+        auto result = engine.execute_streaming(*expr, 5 * MINUTE, 5 * MINUTE, 0,
+                                               [&streamed](QueryEngine::ResultSeries&& series) {
+            streamed.push_back(std::move(series));
+        });
+        CHECK(result.series.empty());
+        CHECK_EQ(result.is_matrix, whole.is_matrix);
+        CHECK_EQ(result.stats.series_matched, whole.stats.series_matched);
+        CHECK_EQ(result.stats.samples_scanned, whole.stats.samples_scanned);
+        CHECK_EQ(streamed.size(), whole.series.size());
+        bool same = streamed.size() == whole.series.size();
+        for (size_t i = 0; same && i < streamed.size(); ++i) {
+            same = streamed[i].tags == whole.series[i].tags && streamed[i].points.size() == whole.series[i].points.size();
+        }
+        CHECK(same);
+    }
+
+    // Cancelling from the sink stops the query before the later waves are read
+    auto expr = parse_query("wide");
+    QueryContext context;
+    size_t delivered = 0;
+    CHECK_THROWS(engine.execute_streaming(*expr, 5 * MINUTE, 5 * MINUTE, 0, [&](QueryEngine::ResultSeries&&) {
+        delivered++;
+        context.cancel();
+    }, &context), QueryCancelled);
+    CHECK_EQ(delivered, QueryEngine::STREAM_SHARDS * QueryEngine::SERIES_PER_TASK);
+
+    CHECK_THROWS(QueryEngine::evaluation_steps(*parse_query("wide[1m]"), 0, MINUTE, SECOND), std::invalid_argument);
+    CHECK_EQ(QueryEngine::evaluation_steps(*expr, 0, MINUTE, 15 * SECOND).size(), 5u);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(instant_selector_uses_lookback);
+    RUN_TEST(range_query_rate_and_aggregation);
+    RUN_TEST(raw_range_vector_returns_samples);
+    RUN_TEST(planner_pushes_bounds_to_scans);
+    RUN_TEST(invalid_ranges_are_rejected);
+    RUN_TEST(parallel_shards_match_serial_evaluation);
+    RUN_TEST(cancelled_queries_throw);
+    RUN_TEST(streaming_hands_over_series_in_waves);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,142 @@
+#include "query_parser.h"
+#include "test_support.h"
+#include <stdexcept>
+
+using namespace metricstream;
+
+namespace {
+
+bool parse_fails(const std::string& query) {
+    try {
+        parse_query(query);
+    } catch (const QueryParseError&) {
+        return true;
+    }
+    return false;
+}
+
+void durations_parse_and_concatenate() {
+    CHECK_EQ(parse_duration_ms("250ms"), int64_t{250});
+    CHECK_EQ(parse_duration_ms("5m"), int64_t{300000});
+    CHECK_EQ(parse_duration_ms("1h30m"), int64_t{5400000});
+    CHECK_EQ(parse_duration_ms("1w"), int64_t{7} * 24 * 3600 * 1000);
+    CHECK_THROWS(parse_duration_ms("5"), std::invalid_argument);
+    CHECK_EQ(parse_duration_ms("1y"), int64_t{365} * 24 * 3600 * 1000);
+    CHECK_THROWS(parse_duration_ms("5x"), std::invalid_argument);
+    CHECK_THROWS(parse_duration_ms(""), std::invalid_argument);
+    CHECK_THROWS(parse_duration_ms("999999999999y"), std::invalid_argument);
+    CHECK_THROWS(parse_duration_ms("99999999999999999999ms"), std::invalid_argument);
+}
+
+void tokenizer_unescapes_strings() {
+    auto tokens = tokenize_query("m{a=\"x\\\"y\\n\\u00e9\"}");
+    CHECK_EQ(tokens.size(), 7u);  // m { a = "..." } END
+    if (tokens.size() < 5) return;
+    CHECK(tokens[4].type == QueryToken::Type::STRING);
+    CHECK_EQ(tokens[4].text, std::string("x\"y\n\xc3\xa9"));
+    CHECK(tokens.back().type == QueryToken::Type::END);
+    CHECK_THROWS(tokenize_query("m{a=\"unterminated}"), QueryParseError);
+}
+
+void selectors_parse_matchers_and_ranges() {
+    auto expr = parse_query("http_requests_total{status!=\"500\", path=~\"/api/.*\"}[5m]");
+    CHECK(expr->kind == QueryExpr::Kind::MATRIX_SELECTOR);
+    CHECK_EQ(expr->range_ms, int64_t{300000});
+    CHECK_EQ(expr->matchers.size(), 3u);  // __name__ included
+
+    bool regex_ok = false;
+    for (const auto& m : expr->matchers) {
+        if (m.op == TagMatcher::Op::REGEX_MATCH) {
+            regex_ok = m.matches("/api/v1") && !m.matches("/health");
+        }
+    }
+    CHECK(regex_ok);
+}
+
+void functions_and_aggregations_parse() {
+    auto expr = parse_query("sum by (region, az, region) (rate(reqs[1m]))");
+    CHECK(expr->kind == QueryExpr::Kind::AGGREGATION);
+    CHECK(expr->aggregate_op == AggregateOp::SUM);
+    CHECK(expr->grouping == (std::vector<std::string>{"az", "region"}));
+    CHECK(!expr->without);
+    CHECK(expr->args[0]->kind == QueryExpr::Kind::FUNCTION_CALL);
+    CHECK_EQ(expr->args[0]->function, std::string("rate"));
+
+    auto over_time = parse_query("max_over_time(cpu{host=\"a\"}[10m])");
+    CHECK_EQ(over_time->function, std::string("max_over_time"));
+    CHECK(parse_query("avg without (host) (cpu)")->without);
+    CHECK(parse_query("42")->kind == QueryExpr::Kind::NUMBER);
+}
+
+void canonical_text_is_order_independent() {
+    auto a = parse_query("cpu{zone=\"b\", host=\"a\"}[1h]");
+    auto b = parse_query("cpu{host=\"a\",zone=\"b\"}[60m]");
+    CHECK_EQ(a->to_string(), b->to_string());
+    CHECK_EQ(a->to_string(), std::string("cpu{host=\"a\",zone=\"b\"}[3600000ms]"));
+
+    CHECK_EQ(parse_query("sum by (b,a) (x)")->to_string(), parse_query("sum by (a, b) (x)")->to_string());
+    CHECK(parse_query("sum by (a) (x)")->to_string() != parse_query("sum without (a) (x)")->to_string());
+}
+
+void canonical_text_round_trips_escapes() {
+    // Values with quotes, backslashes and control characters survive to_string -> parse
+    auto expr = parse_query("m{path=\"C:\\\\tmp\\\"q\\\"\\t\"}");
+    std::string text = expr->to_string();
+    auto reparsed = parse_query(text);
+    CHECK_EQ(reparsed->to_string(), text);
+    CHECK_EQ(reparsed->matchers.size(), expr->matchers.size());
+    bool same_value = false;
+    for (const auto& m : reparsed->matchers) {
+        if (m.key == "path") same_value = m.value == "C:\\tmp\"q\"\t";
+    }
+    CHECK(same_value);
+}
+
+void invalid_queries_fail_with_position() {
+    CHECK(parse_fails("rate(cpu)"));  // rate needs a range vector
+    CHECK(parse_fails("sum by (a (x)"));
+    CHECK(parse_fails("cpu{host=}"));
+    CHECK(parse_fails("cpu{host=~\"(unclosed\"}"));  // bad regex is a parse error, not regex_error
+    CHECK(parse_fails("cpu[5m"));
+    CHECK(parse_fails("rate(cpu[99999999999999999999d])"));
+    CHECK(parse_fails("median(cpu)"));
+    CHECK(parse_fails(""));
+
+    try {
+        parse_query("cpu{host=\"a\"} extra");
+        CHECK(false);
+    } catch (const QueryParseError& e) {
+        CHECK_EQ(e.position(), 14u);
+    }
+}
+
+std::string nested(const std::string& open, const std::string& inner, const std::string& close, size_t depth) {
+    std::string query;
+    for (size_t i = 0; i < depth; ++i) query += open;
+    query += inner;
+    for (size_t i = 0; i < depth; ++i) query += close;
+    return query;
+}
+
+void deep_nesting_is_rejected() {
+    CHECK(!parse_fails(nested("(", "1", ")", MAX_QUERY_DEPTH - 1)));
+    CHECK(parse_fails(nested("(", "1", ")", MAX_QUERY_DEPTH)));
+    CHECK(parse_fails(nested("(", "1", ")", 100000)));  // would overflow the stack
+    CHECK(!parse_fails(nested("sum(", "cpu", ")", 50)));
+    CHECK(parse_fails(nested("sum(", "cpu", ")", 100000)));
+    CHECK(parse_fails(nested("(", "", "", 100000)));  // unbalanced too
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(durations_parse_and_concatenate);
+    RUN_TEST(tokenizer_unescapes_strings);
+    RUN_TEST(selectors_parse_matchers_and_ranges);
+    RUN_TEST(functions_and_aggregations_parse);
+    RUN_TEST(canonical_text_is_order_independent);
+    RUN_TEST(canonical_text_round_trips_escapes);
+    RUN_TEST(invalid_queries_fail_with_position);
+    RUN_TEST(deep_nesting_is_rejected);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,93 @@
+#include "query_service.h"
+#include "test_support.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+using metricstream::test::count_of;
+
+namespace {
+
+const int PORT = 20000 + static_cast<int>((getpid() + 7919) % 20000);
+
+std::string get(const std::string& path) {
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    for (int attempt = 0; attempt < 50; ++attempt) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(PORT));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+            std::string response;
+            char buffer[4096];
+            ssize_t n;
+            while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+            }
+            close(fd);
+            return response;
+        }
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));  // server still starting
+    }
+    return "";
+}
+
+void expression_queries_stream_series() {
+    TempDir dir;
+    StorageEngine::Options options;
+    options.data_dir = dir.path();
+    options.flush_interval_ms = 0;
+    options.rollup_resolutions_ms = {};
+    options.compaction.strategy = CompactionStrategy::NONE;
+    StorageEngine storage(options);
+    for (SeriesId id = 1; id <= 300; ++id) {
+        storage.register_series({id, "cpu", {{"host", "h" + std::to_string(id)}}});
+        for (int64_t ts = 0; ts <= 60000; ts += 10000) storage.append(id, ts, static_cast<double>(id));
+    }
+
+    QueryService service(PORT, storage);
+    service.start();
+
+    std::string instant = get("/query?query=cpu&end=60000");
+    CHECK(instant.rfind("HTTP/1.1 200", 0) == 0);
+    CHECK(instant.find("Transfer-Encoding: chunked") != std::string::npos);
+    CHECK(instant.find("\"result_type\":\"vector\"") != std::string::npos);
+    CHECK_EQ(count_of(instant, "\"name\":\"cpu\""), 300u);
+    CHECK(instant.find("\"series_matched\":300") != std::string::npos);
+    CHECK(instant.find("0\r\n\r\n") != std::string::npos);  // complete body
+
+    std::string range = get("/query?query=rate(cpu%7Bhost%3D%22h7%22%7D%5B30s%5D)&start=30000&end=60000&step=10000");
+    CHECK(range.rfind("HTTP/1.1 200", 0) == 0);
+    CHECK(range.find("\"result_type\":\"matrix\"") != std::string::npos);
+    CHECK_EQ(count_of(range, "\"host\":\"h7\""), 1u);
+
+    // Shape errors are still answered with a status before any body is sent
+    CHECK(get("/query?query=cpu&start=0&end=100000000&step=1").rfind("HTTP/1.1 400", 0) == 0);
+    CHECK(get("/query?query=cpu%5B1m%5D&start=0&end=60000&step=1000").rfind("HTTP/1.1 400", 0) == 0);
+    CHECK(get("/query?query=rate(cpu)").rfind("HTTP/1.1 400", 0) == 0);
+
+    // Raw range queries: the span of extreme timestamps must not wrap past the step cap
+    CHECK(get("/query?name=cpu&start=0&end=60000&step=10000").rfind("HTTP/1.1 200", 0) == 0);
+    CHECK(get("/query?name=cpu&start=-9223372036854775808&end=9223372036854775807&step=1")
+              .rfind("HTTP/1.1 400", 0) == 0);
+    CHECK(get("/query?name=cpu&start=-9223372036854775807&end=9223372036854775807&step=1")
+              .rfind("HTTP/1.1 400", 0) == 0);
+    CHECK(get("/query?name=cpu&start=60000&end=0").rfind("HTTP/1.1 400", 0) == 0);
+
+    service.stop();
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(expression_queries_stream_series);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,159 @@
+#include "storage_engine.h"
+#include "test_support.h"
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+
+namespace {
+
+const int64_t MINUTE = 60 * 1000;
+
+// One minute tier, and late samples that make it rewrite its buckets
+StorageEngine::Options rollup_options(const std::string& dir) {
+    StorageEngine::Options options = test::engine_options(dir);
+    options.rollup_resolutions_ms = {MINUTE};
+    options.out_of_order_window_ms = 60 * MINUTE;
+    return options;
+}
+
+// Tier buckets of series 1 must equal the deduplicated raw samples
+void check_rollups_match_raw(const StorageEngine& engine, int64_t end_ts) {
+    auto raw = engine.query_series({1}, 0, end_ts);
+    auto rollups = engine.query_rollups({1}, MINUTE, 0, end_ts);
+    CHECK(raw.size() == 1 && rollups.size() == 1);
+    if (raw.size() != 1 || rollups.size() != 1) return;
+
+    std::vector<RollupPoint> expected;
+    fold_rollup(raw[0].samples.data(), raw[0].samples.size(), MINUTE, expected);
+    CHECK_EQ(rollups[0].points.size(), expected.size());
+    for (size_t i = 0; i < expected.size() && i < rollups[0].points.size(); ++i) {
+        const Aggregate& got = rollups[0].points[i].aggregate;
+        CHECK_EQ(rollups[0].points[i].timestamp_ms, expected[i].timestamp_ms);
+        CHECK_EQ(got.count, expected[i].aggregate.count);
+        CHECK_NEAR(got.sum, expected[i].aggregate.sum, 1e-9);
+        CHECK_EQ(got.min, expected[i].aggregate.min);
+        CHECK_EQ(got.max, expected[i].aggregate.max);
+    }
+}
+
+void fill(StorageEngine& engine, int64_t from, int64_t to, double value) {
+    for (int64_t ts = from; ts < to; ts += 10000) {
+        engine.append(1, ts, value);
+    }
+}
+
+void fold_and_merge_buckets() {
+    std::vector<Sample> samples{{0, 1.0}, {1, 2.0}, {MINUTE, 3.0}, {MINUTE + 1, 4.0}};
+    std::vector<RollupPoint> points;
+    fold_rollup(samples.data(), samples.size(), MINUTE, points);
+    CHECK_EQ(points.size(), 3u);  // (-1m, 0], (0, 1m], (1m, 2m]
+    CHECK_EQ(rollup_bucket_end(1, MINUTE), MINUTE);
+    CHECK_EQ(rollup_bucket_end(MINUTE, MINUTE), MINUTE);
+    CHECK_EQ(rollup_bucket_end(-1, MINUTE), int64_t{0});
+
+    // Partials of one bucket merge; a complete point replaces what came before
+    std::vector<Sample> more{{2, 10.0}};
+    fold_rollup(more.data(), more.size(), MINUTE, points);
+    merge_rollup_points(points);
+    CHECK_EQ(points.size(), 3u);
+    CHECK_EQ(points[1].aggregate.count, 3u);
+    CHECK_EQ(points[1].aggregate.sum, 15.0);
+
+    std::vector<RollupPoint> rebuilt;
+    fold_rollup(samples.data() + 1, 1, MINUTE, rebuilt);
+    rebuilt[0].complete = true;
+    points.push_back(rebuilt[0]);
+    merge_rollup_points(points);
+    CHECK_EQ(points[1].aggregate.count, 1u);
+    CHECK_EQ(points[1].aggregate.sum, 2.0);
+}
+
+void complete_points_round_trip() {
+    TempDir dir;
+    RollupStore store(dir.path(), MINUTE, 60 * MINUTE);
+    SeriesSamples first{{7, {{1000, 1.0}, {2000, 2.0}}}};
+    SeriesSamples again{{7, {{1000, 5.0}, {2000, 2.0}}}};
+    store.add(first);
+    store.add(first);
+    SeriesRollups points;
+    store.read({7}, 0, MINUTE, points);
+    CHECK(points[7].size() == 1 && points[7][0].aggregate.count == 4);
+
+    store.replace(again);
+    points.clear();
+    store.read({7}, 0, MINUTE, points);
+    CHECK(points[7].size() == 1 && points[7][0].aggregate.count == 2);
+    CHECK(points[7].size() == 1 && points[7][0].aggregate.sum == 7.0);
+
+    // Partials written after a complete point still merge into it
+    store.add(SeriesSamples{{7, {{3000, 1.0}}}});
+    points.clear();
+    store.read({7}, 0, MINUTE, points);
+    CHECK(points[7].size() == 1 && points[7][0].aggregate.count == 3);
+}
+
+void resends_are_counted_once() {
+    TempDir dir;
+    StorageEngine engine(rollup_options(dir.path()));
+    engine.register_series({1, "cpu", {{"host", "a"}}});
+    fill(engine, 0, 5 * MINUTE, 1.0);
+    engine.flush();
+    check_rollups_match_raw(engine, 10 * MINUTE);
+
+    // A resent batch in the head: the head fold must not count it twice
+    fill(engine, MINUTE, 3 * MINUTE, 2.0);
+    fill(engine, 5 * MINUTE, 6 * MINUTE, 1.0);
+    check_rollups_match_raw(engine, 10 * MINUTE);
+
+    // Flushed, it rebuilds the rewritten buckets in the tier
+    engine.flush();
+    check_rollups_match_raw(engine, 10 * MINUTE);
+
+    // And a resend flushed together with its original counts once
+    fill(engine, 6 * MINUTE, 7 * MINUTE, 3.0);
+    fill(engine, 6 * MINUTE, 7 * MINUTE, 4.0);
+    engine.flush();
+    check_rollups_match_raw(engine, 10 * MINUTE);
+}
+
+void resends_after_reopen_are_counted_once() {
+    TempDir dir;
+    {
+        StorageEngine engine(rollup_options(dir.path()));
+        engine.register_series({1, "cpu", {{"host", "a"}}});
+        fill(engine, 0, 5 * MINUTE, 1.0);
+        engine.flush();
+    }
+    StorageEngine engine(rollup_options(dir.path()));
+    fill(engine, 2 * MINUTE, 4 * MINUTE, 5.0);
+    check_rollups_match_raw(engine, 10 * MINUTE);
+    engine.flush();
+    check_rollups_match_raw(engine, 10 * MINUTE);
+}
+
+void new_tiers_backfill_deduplicated() {
+    TempDir dir;
+    {
+        StorageEngine::Options options = rollup_options(dir.path());
+        options.rollup_resolutions_ms = {};
+        StorageEngine engine(options);
+        engine.register_series({1, "cpu", {{"host", "a"}}});
+        fill(engine, 0, 5 * MINUTE, 1.0);
+        engine.flush();
+        fill(engine, 0, 5 * MINUTE, 2.0);  // rewrites every sample in a second block
+        engine.flush();
+    }
+    StorageEngine engine(rollup_options(dir.path()));
+    check_rollups_match_raw(engine, 10 * MINUTE);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(fold_and_merge_buckets);
+    RUN_TEST(complete_points_round_trip);
+    RUN_TEST(resends_are_counted_once);
+    RUN_TEST(resends_after_reopen_are_counted_once);
+    RUN_TEST(new_tiers_backfill_deduplicated);
+    return metricstream::test::exit_code();
+}
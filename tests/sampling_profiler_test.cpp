@@ -0,0 +1,54 @@
+#include "sampling_profiler.h"
+#include "test_support.h"
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+using namespace metricstream;
+
+namespace {
+
+std::atomic<bool> spinning{true};
+
+void spin() {
+    volatile double x = 0.0;
+    while (spinning.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 1000; ++i) x = x + std::sqrt(static_cast<double>(i));
+    }
+}
+
+void busy_threads_show_up_in_folded_stacks() {
+    std::thread worker(spin);
+    std::string folded = SamplingProfiler::instance().profile(std::chrono::milliseconds(300), 200);
+    spinning = false;
+    worker.join();
+
+    // "frame;frame;... count" lines with at least one sample
+    CHECK(!folded.empty());
+    size_t line_end = folded.find('\n');
+    std::string first = folded.substr(0, line_end);
+    size_t space = first.rfind(' ');
+    CHECK(space != std::string::npos && std::stoul(first.substr(space + 1)) > 0);
+    CHECK(!SamplingProfiler::instance().running());
+}
+
+void bad_arguments_and_early_stop() {
+    auto& profiler = SamplingProfiler::instance();
+    CHECK_THROWS(profiler.profile(std::chrono::milliseconds(0), 100), std::invalid_argument);
+    CHECK_THROWS(profiler.profile(std::chrono::milliseconds(100), 0), std::invalid_argument);
+    CHECK_THROWS(profiler.profile(std::chrono::milliseconds(100), SamplingProfiler::MAX_HZ + 1),
+                 std::invalid_argument);
+
+    auto start = std::chrono::steady_clock::now();
+    profiler.profile(std::chrono::seconds(30), 100, [] { return false; });
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(busy_threads_show_up_in_folded_stacks);
+    RUN_TEST(bad_arguments_and_early_stop);
+    return metricstream::test::exit_code();
+}
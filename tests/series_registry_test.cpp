@@ -0,0 +1,109 @@
+#include "hyperloglog.h"
+#include "series_registry.h"
+#include "test_support.h"
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace metricstream;
+
+namespace {
+
+uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void hyperloglog_estimates_within_error() {
+    for (uint64_t n : {1000ull, 50000ull, 500000ull}) {
+        HyperLogLog sketch;
+        for (uint64_t i = 0; i < n; ++i) {
+            sketch.add(mix(i));
+            sketch.add(mix(i));  // repeats do not count
+        }
+        double error = std::abs(sketch.estimate() - static_cast<double>(n)) / static_cast<double>(n);
+        CHECK(error < 0.03);  // ~0.8% standard error at precision 14
+    }
+    CHECK_EQ(HyperLogLog().estimate(), 0.0);
+}
+
+void hyperloglog_merge_is_union() {
+    HyperLogLog a, b;
+    for (uint64_t i = 0; i < 20000; ++i) a.add(mix(i));
+    for (uint64_t i = 10000; i < 30000; ++i) b.add(mix(i));
+    a.merge(b);
+    CHECK_NEAR(a.estimate(), 30000.0, 900.0);
+}
+
+void registry_canonicalizes_tag_order() {
+    SeriesRegistry registry;
+    auto first = registry.resolve("cpu", {{"host", "web-1"}, {"region", "us"}});
+    auto second = registry.resolve("cpu", {{"region", "us"}, {"host", "web-1"}});
+    CHECK(first.created);
+    CHECK(!second.created);
+    CHECK_EQ(first.id, second.id);
+    CHECK_EQ(first.id, SeriesRegistry::compute_series_id("cpu", {{"region", "us"}, {"host", "web-1"}}));
+    CHECK_EQ(registry.series_count(), 1u);
+
+    auto desc = registry.lookup(first.id);
+    CHECK(desc.has_value());
+    CHECK_EQ(desc->name, std::string("cpu"));
+    CHECK(desc->tags == (std::vector<std::pair<std::string, std::string>>{{"host", "web-1"}, {"region", "us"}}));
+    CHECK(!registry.lookup(first.id + 1).has_value());
+}
+
+void registry_separates_distinct_series() {
+    // Concatenation-aliasing pairs must not share an ID
+    SeriesRegistry registry;
+    SeriesId a = registry.resolve("cpu", {{"ab", "c"}}).id;
+    SeriesId b = registry.resolve("cpu", {{"a", "bc"}}).id;
+    SeriesId c = registry.resolve("cpua", {}).id;
+    SeriesId d = registry.resolve("cpu", {}).id;
+    CHECK(a != b);
+    CHECK(c != d);
+    CHECK_EQ(registry.series_count(), 4u);
+}
+
+void registry_concurrent_resolve_agrees() {
+    SeriesRegistry registry;
+    std::vector<std::vector<SeriesId>> ids(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < ids.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 2000; ++i) {
+                ids[t].push_back(registry.resolve("m", {{"i", std::to_string(i)}}, "tenant").id);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (size_t t = 1; t < ids.size(); ++t) {
+        CHECK(ids[t] == ids[0]);
+    }
+    CHECK_EQ(registry.series_count(), 2000u);
+}
+
+void registry_tracks_tenant_cardinality() {
+    SeriesRegistry registry;
+    for (int i = 0; i < 5000; ++i) {
+        registry.resolve("m", {{"i", std::to_string(i)}}, "big");
+        registry.resolve("m", {{"i", std::to_string(i % 10)}}, "small");
+    }
+    CHECK_NEAR(registry.tenant_cardinality("big"), 5000.0, 200.0);
+    CHECK_NEAR(registry.tenant_cardinality("small"), 10.0, 1.0);
+    CHECK_EQ(registry.tenant_cardinality("unknown"), 0.0);
+    CHECK_EQ(registry.tenant_cardinalities().size(), 2u);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(hyperloglog_estimates_within_error);
+    RUN_TEST(hyperloglog_merge_is_union);
+    RUN_TEST(registry_canonicalizes_tag_order);
+    RUN_TEST(registry_separates_distinct_series);
+    RUN_TEST(registry_concurrent_resolve_agrees);
+    RUN_TEST(registry_tracks_tenant_cardinality);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,233 @@
+#include "storage_engine.h"
+#include "test_support.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+using metricstream::test::engine_options;
+
+namespace {
+
+SeriesDescriptor cpu_series(SeriesId id, const std::string& host) {
+    SeriesDescriptor desc;
+    desc.id = id;
+    desc.name = "cpu";
+    desc.tags = {{"host", host}};
+    return desc;
+}
+
+void engine_merges_head_and_blocks() {
+    TempDir dir;
+    StorageEngine engine(engine_options(dir.path()));
+    engine.register_series(cpu_series(1, "a"));
+    engine.register_series(cpu_series(2, "b"));
+    for (int64_t i = 0; i < 100; ++i) {
+        engine.append(1, i * 1000, static_cast<double>(i));
+        engine.append(2, i * 1000, -static_cast<double>(i));
+    }
+    engine.flush();
+    CHECK(engine.block_count() >= 1);
+    CHECK_EQ(engine.head_samples(), 0u);
+    for (int64_t i = 100; i < 150; ++i) {
+        engine.append(1, i * 1000, static_cast<double>(i));
+    }
+
+    StorageEngine::QueryStats stats;
+    auto results = engine.query({{TagIndex::NAME_TAG, "cpu"}, {"host", "a"}}, 0, INT64_MAX, &stats);
+    CHECK_EQ(results.size(), 1u);
+    if (results.empty()) return;
+    CHECK_EQ(results[0].series.tags[0].second, std::string("a"));
+    CHECK_EQ(results[0].samples.size(), 150u);
+    CHECK_EQ(results[0].samples.back().value, 149.0);
+    CHECK_EQ(stats.series_matched, 1u);
+
+    auto ranged = engine.query({{TagIndex::NAME_TAG, "cpu"}}, 95000, 104000);
+    CHECK_EQ(ranged.size(), 2u);
+    if (ranged.size() == 2) {
+        CHECK_EQ(ranged[0].samples.size() + ranged[1].samples.size(), 10u + 5u);
+    }
+}
+
+void engine_reopens_with_series_and_blocks() {
+    TempDir dir;
+    {
+        StorageEngine engine(engine_options(dir.path()));
+        engine.register_series(cpu_series(7, "x"));
+        for (int64_t i = 0; i < 10; ++i) engine.append(7, i, 1.0);
+    }  // flushes on shutdown
+    StorageEngine reopened(engine_options(dir.path()));
+    CHECK_EQ(reopened.series_count(), 1u);
+    auto results = reopened.query({{"host", "x"}}, 0, INT64_MAX);
+    CHECK_EQ(results.size(), 1u);
+    if (!results.empty()) CHECK_EQ(results[0].samples.size(), 10u);
+}
+
+void queries_never_miss_chunks_during_flushes() {
+    // Flushes move chunks from the head into blocks while queries run; every
+    // answer must be a gap-free prefix of what was appended
+    TempDir dir;
+    StorageEngine engine(engine_options(dir.path()));
+    engine.register_series(cpu_series(1, "a"));
+
+    constexpr int64_t TOTAL = 20000;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int64_t i = 0; i < TOTAL; ++i) {
+            engine.append(1, i, static_cast<double>(i));
+            if (i % 700 == 699) engine.flush();
+        }
+        done = true;
+    });
+
+    size_t queries = 0;
+    size_t gaps = 0;
+    size_t shrinks = 0;
+    size_t last_size = 0;
+    while (!done || queries == 0) {
+        auto results = engine.query_series({1}, 0, INT64_MAX);
+        const std::vector<Sample> empty;
+        const auto& samples = results.empty() ? empty : results[0].samples;
+        for (size_t i = 0; i < samples.size(); ++i) {
+            if (samples[i].timestamp_ms != static_cast<int64_t>(i)) {
+                gaps++;
+                break;
+            }
+        }
+        if (samples.size() < last_size) shrinks++;
+        last_size = samples.size();
+        queries++;
+    }
+    writer.join();
+
+    CHECK_EQ(gaps, 0u);
+    CHECK_EQ(shrinks, 0u);
+    auto final_results = engine.query_series({1}, 0, INT64_MAX);
+    CHECK(!final_results.empty() && final_results[0].samples.size() == static_cast<size_t>(TOTAL));
+    CHECK(queries > 10);
+}
+
+void churned_series_leave_the_head() {
+    TempDir dir;
+    StorageEngine::Options options = engine_options(dir.path());
+    options.head_window_ms = 60000;
+    options.out_of_order_window_ms = 30000;
+    StorageEngine engine(options);
+    for (SeriesId id = 1; id <= 500; ++id) {
+        engine.register_series(cpu_series(id, "pod-" + std::to_string(id)));
+        engine.append(id, 1000, 1.0);
+    }
+    engine.register_series(cpu_series(1000, "steady"));
+    engine.append(1000, 1000, 1.0);
+    CHECK_EQ(engine.head().series_count(), 501u);
+
+    engine.append(1000, 120000, 2.0);  // the churned series have been idle for two minutes
+    engine.flush();
+    CHECK_EQ(engine.head().series_count(), 1u);
+    auto results = engine.query_series({42}, 0, INT64_MAX);
+    CHECK(results.size() == 1 && results[0].samples.size() == 1);
+}
+
+// Every series of the engine must read back exactly the reference
+size_t mismatches(const StorageEngine& engine, const std::map<SeriesId, std::map<int64_t, double>>& expected) {
+    size_t bad = 0;
+    for (const auto& [id, points] : expected) {
+        auto results = engine.query_series({id}, 0, INT64_MAX);
+        const std::vector<Sample> empty;
+        const auto& samples = results.empty() ? empty : results[0].samples;
+        if (samples.size() != points.size()) {
+            bad++;
+            continue;
+        }
+        auto it = points.begin();
+        for (const Sample& sample : samples) {
+            if (sample.timestamp_ms != it->first || sample.value != it->second) {
+                bad++;
+                break;
+            }
+            ++it;
+        }
+    }
+    return bad;
+}
+
+void late_and_duplicate_writes_read_back_latest(CompactionStrategy strategy) {
+    constexpr int64_t WINDOW_MS = 20000;
+    TempDir dir;
+    StorageEngine::Options options = engine_options(dir.path());
+    options.block_duration_ms = 60000;
+    options.head_window_ms = 600000;  // no series goes idle, so none is evicted and forgets its lateness
+    options.max_head_samples = 300;  // flushes on append, with the newest sample as cutoff
+    options.out_of_order_window_ms = WINDOW_MS;
+    options.compaction.strategy = strategy;
+    options.compaction.min_input_blocks = 2;
+    options.compaction.max_level = 3;
+    options.compaction.level_base_bytes = 2048;
+    options.compaction.io_bytes_per_second = 0;
+    options.compaction.interval_ms = 0;
+    options.compaction.window_grace_ms = 0;
+
+    std::mt19937_64 rng(42);
+    std::map<SeriesId, std::map<int64_t, double>> expected;
+    std::map<SeriesId, int64_t> last_ts;
+    size_t rejected = 0;
+    {
+        StorageEngine engine(options);
+        for (SeriesId id = 1; id <= 3; ++id) {
+            engine.register_series(cpu_series(id, "h" + std::to_string(id)));
+            last_ts[id] = 100000;
+        }
+        for (int step = 0; step < 6000; ++step) {
+            SeriesId id = 1 + rng() % 3;
+            int64_t ts = last_ts[id] + 1000 * static_cast<int64_t>(rng() % 3);  // equal: a duplicate
+            if (rng() % 4 == 0) {
+                ts = last_ts[id] - 1000 * static_cast<int64_t>(rng() % 30);  // late, maybe too late
+            }
+            double value = static_cast<double>(step);
+            engine.append(id, ts, value);
+            if (last_ts[id] - ts > WINDOW_MS) {
+                rejected++;
+            } else {
+                expected[id][ts] = value;
+                last_ts[id] = std::max(last_ts[id], ts);
+            }
+
+            if (step % 1000 == 999) {
+                CHECK_EQ(mismatches(engine, expected), 0u);
+                engine.compact();
+                CHECK_EQ(mismatches(engine, expected), 0u);
+            }
+        }
+        CHECK(rejected > 0);
+        CHECK_EQ(engine.out_of_order_rejected(), rejected);
+        CHECK(engine.out_of_order_accepted() > 0);
+        engine.flush();
+        CHECK_EQ(mismatches(engine, expected), 0u);
+        CHECK(engine.compact() > 0);
+        CHECK_EQ(mismatches(engine, expected), 0u);
+    }
+    StorageEngine reopened(options);
+    CHECK_EQ(mismatches(reopened, expected), 0u);
+}
+
+void late_and_duplicate_writes_time_window() {
+    late_and_duplicate_writes_read_back_latest(CompactionStrategy::TIME_WINDOW);
+}
+
+void late_and_duplicate_writes_leveled() {
+    late_and_duplicate_writes_read_back_latest(CompactionStrategy::LEVELED);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(engine_merges_head_and_blocks);
+    RUN_TEST(engine_reopens_with_series_and_blocks);
+    RUN_TEST(queries_never_miss_chunks_during_flushes);
+    RUN_TEST(churned_series_leave_the_head);
+    RUN_TEST(late_and_duplicate_writes_time_window);
+    RUN_TEST(late_and_duplicate_writes_leveled);
+    return metricstream::test::exit_code();
+}
@@ -0,0 +1,160 @@
+#include "bloom_filter.h"
+#include "roaring_bitmap.h"
+#include "tag_index.h"
+#include "test_support.h"
+#include <regex>
+#include <set>
+
+using namespace metricstream;
+
+namespace {
+
+void roaring_add_remove_contains() {
+    RoaringBitmap bitmap;
+    CHECK(bitmap.empty());
+    for (uint32_t v : {1u, 5u, 70000u, 1u << 31}) {
+        bitmap.add(v);
+    }
+    bitmap.add(5);  // duplicate
+    CHECK_EQ(bitmap.cardinality(), 4u);
+    CHECK(bitmap.contains(70000));
+    CHECK(!bitmap.contains(2));
+    CHECK(bitmap.remove(70000));
+    CHECK(!bitmap.remove(70000));
+    CHECK(!bitmap.contains(70000));
+    CHECK(bitmap.to_vector() == (std::vector<uint32_t>{1, 5, 1u << 31}));
+}
+
+void roaring_set_operations_match_std_set() {
+    // Dense ranges push containers past the array/bitset threshold
+    RoaringBitmap a, b;
+    std::set<uint32_t> sa, sb;
+    for (uint32_t v = 0; v < 20000; v += 2) { a.add(v); sa.insert(v); }
+    for (uint32_t v = 0; v < 200000; v += 3) { b.add(v); sb.insert(v); }
+    for (uint32_t v = 100000; v < 100010; ++v) { a.add(v); sa.insert(v); }
+
+    std::vector<uint32_t> both, either, only_a;
+    for (uint32_t v : sa) {
+        if (sb.count(v)) both.push_back(v); else only_a.push_back(v);
+    }
+    std::set<uint32_t> united(sa);
+    united.insert(sb.begin(), sb.end());
+    either.assign(united.begin(), united.end());
+
+    CHECK(a.and_(b).to_vector() == both);
+    CHECK(a.or_(b).to_vector() == either);
+    CHECK(a.andnot(b).to_vector() == only_a);
+    CHECK_EQ(a.or_(b).cardinality(), static_cast<uint64_t>(either.size()));
+
+    RoaringBitmap copy(a);
+    copy.add(7);
+    CHECK(!a.contains(7));
+    CHECK(copy.contains(7));
+}
+
+void bloom_has_no_false_negatives() {
+    BloomFilter filter(1000, 0.01);
+    for (uint64_t key = 0; key < 1000; ++key) {
+        filter.add(key * 7919);
+    }
+    for (uint64_t key = 0; key < 1000; ++key) {
+        CHECK(filter.might_contain(key * 7919));
+    }
+
+    size_t false_positives = 0;
+    for (uint64_t key = 0; key < 10000; ++key) {
+        if (filter.might_contain(key * 7919 + 1)) false_positives++;
+    }
+    CHECK(false_positives < 500);  // 1% target, generous bound
+}
+
+void bloom_round_trips_through_serialize() {
+    BloomFilter filter(100, 0.01);
+    filter.add(std::string("host=web-1"));
+    filter.add(42);
+    BloomFilter copy = BloomFilter::deserialize(filter.serialize());
+    CHECK(copy.might_contain(std::string("host=web-1")));
+    CHECK(copy.might_contain(42));
+    CHECK_EQ(copy.bit_count(), filter.bit_count());
+    CHECK_EQ(copy.hash_count(), filter.hash_count());
+}
+
+void fill_index(TagIndex& index) {
+    index.add_series(10, "cpu", {{"host", "web-1"}, {"region", "us-east"}});
+    index.add_series(11, "cpu", {{"host", "web-2"}, {"region", "us-west"}});
+    index.add_series(12, "cpu", {{"host", "db-1"}});
+    index.add_series(13, "mem", {{"host", "web-1"}, {"region", "eu"}});
+}
+
+void tag_index_equality_and_negation() {
+    TagIndex index;
+    fill_index(index);
+    CHECK(!index.add_series(10, "cpu", {}));
+    CHECK_EQ(index.series_count(), 4u);
+
+    CHECK(index.select("cpu") == (std::vector<SeriesId>{10, 11, 12}));
+    CHECK(index.select("cpu", {{"host", "web-1"}}) == (std::vector<SeriesId>{10}));
+    CHECK(index.select("disk").empty());
+
+    std::vector<TagMatcher> not_web1{{TagIndex::NAME_TAG, "cpu"},
+                                     {"host", "web-1", TagMatcher::Op::NOT_EQUAL}};
+    CHECK(index.select(not_web1) == (std::vector<SeriesId>{11, 12}));
+
+    // A missing tag is the empty value
+    std::vector<TagMatcher> no_region{{TagIndex::NAME_TAG, "cpu"}, {"region", ""}};
+    CHECK(index.select(no_region) == (std::vector<SeriesId>{12}));
+}
+
+void tag_index_regex_matchers() {
+    TagIndex index;
+    fill_index(index);
+    std::vector<TagMatcher> web{{TagIndex::NAME_TAG, "cpu"}, {"host", "web-.*", TagMatcher::Op::REGEX_MATCH}};
+    CHECK(index.select(web) == (std::vector<SeriesId>{10, 11}));
+
+    // Anchored: "us" alone does not match "us-east"
+    std::vector<TagMatcher> partial{{"region", "us", TagMatcher::Op::REGEX_MATCH}};
+    CHECK(index.select(partial).empty());
+
+    std::vector<TagMatcher> not_us{{TagIndex::NAME_TAG, "cpu"},
+                                   {"region", "us-.*", TagMatcher::Op::REGEX_NO_MATCH}};
+    CHECK(index.select(not_us) == (std::vector<SeriesId>{12}));
+
+    // Only negative matchers fall back to a scan of every series
+    std::vector<TagMatcher> only_negative{{"host", "web-1", TagMatcher::Op::NOT_EQUAL}};
+    CHECK(index.select(only_negative) == (std::vector<SeriesId>{11, 12}));
+}
+
+void tag_matcher_compiles_regex_once() {
+    TagMatcher matcher("host", "web-[0-9]+", TagMatcher::Op::REGEX_MATCH);
+    CHECK(matcher.regex != nullptr);
+    CHECK(matcher.matches("web-12"));
+    CHECK(!matcher.matches("web-x"));
+
+    TagMatcher copy = matcher;
+    CHECK(copy.regex == matcher.regex);  // copies share the compiled pattern
+
+    CHECK(TagMatcher("host", "web-1").regex == nullptr);
+    CHECK_THROWS(TagMatcher("host", "web-[", TagMatcher::Op::REGEX_MATCH), std::regex_error);
+}
+
+void tag_index_tag_values() {
+    TagIndex index;
+    fill_index(index);
+    CHECK(index.tag_values("host") == (std::vector<std::string>{"db-1", "web-1", "web-2"}));
+    CHECK(index.tag_values("missing").empty());
+    CHECK_EQ(index.postings_count(), 8u);  // 2 names, 3 hosts, 3 regions
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(roaring_add_remove_contains);
+    RUN_TEST(roaring_set_operations_match_std_set);
+    RUN_TEST(bloom_has_no_false_negatives);
+    RUN_TEST(bloom_round_trips_through_serialize);
+    RUN_TEST(tag_index_equality_and_negation);
+    RUN_TEST(tag_index_regex_matchers);
+    RUN_TEST(tag_matcher_compiles_regex_once);
+    RUN_TEST(tag_index_tag_values);
+    return metricstream::test::exit_code();
+}
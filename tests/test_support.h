@@ -0,0 +1,149 @@
+#pragma once
+
+// Minimal assertion helpers shared by the test executables. Each test binary
+// runs its cases through RUN_TEST and exits non-zero if any CHECK failed,
+// which is all ctest needs.
+
+#include "storage_engine.h"
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace metricstream::test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline void report(const char* file, int line, const std::string& message) {
+    std::cerr << file << ":" << line << ": " << message << std::endl;
+    failures()++;
+}
+
+template <typename Fn>
+void run(const char* name, Fn fn) {
+    int before = failures();
+    try {
+        fn();
+    } catch (const std::exception& e) {
+        report(name, 0, std::string("unexpected exception: ") + e.what());
+    }
+    std::cout << (failures() == before ? "[ OK ] " : "[FAIL] ") << name << std::endl;
+}
+
+template <typename T>
+auto describe_impl(const T& value, int) -> decltype(std::to_string(value)) {
+    return std::to_string(value);
+}
+
+template <typename T>
+std::string describe_impl(const T& value, long) {
+    if constexpr (std::is_convertible_v<T, std::string>) {
+        return "\"" + std::string(value) + "\"";
+    } else {
+        (void)value;
+        return "<value>";
+    }
+}
+
+template <typename T>
+std::string describe(const T& value) {
+    return describe_impl(value, 0);
+}
+
+// Fresh directory under the system temp dir, removed with its contents
+class TempDir {
+public:
+    TempDir() {
+        std::string pattern = (std::filesystem::temp_directory_path() / "metricstream_test_XXXXXX").string();
+        if (!mkdtemp(pattern.data())) {
+            throw std::runtime_error("mkdtemp failed");
+        }
+        path_ = pattern;
+    }
+    ~TempDir() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path_, ignored);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Occurrences of `needle` in `text`, overlapping ones included
+inline size_t count_of(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) count++;
+    return count;
+}
+
+// A StorageEngine in `dir` that only flushes, compacts and rolls up when told
+inline StorageEngine::Options engine_options(const std::string& dir) {
+    StorageEngine::Options options;
+    options.data_dir = dir;
+    options.flush_interval_ms = 0;
+    options.rollup_resolutions_ms = {};
+    options.compaction.strategy = CompactionStrategy::NONE;
+    return options;
+}
+
+inline int exit_code() {
+    return failures() == 0 ? 0 : 1;
+}
+
+} // namespace metricstream::test
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) metricstream::test::report(__FILE__, __LINE__, "CHECK(" #cond ")"); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                        \
+    do {                                                                                  \
+        const auto& check_actual_ = (actual);                                             \
+        const auto& check_expected_ = (expected);                                         \
+        if (!(check_actual_ == check_expected_)) {                                        \
+            metricstream::test::report(__FILE__, __LINE__,                                \
+                                       "CHECK_EQ(" #actual ", " #expected ") got " +      \
+                                           metricstream::test::describe(check_actual_) +  \
+                                           ", expected " +                                \
+                                           metricstream::test::describe(check_expected_)); \
+        }                                                                                 \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                            \
+    do {                                                                                   \
+        double check_actual_ = (actual);                                                   \
+        double check_expected_ = (expected);                                               \
+        if (!(check_actual_ >= check_expected_ - (tolerance) &&                            \
+              check_actual_ <= check_expected_ + (tolerance))) {                           \
+            metricstream::test::report(__FILE__, __LINE__,                                 \
+                                       "CHECK_NEAR(" #actual ", " #expected ") got " +     \
+                                           std::to_string(check_actual_));                 \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_THROWS(expr, exception_type)                                                  \
+    do {                                                                                    \
+        bool check_thrown_ = false;                                                         \
+        try {                                                                               \
+            (void)(expr);                                                                   \
+        } catch (const exception_type&) {                                                   \
+            check_thrown_ = true;                                                           \
+        }                                                                                   \
+        if (!check_thrown_) {                                                               \
+            metricstream::test::report(__FILE__, __LINE__, "CHECK_THROWS(" #expr ")");     \
+        }                                                                                   \
+    } while (0)
+
+#define RUN_TEST(fn) metricstream::test::run(#fn, fn)
@@ -0,0 +1,77 @@
+#include "tracing.h"
+#include "test_support.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace metricstream;
+using metricstream::test::count_of;
+
+namespace {
+
+void sample_rate_controls_tracing() {
+    Tracer& tracer = Tracer::instance();
+    tracer.set_sample_rate(0.0);
+    CHECK_EQ(tracer.start_trace(), 0u);
+
+    tracer.set_sample_rate(1.0);
+    uint64_t a = tracer.start_trace();
+    uint64_t b = tracer.start_trace();
+    CHECK(a != 0 && b != 0 && a != b);
+
+    tracer.set_sample_rate(0.25);
+    int sampled = 0;
+    for (int i = 0; i < 20000; ++i) sampled += tracer.start_trace() != 0 ? 1 : 0;
+    CHECK(sampled > 4000 && sampled < 6000);
+    tracer.set_sample_rate(0.0);
+}
+
+void spans_follow_the_current_trace() {
+    Tracer& tracer = Tracer::instance();
+    tracer.set_sample_rate(1.0);
+    uint64_t trace_id = tracer.start_trace();
+    {
+        TraceSpan untraced("test_untraced");  // no current trace yet
+    }
+    {
+        TraceScope scope(trace_id);
+        CHECK_EQ(current_trace_id, trace_id);
+        TraceSpan span("test_outer");
+        std::thread worker([trace_id] {
+            TraceScope handed_over(trace_id);  // as across the async write queue
+            TraceSpan inner("test_worker");
+        });
+        worker.join();
+    }
+    CHECK_EQ(current_trace_id, 0u);
+    tracer.set_sample_rate(0.0);
+
+    std::string json = tracer.dump_chrome_json();
+    CHECK_EQ(count_of(json, "\"test_outer\""), 1u);
+    CHECK_EQ(count_of(json, "\"test_worker\""), 1u);
+    CHECK_EQ(count_of(json, "\"test_untraced\""), 0u);
+    CHECK(json.find("\"ph\":\"X\"") != std::string::npos);
+}
+
+void rings_keep_the_newest_spans() {
+    Tracer& tracer = Tracer::instance();
+    std::thread writer([&tracer] {
+        for (size_t i = 0; i < Tracer::RING_SIZE + 100; ++i) {
+            tracer.record(7, i < 100 ? "test_overwritten" : "test_kept", 0, 1);
+        }
+    });
+    writer.join();
+    std::string json = tracer.dump_chrome_json();
+    CHECK_EQ(count_of(json, "\"test_overwritten\""), 0u);
+    // The oldest slot is dropped too: the writer's next span lands there
+    CHECK_EQ(count_of(json, "\"test_kept\""), Tracer::RING_SIZE - 1);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(sample_rate_controls_tracing);
+    RUN_TEST(spans_follow_the_current_trace);
+    RUN_TEST(rings_keep_the_newest_spans);
+    return metricstream::test::exit_code();
+}
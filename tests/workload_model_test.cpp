@@ -0,0 +1,107 @@
+#include "workload_model.h"
+#include "test_support.h"
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace metricstream;
+using metricstream::test::TempDir;
+using metricstream::test::count_of;
+
+namespace {
+
+void zipf_ranks_follow_the_skew() {
+    std::mt19937_64 gen(1);
+    ZipfDistribution zipf(1000, 1.0);
+    std::vector<uint64_t> counts(1000);
+    const int draws = 200000;
+    for (int i = 0; i < draws; ++i) {
+        uint64_t rank = zipf(gen);
+        CHECK(rank < 1000);
+        if (rank < 1000) counts[rank]++;
+    }
+    // P(0) / P(1) = 2 and P(0) = 1 / H(1000) ~ 0.134 for s = 1
+    CHECK_NEAR(static_cast<double>(counts[0]) / counts[1], 2.0, 0.1);
+    CHECK_NEAR(static_cast<double>(counts[0]) / draws, 0.134, 0.01);
+
+    ZipfDistribution uniform(10, 0.0);
+    std::vector<uint64_t> flat(10);
+    for (int i = 0; i < 100000; ++i) flat[uniform(gen)]++;
+    for (uint64_t c : flat) CHECK_NEAR(static_cast<double>(c), 10000.0, 600.0);
+}
+
+void config_parses_and_validates() {
+    auto config = WorkloadConfig::parse("series=5000,series_skew=1.1,clients=20,batch=5-50,tags=1-3,names=7,seed=9");
+    CHECK_EQ(config.series, 5000u);
+    CHECK_NEAR(config.series_skew, 1.1, 1e-12);
+    CHECK_EQ(config.clients, 20u);
+    CHECK_EQ(config.min_batch, 5u);
+    CHECK_EQ(config.max_batch, 50u);
+    CHECK_EQ(config.max_tags, 3u);
+    CHECK_EQ(config.metric_names, 7u);
+    CHECK(config.describe().find("series=5000") != std::string::npos);
+
+    CHECK_THROWS(WorkloadConfig::parse("colour=blue"), std::invalid_argument);
+    CHECK_THROWS(WorkloadConfig::parse("series=abc"), std::invalid_argument);
+    CHECK_THROWS(WorkloadConfig::parse("batch=10-5"), std::invalid_argument);
+    CHECK_THROWS(WorkloadConfig::parse("batch=1-5000"), std::invalid_argument);
+}
+
+void series_are_stable_and_distinct() {
+    WorkloadModel model(WorkloadConfig::parse("series=100,names=3,seed=7"));
+    std::mt19937_64 a(1);
+    std::mt19937_64 b(2);
+    std::string first;
+    std::string second;
+    model.append_metric(42, a, first);
+    model.append_metric(42, b, second);
+    // Same name and tags whichever generator draws it; only the value differs
+    CHECK_EQ(first.substr(0, first.find("\"value\"")), second.substr(0, second.find("\"value\"")));
+
+    std::unordered_set<std::string> identities;
+    for (uint64_t i = 0; i < 100; ++i) {
+        std::string metric;
+        model.append_metric(i, a, metric);
+        identities.insert(metric.substr(0, metric.find("\"value\"")));
+    }
+    CHECK_EQ(identities.size(), 100u);
+}
+
+void requests_respect_batch_bounds_and_round_trip() {
+    WorkloadModel model(WorkloadConfig::parse("series=1000,clients=5,batch=3-8"));
+    std::mt19937_64 gen(3);
+    TempDir dir;
+    std::string path = dir.path() + "/requests.log";
+    std::vector<WorkloadRequest> sent;
+    {
+        std::ofstream out(path);
+        for (int i = 0; i < 50; ++i) {
+            WorkloadRequest request = model.next(gen);
+            size_t metrics = count_of(request.body, "\"name\":");
+            CHECK(metrics >= 3 && metrics <= 8);
+            CHECK(request.client_id.rfind("client_", 0) == 0);
+            request_log::append(out, request);
+            sent.push_back(request);
+        }
+    }
+    auto loaded = request_log::load(path);
+    CHECK_EQ(loaded.size(), sent.size());
+    for (size_t i = 0; i < loaded.size() && i < sent.size(); ++i) {
+        CHECK_EQ(loaded[i].client_id, sent[i].client_id);
+        CHECK_EQ(loaded[i].body, sent[i].body);
+    }
+
+    CHECK_THROWS(request_log::load(dir.path() + "/missing.log"), std::runtime_error);
+    std::ofstream(dir.path() + "/bad.log") << "no tab here\n";
+    CHECK_THROWS(request_log::load(dir.path() + "/bad.log"), std::runtime_error);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(zipf_ranks_follow_the_skew);
+    RUN_TEST(config_parses_and_validates);
+    RUN_TEST(series_are_stable_and_distinct);
+    RUN_TEST(requests_respect_batch_bounds_and_round_trip);
+    return metricstream::test::exit_code();
+}
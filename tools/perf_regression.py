@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+"""
+Performance regression harness for the ingestion server.
+
+Starts a fresh metricstream_server on an ephemeral port for every run, drives
+it with load_test_open_loop over a fixed workload matrix, stores the results
+as JSON and compares them against a stored baseline.
+
+Matrix (one cell per combination):
+    queue mode   file | kafka-mock
+    batch size   metrics per POST
+    connections  concurrent client connections
+
+There is no keep-alive dimension: HttpServer answers every request with
+Connection: close, so each request pays for a fresh connection either way.
+
+kafka-mock runs the server in kafka mode against a broker address nobody
+listens on: librdkafka accepts and buffers every message locally, so the
+cell measures the producer path without broker I/O.
+
+Each cell runs --repetitions times. A metric is flagged as a regression when
+it got worse by more than --threshold (relative) AND Welch's t-test over the
+repetitions says the difference is significant at --alpha, so run-to-run
+noise does not fail the check.
+
+Usage:
+    tools/perf_regression.py --build-dir build                 # compare
+    tools/perf_regression.py --build-dir build --update-baseline
+    tools/perf_regression.py --build-dir build --quick         # smaller matrix
+
+Exit status: 0 = no regression, 1 = regression found, 2 = harness error.
+"""
+
+import argparse
+import datetime
+import itertools
+import json
+import math
+import os
+import platform
+import shutil
+import signal
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# (metric name, extractor, higher is better)
+METRICS = [
+    ("throughput", lambda r: r["throughput"], True),
+    ("latency_p50_us", lambda r: r["latency_us"]["p50"], False),
+    ("latency_p99_us", lambda r: r["latency_us"]["p99"], False),
+    ("latency_p99.9_us", lambda r: r["latency_us"]["p99.9"], False),
+    ("error_pct", lambda r: 100.0 * (r["errors"] + r["unsent"]) / max(r["scheduled"], 1), False),
+]
+
+
+# ----------------------------------------------------------------------------
+# Statistics
+# ----------------------------------------------------------------------------
+
+def _betacf(a, b, x):
+    """Continued fraction for the incomplete beta function (Lentz's method)."""
+    tiny = 1e-300
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 201):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def _betainc(a, b, x):
+    """Regularized incomplete beta I_x(a, b)."""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    front = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) +
+                     a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return front * _betacf(a, b, x) / a
+    return 1.0 - front * _betacf(b, a, 1.0 - x) / b
+
+
+def welch_p_value(xs, ys):
+    """Two-sided p-value of Welch's t-test; needs at least two samples each."""
+    n1, n2 = len(xs), len(ys)
+    if n1 < 2 or n2 < 2:
+        return None
+    m1, m2 = statistics.mean(xs), statistics.mean(ys)
+    v1, v2 = statistics.variance(xs), statistics.variance(ys)
+    se2 = v1 / n1 + v2 / n2
+    if se2 == 0.0:
+        return 1.0 if m1 == m2 else 0.0
+    t = (m1 - m2) / math.sqrt(se2)
+    df = se2 * se2 / ((v1 / n1) ** 2 / (n1 - 1) + (v2 / n2) ** 2 / (n2 - 1))
+    return _betainc(df / 2.0, 0.5, df / (df + t * t))
+
+
+# ----------------------------------------------------------------------------
+# Running the workload
+# ----------------------------------------------------------------------------
+
+def free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def wait_for_port(port, process, timeout_s=10.0):
+    deadline = time.time() + timeout_s
+    while time.time() < deadline:
+        if process.poll() is not None:
+            return False
+        try:
+            with socket.create_connection(("127.0.0.1", port), timeout=0.2):
+                return True
+        except OSError:
+            time.sleep(0.05)
+    return False
+
+
+def cell_key(cell):
+    return "mode={mode},batch={batch},conns={connections}".format(**cell)
+
+
+def run_once(args, cell):
+    """One server start + one load run; returns the load generator's JSON summary."""
+    server_bin = os.path.join(args.build_dir, "metricstream_server")
+    load_bin = os.path.join(args.build_dir, "load_test_open_loop")
+    workdir = tempfile.mkdtemp(prefix="metricstream_perf_")
+    port = free_port()
+
+    server_cmd = [server_bin, str(port)]
+    if cell["mode"] == "kafka-mock":
+        server_cmd += ["kafka", args.kafka_mock_brokers]
+    else:
+        server_cmd += ["file"]
+
+    log = open(os.path.join(workdir, "server.log"), "w")
+    server = subprocess.Popen(server_cmd, cwd=workdir, stdout=log, stderr=subprocess.STDOUT)
+    keep_workdir = False
+    try:
+        if not wait_for_port(port, server):
+            keep_workdir = True
+            raise RuntimeError("server did not start (see %s/server.log)" % workdir)
+
+        summary_path = os.path.join(workdir, "summary.json")
+        load_cmd = [load_bin, str(port), str(args.rate), str(args.duration),
+                    str(cell["connections"]), str(min(args.threads, cell["connections"])),
+                    "--batch=%d" % cell["batch"], "--close", "--json=" + summary_path]
+        subprocess.run(load_cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                       timeout=args.duration + 60)
+        if not os.path.exists(summary_path):
+            raise RuntimeError("load generator wrote no summary for " + cell_key(cell))
+        with open(summary_path) as f:
+            return json.load(f)
+    finally:
+        server.send_signal(signal.SIGTERM)
+        try:
+            server.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            server.kill()
+            server.wait()
+        log.close()
+        if not keep_workdir:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+
+def workload_matrix(args):
+    # Batches up to 100 metrics (about 15 KB) exercise multi-read request bodies
+    modes = ["file", "kafka-mock"] if not args.file_only else ["file"]
+    batches = [1, 10] if args.quick else [1, 10, 100]
+    connections = [8] if args.quick else [4, 32]
+    for mode, batch, conns in itertools.product(modes, batches, connections):
+        yield {"mode": mode, "batch": batch, "connections": conns}
+
+
+def git_revision():
+    try:
+        return subprocess.check_output(["git", "rev-parse", "--short", "HEAD"], cwd=REPO_ROOT,
+                                       stderr=subprocess.DEVNULL, text=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def run_matrix(args):
+    results = {
+        "meta": {
+            "revision": git_revision(),
+            "date": datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="seconds"),
+            "host": platform.node(),
+            "cpus": os.cpu_count(),
+            "rate": args.rate,
+            "duration_s": args.duration,
+            "repetitions": args.repetitions,
+        },
+        "cells": {},
+    }
+    cells = list(workload_matrix(args))
+    for index, cell in enumerate(cells, 1):
+        key = cell_key(cell)
+        runs = []
+        for rep in range(args.repetitions):
+            print("[%d/%d] %s run %d/%d" % (index, len(cells), key, rep + 1, args.repetitions), flush=True)
+            runs.append(run_once(args, cell))
+        results["cells"][key] = {"config": cell, "runs": runs}
+    return results
+
+
+# ----------------------------------------------------------------------------
+# Comparison
+# ----------------------------------------------------------------------------
+
+def compare(baseline, current, threshold, alpha):
+    """Returns (report lines, regression count)."""
+    lines = []
+    regressions = 0
+    header = "%-58s %-18s %12s %12s %8s %8s" % ("cell", "metric", "baseline", "current", "change", "p")
+    lines.append(header)
+    lines.append("-" * len(header))
+    for key, cell in current["cells"].items():
+        base_cell = baseline["cells"].get(key)
+        if base_cell is None:
+            lines.append("%-58s (not in baseline)" % key)
+            continue
+        for name, extract, higher_better in METRICS:
+            xs = [extract(r) for r in base_cell["runs"]]
+            ys = [extract(r) for r in cell["runs"]]
+            base_mean, cur_mean = statistics.mean(xs), statistics.mean(ys)
+            if base_mean == 0.0:
+                change = 0.0 if cur_mean == 0.0 else math.inf
+            else:
+                change = (cur_mean - base_mean) / abs(base_mean)
+            worse = -change if higher_better else change
+            p = welch_p_value(xs, ys)
+            significant = p is not None and p < alpha
+            flag = ""
+            if worse > threshold and significant:
+                flag = "  REGRESSION"
+                regressions += 1
+            elif -worse > threshold and significant:
+                flag = "  improved"
+            lines.append("%-58s %-18s %12.1f %12.1f %+7.1f%% %8s%s" % (
+                key, name, base_mean, cur_mean, change * 100.0,
+                "n/a" if p is None else "%.3f" % p, flag))
+    return lines, regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--build-dir", default=os.path.join(REPO_ROOT, "build"))
+    parser.add_argument("--baseline", default=os.path.join(REPO_ROOT, "perf", "baseline.json"))
+    parser.add_argument("--results-dir", default=os.path.join(REPO_ROOT, "perf", "results"))
+    parser.add_argument("--repetitions", type=int, default=3)
+    parser.add_argument("--duration", type=int, default=5, help="seconds per run")
+    parser.add_argument("--rate", type=float, default=2000.0, help="scheduled requests per second")
+    parser.add_argument("--threads", type=int, default=2, help="load generator threads")
+    parser.add_argument("--threshold", type=float, default=0.10, help="relative change that counts")
+    parser.add_argument("--alpha", type=float, default=0.05, help="significance level")
+    parser.add_argument("--kafka-mock-brokers", default="127.0.0.1:1")
+    parser.add_argument("--quick", action="store_true", help="reduced matrix")
+    parser.add_argument("--file-only", action="store_true", help="skip kafka-mock cells")
+    parser.add_argument("--update-baseline", action="store_true")
+    parser.add_argument("--compare-only", metavar="RESULTS", help="compare a stored results file, no runs")
+    args = parser.parse_args()
+
+    if args.compare_only:
+        with open(args.compare_only) as f:
+            current = json.load(f)
+    else:
+        for binary in ("metricstream_server", "load_test_open_loop"):
+            if not os.access(os.path.join(args.build_dir, binary), os.X_OK):
+                print("Missing %s in %s - build it first" % (binary, args.build_dir), file=sys.stderr)
+                return 2
+        try:
+            current = run_matrix(args)
+        except (RuntimeError, subprocess.TimeoutExpired) as e:
+            print("Harness error: %s" % e, file=sys.stderr)
+            return 2
+        os.makedirs(args.results_dir, exist_ok=True)
+        stamp = datetime.datetime.now().strftime("%Y%m%d-%H%M%S")
+        results_path = os.path.join(args.results_dir, "%s-%s.json" % (stamp, current["meta"]["revision"]))
+        with open(results_path, "w") as f:
+            json.dump(current, f, indent=2)
+        print("Results: " + results_path)
+
+    if args.update_baseline:
+        os.makedirs(os.path.dirname(args.baseline), exist_ok=True)
+        with open(args.baseline, "w") as f:
+            json.dump(current, f, indent=2)
+        print("Baseline updated: " + args.baseline)
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print("No baseline at %s - run with --update-baseline first" % args.baseline)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    print("\nBaseline %s (%s) vs current %s" % (baseline["meta"]["revision"], baseline["meta"]["date"],
+                                               current["meta"]["revision"]))
+    lines, regressions = compare(baseline, current, args.threshold, args.alpha)
+    print("\n".join(lines))
+    if regressions:
+        print("\n%d significant regression(s)" % regressions)
+        return 1
+    print("\nNo significant regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())